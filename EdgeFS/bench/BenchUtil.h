@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+class BenchUtil
+{
+public:
+    static uint64_t nowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    // samples会被排序
+    static uint64_t percentile(std::vector<uint64_t>& samples, double p)
+    {
+        if (samples.empty())
+        {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        size_t idx = (size_t)(p / 100.0 * (samples.size() - 1));
+        return samples[idx];
+    }
+
+    static uint64_t average(const std::vector<uint64_t>& samples)
+    {
+        if (samples.empty())
+        {
+            return 0;
+        }
+        uint64_t total = 0;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            total += samples[i];
+        }
+        return total / samples.size();
+    }
+
+    // 清空并重新创建测试目录
+    static bool resetDir(const std::string& dir)
+    {
+        std::string cmd = "rm -rf '" + dir + "' && mkdir -p '" + dir + "'";
+        return 0 == system(cmd.c_str());
+    }
+};
+
+// 文件大小分布，spec的单位为KB: fixed:N uniform:MIN:MAX exp:MEAN，返回的大小单位为字节，不超过maxSize
+class ValueDist
+{
+public:
+    bool init(const std::string& spec, uint64_t maxSize)
+    {
+        m_maxSize = maxSize;
+        unsigned long long a = 0;
+        unsigned long long b = 0;
+        if (1 == sscanf(spec.c_str(), "fixed:%llu", &a) && 0 != a)
+        {
+            m_type = 'f';
+        }
+        else if (2 == sscanf(spec.c_str(), "uniform:%llu:%llu", &a, &b) && 0 != a && a <= b)
+        {
+            m_type = 'u';
+        }
+        else if (1 == sscanf(spec.c_str(), "exp:%llu", &a) && 0 != a)
+        {
+            m_type = 'e';
+        }
+        else
+        {
+            return false;
+        }
+        m_a = a * 1024;
+        m_b = b * 1024;
+        return true;
+    }
+
+    uint64_t next(std::mt19937_64& rng) const
+    {
+        uint64_t size = m_a;
+        if ('u' == m_type)
+        {
+            size = m_a + rng() % (m_b - m_a + 1);
+        }
+        else if ('e' == m_type)
+        {
+            size = (uint64_t)std::exponential_distribution<double>(1.0 / m_a)(rng) + 1;
+        }
+        return std::min(size, m_maxSize);
+    }
+
+private:
+    char            m_type;
+    uint64_t        m_a;
+    uint64_t        m_b;
+    uint64_t        m_maxSize;
+};
+
+// Zipf分布的排名，返回[0, num)，0最热门，s越大热点越集中
+class ZipfDist
+{
+public:
+    ZipfDist(uint32_t num, double s)
+    : m_cdf(num)
+    {
+        double sum = 0;
+        for (uint32_t i = 0; i < num; i++)
+        {
+            sum += 1.0 / pow(i + 1, s);
+            m_cdf[i] = sum;
+        }
+        for (uint32_t i = 0; i < num; i++)
+        {
+            m_cdf[i] /= sum;
+        }
+    }
+
+    uint32_t next(std::mt19937_64& rng) const
+    {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        size_t idx = std::lower_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin();
+        return (uint32_t)std::min(idx, m_cdf.size() - 1);
+    }
+
+private:
+    std::vector<double>     m_cdf;
+};
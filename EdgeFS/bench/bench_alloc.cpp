@@ -0,0 +1,174 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <new>
+
+/*
+统计稳定状态下每次读写调用的堆内存申请次数和耗时，key接口要求0次申请
+原地写入和日志结构模式(同时开启并发读取)各运行一次
+用法: edgefs_bench_alloc [dir] [loopNum]
+*/
+
+static std::atomic<uint64_t> g_allocNum(0);
+
+void* operator new(size_t size)
+{
+    g_allocNum++;
+    void* ptr = malloc(size ? size : 1);
+    if (NULL == ptr)
+    {
+        abort();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+struct AllocResult
+{
+    uint64_t    allocNum;
+    uint64_t    costNs;
+};
+
+// 先按相同的参数预热一遍，读取线程的临时数组增长到需要的容量后才是稳定状态
+template<typename Func>
+static AllocResult runLoop(uint32_t loopNum, Func func)
+{
+    for (uint32_t i = 0; i < loopNum; i++)
+    {
+        func(i);
+    }
+
+    AllocResult result;
+    uint64_t allocStart = g_allocNum;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < loopNum; i++)
+    {
+        func(i);
+    }
+    result.costNs = BenchUtil::nowNs() - start;
+    result.allocNum = g_allocNum - allocStart;
+    return result;
+}
+
+static void printResult(const char* mode, const char* name, uint32_t loopNum, const AllocResult& result)
+{
+    printf("[%s][%s] calls %u allocs %" PRIu64 " allocs/call %.3f latency %.0fns\n", mode, name, loopNum,
+        result.allocNum, (double)result.allocNum / loopNum, (double)result.costNs / loopNum);
+}
+
+// isLogStruct时使用日志结构模式和并发读取，读取需要把位置映射到段中的物理位置并拆分为小段
+static bool runFS(const std::string& dir, uint32_t loopNum, bool isLogStruct)
+{
+    const char* mode = isLogStruct ? "logstruct" : "inplace";
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 1024ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 4 * 1024 * 1024;
+    sinfo.m_packMaxFileSize = 4096;
+    sinfo.m_packRecordNum = 1024;
+    if (isLogStruct)
+    {
+        sinfo.m_logSegmentSize = 4 * 1024 * 1024;
+        sinfo.m_readThreadNum = 2;
+    }
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    const std::string bigName = "alloc_big";
+    const std::string smallName = "alloc_small";
+    const std::string appendName = "alloc_append";
+    FileKey bigKey, smallKey, appendKey;
+    CalcFileKey(bigName.c_str(), bigName.size(), bigKey);
+    CalcFileKey(smallName.c_str(), smallName.size(), smallKey);
+    CalcFileKey(appendName.c_str(), appendName.size(), appendKey);
+
+    std::vector<char> buff(1024 * 1024, 'a');
+    const uint32_t readLen = 64 * 1024;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        efs->write(bigKey, &buff[0], buff.size(), 0);
+    }
+    efs->write(smallKey, &buff[0], 2048, 0);
+    // 超过打包大小，避免循环中发生一次性的打包文件迁移
+    efs->write(appendKey, &buff[0], 8192, 0);
+
+    const uint64_t bigSize = 16ull * buff.size() - readLen;
+    bool isOk = true;
+    AllocResult result;
+
+    result = runLoop(loopNum, [&](uint32_t i) {
+        efs->read(bigKey, &buff[0], readLen, (i * 7919ull * 4096) % bigSize);
+    });
+    printResult(mode, "read key 64KB", loopNum, result);
+    isOk = isOk && 0 == result.allocNum;
+
+    result = runLoop(loopNum, [&](uint32_t i) {
+        efs->read(smallKey, &buff[0], 2048, 0);
+    });
+    printResult(mode, "read key packed 2KB", loopNum, result);
+    isOk = isOk && 0 == result.allocNum;
+
+    // 达到kParallelReadMinSize，开启并发读取时由读取线程拆分读取
+    const uint32_t parallelLoopNum = std::max(loopNum / 100, 1u);
+    result = runLoop(parallelLoopNum, [&](uint32_t i) {
+        efs->read(bigKey, &buff[0], buff.size(), (i * 7919ull * 4096) % (bigSize + readLen - buff.size()));
+    });
+    printResult(mode, "read key 1MB", parallelLoopNum, result);
+    isOk = isOk && 0 == result.allocNum;
+
+    result = runLoop(loopNum, [&](uint32_t i) {
+        efs->write(appendKey, &buff[0], 512, 0);
+    });
+    printResult(mode, "append key 512B", loopNum, result);
+    isOk = isOk && 0 == result.allocNum;
+
+    result = runLoop(loopNum, [&](uint32_t i) {
+        efs->read(bigName, &buff[0], readLen, (i * 7919ull * 4096) % bigSize);
+    });
+    printResult(mode, "read name 64KB", loopNum, result);
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return isOk;
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "./bench_data";
+    uint32_t loopNum = argc > 2 ? atoi(argv[2]) : 100000;
+
+    bool isOk = runFS(dir + "/inplace", loopNum, false);
+    isOk = runFS(dir + "/logstruct", loopNum, true) && isOk;
+
+    printf("%s\n", isOk ? "zero allocation check passed" : "zero allocation check FAILED");
+    return isOk ? 0 : 1;
+}
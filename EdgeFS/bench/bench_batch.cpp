@@ -0,0 +1,155 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+对比逐个调用和批量接口读写一组小文件的吞吐
+一批文件按顺序写入，读取时既测试整批读取，也测试随机组合的批次
+用法: edgefs_bench_batch [dir] [fileNum] [batchNum] [fileSize]
+*/
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        fileNum;
+    uint32_t        batchNum;
+    uint32_t        fileSize;
+};
+
+static void printResult(const char* name, uint32_t fileNum, uint64_t costNs, uint32_t okNum)
+{
+    printf("[%s] files %u ok %u cost %.1fms %.0f files/s\n", name, fileNum, okNum, costNs / 1e6,
+        fileNum * 1e9 / (costNs ? costNs : 1));
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileNum = argc > 2 ? atoi(argv[2]) : 20000;
+    conf.batchNum = argc > 3 ? atoi(argv[3]) : 32;
+    conf.fileSize = argc > 4 ? atoi(argv[4]) : 4096;
+
+    if (0 == conf.batchNum || conf.fileNum < conf.batchNum || 0 == conf.fileSize)
+    {
+        printf("usage: %s [dir] [fileNum] [batchNum] [fileSize]\n", argv[0]);
+        return -1;
+    }
+    conf.fileNum = conf.fileNum / conf.batchNum * conf.batchNum;
+
+    if (!BenchUtil::resetDir(conf.dir))
+    {
+        printf("reset dir %s failed\n", conf.dir.c_str());
+        return -1;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 4096ull * 1024 * 1024;
+    sinfo.m_diskRootDir = conf.dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    sinfo.m_packMaxFileSize = 16 * 1024;
+    sinfo.m_packRecordNum = conf.fileNum * 4;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return -1;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    std::vector<std::string> singleNames(conf.fileNum), batchNames(conf.fileNum);
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        singleNames[i] = "single_segment_" + std::to_string(i) + ".ts";
+        batchNames[i] = "batch_segment_" + std::to_string(i) + ".ts";
+    }
+    std::vector<char> writeBuff(conf.fileSize, 'w');
+    std::vector<char> readBuff((uint64_t)conf.fileSize * conf.batchNum);
+
+    // 写入
+    uint32_t okNum = 0;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        okNum += conf.fileSize == efs->write(singleNames[i], &writeBuff[0], conf.fileSize) ? 1 : 0;
+    }
+    printResult("write single", conf.fileNum, BenchUtil::nowNs() - start, okNum);
+
+    std::vector<WriteRequest> writeReqs(conf.batchNum);
+    okNum = 0;
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i += conf.batchNum)
+    {
+        for (uint32_t j = 0; j < conf.batchNum; j++)
+        {
+            writeReqs[j].m_fileName = batchNames[i + j];
+            writeReqs[j].m_buff = &writeBuff[0];
+            writeReqs[j].m_len = conf.fileSize;
+        }
+        okNum += efs->writeBatch(writeReqs);
+    }
+    printResult("write batch", conf.fileNum, BenchUtil::nowNs() - start, okNum);
+
+    // 按照写入时的分组读取
+    okNum = 0;
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        okNum += conf.fileSize == efs->read(batchNames[i], &readBuff[0], conf.fileSize, 0) ? 1 : 0;
+    }
+    printResult("read single", conf.fileNum, BenchUtil::nowNs() - start, okNum);
+
+    std::vector<ReadRequest> readReqs(conf.batchNum);
+    okNum = 0;
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i += conf.batchNum)
+    {
+        for (uint32_t j = 0; j < conf.batchNum; j++)
+        {
+            readReqs[j].m_fileName = batchNames[i + j];
+            readReqs[j].m_buff = &readBuff[(uint64_t)j * conf.fileSize];
+            readReqs[j].m_len = conf.fileSize;
+        }
+        okNum += efs->readBatch(readReqs);
+    }
+    printResult("read batch", conf.fileNum, BenchUtil::nowNs() - start, okNum);
+
+    // 随机组合的批次，磁盘上基本不相邻
+    std::default_random_engine e(1);
+    std::uniform_int_distribution<uint32_t> idxDist(0, conf.fileNum - 1);
+    std::vector<uint32_t> randIdxs(conf.fileNum);
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        randIdxs[i] = idxDist(e);
+    }
+
+    okNum = 0;
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        okNum += conf.fileSize == efs->read(batchNames[randIdxs[i]], &readBuff[0], conf.fileSize, 0) ? 1 : 0;
+    }
+    printResult("read single random", conf.fileNum, BenchUtil::nowNs() - start, okNum);
+
+    okNum = 0;
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i += conf.batchNum)
+    {
+        for (uint32_t j = 0; j < conf.batchNum; j++)
+        {
+            readReqs[j].m_fileName = batchNames[randIdxs[i + j]];
+            readReqs[j].m_buff = &readBuff[(uint64_t)j * conf.fileSize];
+            readReqs[j].m_len = conf.fileSize;
+        }
+        okNum += efs->readBatch(readReqs);
+    }
+    printResult("read batch random", conf.fileNum, BenchUtil::nowNs() - start, okNum);
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return 0;
+}
@@ -0,0 +1,339 @@
+#include "../src/common/common.h"
+#include "../src/common/StrStream.h"
+#include "../src/Bitmap.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <map>
+
+/*
+common下基础组件的微基准: sha1、hex编解码、StrStream、Bitmap、mediaLog、AsyncLogging::log和二进制日志
+每个用例按输入大小和线程数分别测量，每行输出一个json，线程数为1到maxThreads的2的幂
+size为输入的字节数，Bitmap为1M个位置，除日志外每个线程使用自己的对象
+日志为全局单例，关闭调用点限速和文件滚动，缓冲区满时丢弃，keptPct为实际写入文件的比例
+指定baseline时和之前保存的输出比较，nsPerOp超过基线tolerancePct%的用例视为退化，有退化或者基线中没有的用例时返回-1
+baseline/bench_common_release.json为Release编译时在1核虚拟机上的结果，计时的波动较大，应在同一台机器上重新保存基线后比较
+保存基线: edgefs_bench_common ./bench_data 4 > baseline.json
+用法: edgefs_bench_common [dir] [maxThreads] [baseline] [tolerancePct]
+*/
+
+typedef struct CaseResult_
+{
+    std::string     m_name;
+    uint32_t        m_size;
+    uint32_t        m_threadNum;
+    double          m_nsPerOp;
+} CaseResult;
+
+static const uint32_t kRepeatNum = 3;
+static std::atomic<uint64_t> g_sink(0);
+static std::vector<CaseResult> g_results;
+
+// 每个线程执行func(tid, opNum)，nsPerOp为单个线程平均每次调用的耗时，重复kRepeatNum次取最快的一次
+static double runCase(const std::string& name, uint32_t size, uint32_t threadNum, uint64_t opNum,
+    const std::function<void(uint32_t, uint64_t)>& func)
+{
+    uint64_t costNs = UINT64_MAX;
+    for (uint32_t repeat = 0; repeat < kRepeatNum; repeat++)
+    {
+        std::vector<std::thread> threads;
+        uint64_t start = BenchUtil::nowNs();
+        for (uint32_t tid = 0; tid < threadNum; tid++)
+        {
+            threads.push_back(std::thread(func, tid, opNum));
+        }
+        for (auto it = threads.begin(); it != threads.end(); ++it)
+        {
+            it->join();
+        }
+        costNs = std::min(costNs, BenchUtil::nowNs() - start);
+    }
+    double nsPerOp = (double)costNs / opNum;
+    double sec = costNs / 1e9;
+    printf("{\"case\":\"%s\",\"size\":%u,\"threads\":%u,\"ops\":%" PRIu64 ",\"nsPerOp\":%.1f,\"opsPerSec\":%.0f"
+        ",\"mbPerSec\":%.2f}\n", name.c_str(), size, threadNum, opNum * threadNum, nsPerOp, opNum * threadNum / sec,
+        (double)size * opNum * threadNum / sec / 1048576);
+    fflush(stdout);
+    CaseResult result = { name, size, threadNum, nsPerOp };
+    g_results.push_back(result);
+    return nsPerOp;
+}
+
+// 按输入大小确定调用次数，每个用例处理的数据量相近
+static uint64_t calcOpNum(uint32_t size)
+{
+    return std::min<uint64_t>(std::max<uint64_t>(16ull * 1024 * 1024 / std::max(size, 1u), 16), 200000);
+}
+
+static uint64_t countLines(const std::string& path)
+{
+    FILE* fp = fopen(path.c_str(), "r");
+    uint64_t lineNum = 0;
+    char buff[65536];
+    size_t len = 0;
+    while (NULL != fp && 0 != (len = fread(buff, 1, sizeof(buff), fp)))
+    {
+        lineNum += std::count(buff, buff + len, '\n');
+    }
+    if (NULL != fp)
+    {
+        fclose(fp);
+    }
+    return lineNum;
+}
+
+static void benchSha(uint32_t threadNum)
+{
+    const uint32_t sizes[] = { 16, 64, 256, 1024, 4096, 65536, 1048576 };
+    for (uint32_t size : sizes)
+    {
+        runCase("sha1", size, threadNum, calcOpNum(size), [size](uint32_t, uint64_t opNum) {
+            std::vector<char> data(size, 's');
+            char digest[SHA_DIGEST_LENGTH] = { '\0' };
+            for (uint64_t i = 0; i < opNum; i++)
+            {
+                data[0] = (char)i;
+                ShaHelper::calcShaToHex(&data[0], size, digest);
+            }
+            g_sink += (uint8_t)digest[0];
+        });
+    }
+}
+
+static void benchHex(uint32_t threadNum)
+{
+    const uint32_t sizes[] = { SHA_DIGEST_LENGTH, 256, 4096 };
+    for (uint32_t size : sizes)
+    {
+        runCase("shaStrToHex", size, threadNum, calcOpNum(size) / 8, [size](uint32_t, uint64_t opNum) {
+            std::string in(size, '\xa5');
+            std::string out;
+            for (uint64_t i = 0; i < opNum; i++)
+            {
+                in[0] = (char)i;
+                ShaHelper::shaStrToHex(in, out);
+            }
+            g_sink += out.size();
+        });
+        runCase("shaHexToStr", size * 2, threadNum, calcOpNum(size) / 8, [size](uint32_t, uint64_t opNum) {
+            std::string in = ShaHelper::shaStrToHex(std::string(size, '\x5a'));
+            std::string out;
+            for (uint64_t i = 0; i < opNum; i++)
+            {
+                in[0] = "0123456789abcdef"[i % 16];
+                ShaHelper::shaHexToStr(in, out);
+            }
+            g_sink += out.size();
+        });
+    }
+}
+
+static void benchStrStream(uint32_t threadNum)
+{
+    // 一行典型日志的8个字段
+    runCase("strStream", 0, threadNum, 200000, [](uint32_t, uint64_t opNum) {
+        apd_vp2p::StrStream ss;
+        const std::string fileName = "http://edge/obj/1234.mp4";
+        for (uint64_t i = 0; i < opNum; i++)
+        {
+            ss << "fileName " << fileName << " offset " << (uint64_t)i << " len " << (uint32_t)4096 << " cost "
+                << (float)1.5;
+            g_sink += ss.size();
+            ss.reset();
+        }
+    });
+}
+
+static void benchBitmap(uint32_t threadNum)
+{
+    const uint32_t idxNum = 1 << 20;
+    const uint32_t fillPcts[] = { 50, 90 };
+    // 90%占用时16个连续空闲位置几乎不存在，每次都会扫描整个bitmap
+    const uint8_t orders[] = { 0, 2 };
+    for (uint32_t fillPct : fillPcts)
+    {
+        // 每个线程一个bitmap，按比例随机占用
+        std::vector<std::vector<uint8_t> > buffs(threadNum, std::vector<uint8_t>(idxNum / 8));
+        std::vector<Bitmap> bitmaps(threadNum);
+        for (uint32_t tid = 0; tid < threadNum; tid++)
+        {
+            bitmaps[tid].initBitmap(&buffs[tid][0], idxNum / 8, idxNum);
+            std::mt19937_64 rng(tid);
+            for (uint32_t idx = 0; idx < idxNum; idx++)
+            {
+                if (rng() % 100 < fillPct)
+                {
+                    bitmaps[tid].insert(idx);
+                }
+            }
+        }
+        std::string suffix = "_f" + std::to_string(fillPct);
+
+        runCase("bitmap_isHave" + suffix, 0, threadNum, 1000000, [&bitmaps](uint32_t tid, uint64_t opNum) {
+            uint64_t haveNum = 0;
+            for (uint64_t i = 0; i < opNum; i++)
+            {
+                haveNum += bitmaps[tid].isHave((uint32_t)(i * 2654435761u) % idxNum) ? 1 : 0;
+            }
+            g_sink += haveNum;
+        });
+        for (uint8_t order : orders)
+        {
+            std::string name = "bitmap_extent_o" + std::to_string(order) + suffix;
+            runCase(name, 0, threadNum, 2000, [&bitmaps, order](uint32_t tid, uint64_t opNum) {
+                uint32_t startIdx = 0;
+                uint32_t scanNum = 0;
+                for (uint64_t i = 0; i < opNum; i++)
+                {
+                    bitmaps[tid].generateIdleExtent(order, startIdx, scanNum);
+                }
+                g_sink += startIdx + scanNum;
+            });
+        }
+    }
+}
+
+static void benchLog(const std::string& logPath, const std::string& binaryLogPath, uint32_t threadNum)
+{
+    // 测量日志本身的开销，不测量被调用点限速拒绝的路径
+    // 不滚动文件，改名后文件的行数变少，按行数计算的写入比例会出错
+    AsyncLogging::instance()->setSiteRateLimit(0, 0);
+    AsyncLogging::instance()->setRotate(0, 0);
+    AsyncLogging::instance()->setLogLevel(LogLevel_INFO);
+    runCase("mediaLog_filtered", 0, threadNum, 1000000, [](uint32_t, uint64_t opNum) {
+        for (uint64_t i = 0; i < opNum; i++)
+        {
+            ldebug("filtered %" PRIu64, i);
+        }
+    });
+
+    const uint32_t sizes[] = { 64, 512 };
+    for (uint32_t size : sizes)
+    {
+        std::string msg(size, 'l');
+        // 等待上一个用例的日志写完，按文件增加的行数计算写入比例
+        usleep(200 * 1000);
+        uint64_t lineNum = countLines(logPath);
+        runCase("asyncLog", size, threadNum, 20000, [&msg](uint32_t, uint64_t opNum) {
+            for (uint64_t i = 0; i < opNum; i++)
+            {
+                AsyncLogging::instance()->log(msg);
+            }
+        });
+        usleep(200 * 1000);
+        uint64_t keptNum = countLines(logPath) - lineNum;
+        printf("{\"case\":\"asyncLog_kept\",\"size\":%u,\"threads\":%u,\"keptPct\":%.2f}\n", size, threadNum,
+            keptNum * 100.0 / (20000.0 * threadNum * kRepeatNum));
+
+        lineNum = countLines(logPath);
+        runCase("mediaLog", size, threadNum, 20000, [&msg](uint32_t, uint64_t opNum) {
+            for (uint64_t i = 0; i < opNum; i++)
+            {
+                linfo("offset %" PRIu64 " msg %s", i, msg.c_str());
+            }
+        });
+        usleep(200 * 1000);
+        keptNum = countLines(logPath) - lineNum;
+        printf("{\"case\":\"mediaLog_kept\",\"size\":%u,\"threads\":%u,\"keptPct\":%.2f}\n", size, threadNum,
+            keptNum * 100.0 / (20000.0 * threadNum * kRepeatNum));
+
+        // 二进制文件不能按行计数，按缓冲区满丢弃和限速丢弃的条数计算写入比例
+        AsyncLogging::instance()->init(binaryLogPath, true);
+        uint64_t dropNum = AsyncLogging::instance()->getDropNum() + AsyncLogging::instance()->getSuppressNum();
+        runCase("binaryLog", size, threadNum, 20000, [&msg](uint32_t, uint64_t opNum) {
+            for (uint64_t i = 0; i < opNum; i++)
+            {
+                linfo("offset %" PRIu64 " msg %s", i, msg.c_str());
+            }
+        });
+        AsyncLogging::instance()->flush();
+        dropNum = AsyncLogging::instance()->getDropNum() + AsyncLogging::instance()->getSuppressNum() - dropNum;
+        printf("{\"case\":\"binaryLog_kept\",\"size\":%u,\"threads\":%u,\"keptPct\":%.2f}\n", size, threadNum,
+            100.0 - dropNum * 100.0 / (20000.0 * threadNum * kRepeatNum));
+        AsyncLogging::instance()->init(logPath);
+    }
+}
+
+// 读取之前保存的输出，比较每个用例的nsPerOp，返回退化的用例和基线中没有的用例个数
+// 基线中没有的用例无法判断是否退化，新增或者修改用例后需要重新保存基线
+static uint32_t compareBaseline(const std::string& path, double tolerancePct)
+{
+    FILE* fp = fopen(path.c_str(), "r");
+    if (NULL == fp)
+    {
+        printf("{\"error\":\"open baseline failed\",\"baseline\":\"%s\"}\n", path.c_str());
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    char line[1024];
+    char name[128];
+    unsigned int size = 0;
+    unsigned int threadNum = 0;
+    unsigned long long opNum = 0;
+    double nsPerOp = 0;
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        if (5 == sscanf(line, "{\"case\":\"%127[^\"]\",\"size\":%u,\"threads\":%u,\"ops\":%llu,\"nsPerOp\":%lf",
+            name, &size, &threadNum, &opNum, &nsPerOp))
+        {
+            baseline[std::string(name) + "/" + std::to_string(size) + "/" + std::to_string(threadNum)] = nsPerOp;
+        }
+    }
+    fclose(fp);
+
+    uint32_t regressNum = 0;
+    for (auto it = g_results.begin(); it != g_results.end(); ++it)
+    {
+        std::string key = it->m_name + "/" + std::to_string(it->m_size) + "/" + std::to_string(it->m_threadNum);
+        auto baseIt = baseline.find(key);
+        if (baseline.end() == baseIt)
+        {
+            printf("{\"missing\":\"%s\",\"nsPerOp\":%.1f}\n", key.c_str(), it->m_nsPerOp);
+            regressNum++;
+            continue;
+        }
+        if (it->m_nsPerOp <= baseIt->second * (1 + tolerancePct / 100))
+        {
+            continue;
+        }
+        printf("{\"regression\":\"%s\",\"nsPerOp\":%.1f,\"baselineNsPerOp\":%.1f,\"changePct\":%.1f}\n",
+            key.c_str(), it->m_nsPerOp, baseIt->second, (it->m_nsPerOp / baseIt->second - 1) * 100);
+        regressNum++;
+    }
+    return regressNum;
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "./bench_data";
+    uint32_t maxThreadNum = argc > 2 ? atoi(argv[2]) : 4;
+    std::string baselinePath = argc > 3 ? argv[3] : "";
+    double tolerancePct = argc > 4 ? atof(argv[4]) : 50;
+
+    if (0 == maxThreadNum || tolerancePct <= 0)
+    {
+        printf("usage: %s [dir] [maxThreads] [baseline] [tolerancePct]\n", argv[0]);
+        return -1;
+    }
+    if (!BenchUtil::resetDir(dir + "/common"))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return -1;
+    }
+    std::string logPath = dir + "/common/bench_common.log";
+    std::string binaryLogPath = dir + "/common/bench_common.blog";
+    AsyncLogging::create();
+    AsyncLogging::instance()->init(logPath);
+
+    for (uint32_t threadNum = 1; threadNum <= maxThreadNum; threadNum *= 2)
+    {
+        benchSha(threadNum);
+        benchHex(threadNum);
+        benchStrStream(threadNum);
+        benchBitmap(threadNum);
+        benchLog(logPath, binaryLogPath, threadNum);
+    }
+    AsyncLogging::release();
+
+    return baselinePath.empty() || 0 == compareBaseline(baselinePath, tolerancePct) ? 0 : -1;
+}
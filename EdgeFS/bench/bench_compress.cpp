@@ -0,0 +1,169 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+对比压缩开启前后写入、整文件读取和随机小段读取的吞吐，以及压缩率
+数据分为可压缩的文本(类似json日志)和不可压缩的随机数据两种
+用法: edgefs_bench_compress [dir] [fileNum] [fileKB] [writeKB] [randReadNum]
+*/
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        fileNum;
+    uint32_t        fileSize;
+    uint32_t        writeLen;
+    uint32_t        randReadNum;    // 随机读取4KB的次数
+};
+
+static void fillText(std::default_random_engine& e, std::vector<char>& content)
+{
+    static const char* keys[] = { "url", "status", "bytes", "referer", "ua", "cache" };
+    static const char* values[] = { "HIT", "MISS", "200", "206", "304", "\"Mozilla/5.0\"", "\"-\"" };
+
+    std::string text;
+    while (text.size() < content.size())
+    {
+        text += "{\"ts\":" + std::to_string(1600000000 + e() % 100000);
+        for (uint32_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+        {
+            text += std::string(",\"") + keys[i] + "\":" + values[e() % (sizeof(values) / sizeof(values[0]))];
+        }
+        text += ",\"id\":" + std::to_string(e() % 1000000) + "}\n";
+    }
+    memcpy(&content[0], text.data(), content.size());
+}
+
+static void fillRandom(std::default_random_engine& e, std::vector<char>& content)
+{
+    for (uint32_t i = 0; i < content.size(); i++)
+    {
+        content[i] = (char)e();
+    }
+}
+
+static bool runBench(const BenchConf& conf, bool isText, bool isCompress)
+{
+    std::string mode = std::string(isText ? "text" : "random") + (isCompress ? " compress" : " raw");
+    std::string dir = conf.dir + "/" + (isText ? "text" : "random") + (isCompress ? "_compress" : "_raw");
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 4096ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    sinfo.m_isCompress = isCompress;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    std::default_random_engine e(1);
+    std::vector<std::vector<char> > contents(conf.fileNum);
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        contents[i].resize(conf.fileSize);
+        isText ? fillText(e, contents[i]) : fillRandom(e, contents[i]);
+    }
+
+    uint64_t totalBytes = (uint64_t)conf.fileNum * conf.fileSize;
+    uint32_t failNum = 0;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        std::string fileName = "http://edge/log_" + std::to_string(i) + ".json";
+        for (uint32_t offset = 0; offset < conf.fileSize; offset += conf.writeLen)
+        {
+            uint32_t len = std::min(conf.writeLen, conf.fileSize - offset);
+            if (len != efs->write(fileName, &contents[i][offset], len, conf.fileSize))
+            {
+                failNum++;
+                break;
+            }
+        }
+    }
+    uint64_t writeNs = BenchUtil::nowNs() - start;
+
+    std::vector<char> buff(conf.fileSize);
+    uint32_t badNum = 0;
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        std::string fileName = "http://edge/log_" + std::to_string(i) + ".json";
+        if (conf.fileSize != efs->read(fileName, &buff[0], conf.fileSize, 0) ||
+            0 != memcmp(&buff[0], &contents[i][0], conf.fileSize))
+        {
+            badNum++;
+        }
+    }
+    uint64_t readNs = BenchUtil::nowNs() - start;
+
+    // 随机读取4KB，只需要解压涉及的chunk
+    const uint32_t kRandReadLen = 4096;
+    std::uniform_int_distribution<uint32_t> fileDist(0, conf.fileNum - 1);
+    std::uniform_int_distribution<uint32_t> offsetDist(0, conf.fileSize - kRandReadLen);
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.randReadNum; i++)
+    {
+        uint32_t idx = fileDist(e);
+        uint32_t offset = offsetDist(e);
+        std::string fileName = "http://edge/log_" + std::to_string(idx) + ".json";
+        if (kRandReadLen != efs->read(fileName, &buff[0], kRandReadLen, offset) ||
+            0 != memcmp(&buff[0], &contents[idx][offset], kRandReadLen))
+        {
+            badNum++;
+        }
+    }
+    uint64_t randReadNs = BenchUtil::nowNs() - start;
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    uint64_t rawBytes = (uint64_t)space.m_compressedChunkNum * space.m_chunkSize;
+    uint64_t storedBytes = space.m_fileBytes - rawBytes + space.m_compressedBytes;
+    printf("[%s] chunkSize %u files %u fileSize %u fail %u bad %u\n", mode.c_str(), space.m_chunkSize,
+        conf.fileNum, conf.fileSize, failNum, badNum);
+    printf("[%s] write %.1fMB/s read %.1fMB/s randRead4K %.0f ops/s\n", mode.c_str(),
+        totalBytes * 1e9 / 1024 / 1024 / (writeNs ? writeNs : 1), totalBytes * 1e9 / 1024 / 1024 / (readNs ? readNs : 1),
+        conf.randReadNum * 1e9 / (randReadNs ? randReadNs : 1));
+    printf("[%s] compressedChunks %u fileBytes %" PRIu64 " storedBytes %" PRIu64 " ratio %.2f\n", mode.c_str(),
+        space.m_compressedChunkNum, space.m_fileBytes, storedBytes,
+        0 == storedBytes ? 0.0 : (double)space.m_fileBytes / storedBytes);
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileNum = argc > 2 ? atoi(argv[2]) : 32;
+    conf.fileSize = (argc > 3 ? atoi(argv[3]) : 4096) * 1024;
+    conf.writeLen = (argc > 4 ? atoi(argv[4]) : 256) * 1024;
+    conf.randReadNum = argc > 5 ? atoi(argv[5]) : 20000;
+
+    if (0 == conf.fileNum || conf.fileSize < 4096 || 0 == conf.writeLen)
+    {
+        printf("usage: %s [dir] [fileNum] [fileKB] [writeKB] [randReadNum]\n", argv[0]);
+        return -1;
+    }
+
+    runBench(conf, true, false);
+    runBench(conf, true, true);
+    runBench(conf, false, false);
+    runBench(conf, false, true);
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+同一内容以不同文件名多次写入的负载下，对比去重开启前后的写入吞吐和空间占用
+用法: edgefs_bench_dedup [dir] [uniqueNum] [copyNum] [fileKB] [writeKB]
+*/
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        uniqueNum;      // 不同内容的文件个数
+    uint32_t        copyNum;        // 每个内容写入的次数
+    uint32_t        fileSize;
+    uint32_t        writeLen;
+};
+
+static bool runBench(const BenchConf& conf, bool isDedup)
+{
+    const char* mode = isDedup ? "dedup" : "nodedup";
+    std::string dir = conf.dir + "/" + mode;
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 4096ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    if (isDedup)
+    {
+        sinfo.m_dedupRecordNum = 16 * 1024;
+        sinfo.m_dedupLinkNum = 64 * 1024;
+    }
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    std::default_random_engine e(1);
+    std::vector<std::vector<char> > contents(conf.uniqueNum);
+    for (uint32_t i = 0; i < conf.uniqueNum; i++)
+    {
+        contents[i].resize(conf.fileSize);
+        for (uint32_t j = 0; j < conf.fileSize; j++)
+        {
+            contents[i][j] = (char)e();
+        }
+    }
+
+    // 同一内容的多个副本交替写入，模拟不同url先后回源
+    uint64_t writeBytes = 0;
+    uint32_t failNum = 0;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t copy = 0; copy < conf.copyNum; copy++)
+    {
+        for (uint32_t i = 0; i < conf.uniqueNum; i++)
+        {
+            std::string fileName = "http://edge/object_" + std::to_string(i) + "?variant=" + std::to_string(copy);
+            for (uint32_t offset = 0; offset < conf.fileSize; offset += conf.writeLen)
+            {
+                uint32_t len = std::min(conf.writeLen, conf.fileSize - offset);
+                if (len != efs->write(fileName, &contents[i][offset], len))
+                {
+                    failNum++;
+                    break;
+                }
+                writeBytes += len;
+            }
+        }
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+
+    // 抽查副本的内容
+    std::vector<char> buff(conf.fileSize);
+    uint32_t badNum = 0;
+    for (uint32_t i = 0; i < conf.uniqueNum; i++)
+    {
+        std::string fileName = "http://edge/object_" + std::to_string(i) + "?variant=" +
+            std::to_string(conf.copyNum - 1);
+        if (conf.fileSize != efs->read(fileName, &buff[0], conf.fileSize, 0) ||
+            0 != memcmp(&buff[0], &contents[i][0], conf.fileSize))
+        {
+            badNum++;
+        }
+    }
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    uint64_t storedBytes = space.m_fileBytes - space.m_dedupBytes;
+    printf("[%s] chunkSize %u write %" PRIu64 "MB fail %u cost %.1fms throughput %.1fMB/s\n", mode, space.m_chunkSize,
+        writeBytes / 1024 / 1024, failNum, costNs / 1e6, writeBytes * 1e9 / 1024 / 1024 / (costNs ? costNs : 1));
+    printf("[%s] usedChunks %u dedupChunks %u fileBytes %" PRIu64 " storedBytes %" PRIu64
+        " dedupRatio %.2f verifyBad %u\n", mode, space.m_usedChunkNum, space.m_dedupChunkNum, space.m_fileBytes,
+        storedBytes, 0 == storedBytes ? 0.0 : (double)space.m_fileBytes / storedBytes, badNum);
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.uniqueNum = argc > 2 ? atoi(argv[2]) : 32;
+    conf.copyNum = argc > 3 ? atoi(argv[3]) : 4;
+    conf.fileSize = (argc > 4 ? atoi(argv[4]) : 4096) * 1024;
+    conf.writeLen = (argc > 5 ? atoi(argv[5]) : 256) * 1024;
+
+    if (0 == conf.uniqueNum || 0 == conf.copyNum || 0 == conf.fileSize || 0 == conf.writeLen)
+    {
+        printf("usage: %s [dir] [uniqueNum] [copyNum] [fileKB] [writeKB]\n", argv[0]);
+        return -1;
+    }
+
+    runBench(conf, false);
+    runBench(conf, true);
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "../src/EdgeFSConst.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+多个文件交替追加写入后数据块互相穿插，对比整理前后的碎片统计和顺序读取的吞吐
+每轮读取前丢弃数据文件的页缓存，读取的内容与写入的内容逐字节比较
+用法: edgefs_bench_defrag [dir] [fileNum] [fileMB] [writeKB] [readKB]
+*/
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        fileNum;
+    uint64_t        fileSize;
+    uint32_t        writeLen;
+    uint32_t        readLen;
+};
+
+static std::string fileNameOf(uint32_t idx)
+{
+    return "http://edge/vod_" + std::to_string(idx) + ".mp4";
+}
+
+static char contentOf(uint32_t idx, uint64_t pos)
+{
+    return (char)(pos * 131 + idx);
+}
+
+static void printSpace(const char* tag, const SpaceInfo& space)
+{
+    printf("[%s] files %u fragmentedFiles %u fragments %u defragFiles %" PRIu64 " defragBytes %" PRIu64 "\n", tag,
+        space.m_dataFileNum, space.m_fragmentedFileNum, space.m_fragmentNum, space.m_defragFileNum,
+        space.m_defragBytes);
+}
+
+// 按照readLen顺序读取所有文件，返回吞吐MB/s，内容不一致时badNum增加
+static double readAll(IEdgeFS* efs, const BenchConf& conf, int dataFd, uint32_t& badNum)
+{
+    fdatasync(dataFd);
+    posix_fadvise(dataFd, 0, 0, POSIX_FADV_DONTNEED);
+
+    std::vector<char> buff(conf.readLen);
+    uint64_t totalBytes = 0;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t idx = 0; idx < conf.fileNum; idx++)
+    {
+        for (uint64_t pos = 0; pos < conf.fileSize; pos += conf.readLen)
+        {
+            int64_t len = efs->read(fileNameOf(idx), &buff[0], conf.readLen, pos);
+            if (len <= 0)
+            {
+                badNum++;
+                break;
+            }
+            for (int64_t k = 0; k < len; k++)
+            {
+                if (buff[k] != contentOf(idx, pos + k))
+                {
+                    badNum++;
+                    break;
+                }
+            }
+            totalBytes += len;
+        }
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+    return totalBytes / 1048576.0 * 1e9 / (costNs ? costNs : 1);
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileNum = argc > 2 ? atoi(argv[2]) : 16;
+    conf.fileSize = (argc > 3 ? atoi(argv[3]) : 8) * 1024ull * 1024;
+    conf.writeLen = (argc > 4 ? atoi(argv[4]) : 16) * 1024;
+    conf.readLen = (argc > 5 ? atoi(argv[5]) : 256) * 1024;
+
+    if (0 == conf.fileNum || 0 == conf.fileSize || 0 == conf.writeLen || 0 == conf.readLen)
+    {
+        printf("usage: %s [dir] [fileNum] [fileMB] [writeKB] [readKB]\n", argv[0]);
+        return -1;
+    }
+
+    std::string dir = conf.dir + "/defrag";
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return -1;
+    }
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = conf.fileNum * conf.fileSize * 2 + 64ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return -1;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+    int dataFd = open((dir + "/" + kDataFileName).c_str(), O_RDONLY);
+
+    // 所有文件轮流追加，每个文件的数据块被其他文件的数据块隔开
+    std::vector<char> buff(conf.writeLen);
+    uint32_t failNum = 0;
+    for (uint64_t pos = 0; pos < conf.fileSize; pos += conf.writeLen)
+    {
+        uint32_t len = std::min((uint64_t)conf.writeLen, conf.fileSize - pos);
+        for (uint32_t idx = 0; idx < conf.fileNum; idx++)
+        {
+            for (uint32_t k = 0; k < len; k++)
+            {
+                buff[k] = contentOf(idx, pos + k);
+            }
+            if (len != efs->write(fileNameOf(idx), &buff[0], len))
+            {
+                failNum++;
+            }
+        }
+    }
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    printSpace("before", space);
+    uint32_t badNum = 0;
+    double beforeMBps = readAll(efs, conf, dataFd, badNum);
+
+    uint64_t start = BenchUtil::nowNs();
+    uint64_t movedBytes = 0;
+    uint64_t stepBytes = 0;
+    while (0 != (stepBytes = efs->defrag(64ull * 1024 * 1024)))
+    {
+        movedBytes += stepBytes;
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+
+    efs->getSpaceInfo(space);
+    printSpace("after", space);
+    double afterMBps = readAll(efs, conf, dataFd, badNum);
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    close(dataFd);
+
+    printf("defrag moved %" PRIu64 " bytes cost %.1fms %.1fMB/s\n", movedBytes, costNs / 1e6,
+        movedBytes / 1048576.0 * 1e9 / (costNs ? costNs : 1));
+    printf("sequential read before %.1fMB/s after %.1fMB/s writeFail %u bad %u\n", beforeMBps, afterMBps, failNum,
+        badNum);
+    return 0 == badNum && 0 == failNum ? 0 : -1;
+}
@@ -0,0 +1,94 @@
+#include "../src/ChunkGeometry.h"
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <random>
+
+/*
+对比chunk大小计算策略的单次调用开销，以及initFS按照内存计算出的chunk大小是否使用Pow2Geometry
+用法: edgefs_bench_geometry [chunkSize] [loopNum] [dir]
+*/
+
+static volatile uint64_t g_sink = 0;
+
+template<typename Geometry>
+static void runBench(const char* name, uint32_t chunkSize, const std::vector<uint64_t>& offsets, uint32_t loopNum)
+{
+    const Geometry geometry(chunkSize);
+    uint64_t sum = 0;
+
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t loop = 0; loop < loopNum; loop++)
+    {
+        for (size_t i = 0; i < offsets.size(); i++)
+        {
+            // 模拟一次读写中的典型计算：定位chunk、chunk内偏移、回算磁盘偏移、数据块大小
+            uint32_t chunkid = geometry.chunkid(offsets[i]);
+            uint32_t chunkOffset = geometry.chunkOffset(offsets[i]);
+            sum += geometry.offset(chunkid) + chunkOffset + geometry.extentSize(chunkid & 7);
+        }
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+    g_sink += sum;
+
+    uint64_t callNum = (uint64_t)loopNum * offsets.size();
+    printf("[%s] chunkSize %u calls %" PRIu64 " total %" PRIu64 "us per call %.3fns\n", name, chunkSize, callNum,
+        costNs / 1000, (double)costNs / callNum);
+}
+
+// 同样的磁盘和内存，默认的chunk大小只做4K对齐，设置m_isPow2ChunkSize后取整到2的幂
+static bool runInitFS(const std::string& dir, bool isPow2ChunkSize)
+{
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 10ull * 1024 * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 3 * 1024 * 1024;
+    sinfo.m_isPow2ChunkSize = isPow2ChunkSize;
+    SpaceInfo info;
+    bool isOk = efs->initFS(sinfo) && efs->getSpaceInfo(info);
+    if (isOk)
+    {
+        printf("[initFS] isPow2ChunkSize %d chunkSize %u chunkNum %u geometry %s\n", isPow2ChunkSize,
+            info.m_chunkSize, info.m_chunkNum, Pow2Geometry::isMatch(info.m_chunkSize) ? "pow2" : "generic");
+    }
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return isOk;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t chunkSize = argc > 1 ? atoi(argv[1]) : 64 * 1024;
+    uint32_t loopNum = argc > 2 ? atoi(argv[2]) : 100;
+    std::string dir = argc > 3 ? argv[3] : "./bench_data";
+
+    if (!Pow2Geometry::isMatch(chunkSize))
+    {
+        printf("usage: %s [chunkSize(power of two)] [loopNum] [dir]\n", argv[0]);
+        return -1;
+    }
+
+    std::default_random_engine e(1);
+    std::uniform_int_distribution<uint64_t> dist(0, (uint64_t)chunkSize * 1024 * 1024);
+    std::vector<uint64_t> offsets(1024 * 1024);
+    for (size_t i = 0; i < offsets.size(); i++)
+    {
+        offsets[i] = dist(e);
+    }
+
+    // 同一个2的幂大小分别使用两种策略，结果相同，只比较计算开销
+    runBench<GenericGeometry>("generic", chunkSize, offsets, loopNum);
+    runBench<Pow2Geometry>("pow2", chunkSize, offsets, loopNum);
+
+    bool isOk = runInitFS(dir + "/generic", false);
+    isOk = runInitFS(dir + "/pow2", true) && isOk;
+    return isOk ? 0 : -1;
+}
@@ -0,0 +1,350 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+/*
+对比不记录日志、每次写入都提交和合并提交三种方式下小段写入的吞吐和fdatasync次数
+最后在子进程写入过程中强制杀死进程，重新打开后检查重放日志得到的文件是否完整
+以及去重释放的chunk在提交前不会被重新分配
+用法: edgefs_bench_journal [dir] [fileNum] [writeNum] [writeKB] [commitMs] [batchSize]
+*/
+
+static uint64_t g_syncNum = 0;
+
+extern "C" int fdatasync(int fd)
+{
+    g_syncNum++;
+    return syscall(SYS_fdatasync, fd);
+}
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        fileNum;
+    uint32_t        writeNum;
+    uint32_t        writeLen;
+    uint32_t        commitMs;
+    uint32_t        batchSize;      // 批量写入时每批的请求个数
+};
+
+enum JournalMode
+{
+    JournalMode_NONE = 0,
+    JournalMode_EVERY,              // 每次写入都提交
+    JournalMode_GROUP,              // 等待commitMs后合并提交
+    JournalMode_BATCH,              // 批量写入，每批提交一次
+};
+
+static const char* kModeNames[] = { "none", "every", "group", "batch" };
+
+static std::string fileNameOf(uint32_t idx)
+{
+    return "http://edge/seg_" + std::to_string(idx) + ".ts";
+}
+
+static char contentOf(uint32_t idx, uint64_t pos)
+{
+    return (char)(pos * 131 + idx);
+}
+
+static IEdgeFS* openFS(const BenchConf& conf, const std::string& dir, bool isJournal, uint32_t commitMs)
+{
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = (uint64_t)conf.writeNum * conf.writeLen * 2 + 64ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    sinfo.m_isJournal = isJournal;
+    sinfo.m_journalCommitMs = commitMs;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return NULL;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+    return efs;
+}
+
+static bool runBench(const BenchConf& conf, JournalMode mode)
+{
+    std::string dir = conf.dir + "/" + kModeNames[mode];
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+    IEdgeFS* efs = openFS(conf, dir, JournalMode_NONE != mode, JournalMode_EVERY == mode ? 0 : conf.commitMs);
+    if (NULL == efs)
+    {
+        return false;
+    }
+
+    std::vector<uint64_t> fileSizes(conf.fileNum, 0);
+    std::vector<std::vector<char> > buffs(conf.batchSize, std::vector<char>(conf.writeLen));
+    std::vector<WriteRequest> reqs;
+    uint32_t failNum = 0;
+    g_syncNum = 0;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.writeNum; )
+    {
+        uint32_t reqNum = JournalMode_BATCH == mode ? std::min(conf.batchSize, conf.writeNum - i) : 1;
+        reqs.resize(reqNum);
+        for (uint32_t j = 0; j < reqNum; j++)
+        {
+            uint32_t idx = (i + j) % conf.fileNum;
+            for (uint32_t k = 0; k < conf.writeLen; k++)
+            {
+                buffs[j][k] = contentOf(idx, fileSizes[idx] + k);
+            }
+            reqs[j].m_fileName = fileNameOf(idx);
+            reqs[j].m_buff = &buffs[j][0];
+            reqs[j].m_len = conf.writeLen;
+            fileSizes[idx] += conf.writeLen;
+        }
+
+        if (JournalMode_BATCH == mode)
+        {
+            failNum += reqNum - efs->writeBatch(reqs);
+        }
+        else if (conf.writeLen != efs->write(reqs[0].m_fileName, reqs[0].m_buff, reqs[0].m_len))
+        {
+            failNum++;
+        }
+        i += reqNum;
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+
+    printf("[%s] writes %u writeLen %u fail %u cost %.1fms ops %.0f/s fdatasync %" PRIu64 " commits %" PRIu64
+        " journalBytes/write %.1f\n", kModeNames[mode], conf.writeNum, conf.writeLen, failNum, costNs / 1e6,
+        conf.writeNum * 1e9 / (costNs ? costNs : 1), g_syncNum, space.m_journalCommitNum,
+        (double)space.m_journalBytes / conf.writeNum);
+    return true;
+}
+
+// 子进程每次写入都提交，写到一半时被杀死，重新打开后每个文件都应该是写入内容的完整前缀
+static bool runCrash(const BenchConf& conf)
+{
+    std::string dir = conf.dir + "/crash";
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (0 == pid)
+    {
+        IEdgeFS* efs = openFS(conf, dir, true, 0);
+        if (NULL == efs)
+        {
+            _exit(1);
+        }
+        std::vector<uint64_t> fileSizes(conf.fileNum, 0);
+        std::vector<char> buff(conf.writeLen);
+        for (uint32_t i = 0; i < conf.writeNum; i++)
+        {
+            uint32_t idx = i % conf.fileNum;
+            for (uint32_t k = 0; k < conf.writeLen; k++)
+            {
+                buff[k] = contentOf(idx, fileSizes[idx] + k);
+            }
+            efs->write(fileNameOf(idx), &buff[0], conf.writeLen);
+            fileSizes[idx] += conf.writeLen;
+            if (i == conf.writeNum / 2)
+            {
+                kill(getpid(), SIGKILL);
+            }
+        }
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    IEdgeFS* efs = openFS(conf, dir, true, conf.commitMs);
+    if (NULL == efs)
+    {
+        return false;
+    }
+    uint32_t foundNum = 0;
+    uint32_t badNum = 0;
+    uint64_t totalBytes = 0;
+    std::vector<char> buff((uint64_t)conf.writeNum / conf.fileNum * conf.writeLen + conf.writeLen);
+    for (uint32_t idx = 0; idx < conf.fileNum; idx++)
+    {
+        int64_t len = efs->read(fileNameOf(idx), &buff[0], buff.size(), 0);
+        if (len < 0)
+        {
+            continue;
+        }
+        foundNum++;
+        totalBytes += len;
+        for (int64_t k = 0; k < len; k++)
+        {
+            if (buff[k] != contentOf(idx, k))
+            {
+                badNum++;
+                break;
+            }
+        }
+    }
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+
+    printf("[crash] killed %d files %u/%u recoveredBytes %" PRIu64 " bad %u\n", WIFSIGNALED(status), foundNum,
+        conf.fileNum, totalBytes, badNum);
+    return 0 == badNum;
+}
+
+static IEdgeFS* openDedupFS(const std::string& dir, uint32_t commitMs)
+{
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 2 * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 512 * 1024;
+    sinfo.m_dedupRecordNum = 2048;
+    sinfo.m_dedupLinkNum = 2048;
+    sinfo.m_isJournal = true;
+    sinfo.m_journalCommitMs = commitMs;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return NULL;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+    return efs;
+}
+
+// 去重替换掉的chunk要等替换提交后才能重新分配，否则崩溃后旧的index仍然引用被其他文件覆盖的chunk
+// 每两个文件内容相同，每次写入很小，chunk经过多次提交才写满，写满后被去重释放
+// 磁盘接近写满时新的分配很容易落到刚释放的chunk上
+// 子进程合并提交，在不同的位置被杀死，重新打开后每个文件都应该是写入内容的完整前缀
+static bool runReuseCrash(const BenchConf& conf)
+{
+    const uint32_t kFileNum = 16;
+    const uint32_t kRoundNum = 12;
+    uint32_t killNum = 0;
+    uint32_t badNum = 0;
+    uint32_t dedupNum = 0;
+    uint32_t writeNum = 0;
+    for (uint32_t round = 0; round < kRoundNum; round++)
+    {
+        std::string dir = conf.dir + "/reuse_crash";
+        if (!BenchUtil::resetDir(dir))
+        {
+            printf("reset dir %s failed\n", dir.c_str());
+            return false;
+        }
+
+        // 先确定写满磁盘需要的写入次数，被杀死的位置分布在写满之后
+        IEdgeFS* efs = openDedupFS(dir, conf.commitMs);
+        if (NULL == efs)
+        {
+            return false;
+        }
+        SpaceInfo space;
+        efs->getSpaceInfo(space);
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        uint32_t pieceLen = space.m_chunkSize / 64;
+        writeNum = space.m_chunkNum * 64 * 2;
+        uint32_t killIdx = writeNum / 2 + round * writeNum / 2 / kRoundNum;
+
+        pid_t pid = fork();
+        if (0 == pid)
+        {
+            efs = openDedupFS(dir, conf.commitMs);
+            if (NULL == efs)
+            {
+                _exit(1);
+            }
+            std::vector<uint64_t> fileSizes(kFileNum, 0);
+            std::vector<char> buff(pieceLen);
+            for (uint32_t i = 0; i < writeNum; i++)
+            {
+                uint32_t idx = i % kFileNum;
+                for (uint32_t k = 0; k < pieceLen; k++)
+                {
+                    buff[k] = contentOf(idx / 2, fileSizes[idx] + k);
+                }
+                if (pieceLen == efs->write(fileNameOf(idx), &buff[0], pieceLen))
+                {
+                    fileSizes[idx] += pieceLen;
+                }
+                if (i == killIdx)
+                {
+                    kill(getpid(), SIGKILL);
+                }
+            }
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        killNum += WIFSIGNALED(status) ? 1 : 0;
+
+        efs = openDedupFS(dir, conf.commitMs);
+        if (NULL == efs)
+        {
+            return false;
+        }
+        efs->getSpaceInfo(space);
+        dedupNum += space.m_dedupChunkNum;
+        std::vector<char> buff((uint64_t)space.m_chunkNum * space.m_chunkSize);
+        for (uint32_t idx = 0; idx < kFileNum; idx++)
+        {
+            int64_t len = efs->read(fileNameOf(idx), &buff[0], buff.size(), 0);
+            for (int64_t k = 0; k < len; k++)
+            {
+                if (buff[k] != contentOf(idx / 2, k))
+                {
+                    badNum++;
+                    break;
+                }
+            }
+        }
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+    }
+
+    printf("[reuse crash] rounds %u killed %u writesPerRound %u recoveredDedupChunks %u bad %u\n", kRoundNum,
+        killNum, writeNum, dedupNum, badNum);
+    return 0 == badNum;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileNum = argc > 2 ? atoi(argv[2]) : 64;
+    conf.writeNum = argc > 3 ? atoi(argv[3]) : 4000;
+    conf.writeLen = (argc > 4 ? atoi(argv[4]) : 4) * 1024;
+    conf.commitMs = argc > 5 ? atoi(argv[5]) : 10;
+    conf.batchSize = argc > 6 ? atoi(argv[6]) : 64;
+
+    if (0 == conf.fileNum || 0 == conf.writeNum || 0 == conf.writeLen || 0 == conf.batchSize)
+    {
+        printf("usage: %s [dir] [fileNum] [writeNum] [writeKB] [commitMs] [batchSize]\n", argv[0]);
+        return -1;
+    }
+
+    runBench(conf, JournalMode_NONE);
+    runBench(conf, JournalMode_EVERY);
+    runBench(conf, JournalMode_GROUP);
+    runBench(conf, JournalMode_BATCH);
+    bool isOk = runCrash(conf);
+    isOk = runReuseCrash(conf) && isOk;
+    return isOk ? 0 : -1;
+}
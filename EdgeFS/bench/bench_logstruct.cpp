@@ -0,0 +1,285 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "../src/EdgeFSConst.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <unordered_map>
+
+/*
+多个文件交替追加小段数据的负载下，对比原地写入和日志结构模式的写放大
+数据文件的写入被替换为带有模拟FTL的版本，模型参考SD卡和eMMC常用的混合映射FTL:
+闪存按擦除块管理，写入先进入少量的日志块，每个日志块对应一个擦除块
+写入没有日志块的擦除块时需要回收最久未使用的日志块，日志块从头到尾顺序写满时直接替换原来的块，
+否则需要把原来的块和日志块中的有效数据合并写入一个新块
+用法: edgefs_bench_logstruct [dir] [streamNum] [totalMB] [maxPieceKB] [eraseKB] [logBlockNum] [segmentKB]
+*/
+
+struct LogBlock
+{
+    uint64_t        block;
+    uint64_t        writePos;           // 顺序写入的位置
+    uint64_t        programBytes;       // 日志块已经编程的字节数
+    bool            isSeq;              // 是否从块头开始顺序写入
+};
+
+struct FtlModel
+{
+    int             dataFd;             // 只统计数据文件
+    uint64_t        eraseSize;
+    uint32_t        logBlockNum;
+    uint64_t        deviceBytes;        // 写入数据文件的字节数
+    uint64_t        flashBytes;         // 闪存实际编程的字节数
+    uint64_t        mergeNum;           // 需要复制数据的合并次数
+    std::vector<LogBlock>   logBlocks;  // 按照使用时间排序，最后一个是最近使用的
+};
+
+static FtlModel g_ftl;
+
+// 回收日志块，顺序写满的日志块直接替换原来的块，否则合并写入新块
+static void ftlCloseLogBlock(uint32_t idx)
+{
+    const LogBlock& logBlock = g_ftl.logBlocks[idx];
+    if (!logBlock.isSeq || logBlock.writePos != g_ftl.eraseSize)
+    {
+        g_ftl.flashBytes += g_ftl.eraseSize;
+        g_ftl.mergeNum++;
+    }
+    g_ftl.logBlocks.erase(g_ftl.logBlocks.begin() + idx);
+}
+
+static void ftlWrite(uint64_t offset, uint64_t len)
+{
+    g_ftl.deviceBytes += len;
+    while (0 != len)
+    {
+        uint64_t block = offset / g_ftl.eraseSize;
+        uint64_t inOffset = offset % g_ftl.eraseSize;
+        uint64_t writeLen = std::min(len, g_ftl.eraseSize - inOffset);
+
+        uint32_t idx = 0;
+        while (idx < g_ftl.logBlocks.size() && g_ftl.logBlocks[idx].block != block)
+        {
+            idx++;
+        }
+        if (idx == g_ftl.logBlocks.size())
+        {
+            if (g_ftl.logBlocks.size() == g_ftl.logBlockNum)
+            {
+                ftlCloseLogBlock(0);
+            }
+            LogBlock logBlock = { block, 0, 0, true };
+            g_ftl.logBlocks.push_back(logBlock);
+            idx = g_ftl.logBlocks.size() - 1;
+        }
+        else
+        {
+            std::rotate(g_ftl.logBlocks.begin() + idx, g_ftl.logBlocks.begin() + idx + 1, g_ftl.logBlocks.end());
+            idx = g_ftl.logBlocks.size() - 1;
+        }
+
+        LogBlock& logBlock = g_ftl.logBlocks[idx];
+        logBlock.isSeq = logBlock.isSeq && inOffset == logBlock.writePos;
+        logBlock.writePos = inOffset + writeLen;
+        logBlock.programBytes += writeLen;
+        g_ftl.flashBytes += writeLen;
+        // 日志块写满后回收
+        if (logBlock.programBytes >= g_ftl.eraseSize)
+        {
+            ftlCloseLogBlock(idx);
+        }
+
+        offset += writeLen;
+        len -= writeLen;
+    }
+}
+
+extern "C" ssize_t write(int fd, const void* buf, size_t count)
+{
+    if (fd == g_ftl.dataFd)
+    {
+        ftlWrite(::lseek(fd, 0, SEEK_CUR), count);
+    }
+    return syscall(SYS_write, fd, buf, count);
+}
+
+extern "C" ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset)
+{
+    if (fd == g_ftl.dataFd)
+    {
+        ftlWrite(offset, count);
+    }
+    return syscall(SYS_pwrite64, fd, buf, count, offset);
+}
+
+extern "C" ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset)
+{
+    if (fd == g_ftl.dataFd)
+    {
+        uint64_t len = 0;
+        for (int i = 0; i < iovcnt; i++)
+        {
+            len += iov[i].iov_len;
+        }
+        ftlWrite(offset, len);
+    }
+    return syscall(SYS_pwritev, fd, iov, iovcnt, offset, 0);
+}
+
+// 在打开的文件描述符中找到数据文件
+static int findDataFd()
+{
+    for (int fd = 0; fd < 1024; fd++)
+    {
+        char link[64];
+        char path[1024];
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        ssize_t len = readlink(link, path, sizeof(path) - 1);
+        if (len <= 0)
+        {
+            continue;
+        }
+        path[len] = '\0';
+        std::string str(path);
+        if (str.size() >= kDataFileName.size() &&
+            0 == str.compare(str.size() - kDataFileName.size(), kDataFileName.size(), kDataFileName))
+        {
+            return fd;
+        }
+    }
+    return -1;
+}
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        streamNum;
+    uint64_t        totalBytes;
+    uint32_t        maxPieceLen;
+    uint32_t        eraseSize;
+    uint32_t        logBlockNum;
+    uint32_t        segmentSize;
+};
+
+static bool runBench(const BenchConf& conf, bool isLog)
+{
+    const char* mode = isLog ? "log" : "inplace";
+    std::string dir = conf.dir + "/" + mode;
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = conf.totalBytes * 2;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    sinfo.m_logSegmentSize = isLog ? conf.segmentSize : 0;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    g_ftl = FtlModel();
+    g_ftl.eraseSize = conf.eraseSize;
+    g_ftl.logBlockNum = conf.logBlockNum;
+    g_ftl.dataFd = findDataFd();
+
+    // 每个文件的内容由文件序号和偏移决定，方便校验
+    std::default_random_engine e(1);
+    std::uniform_int_distribution<uint32_t> pieceDist(1, conf.maxPieceLen);
+    std::vector<uint64_t> fileSizes(conf.streamNum, 0);
+    std::vector<char> buff(conf.maxPieceLen);
+    uint64_t hostBytes = 0;
+    uint32_t failNum = 0;
+    uint64_t start = BenchUtil::nowNs();
+    while (hostBytes < conf.totalBytes)
+    {
+        uint32_t idx = e() % conf.streamNum;
+        uint32_t len = pieceDist(e);
+        for (uint32_t i = 0; i < len; i++)
+        {
+            buff[i] = (char)((fileSizes[idx] + i) * 131 + idx);
+        }
+        std::string fileName = "http://edge/live_" + std::to_string(idx) + ".ts";
+        if (len != efs->write(fileName, &buff[0], len))
+        {
+            failNum++;
+            break;
+        }
+        fileSizes[idx] += len;
+        hostBytes += len;
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+
+    uint32_t badNum = 0;
+    std::vector<char> readBuff;
+    for (uint32_t idx = 0; idx < conf.streamNum; idx++)
+    {
+        readBuff.resize(fileSizes[idx]);
+        std::string fileName = "http://edge/live_" + std::to_string(idx) + ".ts";
+        if (0 == fileSizes[idx])
+        {
+            continue;
+        }
+        if ((int64_t)fileSizes[idx] != efs->read(fileName, &readBuff[0], fileSizes[idx], 0))
+        {
+            badNum++;
+            continue;
+        }
+        for (uint64_t i = 0; i < fileSizes[idx]; i++)
+        {
+            if (readBuff[i] != (char)(i * 131 + idx))
+            {
+                badNum++;
+                break;
+            }
+        }
+    }
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    g_ftl.dataFd = -1;
+
+    printf("[%s] chunkSize %u write %" PRIu64 "MB fail %u bad %u cost %.1fms throughput %.1fMB/s\n", mode,
+        space.m_chunkSize, hostBytes / 1024 / 1024, failNum, badNum, costNs / 1e6,
+        hostBytes * 1e9 / 1024 / 1024 / (costNs ? costNs : 1));
+    printf("[%s] deviceBytes %" PRIu64 " flashBytes %" PRIu64 " merges %" PRIu64 " deviceWA %.2f flashWA %.2f"
+        " freeSegments %u/%u\n", mode, g_ftl.deviceBytes, g_ftl.flashBytes, g_ftl.mergeNum,
+        (double)g_ftl.deviceBytes / (hostBytes ? hostBytes : 1), (double)g_ftl.flashBytes / (hostBytes ? hostBytes : 1),
+        space.m_logFreeSegmentNum, space.m_logSegmentNum);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    g_ftl.dataFd = -1;
+
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.streamNum = argc > 2 ? atoi(argv[2]) : 64;
+    conf.totalBytes = (uint64_t)(argc > 3 ? atoi(argv[3]) : 256) * 1024 * 1024;
+    conf.maxPieceLen = (argc > 4 ? atoi(argv[4]) : 16) * 1024;
+    conf.eraseSize = (argc > 5 ? atoi(argv[5]) : 512) * 1024;
+    conf.logBlockNum = argc > 6 ? atoi(argv[6]) : 8;
+    conf.segmentSize = (argc > 7 ? atoi(argv[7]) : 1024) * 1024;
+
+    if (0 == conf.streamNum || 0 == conf.totalBytes || 0 == conf.maxPieceLen || 0 == conf.eraseSize ||
+        0 == conf.logBlockNum || 0 == conf.segmentSize)
+    {
+        printf("usage: %s [dir] [streamNum] [totalMB] [maxPieceKB] [eraseKB] [logBlockNum] [segmentKB]\n", argv[0]);
+        return -1;
+    }
+
+    runBench(conf, false);
+    runBench(conf, true);
+    return 0;
+}
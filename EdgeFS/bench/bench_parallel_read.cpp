@@ -0,0 +1,150 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "../src/EdgeFSConst.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+不同并发读取线程数下单次大段读取的耗时和吞吐
+每次读取前丢弃数据文件的页缓存，读取的内容与写入的内容逐字节比较
+用法: edgefs_bench_parallel_read [dir] [fileNum] [fileMB] [readMB] [threads1,threads2,...]
+*/
+
+struct BenchConf
+{
+    std::string             dir;
+    uint32_t                fileNum;
+    uint64_t                fileSize;
+    uint32_t                readLen;
+    std::vector<uint32_t>   threadNums;
+};
+
+static std::string fileNameOf(uint32_t idx)
+{
+    return "http://edge/vod_" + std::to_string(idx) + ".mp4";
+}
+
+static char contentOf(uint32_t idx, uint64_t pos)
+{
+    return (char)(pos * 131 + idx);
+}
+
+static bool runBench(const BenchConf& conf, uint32_t threadNum)
+{
+    std::string dir = conf.dir + "/parallel_read";
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = conf.fileNum * conf.fileSize + 64ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    sinfo.m_readThreadNum = threadNum;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    // 第一次运行时写入，之后复用同一份数据
+    std::vector<char> buff(conf.readLen);
+    uint32_t failNum = 0;
+    if (efs->read(fileNameOf(0), &buff[0], 1, 0) <= 0)
+    {
+        for (uint32_t idx = 0; idx < conf.fileNum; idx++)
+        {
+            for (uint64_t pos = 0; pos < conf.fileSize; pos += buff.size())
+            {
+                uint32_t len = std::min((uint64_t)buff.size(), conf.fileSize - pos);
+                for (uint32_t k = 0; k < len; k++)
+                {
+                    buff[k] = contentOf(idx, pos + k);
+                }
+                failNum += len == efs->write(fileNameOf(idx), &buff[0], len) ? 0 : 1;
+            }
+        }
+        efs->sync();
+    }
+
+    int dataFd = open((dir + "/" + kDataFileName).c_str(), O_RDONLY);
+    std::vector<uint64_t> readNs;
+    uint64_t totalBytes = 0;
+    uint32_t badNum = 0;
+    for (uint32_t idx = 0; idx < conf.fileNum; idx++)
+    {
+        for (uint64_t pos = 0; pos + conf.readLen <= conf.fileSize; pos += conf.readLen)
+        {
+            posix_fadvise(dataFd, 0, 0, POSIX_FADV_DONTNEED);
+            uint64_t start = BenchUtil::nowNs();
+            int64_t len = efs->read(fileNameOf(idx), &buff[0], conf.readLen, pos);
+            readNs.push_back(BenchUtil::nowNs() - start);
+            if (len != (int64_t)conf.readLen)
+            {
+                badNum++;
+                continue;
+            }
+            for (int64_t k = 0; k < len; k++)
+            {
+                if (buff[k] != contentOf(idx, pos + k))
+                {
+                    badNum++;
+                    break;
+                }
+            }
+            totalBytes += len;
+        }
+    }
+    close(dataFd);
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+
+    uint64_t costNs = 0;
+    for (auto it = readNs.begin(); it != readNs.end(); ++it)
+    {
+        costNs += *it;
+    }
+    printf("[threads %u] reads %zu readLen %u avg %.2fms p50 %.2fms p99 %.2fms %.1fMB/s parallelReads %" PRIu64
+        " writeFail %u bad %u\n", threadNum, readNs.size(), conf.readLen, BenchUtil::average(readNs) / 1e6,
+        BenchUtil::percentile(readNs, 50) / 1e6, BenchUtil::percentile(readNs, 99) / 1e6,
+        totalBytes / 1048576.0 * 1e9 / (costNs ? costNs : 1), space.m_parallelReadNum, failNum, badNum);
+    return 0 == badNum && 0 == failNum;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileNum = argc > 2 ? atoi(argv[2]) : 4;
+    conf.fileSize = (argc > 3 ? atoi(argv[3]) : 128) * 1024ull * 1024;
+    conf.readLen = (argc > 4 ? atoi(argv[4]) : 16) * 1024 * 1024;
+    std::string threadNums = argc > 5 ? argv[5] : "0,1,2,4,8";
+    std::stringstream ss(threadNums);
+    std::string threadNum;
+    while (std::getline(ss, threadNum, ','))
+    {
+        conf.threadNums.push_back(atoi(threadNum.c_str()));
+    }
+
+    if (0 == conf.fileNum || 0 == conf.readLen || conf.fileSize < conf.readLen || conf.threadNums.empty())
+    {
+        printf("usage: %s [dir] [fileNum] [fileMB] [readMB] [threads1,threads2,...]\n", argv[0]);
+        return -1;
+    }
+    if (!BenchUtil::resetDir(conf.dir + "/parallel_read"))
+    {
+        printf("reset dir %s failed\n", conf.dir.c_str());
+        return -1;
+    }
+
+    bool isOk = true;
+    for (auto it = conf.threadNums.begin(); it != conf.threadNums.end(); ++it)
+    {
+        isOk = runBench(conf, *it) && isOk;
+    }
+    return isOk ? 0 : -1;
+}
@@ -0,0 +1,99 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+读写调用的性能计数和开销
+分别在不开启和开启性能计数时写入文件并测量页缓存命中的读取耗时，输出每次调用的平均计数
+内核不允许硬件计数时只输出软件计数
+用法: edgefs_bench_perf_counter [dir] [loopNum]
+*/
+
+static const char* const kModeNames[] = { "none", "hardware", "software", "rusage" };
+
+static void printPerf(const char* name, const PerfCounterInfo& perf)
+{
+    double callNum = perf.m_callNum ? perf.m_callNum : 1;
+    printf("[%s] calls %" PRIu64 " cycles %.0f instructions %.0f ipc %.2f llcMiss %.2f dtlbMiss %.2f cpu %.0fns"
+        " pageFault %.3f ctxSwitch %.3f\n", name, perf.m_callNum, perf.m_cycles / callNum,
+        perf.m_instructions / callNum, (double)perf.m_instructions / (perf.m_cycles ? perf.m_cycles : 1),
+        perf.m_llcMisses / callNum, perf.m_dtlbMisses / callNum, perf.m_taskClockNs / callNum,
+        perf.m_pageFaults / callNum, perf.m_contextSwitches / callNum);
+}
+
+static bool runReadWrite(const std::string& dir, bool isPerfCounter, uint32_t loopNum, double& readNs,
+    StatsInfo& delta)
+{
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 256ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 4 * 1024 * 1024;
+    sinfo.m_isPerfCounter = isPerfCounter;
+    if (!BenchUtil::resetDir(dir) || !efs->initFS(sinfo))
+    {
+        printf("init fs failed, dir %s\n", dir.c_str());
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    const std::string fileName = "http://edge/perf.mp4";
+    const uint64_t fileSize = 16ull * 1024 * 1024;
+    const uint32_t readLen = 4096;
+    std::vector<char> buff(64 * 1024, 'p');
+    uint32_t failNum = 0;
+    StatsInfo prev;
+    efs->getStats(prev);
+    for (uint64_t pos = 0; pos < fileSize; pos += buff.size())
+    {
+        failNum += (int64_t)buff.size() == efs->write(fileName, &buff[0], buff.size(), fileSize) ? 0 : 1;
+    }
+    efs->sync();
+
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < loopNum; i++)
+    {
+        uint64_t offset = (i * 7919ull * 4096) % (fileSize - readLen);
+        failNum += (int64_t)readLen == efs->read(fileName, &buff[0], readLen, offset) ? 0 : 1;
+    }
+    readNs = (double)(BenchUtil::nowNs() - start) / loopNum;
+
+    efs->getStats(delta);
+    delta.subtract(prev);
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return 0 == failNum;
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "./bench_data";
+    uint32_t loopNum = argc > 2 ? atoi(argv[2]) : 100000;
+
+    if (0 == loopNum)
+    {
+        printf("usage: %s [dir] [loopNum]\n", argv[0]);
+        return -1;
+    }
+
+    double offNs = 0;
+    double onNs = 0;
+    StatsInfo offDelta;
+    StatsInfo onDelta;
+    if (!runReadWrite(dir + "/perf_off", false, loopNum, offNs, offDelta) ||
+        !runReadWrite(dir + "/perf_on", true, loopNum, onNs, onDelta))
+    {
+        return -1;
+    }
+
+    printf("[perf off] read %.1fns/call\n", offNs);
+    printf("[perf on]  read %.1fns/call overhead %.2f%% mode %s\n", onNs, (onNs - offNs) * 100 / (offNs ? offNs : 1),
+        kModeNames[onDelta.m_perfMode]);
+    printPerf("read", onDelta.m_readPerf);
+    printPerf("write", onDelta.m_writePerf);
+    return 0 == offDelta.m_readPerf.m_callNum && loopNum == onDelta.m_readPerf.m_callNum ? 0 : -1;
+}
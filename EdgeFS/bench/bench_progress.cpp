@@ -0,0 +1,247 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+一个线程边下载边写入，多个线程用readWait跟随读取，同时在不同位置注册watch
+检查读到的数据和写入的一致，等待不会超时即没有漏掉唤醒，每个watch恰好回调一次
+写入的长度和间隔随机，一部分写入连续进行，让唤醒和下一次读取交错
+一部分写入之后等所有读取追上再继续写，漏掉唤醒的读取在没有后续写入时只能等到超时
+用法: edgefs_bench_progress [dir] [objectNum] [readerNum] [objectMB] [timeoutMs]
+*/
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        objectNum;
+    uint32_t        readerNum;
+    uint32_t        objectSize;
+    uint32_t        timeoutMs;
+};
+
+struct ReaderResult
+{
+    std::atomic<uint64_t>   readOffset;     // 写入线程据此判断读取是否已经追上
+    std::atomic<bool>       isDone;
+    uint64_t                readBytes;
+    uint32_t                timeoutNum;
+    uint32_t                badNum;
+    std::vector<uint64_t>   waitNs;
+
+    ReaderResult()
+    : readOffset(0)
+    , isDone(false)
+    , readBytes(0)
+    , timeoutNum(0)
+    , badNum(0)
+    {}
+};
+
+struct WatchResult
+{
+    std::atomic<uint32_t>   firedNum;
+    std::atomic<uint32_t>   badNum;
+};
+
+static char byteAt(uint32_t object, uint64_t pos)
+{
+    return (char)('a' + (pos * 7 + pos / 1000 + object) % 26);
+}
+
+static void readerFunc(IEdgeFS* efs, const BenchConf& conf, const std::string& fileName, uint32_t object,
+    uint32_t readLen, ReaderResult* pResult)
+{
+    std::vector<char> buff(readLen);
+    uint64_t offset = 0;
+    while (true)
+    {
+        uint64_t start = BenchUtil::nowNs();
+        int64_t ret = efs->readWait(fileName, &buff[0], readLen, offset, conf.timeoutMs);
+        pResult->waitNs.push_back(BenchUtil::nowNs() - start);
+        if (kEdgeFSWaitTimeout == ret)
+        {
+            pResult->timeoutNum++;
+            break;
+        }
+        if (ret <= 0)
+        {
+            break;
+        }
+        for (int64_t i = 0; i < ret; i++)
+        {
+            if (buff[i] != byteAt(object, offset + i))
+            {
+                pResult->badNum++;
+                break;
+            }
+        }
+        offset += ret;
+        pResult->readOffset = offset;
+    }
+    pResult->isDone = true;
+    pResult->readBytes += offset;
+    if (offset != conf.objectSize)
+    {
+        pResult->badNum++;
+    }
+}
+
+// 等待所有读取读到pos或者结束，超过超时时间的两倍时放弃，读取自己会先超时
+static void waitReaders(std::vector<ReaderResult>& readers, const BenchConf& conf, uint64_t pos)
+{
+    uint64_t deadline = BenchUtil::nowNs() + conf.timeoutMs * 2000000ull;
+    for (auto it = readers.begin(); it != readers.end(); ++it)
+    {
+        while (it->readOffset < pos && !it->isDone && BenchUtil::nowNs() < deadline)
+        {
+            usleep(100);
+        }
+    }
+}
+
+static bool writeObject(IEdgeFS* efs, const BenchConf& conf, const std::string& fileName, uint32_t object,
+    std::vector<ReaderResult>& readers)
+{
+    std::mt19937 rng(object);
+    std::vector<char> piece(256 * 1024);
+    uint64_t pos = 0;
+    while (pos < conf.objectSize)
+    {
+        uint32_t len = (uint32_t)std::min((uint64_t)rng() % piece.size() + 1, conf.objectSize - pos);
+        for (uint32_t i = 0; i < len; i++)
+        {
+            piece[i] = byteAt(object, pos + i);
+        }
+        if ((int64_t)len != efs->write(fileName, &piece[0], len))
+        {
+            return false;
+        }
+        pos += len;
+        uint32_t action = rng() % 8;
+        if (0 == action)
+        {
+            usleep(rng() % 2000);
+        }
+        else if (1 == action)
+        {
+            waitReaders(readers, conf, pos);
+        }
+    }
+    return efs->complete(fileName, conf.objectSize);
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.objectNum = argc > 2 ? atoi(argv[2]) : 8;
+    conf.readerNum = argc > 3 ? atoi(argv[3]) : 8;
+    conf.objectSize = (argc > 4 ? atoi(argv[4]) : 8) * 1024 * 1024;
+    conf.timeoutMs = argc > 5 ? atoi(argv[5]) : 5000;
+
+    if (0 == conf.objectNum || 0 == conf.readerNum || 0 == conf.objectSize || 0 == conf.timeoutMs)
+    {
+        printf("usage: %s [dir] [objectNum] [readerNum] [objectMB] [timeoutMs]\n", argv[0]);
+        return -1;
+    }
+    if (!BenchUtil::resetDir(conf.dir))
+    {
+        printf("reset dir %s failed\n", conf.dir.c_str());
+        return -1;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = (uint64_t)conf.objectNum * conf.objectSize * 2 + 64ull * 1024 * 1024;
+    sinfo.m_diskRootDir = conf.dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return -1;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    // 长度为0的读取不等待
+    char byte = 0;
+    efs->markInProgress("empty_read");
+    uint64_t start = BenchUtil::nowNs();
+    int64_t emptyRet = efs->readWait("empty_read", &byte, 0, 0, conf.timeoutMs);
+    uint64_t emptyNs = BenchUtil::nowNs() - start;
+    efs->complete("empty_read", 0);
+
+    // 完整大小之后的watch只在下载结束时回调
+    const uint32_t kWatchNum = 5;
+    uint64_t watchOffsets[kWatchNum] = { 0, 4096, conf.objectSize / 2, conf.objectSize - 1, conf.objectSize };
+    std::vector<ReaderResult> readers(conf.readerNum);
+    WatchResult watch;
+    watch.firedNum = 0;
+    watch.badNum = 0;
+    uint32_t writeFailNum = 0;
+    start = BenchUtil::nowNs();
+    for (uint32_t object = 0; object < conf.objectNum; object++)
+    {
+        std::string fileName = "http://edge/live_" + std::to_string(object) + ".mp4";
+        efs->markInProgress(fileName);
+        for (uint32_t i = 0; i < kWatchNum; i++)
+        {
+            uint64_t offset = watchOffsets[i];
+            efs->watch(fileName, offset, [&watch, offset, &conf](uint64_t availLen, bool isComplete)
+                {
+                    watch.firedNum++;
+                    if ((!isComplete && availLen <= offset) || (isComplete && availLen != conf.objectSize))
+                    {
+                        watch.badNum++;
+                    }
+                });
+        }
+
+        // 读取长度各不相同，一部分读取在已有数据中，一部分等待新的写入
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < conf.readerNum; i++)
+        {
+            readers[i].readOffset = 0;
+            readers[i].isDone = false;
+            threads.push_back(std::thread(readerFunc, efs, std::cref(conf), fileName, object, 4096u << (i % 6),
+                &readers[i]));
+        }
+        writeFailNum += writeObject(efs, conf, fileName, object, readers) ? 0 : 1;
+        for (auto it = threads.begin(); it != threads.end(); ++it)
+        {
+            it->join();
+        }
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+
+    uint64_t readBytes = 0;
+    uint32_t timeoutNum = 0;
+    uint32_t badNum = 0;
+    std::vector<uint64_t> waitNs;
+    for (auto it = readers.begin(); it != readers.end(); ++it)
+    {
+        readBytes += it->readBytes;
+        timeoutNum += it->timeoutNum;
+        badNum += it->badNum;
+        waitNs.insert(waitNs.end(), it->waitNs.begin(), it->waitNs.end());
+    }
+    uint32_t expectWatchNum = conf.objectNum * kWatchNum;
+    printf("[empty read] ret %" PRId64 " cost %.3fms\n", emptyRet, emptyNs / 1e6);
+    printf("[progress] objects %u readers %u objectMB %u cost %.1fms readMB/s %.1f readWait p50 %.3fms p99 %.3fms"
+        " max %.3fms\n", conf.objectNum, conf.readerNum, conf.objectSize / 1024 / 1024, costNs / 1e6,
+        readBytes / 1024.0 / 1024 * 1e9 / (costNs ? costNs : 1), BenchUtil::percentile(waitNs, 50) / 1e6,
+        BenchUtil::percentile(waitNs, 99) / 1e6, BenchUtil::percentile(waitNs, 100) / 1e6);
+    printf("[progress] writeFail %u timeouts %u bad %u watchFired %u/%u watchBad %u\n", writeFailNum, timeoutNum,
+        badNum, watch.firedNum.load(), expectWatchNum, watch.badNum.load());
+
+    bool isOk = 0 == emptyRet && emptyNs < conf.timeoutMs * 1000000ull / 2 && 0 == writeFailNum &&
+        0 == timeoutNum && 0 == badNum && expectWatchNum == watch.firedNum && 0 == watch.badNum;
+    return isOk ? 0 : -1;
+}
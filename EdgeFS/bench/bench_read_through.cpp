@@ -0,0 +1,232 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+多个客户端同时请求同一个冷文件，对比各自回源和readThrough合并回源的源站流量和首字节延迟
+源站是本地的模拟函数，按照固定带宽分段返回数据
+用法: edgefs_bench_read_through [dir] [clients] [objectMB] [originMBps] [readKB]
+*/
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        clientNum;
+    uint32_t        objectSize;
+    uint32_t        originMBps;
+    uint32_t        readLen;
+};
+
+// 模拟的源站，每个连接独立计算带宽
+class StubOrigin
+{
+public:
+    StubOrigin(const BenchConf& conf)
+    : m_conf(conf)
+    , m_fetchNum(0)
+    , m_fetchBytes(0)
+    {}
+
+    static char byteAt(uint64_t pos)
+    {
+        return (char)('a' + (pos * 7 + pos / 4096) % 26);
+    }
+
+    int64_t fetch(uint64_t offset, const OriginWriter& writer)
+    {
+        m_fetchNum++;
+        const uint32_t kPieceLen = 256 * 1024;
+        std::vector<char> piece(kPieceLen);
+        uint64_t nsPerPiece = 1000000000ull * kPieceLen / ((uint64_t)m_conf.originMBps * 1024 * 1024);
+        for (uint64_t pos = offset; pos < m_conf.objectSize; pos += kPieceLen)
+        {
+            uint32_t len = (uint32_t)std::min((uint64_t)kPieceLen, m_conf.objectSize - pos);
+            for (uint32_t i = 0; i < len; i++)
+            {
+                piece[i] = byteAt(pos + i);
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(nsPerPiece * len / kPieceLen));
+            m_fetchBytes += len;
+            if (!writer(&piece[0], len))
+            {
+                return -1;
+            }
+        }
+        return m_conf.objectSize;
+    }
+
+public:
+    const BenchConf&        m_conf;
+    std::atomic<uint32_t>   m_fetchNum;
+    std::atomic<uint64_t>   m_fetchBytes;
+};
+
+struct ClientResult
+{
+    uint64_t        firstByteNs;
+    uint64_t        doneNs;
+    bool            isOk;
+};
+
+static bool checkData(const std::vector<char>& buff, uint64_t offset, int64_t len)
+{
+    for (int64_t i = 0; i < len; i++)
+    {
+        if (buff[i] != StubOrigin::byteAt(offset + i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 现有的做法: 每个客户端未命中时自己回源，数据只在内存中使用
+static void wrapperClient(IEdgeFS* efs, StubOrigin* pOrigin, const BenchConf& conf, const std::string& fileName,
+    uint64_t startNs, ClientResult* pResult)
+{
+    std::vector<char> buff(conf.readLen);
+    pResult->isOk = true;
+    pResult->firstByteNs = 0;
+    if (efs->read(fileName, &buff[0], conf.readLen, 0) <= 0)
+    {
+        std::vector<char> object;
+        pOrigin->fetch(0, [&](const char* data, uint32_t len)
+            {
+                if (object.empty())
+                {
+                    pResult->firstByteNs = BenchUtil::nowNs() - startNs;
+                }
+                object.insert(object.end(), data, data + len);
+                return true;
+            });
+        pResult->isOk = object.size() == conf.objectSize;
+    }
+    pResult->doneNs = BenchUtil::nowNs() - startNs;
+}
+
+static void readThroughClient(IEdgeFS* efs, const BenchConf& conf, const std::string& fileName, uint64_t startNs,
+    ClientResult* pResult)
+{
+    std::vector<char> buff(conf.readLen);
+    uint64_t offset = 0;
+    pResult->isOk = true;
+    pResult->firstByteNs = 0;
+    while (true)
+    {
+        int64_t ret = efs->readThrough(fileName, &buff[0], conf.readLen, offset, 10000);
+        if (ret <= 0)
+        {
+            pResult->isOk = 0 == ret && offset == conf.objectSize;
+            break;
+        }
+        if (0 == offset)
+        {
+            pResult->firstByteNs = BenchUtil::nowNs() - startNs;
+        }
+        if (!checkData(buff, offset, ret))
+        {
+            pResult->isOk = false;
+            break;
+        }
+        offset += ret;
+    }
+    pResult->doneNs = BenchUtil::nowNs() - startNs;
+}
+
+static bool runBench(const BenchConf& conf, bool isReadThrough)
+{
+    const char* mode = isReadThrough ? "readthrough" : "wrapper";
+    std::string dir = conf.dir + "/" + mode;
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 1024ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 4 * 1024 * 1024;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    StubOrigin origin(conf);
+    efs->setOriginFetcher([&origin](const std::string&, uint64_t offset, const OriginWriter& writer)
+        {
+            return origin.fetch(offset, writer);
+        });
+
+    const std::string fileName = "cold_object";
+    std::vector<ClientResult> results(conf.clientNum);
+    std::vector<std::thread> threads;
+    uint64_t startNs = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.clientNum; i++)
+    {
+        if (isReadThrough)
+        {
+            threads.push_back(std::thread(readThroughClient, efs, std::cref(conf), std::cref(fileName), startNs,
+                &results[i]));
+        }
+        else
+        {
+            threads.push_back(std::thread(wrapperClient, efs, &origin, std::cref(conf), std::cref(fileName),
+                startNs, &results[i]));
+        }
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it)
+    {
+        it->join();
+    }
+
+    std::vector<uint64_t> firstByteNs;
+    std::vector<uint64_t> doneNs;
+    uint32_t failNum = 0;
+    for (auto it = results.begin(); it != results.end(); ++it)
+    {
+        firstByteNs.push_back(it->firstByteNs);
+        doneNs.push_back(it->doneNs);
+        failNum += it->isOk ? 0 : 1;
+    }
+    StatsInfo stats;
+    efs->getStats(stats);
+    printf("[%s] clients %u originFetches %u originMB %.1f coalesced %" PRIu64 " firstByte p50 %.1fms p99 %.1fms"
+        " done p50 %.1fms p99 %.1fms fail %u\n", mode, conf.clientNum, origin.m_fetchNum.load(),
+        origin.m_fetchBytes.load() / 1024.0 / 1024, stats.m_originCoalesceNum,
+        BenchUtil::percentile(firstByteNs, 50) / 1e6, BenchUtil::percentile(firstByteNs, 99) / 1e6,
+        BenchUtil::percentile(doneNs, 50) / 1e6, BenchUtil::percentile(doneNs, 99) / 1e6, failNum);
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return 0 == failNum;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.clientNum = argc > 2 ? atoi(argv[2]) : 64;
+    conf.objectSize = (argc > 3 ? atoi(argv[3]) : 16) * 1024 * 1024;
+    conf.originMBps = argc > 4 ? atoi(argv[4]) : 100;
+    conf.readLen = (argc > 5 ? atoi(argv[5]) : 256) * 1024;
+
+    if (0 == conf.clientNum || 0 == conf.objectSize || 0 == conf.originMBps || 0 == conf.readLen)
+    {
+        printf("usage: %s [dir] [clients] [objectMB] [originMBps] [readKB]\n", argv[0]);
+        return -1;
+    }
+    printf("origin %uMB/s per connection, object %uMB, clients %u, read %uKB\n", conf.originMBps,
+        conf.objectSize / 1024 / 1024, conf.clientNum, conf.readLen / 1024);
+
+    bool isOk = runBench(conf, false);
+    isOk = runBench(conf, true) && isOk;
+    return isOk ? 0 : -1;
+}
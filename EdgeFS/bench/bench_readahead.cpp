@@ -0,0 +1,306 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <unordered_map>
+
+/*
+在模拟的机械盘延迟下，对比预读开启前后顺序读和随机读的耗时
+数据文件的读取和fadvise被替换为带延迟的版本: 不连续的请求需要寻道，传输按照固定带宽计算，
+fadvise发起的预读在后台排队完成，读取未就绪的页需要等待
+用法: edgefs_bench_readahead [dir] [fileMB] [readKB] [thinkUs] [seekUs] [bandwidthMB]
+*/
+
+struct DiskModel
+{
+    bool            isEnable;
+    uint64_t        seekNs;
+    uint64_t        nsPerByte100;       // 每100字节的传输耗时
+    uint64_t        freeNs;             // 磁盘队列空闲的时间
+    uint64_t        headPos;            // 上一个请求结束的位置
+    std::unordered_map<uint64_t, uint64_t>  readyNs;    // 页 -> 数据就绪的时间
+    uint64_t        prefetchPages;
+    uint64_t        usedPrefetchPages;
+    uint64_t        syncPages;
+};
+
+static DiskModel g_disk;
+static const uint64_t kPageSize = 4096;
+static std::unordered_map<uint64_t, bool> g_prefetchUnused;
+
+// 提交一段磁盘请求，返回完成时间
+static uint64_t submitIO(uint64_t offset, uint64_t len)
+{
+    uint64_t start = std::max(BenchUtil::nowNs(), g_disk.freeNs);
+    uint64_t cost = (offset == g_disk.headPos ? 0 : g_disk.seekNs) + len * g_disk.nsPerByte100 / 100;
+    g_disk.freeNs = start + cost;
+    g_disk.headPos = offset + len;
+    return g_disk.freeNs;
+}
+
+// 不在缓存中的连续页合并为一个请求
+static uint64_t loadPages(uint64_t offset, uint64_t len, bool isPrefetch)
+{
+    uint64_t firstPage = offset / kPageSize;
+    uint64_t endPage = (offset + len + kPageSize - 1) / kPageSize;
+    uint64_t lastReady = 0;
+    uint64_t page = firstPage;
+    while (page < endPage)
+    {
+        auto it = g_disk.readyNs.find(page);
+        if (it != g_disk.readyNs.end())
+        {
+            lastReady = std::max(lastReady, it->second);
+            if (!isPrefetch && g_prefetchUnused.erase(page))
+            {
+                g_disk.usedPrefetchPages++;
+            }
+            page++;
+            continue;
+        }
+        uint64_t runEnd = page;
+        while (runEnd < endPage && g_disk.readyNs.end() == g_disk.readyNs.find(runEnd))
+        {
+            runEnd++;
+        }
+        uint64_t done = submitIO(page * kPageSize, (runEnd - page) * kPageSize);
+        for (uint64_t i = page; i < runEnd; i++)
+        {
+            g_disk.readyNs[i] = done;
+            if (isPrefetch)
+            {
+                g_prefetchUnused[i] = true;
+            }
+        }
+        if (isPrefetch)
+        {
+            g_disk.prefetchPages += runEnd - page;
+        }
+        else
+        {
+            g_disk.syncPages += runEnd - page;
+        }
+        lastReady = std::max(lastReady, done);
+        page = runEnd;
+    }
+    return lastReady;
+}
+
+static void waitUntil(uint64_t ns)
+{
+    uint64_t now = BenchUtil::nowNs();
+    if (ns > now)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ns - now));
+    }
+}
+
+extern "C" ssize_t read(int fd, void* buf, size_t count)
+{
+    if (g_disk.isEnable)
+    {
+        off_t offset = ::lseek(fd, 0, SEEK_CUR);
+        waitUntil(loadPages(offset, count, false));
+    }
+    return syscall(SYS_read, fd, buf, count);
+}
+
+// 数据文件按照偏移读取，不移动文件位置
+extern "C" ssize_t pread(int fd, void* buf, size_t count, off_t offset)
+{
+    if (g_disk.isEnable)
+    {
+        waitUntil(loadPages(offset, count, false));
+    }
+    return syscall(SYS_pread64, fd, buf, count, offset);
+}
+
+extern "C" ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset)
+{
+    if (g_disk.isEnable)
+    {
+        size_t count = 0;
+        for (int i = 0; i < iovcnt; i++)
+        {
+            count += iov[i].iov_len;
+        }
+        waitUntil(loadPages(offset, count, false));
+    }
+    return syscall(SYS_preadv, fd, iov, iovcnt, offset, 0);
+}
+
+extern "C" int posix_fadvise(int fd, off_t offset, off_t len, int advice)
+{
+    if (g_disk.isEnable && POSIX_FADV_WILLNEED == advice)
+    {
+        // 只排队，不等待
+        loadPages(offset, len, true);
+        return 0;
+    }
+    return syscall(SYS_fadvise64, fd, offset, len, advice);
+}
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        fileSize;
+    uint32_t        readLen;
+    uint32_t        thinkUs;
+    uint32_t        seekUs;
+    uint32_t        bandwidthMB;
+};
+
+static void resetDisk(const BenchConf& conf)
+{
+    g_disk.readyNs.clear();
+    g_prefetchUnused.clear();
+    g_disk.seekNs = conf.seekUs * 1000ull;
+    g_disk.nsPerByte100 = 100ull * 1000000000 / (conf.bandwidthMB * 1024ull * 1024);
+    g_disk.freeNs = 0;
+    g_disk.headPos = -1;
+    g_disk.prefetchPages = 0;
+    g_disk.usedPrefetchPages = 0;
+    g_disk.syncPages = 0;
+}
+
+static void think(uint32_t thinkUs)
+{
+    // 模拟上层处理数据的耗时，预读在这段时间内完成
+    uint64_t end = BenchUtil::nowNs() + thinkUs * 1000ull;
+    while (BenchUtil::nowNs() < end)
+    {
+    }
+}
+
+// raHitNum为区间内读取完全落在预读范围内的次数
+static void printResult(const char* mode, const char* pattern, uint32_t readNum, uint64_t costNs,
+    std::vector<uint64_t>& latencys, uint64_t readBytes, uint64_t raHitNum)
+{
+    printf("[%s][%s] reads %u cost %.1fms throughput %.1fMB/s latency avg %.0fus p50 %.0fus p99 %.0fus"
+        " syncPages %" PRIu64 " prefetchPages %" PRIu64 " prefetchUsed %.1f%% raHits %" PRIu64 "\n",
+        mode, pattern, readNum, costNs / 1e6, readBytes * 1e9 / 1024 / 1024 / (costNs ? costNs : 1),
+        BenchUtil::average(latencys) / 1e3, BenchUtil::percentile(latencys, 50) / 1e3,
+        BenchUtil::percentile(latencys, 99) / 1e3, g_disk.syncPages, g_disk.prefetchPages,
+        0 == g_disk.prefetchPages ? 0.0 : 100.0 * g_disk.usedPrefetchPages / g_disk.prefetchPages, raHitNum);
+}
+
+static bool runBench(const BenchConf& conf, uint32_t readaheadMaxSize)
+{
+    const char* mode = 0 == readaheadMaxSize ? "noreadahead" : "readahead";
+    std::string dir = conf.dir + "/" + mode;
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 1024ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 4 * 1024 * 1024;
+    sinfo.m_readaheadMaxSize = readaheadMaxSize;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    const std::string fileName = "readahead_file";
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+
+    // 分段写入，文件由多个不连续的数据块组成
+    std::vector<char> buff(std::max(conf.readLen, 1024u * 1024), 'r');
+    uint32_t writeLen = 0;
+    while (writeLen < conf.fileSize)
+    {
+        uint32_t len = std::min((uint32_t)buff.size(), conf.fileSize - writeLen);
+        if (len != efs->write(key, &buff[0], len, 0))
+        {
+            printf("write failed\n");
+            efs->unitFS();
+            DestroyPcdnSdk(efs);
+            return false;
+        }
+        writeLen += len;
+    }
+
+    uint32_t readNum = conf.fileSize / conf.readLen;
+    std::vector<uint64_t> latencys;
+    latencys.reserve(readNum);
+
+    // 顺序读
+    StatsInfo prevStats;
+    StatsInfo stats;
+    efs->getStats(prevStats);
+    resetDisk(conf);
+    g_disk.isEnable = true;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < readNum; i++)
+    {
+        uint64_t begin = BenchUtil::nowNs();
+        efs->read(key, &buff[0], conf.readLen, (uint64_t)i * conf.readLen);
+        latencys.push_back(BenchUtil::nowNs() - begin);
+        think(conf.thinkUs);
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+    g_disk.isEnable = false;
+    efs->getStats(stats);
+    stats.subtract(prevStats);
+    printResult(mode, "sequential", readNum, costNs, latencys, (uint64_t)readNum * conf.readLen,
+        stats.m_readaheadHitNum);
+
+    // 随机读，预读不应该被触发
+    std::default_random_engine e(1);
+    std::uniform_int_distribution<uint32_t> idxDist(0, readNum - 1);
+    efs->getStats(prevStats);
+    resetDisk(conf);
+    latencys.clear();
+    g_disk.isEnable = true;
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < readNum; i++)
+    {
+        uint64_t begin = BenchUtil::nowNs();
+        efs->read(key, &buff[0], conf.readLen, (uint64_t)idxDist(e) * conf.readLen);
+        latencys.push_back(BenchUtil::nowNs() - begin);
+        think(conf.thinkUs);
+    }
+    costNs = BenchUtil::nowNs() - start;
+    g_disk.isEnable = false;
+    efs->getStats(stats);
+    stats.subtract(prevStats);
+    printResult(mode, "random", readNum, costNs, latencys, (uint64_t)readNum * conf.readLen,
+        stats.m_readaheadHitNum);
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileSize = (argc > 2 ? atoi(argv[2]) : 32) * 1024 * 1024;
+    conf.readLen = (argc > 3 ? atoi(argv[3]) : 64) * 1024;
+    conf.thinkUs = argc > 4 ? atoi(argv[4]) : 200;
+    conf.seekUs = argc > 5 ? atoi(argv[5]) : 8000;
+    conf.bandwidthMB = argc > 6 ? atoi(argv[6]) : 120;
+
+    if (0 == conf.readLen || conf.fileSize < conf.readLen || 0 == conf.bandwidthMB)
+    {
+        printf("usage: %s [dir] [fileMB] [readKB] [thinkUs] [seekUs] [bandwidthMB]\n", argv[0]);
+        return -1;
+    }
+    printf("disk model: seek %uus bandwidth %uMB/s, file %uMB read %uKB think %uus\n", conf.seekUs,
+        conf.bandwidthMB, conf.fileSize / 1024 / 1024, conf.readLen / 1024, conf.thinkUs);
+
+    runBench(conf, 0);
+    runBench(conf, 1024 * 1024);
+    return 0;
+}
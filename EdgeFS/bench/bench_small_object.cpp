@@ -0,0 +1,132 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+小文件为主的负载下，对比打包存储开启前后的空间利用率和读取延迟
+用法: edgefs_bench_small_object [dir] [fileNum] [minSize] [maxSize]
+*/
+
+struct BenchConf
+{
+    std::string     dir;
+    uint32_t        fileNum;
+    uint32_t        minSize;
+    uint32_t        maxSize;
+    uint64_t        diskCapacity;
+    uint64_t        memory;
+};
+
+static bool runBench(const BenchConf& conf, uint32_t packMaxFileSize)
+{
+    std::string dir = conf.dir + (0 == packMaxFileSize ? "/nopack" : "/pack");
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = conf.diskCapacity;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = conf.memory;
+    sinfo.m_packMaxFileSize = packMaxFileSize;
+    sinfo.m_packRecordNum = 0 == packMaxFileSize ? 0 : conf.fileNum * 2;
+
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    std::default_random_engine e(1);
+    std::uniform_int_distribution<uint32_t> sizeDist(conf.minSize, conf.maxSize);
+    std::vector<uint32_t> sizes(conf.fileNum);
+    std::vector<char> buff(conf.maxSize, 'x');
+
+    uint32_t writeFileNum = 0;
+    uint64_t writeBytes = 0;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        sizes[i] = sizeDist(e);
+        if (sizes[i] != efs->write("small_" + std::to_string(i), &buff[0], sizes[i]))
+        {
+            sizes[i] = 0;
+            continue;
+        }
+        writeFileNum++;
+        writeBytes += sizes[i];
+    }
+    uint64_t writeNs = BenchUtil::nowNs() - start;
+
+    std::vector<uint32_t> order(conf.fileNum);
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), e);
+
+    std::vector<uint64_t> latencys;
+    latencys.reserve(conf.fileNum);
+    for (uint32_t i = 0; i < conf.fileNum; i++)
+    {
+        uint32_t idx = order[i];
+        if (0 == sizes[idx])
+        {
+            continue;
+        }
+        std::string fileName = "small_" + std::to_string(idx);
+        uint64_t begin = BenchUtil::nowNs();
+        int64_t ret = efs->read(fileName, &buff[0], sizes[idx], 0);
+        latencys.push_back(BenchUtil::nowNs() - begin);
+        if (ret != sizes[idx])
+        {
+            printf("read %s failed, ret %" PRId64 " expect %u\n", fileName.c_str(), ret, sizes[idx]);
+        }
+    }
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    uint64_t allocBytes = (uint64_t)space.m_usedChunkNum * space.m_chunkSize;
+
+    printf("[%s] chunkSize %u files %u/%u bytes %" PRIu64 " usedChunks %u packChunks %u packFiles %u"
+        " allocBytes %" PRIu64 " spaceEfficiency %.2f%%\n",
+        0 == packMaxFileSize ? "nopack" : "pack", space.m_chunkSize, writeFileNum, conf.fileNum, writeBytes,
+        space.m_usedChunkNum, space.m_packChunkNum, space.m_packFileNum, allocBytes,
+        0 == allocBytes ? 0.0 : 100.0 * space.m_fileBytes / allocBytes);
+    printf("[%s] write %.2f files/s, read latency avg %" PRIu64 "ns p50 %" PRIu64 "ns p99 %" PRIu64 "ns\n",
+        0 == packMaxFileSize ? "nopack" : "pack", writeFileNum * 1e9 / (writeNs ? writeNs : 1),
+        BenchUtil::average(latencys), BenchUtil::percentile(latencys, 50), BenchUtil::percentile(latencys, 99));
+
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileNum = argc > 2 ? atoi(argv[2]) : 10000;
+    conf.minSize = argc > 3 ? atoi(argv[3]) : 512;
+    conf.maxSize = argc > 4 ? atoi(argv[4]) : 8192;
+    conf.diskCapacity = 1024ull * 1024 * 1024;
+    conf.memory = 1024 * 1024;
+
+    if (0 == conf.fileNum || conf.minSize > conf.maxSize)
+    {
+        printf("usage: %s [dir] [fileNum] [minSize] [maxSize]\n", argv[0]);
+        return -1;
+    }
+
+    runBench(conf, 0);
+    runBench(conf, conf.maxSize);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "../src/IEdgeFS.h"
+#include "../src/StatsMgr.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+统计计数的开销和getStats的区间增量
+先单独测量一次读取调用中的计数耗时，再测量页缓存命中时的读取耗时，两者的比值即计数的开销占比
+用法: edgefs_bench_stats [dir] [loopNum] [readKB]
+*/
+
+static void printLatency(const char* name, const LatencyHistogram& histogram)
+{
+    printf("[%s] count %" PRIu64 " avg %" PRIu64 "ns p50 %" PRIu64 "ns p99 %" PRIu64 "ns p999 %" PRIu64 "ns\n",
+        name, histogram.m_count, histogram.averageNs(), histogram.percentile(50), histogram.percentile(99),
+        histogram.percentile(99.9));
+}
+
+static void printStats(const StatsInfo& delta)
+{
+    double sec = delta.m_timeNs / 1e9;
+    printf("interval %.3fs reads %" PRIu64 " (%.0f/s) readBytes %" PRIu64 " readFail %" PRIu64 " writes %" PRIu64
+        " writeBytes %" PRIu64 " writeFail %" PRIu64 "\n", sec, delta.m_readNum, delta.m_readNum / (sec ? sec : 1),
+        delta.m_readBytes, delta.m_readFailNum, delta.m_writeNum, delta.m_writeBytes, delta.m_writeFailNum);
+    printf("lookups %" PRIu64 " avgChain %.2f allocs %" PRIu64 " avgScan %.2f readaheadHit %" PRIu64 "\n",
+        delta.m_lookupNum, (double)delta.m_lookupNodeNum / (delta.m_lookupNum ? delta.m_lookupNum : 1),
+        delta.m_allocNum, (double)delta.m_allocScanNum / (delta.m_allocNum ? delta.m_allocNum : 1),
+        delta.m_readaheadHitNum);
+    printf("diskRead %" PRIu64 " bytes/call %.0f diskWrite %" PRIu64 " bytes/call %.0f diskSync %" PRIu64 "\n",
+        delta.m_diskReadNum, (double)delta.m_diskReadBytes / (delta.m_diskReadNum ? delta.m_diskReadNum : 1),
+        delta.m_diskWriteNum, (double)delta.m_diskWriteBytes / (delta.m_diskWriteNum ? delta.m_diskWriteNum : 1),
+        delta.m_diskSyncNum);
+    printLatency("read", delta.m_readLatency);
+    printLatency("write", delta.m_writeLatency);
+    printLatency("sync", delta.m_syncLatency);
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "./bench_data";
+    uint32_t loopNum = argc > 2 ? atoi(argv[2]) : 200000;
+    uint32_t readLen = (argc > 3 ? atoi(argv[3]) : 4) * 1024;
+
+    if (0 == loopNum || 0 == readLen)
+    {
+        printf("usage: %s [dir] [loopNum] [readKB]\n", argv[0]);
+        return -1;
+    }
+    if (!BenchUtil::resetDir(dir + "/stats"))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return -1;
+    }
+
+    // 一次读取调用中的计数：读取次数和字节数、hash链查找和延迟
+    StatsMgr statsMgr;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < loopNum; i++)
+    {
+        uint64_t startNs = statsMgr.beginLatency();
+        statsMgr.add(StatType_LOOKUP_NUM, StatType_LOOKUP_NODE_NUM, 2);
+        statsMgr.add(StatType_READ_NUM, StatType_READ_BYTES, readLen);
+        statsMgr.addLatency(LatencyType_READ, startNs);
+    }
+    double countNs = (double)(BenchUtil::nowNs() - start) / loopNum;
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 256ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir + "/stats";
+    sinfo.m_edgeFSUsableMemory = 4 * 1024 * 1024;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return -1;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    const std::string fileName = "http://edge/stats.mp4";
+    const uint64_t fileSize = 16ull * 1024 * 1024;
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+    std::vector<char> buff(1024 * 1024, 's');
+    uint32_t failNum = 0;
+    for (uint64_t pos = 0; pos < fileSize; pos += buff.size())
+    {
+        failNum += (int64_t)buff.size() == efs->write(key, &buff[0], buff.size(), fileSize) ? 0 : 1;
+    }
+    efs->sync();
+
+    StatsInfo prev;
+    efs->getStats(prev);
+    start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < loopNum; i++)
+    {
+        failNum += (int64_t)readLen == efs->read(key, &buff[0], readLen, (i * 7919ull * 4096) % (fileSize - readLen))
+            ? 0 : 1;
+    }
+    double readNs = (double)(BenchUtil::nowNs() - start) / loopNum;
+
+    StatsInfo cur;
+    efs->getStats(cur);
+    StatsInfo delta = cur;
+    delta.subtract(prev);
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+
+    printf("count %.1fns/call read %.1fns/call overhead %.2f%% fail %u\n", countNs, readNs,
+        countNs * 100 / (readNs ? readNs : 1), failNum);
+    printStats(delta);
+    return 0 == failNum ? 0 : -1;
+}
@@ -0,0 +1,167 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "../src/EdgeFSConst.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+不同写入速率下，后台线程定期落盘的耗时
+full: 数据文件和整个index文件落盘，dirty: 调用sync()，数据文件落盘后只写回被修改的index页
+同时统计落盘期间写入的延迟，sync()只在取出被修改的页时持有锁
+用法: edgefs_bench_sync [dir] [fileNum] [seconds] [writeKB] [syncMs] [rate1,rate2,...]，速率为每秒写入次数，0表示不限速
+*/
+
+struct BenchConf
+{
+    std::string             dir;
+    uint32_t                fileNum;
+    uint32_t                seconds;
+    uint32_t                writeLen;
+    uint32_t                syncMs;
+    std::vector<uint32_t>   rates;
+};
+
+struct SyncStat
+{
+    std::vector<uint64_t>   syncNs;
+    uint32_t                failNum;
+};
+
+static std::string fileNameOf(uint32_t idx)
+{
+    return "http://edge/seg_" + std::to_string(idx) + ".ts";
+}
+
+static void syncLoop(IEdgeFS* efs, bool isFull, int dataFd, int indexFd, uint32_t syncMs,
+    std::atomic<bool>* pIsStop, SyncStat* pStat)
+{
+    while (!*pIsStop)
+    {
+        usleep(syncMs * 1000);
+        uint64_t start = BenchUtil::nowNs();
+        bool isOk = isFull ? 0 == fdatasync(dataFd) && 0 == fdatasync(indexFd) : efs->sync();
+        pStat->syncNs.push_back(BenchUtil::nowNs() - start);
+        pStat->failNum += isOk ? 0 : 1;
+    }
+}
+
+static bool runBench(const BenchConf& conf, bool isFull, uint32_t rate)
+{
+    const char* mode = isFull ? "full" : "dirty";
+    std::string dir = conf.dir + "/" + mode + "_" + std::to_string(rate);
+    if (!BenchUtil::resetDir(dir))
+    {
+        printf("reset dir %s failed\n", dir.c_str());
+        return false;
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 1024ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 16 * 1024 * 1024;
+    if (!efs->initFS(sinfo))
+    {
+        printf("init fs failed\n");
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+    int dataFd = open((dir + "/" + kDataFileName).c_str(), O_RDWR);
+    int indexFd = open((dir + "/" + kIndexFileName).c_str(), O_RDWR);
+    uint64_t indexSize = lseek(indexFd, 0, SEEK_END);
+
+    // 新建的index文件先整体落盘，不计入统计
+    efs->sync();
+    SpaceInfo initSpace;
+    efs->getSpaceInfo(initSpace);
+
+    std::atomic<bool> isStop(false);
+    SyncStat stat;
+    stat.failNum = 0;
+    std::thread syncThread(syncLoop, efs, isFull, dataFd, indexFd, conf.syncMs, &isStop, &stat);
+
+    // 按照速率均匀写入，轮流追加到各个文件
+    std::vector<char> buff(conf.writeLen, 'e');
+    std::vector<uint64_t> writeNs;
+    uint64_t intervalNs = 0 == rate ? 0 : 1000000000ull / rate;
+    uint64_t start = BenchUtil::nowNs();
+    uint64_t endNs = start + conf.seconds * 1000000000ull;
+    uint32_t writeNum = 0;
+    uint32_t failNum = 0;
+    while (true)
+    {
+        uint64_t now = BenchUtil::nowNs();
+        if (now >= endNs)
+        {
+            break;
+        }
+        uint64_t nextNs = start + writeNum * intervalNs;
+        if (now < nextNs)
+        {
+            usleep((nextNs - now) / 1000);
+            continue;
+        }
+        if (conf.writeLen != efs->write(fileNameOf(writeNum % conf.fileNum), &buff[0], conf.writeLen))
+        {
+            failNum++;
+        }
+        writeNs.push_back(BenchUtil::nowNs() - now);
+        writeNum++;
+    }
+    uint64_t costNs = BenchUtil::nowNs() - start;
+    isStop = true;
+    syncThread.join();
+
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    close(dataFd);
+    close(indexFd);
+
+    std::vector<uint64_t>& syncNs = stat.syncNs;
+    std::sort(syncNs.begin(), syncNs.end());
+    printf("[%s] rate %u writes %u fail %u ops %.0f/s syncs %zu syncFail %u sync avg %.2fms p50 %.2fms p99 %.2fms"
+        " max %.2fms\n", mode, rate, writeNum, failNum, writeNum * 1e9 / (costNs ? costNs : 1), syncNs.size(),
+        stat.failNum, BenchUtil::average(syncNs) / 1e6, BenchUtil::percentile(syncNs, 50) / 1e6,
+        BenchUtil::percentile(syncNs, 99) / 1e6, syncNs.empty() ? 0 : syncNs.back() / 1e6);
+    printf("[%s] rate %u write p50 %.1fus p99 %.1fus p999 %.1fus indexSize %" PRIu64 " indexBytes/sync %.0f\n", mode,
+        rate, BenchUtil::percentile(writeNs, 50) / 1e3, BenchUtil::percentile(writeNs, 99) / 1e3,
+        BenchUtil::percentile(writeNs, 99.9) / 1e3, indexSize,
+        isFull ? 0.0 : (double)(space.m_indexSyncBytes - initSpace.m_indexSyncBytes) /
+        std::max<uint64_t>(space.m_indexSyncNum - initSpace.m_indexSyncNum, 1));
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConf conf;
+    conf.dir = argc > 1 ? argv[1] : "./bench_data";
+    conf.fileNum = argc > 2 ? atoi(argv[2]) : 256;
+    conf.seconds = argc > 3 ? atoi(argv[3]) : 2;
+    conf.writeLen = (argc > 4 ? atoi(argv[4]) : 4) * 1024;
+    conf.syncMs = argc > 5 ? atoi(argv[5]) : 50;
+    std::string rates = argc > 6 ? argv[6] : "500,2000,8000,0";
+    std::stringstream ss(rates);
+    std::string rate;
+    while (std::getline(ss, rate, ','))
+    {
+        conf.rates.push_back(atoi(rate.c_str()));
+    }
+
+    if (0 == conf.fileNum || 0 == conf.seconds || 0 == conf.writeLen || 0 == conf.syncMs || conf.rates.empty())
+    {
+        printf("usage: %s [dir] [fileNum] [seconds] [writeKB] [syncMs] [rate1,rate2,...]\n", argv[0]);
+        return -1;
+    }
+
+    for (auto it = conf.rates.begin(); it != conf.rates.end(); ++it)
+    {
+        runBench(conf, true, *it);
+        runBench(conf, false, *it);
+    }
+    return 0;
+}
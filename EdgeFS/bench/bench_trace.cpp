@@ -0,0 +1,96 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+
+/*
+追踪的开销和导出
+分别在不开启和开启追踪时测量页缓存命中的读取耗时，之后导出追踪并统计事件数
+导出的文件可以在chrome://tracing或者https://ui.perfetto.dev中打开
+用法: edgefs_bench_trace [dir] [loopNum]
+*/
+
+static bool runRead(const std::string& dir, uint32_t traceEventNum, uint32_t loopNum, double& readNs,
+    uint32_t& eventNum)
+{
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = 256ull * 1024 * 1024;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = 4 * 1024 * 1024;
+    sinfo.m_traceEventNum = traceEventNum;
+    if (!BenchUtil::resetDir(dir) || !efs->initFS(sinfo))
+    {
+        printf("init fs failed, dir %s\n", dir.c_str());
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return false;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    const std::string fileName = "http://edge/trace.mp4";
+    const uint64_t fileSize = 16ull * 1024 * 1024;
+    const uint32_t readLen = 4096;
+    std::vector<char> buff(1024 * 1024, 't');
+    uint32_t failNum = 0;
+    for (uint64_t pos = 0; pos < fileSize; pos += buff.size())
+    {
+        failNum += (int64_t)buff.size() == efs->write(fileName, &buff[0], buff.size(), fileSize) ? 0 : 1;
+    }
+    efs->sync();
+
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t i = 0; i < loopNum; i++)
+    {
+        uint64_t offset = (i * 7919ull * 4096) % (fileSize - readLen);
+        failNum += (int64_t)readLen == efs->read(fileName, &buff[0], readLen, offset) ? 0 : 1;
+    }
+    readNs = (double)(BenchUtil::nowNs() - start) / loopNum;
+
+    // 按行统计导出的事件数，不开启追踪时导出失败
+    eventNum = 0;
+    std::string tracePath = dir + "/trace.json";
+    if (efs->dumpTrace(tracePath))
+    {
+        FILE* fp = fopen(tracePath.c_str(), "r");
+        char line[512];
+        while (NULL != fp && NULL != fgets(line, sizeof(line), fp))
+        {
+            eventNum += 0 == strncmp(line, "{\"name\"", 7) || 0 == strncmp(line, ",{\"name\"", 8) ? 1 : 0;
+        }
+        if (NULL != fp)
+        {
+            fclose(fp);
+        }
+    }
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return 0 == failNum;
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = argc > 1 ? argv[1] : "./bench_data";
+    uint32_t loopNum = argc > 2 ? atoi(argv[2]) : 100000;
+
+    if (0 == loopNum)
+    {
+        printf("usage: %s [dir] [loopNum]\n", argv[0]);
+        return -1;
+    }
+
+    double offNs = 0;
+    double onNs = 0;
+    uint32_t offEventNum = 0;
+    uint32_t onEventNum = 0;
+    if (!runRead(dir + "/trace_off", 0, loopNum, offNs, offEventNum) ||
+        !runRead(dir + "/trace_on", 65536, loopNum, onNs, onEventNum))
+    {
+        return -1;
+    }
+
+    printf("[trace off] read %.1fns/call events %u\n", offNs, offEventNum);
+    printf("[trace on]  read %.1fns/call events %u overhead %.2f%% trace %s/trace_on/trace.json\n", onNs,
+        onEventNum, (onNs - offNs) * 100 / (offNs ? offNs : 1), dir.c_str());
+    return 0 == offEventNum && 0 != onEventNum ? 0 : -1;
+}
@@ -0,0 +1,512 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <functional>
+
+/*
+存储引擎的综合测试，每个阶段输出一行json，便于比较不同版本和编译选项
+阶段: seq_write顺序写入数据集 seq_read顺序读取数据集 rand_read随机读取 rand_write交错追加多个文件
+      append小块追加 mixed按比例随机读写 fill在新的目录中依次填充到各个比例，每个比例测量写入和随机读写
+用法: edgefs_bench [--key=value ...]
+    --dir=./bench_data      测试目录
+    --capacity-mb=512       磁盘容量，设置chunk-kb时按内存可以管理的chunk个数计算
+    --memory-kb=4096        index可用内存
+    --chunk-kb=0            chunk大小，0表示由容量和内存计算
+    --threads=1             并发调用的线程数
+    --value=fixed:256       文件大小分布，单位KB，fixed:N uniform:MIN:MAX exp:MEAN
+    --dataset-pct=25        seq_write写入的数据量占容量的比例
+    --io-kb=64              顺序读写和填充时每次调用的长度
+    --rand-kb=4             随机读写每次调用的长度
+    --append-bytes=512      append阶段每次追加的字节数
+    --ops=20000             随机读写阶段每个阶段的调用次数
+    --read-pct=90           mixed阶段读取的比例
+    --fills=10,50,90,99     fill阶段依次填充到的比例
+    --phases=all            逗号分隔的阶段名称
+    --seed=1
+*/
+
+typedef struct BenchConfig_
+{
+    std::string     m_dir;
+    uint64_t        m_capacity;
+    uint64_t        m_memory;
+    uint32_t        m_chunkSize;
+    uint32_t        m_threadNum;
+    std::string     m_value;
+    uint32_t        m_datasetPct;
+    uint32_t        m_ioLen;
+    uint32_t        m_randLen;
+    uint32_t        m_appendLen;
+    uint32_t        m_opNum;
+    uint32_t        m_readPct;
+    std::vector<uint32_t>   m_fills;
+    std::string     m_phases;
+    uint32_t        m_seed;
+
+    BenchConfig_()
+    : m_dir("./bench_data")
+    , m_capacity(512ull * 1024 * 1024)
+    , m_memory(4 * 1024 * 1024)
+    , m_chunkSize(0)
+    , m_threadNum(1)
+    , m_value("fixed:256")
+    , m_datasetPct(25)
+    , m_ioLen(64 * 1024)
+    , m_randLen(4096)
+    , m_appendLen(512)
+    , m_opNum(20000)
+    , m_readPct(90)
+    , m_fills({ 10, 50, 90, 99 })
+    , m_phases("all")
+    , m_seed(1)
+    {}
+} BenchConfig;
+
+typedef struct ObjectInfo_
+{
+    std::string     m_name;
+    uint64_t        m_size;
+} ObjectInfo;
+
+typedef struct PhaseResult_
+{
+    uint64_t                m_opNum;
+    uint64_t                m_bytes;
+    uint64_t                m_failNum;
+    std::vector<uint64_t>   m_latencies;
+
+    PhaseResult_()
+    : m_opNum(0)
+    , m_bytes(0)
+    , m_failNum(0)
+    {}
+} PhaseResult;
+
+// 同时写入多个文件，每次追加到随机的一个，写满目标大小后换新的文件
+class StreamWriter
+{
+public:
+    StreamWriter(IEdgeFS* efs, const ValueDist& dist, const std::string& prefix, uint32_t streamNum, uint64_t seed)
+    : m_efs(efs)
+    , m_dist(dist)
+    , m_prefix(prefix)
+    , m_rng(seed)
+    , m_nextId(0)
+    , m_streams(streamNum)
+    , m_targets(streamNum)
+    {
+        for (uint32_t i = 0; i < streamNum; i++)
+        {
+            newStream(i);
+        }
+    }
+
+    // 返回写入的字节数，失败返回-1
+    int64_t append(const char* buff, uint32_t len)
+    {
+        uint32_t idx = m_rng() % m_streams.size();
+        ObjectInfo& stream = m_streams[idx];
+        uint32_t writeLen = (uint32_t)std::min<uint64_t>(len, m_targets[idx] - stream.m_size);
+        int64_t ret = m_efs->write(stream.m_name, buff, writeLen, m_targets[idx]);
+        if (-1 == ret)
+        {
+            newStream(idx);
+            return -1;
+        }
+        stream.m_size += ret;
+        if (stream.m_size >= m_targets[idx])
+        {
+            m_doneObjects.push_back(stream);
+            newStream(idx);
+        }
+        return ret;
+    }
+
+    // 已经写入数据的文件，包括没有写满的
+    void collect(std::vector<ObjectInfo>& objects) const
+    {
+        objects.insert(objects.end(), m_doneObjects.begin(), m_doneObjects.end());
+        for (auto it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            if (0 != it->m_size)
+            {
+                objects.push_back(*it);
+            }
+        }
+    }
+
+private:
+    void newStream(uint32_t idx)
+    {
+        m_streams[idx].m_name = m_prefix + std::to_string(m_nextId++);
+        m_streams[idx].m_size = 0;
+        m_targets[idx] = m_dist.next(m_rng);
+    }
+
+private:
+    IEdgeFS*                    m_efs;
+    const ValueDist&            m_dist;
+    std::string                 m_prefix;
+    std::mt19937_64             m_rng;
+    uint64_t                    m_nextId;
+    std::vector<ObjectInfo>     m_streams;
+    std::vector<uint64_t>       m_targets;
+    std::vector<ObjectInfo>     m_doneObjects;
+};
+
+static bool parseArgs(int argc, char** argv, BenchConfig& config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t pos = arg.find('=');
+        if (0 != arg.compare(0, 2, "--") || std::string::npos == pos)
+        {
+            return false;
+        }
+        std::string key = arg.substr(2, pos - 2);
+        std::string value = arg.substr(pos + 1);
+        uint64_t num = strtoull(value.c_str(), NULL, 10);
+        if ("dir" == key) config.m_dir = value;
+        else if ("capacity-mb" == key) config.m_capacity = num * 1024 * 1024;
+        else if ("memory-kb" == key) config.m_memory = num * 1024;
+        else if ("chunk-kb" == key) config.m_chunkSize = (uint32_t)num * 1024;
+        else if ("threads" == key) config.m_threadNum = (uint32_t)num;
+        else if ("value" == key) config.m_value = value;
+        else if ("dataset-pct" == key) config.m_datasetPct = (uint32_t)num;
+        else if ("io-kb" == key) config.m_ioLen = (uint32_t)num * 1024;
+        else if ("rand-kb" == key) config.m_randLen = (uint32_t)num * 1024;
+        else if ("append-bytes" == key) config.m_appendLen = (uint32_t)num;
+        else if ("ops" == key) config.m_opNum = (uint32_t)num;
+        else if ("read-pct" == key) config.m_readPct = (uint32_t)num;
+        else if ("phases" == key) config.m_phases = value;
+        else if ("seed" == key) config.m_seed = (uint32_t)num;
+        else if ("fills" == key)
+        {
+            config.m_fills.clear();
+            std::stringstream ss(value);
+            std::string item;
+            while (std::getline(ss, item, ','))
+            {
+                config.m_fills.push_back((uint32_t)strtoul(item.c_str(), NULL, 10));
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return 0 != config.m_capacity && 0 != config.m_memory && 0 != config.m_threadNum && 0 != config.m_ioLen &&
+        0 != config.m_randLen && 0 != config.m_appendLen && config.m_readPct <= 100 && config.m_datasetPct < 100;
+}
+
+static bool isPhaseOn(const BenchConfig& config, const std::string& phase)
+{
+    return "all" == config.m_phases || std::string::npos != ("," + config.m_phases + ",").find("," + phase + ",");
+}
+
+static double calcFillPct(IEdgeFS* efs)
+{
+    SpaceInfo info;
+    return efs->getSpaceInfo(info) && 0 != info.m_chunkNum ? info.m_usedChunkNum * 100.0 / info.m_chunkNum : 0;
+}
+
+// 清空目录后初始化，设置了chunk大小时先按任意容量初始化得到内存可以管理的chunk个数
+static IEdgeFS* openFS(const BenchConfig& config, const std::string& dir, SpaceInfo& space)
+{
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = config.m_capacity;
+    sinfo.m_diskRootDir = dir;
+    sinfo.m_edgeFSUsableMemory = config.m_memory;
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        IEdgeFS* efs = CreateEdgeFS();
+        if (!BenchUtil::resetDir(dir) || !efs->initFS(sinfo) || !efs->getSpaceInfo(space))
+        {
+            printf("{\"error\":\"init fs failed\",\"dir\":\"%s\"}\n", dir.c_str());
+            efs->unitFS();
+            DestroyPcdnSdk(efs);
+            return NULL;
+        }
+        AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+        if (0 == config.m_chunkSize || space.m_chunkSize == config.m_chunkSize || 0 != i)
+        {
+            return efs;
+        }
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        sinfo.m_diskCapacity = (uint64_t)space.m_chunkNum * config.m_chunkSize;
+    }
+    return NULL;
+}
+
+// 每个线程执行一次func，汇总后输出一行json，extra为附加的字段
+static void runPhase(IEdgeFS* efs, const BenchConfig& config, const std::string& phase, const std::string& extra,
+    const std::function<void(uint32_t, PhaseResult&)>& func)
+{
+    std::vector<PhaseResult> results(config.m_threadNum);
+    std::vector<std::thread> threads;
+    uint64_t start = BenchUtil::nowNs();
+    for (uint32_t tid = 0; tid < config.m_threadNum; tid++)
+    {
+        threads.push_back(std::thread(func, tid, std::ref(results[tid])));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it)
+    {
+        it->join();
+    }
+    double sec = (BenchUtil::nowNs() - start) / 1e9;
+
+    PhaseResult total;
+    for (auto it = results.begin(); it != results.end(); ++it)
+    {
+        total.m_opNum += it->m_opNum;
+        total.m_bytes += it->m_bytes;
+        total.m_failNum += it->m_failNum;
+        total.m_latencies.insert(total.m_latencies.end(), it->m_latencies.begin(), it->m_latencies.end());
+    }
+    sec = sec > 0 ? sec : 1e-9;
+    uint64_t avg = BenchUtil::average(total.m_latencies);
+    uint64_t p50 = BenchUtil::percentile(total.m_latencies, 50);
+    printf("{\"phase\":\"%s\"%s,\"threads\":%u,\"ops\":%" PRIu64 ",\"failNum\":%" PRIu64 ",\"bytes\":%" PRIu64
+        ",\"sec\":%.6f,\"opsPerSec\":%.1f,\"mbPerSec\":%.2f,\"fillPct\":%.2f,\"latencyNs\":{\"avg\":%" PRIu64
+        ",\"p50\":%" PRIu64 ",\"p90\":%" PRIu64 ",\"p99\":%" PRIu64 ",\"p999\":%" PRIu64 ",\"max\":%" PRIu64 "}}\n",
+        phase.c_str(), extra.c_str(), config.m_threadNum, total.m_opNum, total.m_failNum, total.m_bytes, sec,
+        total.m_opNum / sec, total.m_bytes / sec / (1024 * 1024), calcFillPct(efs), avg, p50,
+        BenchUtil::percentile(total.m_latencies, 90), BenchUtil::percentile(total.m_latencies, 99),
+        BenchUtil::percentile(total.m_latencies, 99.9), total.m_latencies.empty() ? 0 : total.m_latencies.back());
+    fflush(stdout);
+}
+
+static void recordOp(PhaseResult& result, int64_t ret, uint64_t startNs)
+{
+    result.m_latencies.push_back(BenchUtil::nowNs() - startNs);
+    result.m_opNum++;
+    result.m_failNum += -1 == ret ? 1 : 0;
+    result.m_bytes += -1 == ret ? 0 : ret;
+}
+
+static void randRead(IEdgeFS* efs, const std::vector<ObjectInfo>& objects, std::mt19937_64& rng, char* buff,
+    uint32_t len, PhaseResult& result)
+{
+    const ObjectInfo& object = objects[rng() % objects.size()];
+    uint64_t offset = object.m_size > len ? rng() % (object.m_size - len) / 4096 * 4096 : 0;
+    uint64_t startNs = BenchUtil::nowNs();
+    recordOp(result, efs->read(object.m_name, buff, len, offset), startNs);
+}
+
+// 按比例随机读取objects或者追加写入新的文件
+static void runMixed(IEdgeFS* efs, const BenchConfig& config, const ValueDist& dist,
+    const std::vector<ObjectInfo>& objects, const std::string& phase, const std::string& extra)
+{
+    if (objects.empty())
+    {
+        return ;
+    }
+    // 多次执行时写入不同的文件
+    static uint32_t s_round = 0;
+    std::string prefix = phase + "_" + std::to_string(s_round++) + "_";
+    runPhase(efs, config, phase, extra, [&](uint32_t tid, PhaseResult& result) {
+        std::mt19937_64 rng(config.m_seed * 1000 + tid);
+        StreamWriter writer(efs, dist, prefix + std::to_string(tid) + "_", 16, rng());
+        std::vector<char> buff(config.m_randLen, 'm');
+        for (uint32_t i = tid; i < config.m_opNum; i += config.m_threadNum)
+        {
+            if (rng() % 100 < config.m_readPct)
+            {
+                randRead(efs, objects, rng, &buff[0], config.m_randLen, result);
+                continue;
+            }
+            uint64_t startNs = BenchUtil::nowNs();
+            recordOp(result, writer.append(&buff[0], config.m_randLen), startNs);
+        }
+    });
+}
+
+// 在新的目录中依次填充到各个比例
+static bool runFill(const BenchConfig& config, const ValueDist& dist)
+{
+    SpaceInfo space;
+    IEdgeFS* efs = openFS(config, config.m_dir + "/fill", space);
+    if (NULL == efs)
+    {
+        return false;
+    }
+    std::vector<StreamWriter*> writers;
+    for (uint32_t tid = 0; tid < config.m_threadNum; tid++)
+    {
+        std::string prefix = "fill_" + std::to_string(tid) + "_";
+        writers.push_back(new StreamWriter(efs, dist, prefix, 4, config.m_seed * 1000 + tid));
+    }
+
+    for (auto it = config.m_fills.begin(); it != config.m_fills.end(); ++it)
+    {
+        uint32_t fill = std::min(*it, 100u);
+        std::string extra = ",\"fillTarget\":" + std::to_string(fill);
+        // 按占用的chunk比例估算还需要写入的字节数，文件最后一个chunk没有写满，实际比例略高
+        double needPct = std::max(fill - calcFillPct(efs), 0.0);
+        uint64_t needBytes = (uint64_t)(needPct / 100 * space.m_chunkNum * space.m_chunkSize);
+        std::atomic<uint64_t> writtenBytes(0);
+        runPhase(efs, config, "fill_write", extra, [&](uint32_t tid, PhaseResult& result) {
+            std::vector<char> buff(config.m_ioLen, 'f');
+            uint32_t failNum = 0;
+            // 连续失败说明空间不足
+            while (writtenBytes.load() < needBytes && failNum < 16)
+            {
+                uint64_t startNs = BenchUtil::nowNs();
+                int64_t ret = writers[tid]->append(&buff[0], config.m_ioLen);
+                recordOp(result, ret, startNs);
+                failNum = -1 == ret ? failNum + 1 : 0;
+                writtenBytes += -1 == ret ? 0 : ret;
+            }
+        });
+
+        std::vector<ObjectInfo> objects;
+        for (auto writerIt = writers.begin(); writerIt != writers.end(); ++writerIt)
+        {
+            (*writerIt)->collect(objects);
+        }
+        runMixed(efs, config, dist, objects, "fill_mixed", extra);
+    }
+
+    for (auto it = writers.begin(); it != writers.end(); ++it)
+    {
+        delete *it;
+    }
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config))
+    {
+        printf("usage: %s [--dir=] [--capacity-mb=] [--memory-kb=] [--chunk-kb=] [--threads=] [--value=fixed:N|"
+            "uniform:MIN:MAX|exp:MEAN] [--dataset-pct=] [--io-kb=] [--rand-kb=] [--append-bytes=] [--ops=]"
+            " [--read-pct=] [--fills=] [--phases=] [--seed=]\n", argv[0]);
+        return -1;
+    }
+
+    SpaceInfo space;
+    IEdgeFS* efs = openFS(config, config.m_dir + "/main", space);
+    if (NULL == efs)
+    {
+        return -1;
+    }
+    uint64_t diskSize = (uint64_t)space.m_chunkNum * space.m_chunkSize;
+    ValueDist dist;
+    if (!dist.init(config.m_value, diskSize / 16))
+    {
+        printf("{\"error\":\"invalid value distribution\",\"value\":\"%s\"}\n", config.m_value.c_str());
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return -1;
+    }
+    printf("{\"phase\":\"config\",\"capacity\":%" PRIu64 ",\"memory\":%" PRIu64 ",\"chunkSize\":%u,\"chunkNum\":%u"
+        ",\"threads\":%u,\"value\":\"%s\",\"datasetPct\":%u,\"ioLen\":%u,\"randLen\":%u,\"appendLen\":%u,\"ops\":%u"
+        ",\"readPct\":%u,\"seed\":%u}\n", diskSize, config.m_memory, space.m_chunkSize, space.m_chunkNum,
+        config.m_threadNum, config.m_value.c_str(), config.m_datasetPct, config.m_ioLen, config.m_randLen,
+        config.m_appendLen, config.m_opNum, config.m_readPct, config.m_seed);
+
+    // 数据集由seq_write写入，之后的读取阶段都读取这些文件
+    std::vector<ObjectInfo> objects;
+    std::mt19937_64 rng(config.m_seed);
+    for (uint64_t bytes = 0; bytes < diskSize * config.m_datasetPct / 100;)
+    {
+        ObjectInfo object = { "obj_" + std::to_string(objects.size()), dist.next(rng) };
+        bytes += object.m_size;
+        objects.push_back(object);
+    }
+
+    if (isPhaseOn(config, "seq_write") || isPhaseOn(config, "seq_read") || isPhaseOn(config, "rand_read") ||
+        isPhaseOn(config, "mixed"))
+    {
+        runPhase(efs, config, "seq_write", "", [&](uint32_t tid, PhaseResult& result) {
+            std::vector<char> buff(config.m_ioLen, 'w');
+            for (size_t i = tid; i < objects.size(); i += config.m_threadNum)
+            {
+                for (uint64_t pos = 0; pos < objects[i].m_size; pos += config.m_ioLen)
+                {
+                    uint32_t len = (uint32_t)std::min<uint64_t>(config.m_ioLen, objects[i].m_size - pos);
+                    uint64_t startNs = BenchUtil::nowNs();
+                    recordOp(result, efs->write(objects[i].m_name, &buff[0], len, objects[i].m_size), startNs);
+                }
+            }
+        });
+        efs->sync();
+    }
+
+    if (isPhaseOn(config, "seq_read"))
+    {
+        runPhase(efs, config, "seq_read", "", [&](uint32_t tid, PhaseResult& result) {
+            std::vector<char> buff(config.m_ioLen);
+            for (size_t i = tid; i < objects.size(); i += config.m_threadNum)
+            {
+                for (uint64_t pos = 0; pos < objects[i].m_size; pos += config.m_ioLen)
+                {
+                    uint64_t startNs = BenchUtil::nowNs();
+                    recordOp(result, efs->read(objects[i].m_name, &buff[0], config.m_ioLen, pos), startNs);
+                }
+            }
+        });
+    }
+
+    if (isPhaseOn(config, "rand_read"))
+    {
+        runPhase(efs, config, "rand_read", "", [&](uint32_t tid, PhaseResult& result) {
+            std::mt19937_64 threadRng(config.m_seed * 1000 + tid);
+            std::vector<char> buff(config.m_randLen);
+            for (uint32_t i = tid; i < config.m_opNum; i += config.m_threadNum)
+            {
+                randRead(efs, objects, threadRng, &buff[0], config.m_randLen, result);
+            }
+        });
+    }
+
+    // 交错追加多个文件，磁盘上的写入位置随机
+    if (isPhaseOn(config, "rand_write"))
+    {
+        runPhase(efs, config, "rand_write", "", [&](uint32_t tid, PhaseResult& result) {
+            StreamWriter writer(efs, dist, "rw_" + std::to_string(tid) + "_", 16, config.m_seed * 1000 + tid);
+            std::vector<char> buff(config.m_randLen, 'r');
+            for (uint32_t i = tid; i < config.m_opNum; i += config.m_threadNum)
+            {
+                uint64_t startNs = BenchUtil::nowNs();
+                recordOp(result, writer.append(&buff[0], config.m_randLen), startNs);
+            }
+        });
+    }
+
+    if (isPhaseOn(config, "append"))
+    {
+        runPhase(efs, config, "append", "", [&](uint32_t tid, PhaseResult& result) {
+            StreamWriter writer(efs, dist, "ap_" + std::to_string(tid) + "_", 256, config.m_seed * 1000 + tid);
+            std::vector<char> buff(config.m_appendLen, 'a');
+            for (uint32_t i = tid; i < config.m_opNum; i += config.m_threadNum)
+            {
+                uint64_t startNs = BenchUtil::nowNs();
+                recordOp(result, writer.append(&buff[0], config.m_appendLen), startNs);
+            }
+        });
+    }
+
+    if (isPhaseOn(config, "mixed"))
+    {
+        runMixed(efs, config, dist, objects, "mixed", ",\"readPct\":" + std::to_string(config.m_readPct));
+    }
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+
+    if (isPhaseOn(config, "fill") && !runFill(config, dist))
+    {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,346 @@
+#include "../src/common/BinaryLog.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <unordered_map>
+
+/*
+把二进制日志(SystemInfo::m_isBinaryLog打开时的edgefs.blog)还原为和文本日志相同格式的文本，输出到标准输出
+每个文件单独解码，滚动后的文件按时间顺序传入，例如 edgefs.blog.2 edgefs.blog.1 edgefs.blog
+用法: edgefs_logdecode FILE...
+*/
+
+typedef struct DecodeSite_
+{
+    std::string     m_levelStr;
+    std::string     m_file;
+    std::string     m_function;
+    std::string     m_format;
+    uint32_t        m_line;
+} DecodeSite;
+
+typedef struct DecodeArg_
+{
+    uint8_t         m_type;
+    int64_t         m_int;
+    uint64_t        m_uint;
+    double          m_double;
+    std::string     m_str;
+} DecodeArg;
+
+typedef struct DecodeClock_
+{
+    uint64_t        m_tick;
+    uint64_t        m_ns;
+    uint64_t        m_tickPerSec;
+} DecodeClock;
+
+// 按顺序读取记录内容，越界后m_isOk为false
+class RecordReader
+{
+public:
+    RecordReader(const char* p, const char* end)
+    : m_p(p)
+    , m_end(end)
+    , m_isOk(true)
+    {}
+
+    template<typename T>
+    T get()
+    {
+        T value = 0;
+        if (m_end - m_p < (ptrdiff_t)sizeof(T))
+        {
+            m_isOk = false;
+            return value;
+        }
+        memcpy(&value, m_p, sizeof(T));
+        m_p += sizeof(T);
+        return value;
+    }
+
+    std::string getString()
+    {
+        uint16_t len = get<uint16_t>();
+        if (!m_isOk || m_end - m_p < len)
+        {
+            m_isOk = false;
+            return "";
+        }
+        std::string str(m_p, len);
+        m_p += len;
+        return str;
+    }
+
+    std::string getRest()
+    {
+        std::string str(m_p, m_end - m_p);
+        m_p = m_end;
+        return str;
+    }
+
+    bool isEnd()    { return m_p >= m_end; }
+    bool isOk()     { return m_isOk; }
+
+private:
+    const char*     m_p;
+    const char*     m_end;
+    bool            m_isOk;
+};
+
+static std::string formatTime(const DecodeClock& clock, uint64_t tick)
+{
+    int64_t deltaNs = (int64_t)((double)(int64_t)(tick - clock.m_tick) * 1e9 / clock.m_tickPerSec);
+    uint64_t ns = clock.m_ns + deltaNs;
+    time_t sec = (time_t)(ns / 1000000000ull);
+    struct tm tmInfo;
+    localtime_r(&sec, &tmInfo);
+    char buf[64];
+    size_t len = strftime(buf, sizeof(buf), "%F %T", &tmInfo);
+    snprintf(buf + len, sizeof(buf) - len, ".%03u", (uint32_t)(ns / 1000000 % 1000));
+    return buf;
+}
+
+// 按格式中的转换说明依次代入参数，长度修饰按记录的参数类型重新生成
+static std::string render(const std::string& format, const std::vector<DecodeArg>& args)
+{
+    std::string out;
+    size_t argIdx = 0;
+    char buf[4096];
+    for (size_t i = 0; i < format.size(); i++)
+    {
+        if ('%' != format[i])
+        {
+            out.push_back(format[i]);
+            continue;
+        }
+        if (i + 1 < format.size() && '%' == format[i + 1])
+        {
+            out.push_back('%');
+            i++;
+            continue;
+        }
+
+        std::string spec = "%";
+        size_t j = i + 1;
+        for (; j < format.size() && strchr("-+ #0'", format[j]); j++)
+        {
+            spec.push_back(format[j]);
+        }
+        // 宽度和精度可能是*，取一个整数参数
+        for (; j < format.size() && (isdigit(format[j]) || '.' == format[j] || '*' == format[j]); j++)
+        {
+            if ('*' != format[j])
+            {
+                spec.push_back(format[j]);
+                continue;
+            }
+            int64_t value = argIdx < args.size() ? args[argIdx].m_int : 0;
+            argIdx++;
+            spec += std::to_string(value);
+        }
+        for (; j < format.size() && strchr("hlLqjzt", format[j]); j++)
+        {
+        }
+        if (j >= format.size())
+        {
+            out += format.substr(i);
+            break;
+        }
+        char conv = format[j];
+        i = j;
+
+        if (argIdx >= args.size())
+        {
+            out += "<missing>";
+            continue;
+        }
+        const DecodeArg& arg = args[argIdx++];
+        if (strchr("diouxXc", conv) && (BinaryLogArg_INT == arg.m_type || BinaryLogArg_UINT == arg.m_type))
+        {
+            if ('c' == conv)
+            {
+                snprintf(buf, sizeof(buf), (spec + conv).c_str(), (int)arg.m_int);
+            }
+            else if (BinaryLogArg_INT == arg.m_type)
+            {
+                snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), (long long)arg.m_int);
+            }
+            else
+            {
+                snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), (unsigned long long)arg.m_uint);
+            }
+        }
+        else if (strchr("eEfFgGaA", conv) && BinaryLogArg_DOUBLE == arg.m_type)
+        {
+            snprintf(buf, sizeof(buf), (spec + conv).c_str(), arg.m_double);
+        }
+        else if ('s' == conv && BinaryLogArg_STRING == arg.m_type)
+        {
+            snprintf(buf, sizeof(buf), (spec + conv).c_str(), arg.m_str.c_str());
+        }
+        else if ('p' == conv && BinaryLogArg_POINTER == arg.m_type)
+        {
+            snprintf(buf, sizeof(buf), (spec + conv).c_str(), (void*)(uintptr_t)arg.m_uint);
+        }
+        else
+        {
+            snprintf(buf, sizeof(buf), "<bad arg %c>", conv);
+        }
+        out += buf;
+    }
+    return out;
+}
+
+static bool decodeArgs(RecordReader& reader, std::vector<DecodeArg>& args)
+{
+    while (!reader.isEnd())
+    {
+        DecodeArg arg;
+        arg.m_type = reader.get<uint8_t>();
+        arg.m_int = 0;
+        arg.m_uint = 0;
+        arg.m_double = 0;
+        switch (arg.m_type)
+        {
+        case BinaryLogArg_INT:
+            arg.m_int = reader.get<int64_t>();
+            arg.m_uint = arg.m_int;
+            break;
+        case BinaryLogArg_UINT:
+        case BinaryLogArg_POINTER:
+            arg.m_uint = reader.get<uint64_t>();
+            arg.m_int = arg.m_uint;
+            break;
+        case BinaryLogArg_DOUBLE:
+            arg.m_double = reader.get<double>();
+            break;
+        case BinaryLogArg_STRING:
+            arg.m_str = reader.getString();
+            break;
+        default:
+            return false;
+        }
+        if (!reader.isOk())
+        {
+            return false;
+        }
+        args.push_back(arg);
+    }
+    return true;
+}
+
+// 返回解码失败的记录数
+static uint64_t decodeFile(const std::string& path, const std::string& data)
+{
+    if (data.size() < sizeof(kBinaryLogMagic) || 0 != memcmp(data.data(), kBinaryLogMagic, sizeof(kBinaryLogMagic)))
+    {
+        fprintf(stderr, "%s: not a binary log\n", path.c_str());
+        return 1;
+    }
+
+    std::unordered_map<uint32_t, DecodeSite> sites;
+    DecodeClock clock = { 0, 0, 1000000000ull };
+    uint64_t badNum = 0;
+    size_t offset = sizeof(kBinaryLogMagic);
+    while (offset + kBinaryLogHeadLen <= data.size())
+    {
+        uint16_t len = 0;
+        memcpy(&len, data.data() + offset, sizeof(len));
+        uint8_t type = (uint8_t)data[offset + sizeof(len)];
+        if (len < kBinaryLogHeadLen || offset + len > data.size())
+        {
+            fprintf(stderr, "%s: truncated record at offset %zu\n", path.c_str(), offset);
+            return badNum + 1;
+        }
+        RecordReader reader(data.data() + offset + kBinaryLogHeadLen, data.data() + offset + len);
+        offset += len;
+
+        if (BinaryLogType_SITE == type)
+        {
+            uint32_t siteId = reader.get<uint32_t>();
+            DecodeSite site;
+            reader.get<uint8_t>();
+            site.m_line = reader.get<uint32_t>();
+            site.m_levelStr = reader.getString();
+            site.m_file = reader.getString();
+            site.m_function = reader.getString();
+            site.m_format = reader.getString();
+            sites[siteId] = site;
+        }
+        else if (BinaryLogType_CLOCK == type)
+        {
+            clock.m_tick = reader.get<uint64_t>();
+            clock.m_ns = reader.get<uint64_t>();
+            clock.m_tickPerSec = std::max<uint64_t>(reader.get<uint64_t>(), 1);
+        }
+        else if (BinaryLogType_MSG == type)
+        {
+            uint32_t siteId = reader.get<uint32_t>();
+            uint64_t tick = reader.get<uint64_t>();
+            std::vector<DecodeArg> args;
+            auto it = sites.find(siteId);
+            if (sites.end() == it || !decodeArgs(reader, args))
+            {
+                badNum++;
+                continue;
+            }
+            const DecodeSite& site = it->second;
+            printf("%s %s [%s-%s:%u] %s\n", formatTime(clock, tick).c_str(), site.m_levelStr.c_str(),
+                site.m_file.c_str(), site.m_function.c_str(), site.m_line,
+                render(site.m_format.substr(std::min<size_t>(kLogSitePrefixLen, site.m_format.size())), args).c_str());
+        }
+        else if (BinaryLogType_TEXT == type)
+        {
+            uint64_t tick = reader.get<uint64_t>();
+            printf("%s %s\n", formatTime(clock, tick).c_str(), reader.getRest().c_str());
+        }
+        else if (BinaryLogType_DROP == type)
+        {
+            uint64_t tick = reader.get<uint64_t>();
+            uint64_t dropNum = reader.get<uint64_t>();
+            uint64_t totalNum = reader.get<uint64_t>();
+            printf("%s W [AsyncLogging] log buffer full, dropped %" PRIu64 " total %" PRIu64 "\n",
+                formatTime(clock, tick).c_str(), dropNum, totalNum);
+        }
+        if (!reader.isOk())
+        {
+            badNum++;
+        }
+    }
+    return badNum;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: %s FILE...\n", argv[0]);
+        return -1;
+    }
+
+    uint64_t badNum = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        FILE* fp = fopen(argv[i], "rb");
+        if (NULL == fp)
+        {
+            fprintf(stderr, "open %s failed\n", argv[i]);
+            return -1;
+        }
+        std::string data;
+        char buf[64 * 1024];
+        size_t readLen = 0;
+        while ((readLen = fread(buf, 1, sizeof(buf), fp)) > 0)
+        {
+            data.append(buf, readLen);
+        }
+        fclose(fp);
+        badNum += decodeFile(argv[i], data);
+    }
+    if (0 != badNum)
+    {
+        fprintf(stderr, "%" PRIu64 " records failed to decode\n", badNum);
+    }
+    return 0 == badNum ? 0 : -1;
+}
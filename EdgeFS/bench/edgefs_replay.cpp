@@ -0,0 +1,352 @@
+#include "../src/IEdgeFS.h"
+#include "../src/common/common.h"
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <thread>
+#include <unordered_map>
+
+/*
+回放CDN访问的trace，统计命中率、吞吐和延迟，输出一行json
+trace每行一个请求: 时间戳(us) 操作(R读取/W追加) key 偏移 长度，#开头的行为注释，可以由edgefs_tracegen生成
+读取时请求的范围完整存在为命中，未命中时模拟回源，把文件从已有的末尾追加到请求范围的末尾
+打开--range-fill时只回源请求范围中缺失的部分，用writeRange写入，文件中间可以有空洞
+追加请求写入文件末尾到请求范围末尾之间没有的部分，已经存在的部分跳过
+同一个key的请求由同一个线程按顺序执行，空间写满后写入失败，没有淘汰
+用法: edgefs_replay --trace=FILE [--key=value ...]
+    --dir=./bench_data      测试目录，回放前清空
+    --capacity-mb=512       磁盘容量
+    --memory-kb=4096        index可用内存
+    --threads=1             回放的线程数
+    --speed=0               按原始时间间隔的倍速回放，0表示尽快回放
+    --fill-on-miss=1        未命中时是否回源写入
+    --io-kb=1024            读写请求拆分为不超过该长度的调用
+    --range-fill=0          未命中时是否只回源缺失的范围
+*/
+
+typedef struct ReplayConfig_
+{
+    std::string     m_trace;
+    std::string     m_dir;
+    uint64_t        m_capacity;
+    uint64_t        m_memory;
+    uint32_t        m_threadNum;
+    double          m_speed;
+    bool            m_isFillOnMiss;
+    uint32_t        m_ioLen;
+    bool            m_isRangeFill;
+
+    ReplayConfig_()
+    : m_dir("./bench_data")
+    , m_capacity(512ull * 1024 * 1024)
+    , m_memory(4 * 1024 * 1024)
+    , m_threadNum(1)
+    , m_speed(0)
+    , m_isFillOnMiss(true)
+    , m_ioLen(1024 * 1024)
+    , m_isRangeFill(false)
+    {}
+} ReplayConfig;
+
+typedef struct TraceOp_
+{
+    uint64_t        m_timeUs;
+    bool            m_isRead;
+    std::string     m_key;
+    uint64_t        m_offset;
+    uint64_t        m_len;
+} TraceOp;
+
+typedef struct ReplayResult_
+{
+    uint64_t                m_readNum;
+    uint64_t                m_hitNum;
+    uint64_t                m_readBytes;        // 请求读取的字节数
+    uint64_t                m_hitBytes;         // 读取时已经存在的字节数
+    uint64_t                m_writeNum;         // 追加请求和回源的次数
+    uint64_t                m_writeBytes;
+    uint64_t                m_writeFailNum;
+    uint64_t                m_lateNum;          // 按时间回放时开始时间落后超过1ms的请求数
+    std::vector<uint64_t>   m_readLatencies;
+    std::vector<uint64_t>   m_writeLatencies;
+
+    ReplayResult_()
+    : m_readNum(0)
+    , m_hitNum(0)
+    , m_readBytes(0)
+    , m_hitBytes(0)
+    , m_writeNum(0)
+    , m_writeBytes(0)
+    , m_writeFailNum(0)
+    , m_lateNum(0)
+    {}
+} ReplayResult;
+
+static bool parseArgs(int argc, char** argv, ReplayConfig& config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t pos = arg.find('=');
+        if (0 != arg.compare(0, 2, "--") || std::string::npos == pos)
+        {
+            return false;
+        }
+        std::string key = arg.substr(2, pos - 2);
+        std::string value = arg.substr(pos + 1);
+        uint64_t num = strtoull(value.c_str(), NULL, 10);
+        if ("trace" == key) config.m_trace = value;
+        else if ("dir" == key) config.m_dir = value;
+        else if ("capacity-mb" == key) config.m_capacity = num * 1024 * 1024;
+        else if ("memory-kb" == key) config.m_memory = num * 1024;
+        else if ("threads" == key) config.m_threadNum = (uint32_t)num;
+        else if ("speed" == key) config.m_speed = atof(value.c_str());
+        else if ("fill-on-miss" == key) config.m_isFillOnMiss = 0 != num;
+        else if ("io-kb" == key) config.m_ioLen = (uint32_t)num * 1024;
+        else if ("range-fill" == key) config.m_isRangeFill = 0 != num;
+        else
+        {
+            return false;
+        }
+    }
+    return !config.m_trace.empty() && 0 != config.m_capacity && 0 != config.m_memory && 0 != config.m_threadNum &&
+        0 != config.m_ioLen && config.m_speed >= 0;
+}
+
+// 按key分给各个线程，保证同一个key的请求按顺序执行
+static bool loadTrace(const ReplayConfig& config, std::vector<std::vector<TraceOp> >& threadOps, uint64_t& opNum)
+{
+    FILE* fp = fopen(config.m_trace.c_str(), "r");
+    if (NULL == fp)
+    {
+        return false;
+    }
+    threadOps.resize(config.m_threadNum);
+    opNum = 0;
+    char line[4096];
+    char key[2048];
+    char op = 0;
+    std::hash<std::string> hasher;
+    while (NULL != fgets(line, sizeof(line), fp))
+    {
+        TraceOp traceOp;
+        unsigned long long timeUs = 0;
+        unsigned long long offset = 0;
+        unsigned long long len = 0;
+        if ('#' == line[0] || 5 != sscanf(line, "%llu %c %2047s %llu %llu", &timeUs, &op, key, &offset, &len) ||
+            ('R' != op && 'W' != op) || 0 == len)
+        {
+            continue;
+        }
+        traceOp.m_timeUs = timeUs;
+        traceOp.m_isRead = 'R' == op;
+        traceOp.m_key = key;
+        traceOp.m_offset = offset;
+        traceOp.m_len = len;
+        threadOps[hasher(traceOp.m_key) % config.m_threadNum].push_back(traceOp);
+        opNum++;
+    }
+    fclose(fp);
+    return true;
+}
+
+// 把文件从已有的末尾追加到end
+static void appendTo(IEdgeFS* efs, const ReplayConfig& config, const std::string& key, uint64_t& size, uint64_t end,
+    const std::vector<char>& buff, ReplayResult& result)
+{
+    uint64_t startNs = BenchUtil::nowNs();
+    bool isOk = true;
+    while (size < end && isOk)
+    {
+        uint32_t len = (uint32_t)std::min<uint64_t>(config.m_ioLen, end - size);
+        int64_t ret = efs->write(key, &buff[0], len);
+        isOk = -1 != ret && 0 != ret;
+        size += isOk ? ret : 0;
+        result.m_writeBytes += isOk ? ret : 0;
+    }
+    result.m_writeNum++;
+    result.m_writeFailNum += isOk ? 0 : 1;
+    result.m_writeLatencies.push_back(BenchUtil::nowNs() - startNs);
+}
+
+// 只写入[offset, end)中缺失的范围，size为写入过的最大位置
+static void fillRange(IEdgeFS* efs, const ReplayConfig& config, const std::string& key, uint64_t& size,
+    uint64_t offset, uint64_t end, const std::vector<char>& buff, ReplayResult& result)
+{
+    uint64_t startNs = BenchUtil::nowNs();
+    std::vector<ByteRange> ranges;
+    bool isOk = efs->getMissingRanges(key, end, ranges);
+    for (auto it = ranges.begin(); it != ranges.end() && isOk; ++it)
+    {
+        uint64_t pos = std::max(offset, it->m_offset);
+        uint64_t rangeEnd = it->m_offset + it->m_len;
+        while (pos < rangeEnd && isOk)
+        {
+            uint32_t len = (uint32_t)std::min<uint64_t>(config.m_ioLen, rangeEnd - pos);
+            int64_t ret = efs->writeRange(key, &buff[0], len, pos);
+            isOk = (int64_t)len == ret;
+            pos += isOk ? ret : 0;
+            result.m_writeBytes += isOk ? ret : 0;
+        }
+    }
+    size = std::max(size, end);
+    result.m_writeNum++;
+    result.m_writeFailNum += isOk ? 0 : 1;
+    result.m_writeLatencies.push_back(BenchUtil::nowNs() - startNs);
+}
+
+static void replayThread(IEdgeFS* efs, const ReplayConfig& config, const std::vector<TraceOp>& ops, uint64_t baseUs,
+    uint64_t startNs, ReplayResult& result)
+{
+    // 回放开始后写入的文件大小，回放前目录被清空
+    std::unordered_map<std::string, uint64_t> sizes;
+    std::vector<char> buff(config.m_ioLen, 'r');
+    for (auto it = ops.begin(); it != ops.end(); ++it)
+    {
+        if (0 != config.m_speed)
+        {
+            uint64_t dueNs = startNs + (uint64_t)((it->m_timeUs - baseUs) * 1000 / config.m_speed);
+            uint64_t nowNs = BenchUtil::nowNs();
+            if (nowNs < dueNs)
+            {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(dueNs - nowNs));
+            }
+            result.m_lateNum += nowNs > dueNs + 1000000 ? 1 : 0;
+        }
+
+        uint64_t& size = sizes[it->m_key];
+        uint64_t end = it->m_offset + it->m_len;
+        if (!it->m_isRead)
+        {
+            if (size < end)
+            {
+                appendTo(efs, config, it->m_key, size, end, buff, result);
+            }
+            continue;
+        }
+
+        uint64_t hitBytes = 0;
+        uint64_t startReadNs = BenchUtil::nowNs();
+        for (uint64_t pos = it->m_offset; pos < end;)
+        {
+            uint32_t len = (uint32_t)std::min<uint64_t>(config.m_ioLen, end - pos);
+            int64_t ret = efs->read(it->m_key, &buff[0], len, pos);
+            if (ret <= 0)
+            {
+                break;
+            }
+            hitBytes += ret;
+            pos += ret;
+        }
+        result.m_readLatencies.push_back(BenchUtil::nowNs() - startReadNs);
+        result.m_readNum++;
+        result.m_readBytes += it->m_len;
+        result.m_hitBytes += hitBytes;
+        result.m_hitNum += hitBytes == it->m_len ? 1 : 0;
+        if (hitBytes < it->m_len && config.m_isFillOnMiss && config.m_isRangeFill)
+        {
+            fillRange(efs, config, it->m_key, size, it->m_offset, end, buff, result);
+        }
+        else if (hitBytes < it->m_len && config.m_isFillOnMiss)
+        {
+            appendTo(efs, config, it->m_key, size, end, buff, result);
+        }
+    }
+}
+
+static void printLatency(const char* name, std::vector<uint64_t>& latencies)
+{
+    uint64_t avg = BenchUtil::average(latencies);
+    uint64_t p50 = BenchUtil::percentile(latencies, 50);
+    printf(",\"%s\":{\"avg\":%" PRIu64 ",\"p50\":%" PRIu64 ",\"p90\":%" PRIu64 ",\"p99\":%" PRIu64 ",\"p999\":%" PRIu64
+        ",\"max\":%" PRIu64 "}", name, avg, p50, BenchUtil::percentile(latencies, 90),
+        BenchUtil::percentile(latencies, 99), BenchUtil::percentile(latencies, 99.9),
+        latencies.empty() ? 0 : latencies.back());
+}
+
+int main(int argc, char** argv)
+{
+    ReplayConfig config;
+    if (!parseArgs(argc, argv, config))
+    {
+        printf("usage: %s --trace=FILE [--dir=] [--capacity-mb=] [--memory-kb=] [--threads=] [--speed=]"
+            " [--fill-on-miss=] [--io-kb=] [--range-fill=]\n", argv[0]);
+        return -1;
+    }
+    std::vector<std::vector<TraceOp> > threadOps;
+    uint64_t opNum = 0;
+    if (!loadTrace(config, threadOps, opNum) || 0 == opNum)
+    {
+        printf("{\"error\":\"load trace failed\",\"trace\":\"%s\"}\n", config.m_trace.c_str());
+        return -1;
+    }
+    uint64_t baseUs = UINT64_MAX;
+    for (auto it = threadOps.begin(); it != threadOps.end(); ++it)
+    {
+        baseUs = it->empty() ? baseUs : std::min(baseUs, it->front().m_timeUs);
+    }
+
+    IEdgeFS* efs = CreateEdgeFS();
+    SystemInfo sinfo;
+    sinfo.m_diskCapacity = config.m_capacity;
+    sinfo.m_diskRootDir = config.m_dir;
+    sinfo.m_edgeFSUsableMemory = config.m_memory;
+    if (!BenchUtil::resetDir(config.m_dir) || !efs->initFS(sinfo))
+    {
+        printf("{\"error\":\"init fs failed\",\"dir\":\"%s\"}\n", config.m_dir.c_str());
+        efs->unitFS();
+        DestroyPcdnSdk(efs);
+        return -1;
+    }
+    AsyncLogging::instance()->setLogLevel(LogLevel_WARN);
+
+    std::vector<ReplayResult> results(config.m_threadNum);
+    std::vector<std::thread> threads;
+    uint64_t startNs = BenchUtil::nowNs();
+    for (uint32_t tid = 0; tid < config.m_threadNum; tid++)
+    {
+        threads.push_back(std::thread(replayThread, efs, std::cref(config), std::cref(threadOps[tid]), baseUs,
+            startNs, std::ref(results[tid])));
+    }
+    for (auto it = threads.begin(); it != threads.end(); ++it)
+    {
+        it->join();
+    }
+    double sec = std::max((BenchUtil::nowNs() - startNs) / 1e9, 1e-9);
+
+    ReplayResult total;
+    for (auto it = results.begin(); it != results.end(); ++it)
+    {
+        total.m_readNum += it->m_readNum;
+        total.m_hitNum += it->m_hitNum;
+        total.m_readBytes += it->m_readBytes;
+        total.m_hitBytes += it->m_hitBytes;
+        total.m_writeNum += it->m_writeNum;
+        total.m_writeBytes += it->m_writeBytes;
+        total.m_writeFailNum += it->m_writeFailNum;
+        total.m_lateNum += it->m_lateNum;
+        total.m_readLatencies.insert(total.m_readLatencies.end(), it->m_readLatencies.begin(),
+            it->m_readLatencies.end());
+        total.m_writeLatencies.insert(total.m_writeLatencies.end(), it->m_writeLatencies.begin(),
+            it->m_writeLatencies.end());
+    }
+    SpaceInfo space;
+    efs->getSpaceInfo(space);
+    efs->unitFS();
+    DestroyPcdnSdk(efs);
+
+    printf("{\"trace\":\"%s\",\"threads\":%u,\"speed\":%.2f,\"rangeFill\":%d,\"requests\":%" PRIu64
+        ",\"sec\":%.6f,\"reqPerSec\":%.1f,\"reads\":%" PRIu64 ",\"hitRatio\":%.4f,\"byteHitRatio\":%.4f"
+        ",\"readMBPerSec\":%.2f,\"writes\":%" PRIu64 ",\"writeFailNum\":%" PRIu64 ",\"writeMB\":%.2f"
+        ",\"writeMBPerSec\":%.2f,\"lateNum\":%" PRIu64 ",\"fillPct\":%.2f",
+        config.m_trace.c_str(), config.m_threadNum, config.m_speed, config.m_isRangeFill ? 1 : 0, opNum, sec,
+        opNum / sec, total.m_readNum, (double)total.m_hitNum / (total.m_readNum ? total.m_readNum : 1),
+        (double)total.m_hitBytes / (total.m_readBytes ? total.m_readBytes : 1), total.m_hitBytes / sec / 1048576,
+        total.m_writeNum, total.m_writeFailNum, total.m_writeBytes / 1048576.0, total.m_writeBytes / sec / 1048576,
+        total.m_lateNum,
+        space.m_chunkNum ? space.m_usedChunkNum * 100.0 / space.m_chunkNum : 0);
+    printLatency("readLatencyNs", total.m_readLatencies);
+    printLatency("writeLatencyNs", total.m_writeLatencies);
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "BenchUtil.h"
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+生成CDN访问的模拟trace，供edgefs_replay回放
+每行一个请求: 时间戳(us) 操作(R读取/W追加) key 偏移 长度，#开头的行为注释
+文件热度服从Zipf分布，读取分为整个文件和随机范围，一部分文件是边写边读的直播流，按块追加
+用法: edgefs_tracegen [--key=value ...]
+    --out=-                 输出文件，-表示标准输出
+    --objects=10000         文件个数
+    --requests=100000       请求个数
+    --zipf=0.8              Zipf分布的参数
+    --value=exp:1024        文件大小分布，单位KB，fixed:N uniform:MIN:MAX exp:MEAN
+    --max-kb=65536          文件大小的上限
+    --range-pct=30          范围读取的比例，其余读取整个文件
+    --range-kb=256          范围读取的平均长度
+    --live-pct=5            直播流文件的比例
+    --append-kb=256         直播流每次追加的长度
+    --rate=1000             每秒的平均请求数，请求间隔服从指数分布
+    --seed=1
+*/
+
+typedef struct GenConfig_
+{
+    std::string     m_out;
+    uint32_t        m_objectNum;
+    uint64_t        m_requestNum;
+    double          m_zipf;
+    std::string     m_value;
+    uint64_t        m_maxSize;
+    uint32_t        m_rangePct;
+    uint64_t        m_rangeLen;
+    uint32_t        m_livePct;
+    uint64_t        m_appendLen;
+    double          m_rate;
+    uint32_t        m_seed;
+
+    GenConfig_()
+    : m_out("-")
+    , m_objectNum(10000)
+    , m_requestNum(100000)
+    , m_zipf(0.8)
+    , m_value("exp:1024")
+    , m_maxSize(64ull * 1024 * 1024)
+    , m_rangePct(30)
+    , m_rangeLen(256 * 1024)
+    , m_livePct(5)
+    , m_appendLen(256 * 1024)
+    , m_rate(1000)
+    , m_seed(1)
+    {}
+} GenConfig;
+
+typedef struct GenObject_
+{
+    uint64_t        m_size;         // 最终大小
+    uint64_t        m_writtenSize;  // 直播流已经追加的大小，普通文件等于m_size
+} GenObject;
+
+static bool parseArgs(int argc, char** argv, GenConfig& config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        size_t pos = arg.find('=');
+        if (0 != arg.compare(0, 2, "--") || std::string::npos == pos)
+        {
+            return false;
+        }
+        std::string key = arg.substr(2, pos - 2);
+        std::string value = arg.substr(pos + 1);
+        uint64_t num = strtoull(value.c_str(), NULL, 10);
+        if ("out" == key) config.m_out = value;
+        else if ("objects" == key) config.m_objectNum = (uint32_t)num;
+        else if ("requests" == key) config.m_requestNum = num;
+        else if ("zipf" == key) config.m_zipf = atof(value.c_str());
+        else if ("value" == key) config.m_value = value;
+        else if ("max-kb" == key) config.m_maxSize = num * 1024;
+        else if ("range-pct" == key) config.m_rangePct = (uint32_t)num;
+        else if ("range-kb" == key) config.m_rangeLen = num * 1024;
+        else if ("live-pct" == key) config.m_livePct = (uint32_t)num;
+        else if ("append-kb" == key) config.m_appendLen = num * 1024;
+        else if ("rate" == key) config.m_rate = atof(value.c_str());
+        else if ("seed" == key) config.m_seed = (uint32_t)num;
+        else
+        {
+            return false;
+        }
+    }
+    return 0 != config.m_objectNum && 0 != config.m_maxSize && 0 != config.m_rangeLen && 0 != config.m_appendLen &&
+        config.m_rate > 0 && config.m_rangePct <= 100 && config.m_livePct <= 100;
+}
+
+int main(int argc, char** argv)
+{
+    GenConfig config;
+    ValueDist dist;
+    if (!parseArgs(argc, argv, config) || !dist.init(config.m_value, config.m_maxSize))
+    {
+        printf("usage: %s [--out=] [--objects=] [--requests=] [--zipf=] [--value=fixed:N|uniform:MIN:MAX|exp:MEAN]"
+            " [--max-kb=] [--range-pct=] [--range-kb=] [--live-pct=] [--append-kb=] [--rate=] [--seed=]\n", argv[0]);
+        return -1;
+    }
+    FILE* fp = "-" == config.m_out ? stdout : fopen(config.m_out.c_str(), "w");
+    if (NULL == fp)
+    {
+        printf("open %s failed\n", config.m_out.c_str());
+        return -1;
+    }
+
+    std::mt19937_64 rng(config.m_seed);
+    std::vector<GenObject> objects(config.m_objectNum);
+    for (auto it = objects.begin(); it != objects.end(); ++it)
+    {
+        it->m_size = dist.next(rng);
+        it->m_writtenSize = rng() % 100 < config.m_livePct ? 0 : it->m_size;
+    }
+    ZipfDist zipf(config.m_objectNum, config.m_zipf);
+    std::exponential_distribution<double> interval(config.m_rate / 1e6);
+    std::exponential_distribution<double> rangeLen(1.0 / config.m_rangeLen);
+
+    fprintf(fp, "# objects %u requests %" PRIu64 " zipf %.2f value %s rangePct %u livePct %u rate %.0f seed %u\n",
+        config.m_objectNum, config.m_requestNum, config.m_zipf, config.m_value.c_str(), config.m_rangePct,
+        config.m_livePct, config.m_rate, config.m_seed);
+    double timeUs = 0;
+    for (uint64_t i = 0; i < config.m_requestNum; i++)
+    {
+        uint32_t id = zipf.next(rng);
+        GenObject& object = objects[id];
+        timeUs += interval(rng);
+
+        // 直播流没有写完时一半的请求是追加，没有数据时只能追加
+        if (object.m_writtenSize < object.m_size && (0 == object.m_writtenSize || 0 == rng() % 2))
+        {
+            uint64_t len = std::min(config.m_appendLen, object.m_size - object.m_writtenSize);
+            fprintf(fp, "%" PRIu64 " W http://edge/obj/%u %" PRIu64 " %" PRIu64 "\n", (uint64_t)timeUs, id,
+                object.m_writtenSize, len);
+            object.m_writtenSize += len;
+            continue;
+        }
+
+        uint64_t offset = 0;
+        uint64_t len = object.m_writtenSize;
+        if (rng() % 100 < config.m_rangePct)
+        {
+            offset = rng() % object.m_writtenSize / 4096 * 4096;
+            len = std::min((uint64_t)rangeLen(rng) + 1, object.m_writtenSize - offset);
+        }
+        fprintf(fp, "%" PRIu64 " R http://edge/obj/%u %" PRIu64 " %" PRIu64 "\n", (uint64_t)timeUs, id, offset, len);
+    }
+
+    if (stdout != fp)
+    {
+        fclose(fp);
+    }
+    return 0;
+}
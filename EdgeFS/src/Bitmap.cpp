@@ -26,11 +26,7 @@ bool Bitmap::generateIdleChunkids(std::vector<uint32_t>& idleChunkids, uint32_t
         return true;        
     }
 
-    static std::random_device r;
-    static std::default_random_engine e(r());
-    static std::uniform_int_distribution<uint32_t> dist(0, -1);
-
-    uint32_t tmp = dist(e) % m_idxNum;
+    uint32_t tmp = randomIdx(m_idxNum);
 
     auto func = [&](uint32_t start, uint32_t end) -> bool {
         for (uint32_t i = start; i < end; i ++)
@@ -57,6 +53,74 @@ bool Bitmap::generateIdleChunkids(std::vector<uint32_t>& idleChunkids, uint32_t
     return false;
 }
 
+bool Bitmap::generateIdleExtent(uint8_t order, uint32_t& startIdx, uint32_t& scanNum)
+{
+    uint32_t extentLen = 1u << order;
+    uint32_t extentNum = m_idxNum >> order;
+    scanNum = 0;
+    if (0 == extentNum)
+    {
+        return false;
+    }
+
+    uint32_t tmp = randomIdx(extentNum);
+    for (uint32_t i = 0; i < extentNum; i++)
+    {
+        uint32_t idx = (tmp + i) % extentNum;
+        scanNum++;
+        if (isIdleRange(idx << order, extentLen))
+        {
+            startIdx = idx << order;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Bitmap::isIdle(uint32_t startIdx, uint32_t num)
+{
+    if (startIdx >= m_idxNum || num > m_idxNum - startIdx)
+    {
+        return false;
+    }
+    return isIdleRange(startIdx, num);
+}
+
+bool Bitmap::isIdleRange(uint32_t startIdx, uint32_t num)
+{
+    // 按字节对齐的部分整字节比较
+    if (0 == startIdx % 8 && 0 == num % 8)
+    {
+        const uint8_t* dest = m_ptr + startIdx / 8;
+        for (uint32_t i = 0; i < num / 8; i++)
+        {
+            if (0 != dest[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (uint32_t i = startIdx; i < startIdx + num; i++)
+    {
+        if (isHave(i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t Bitmap::randomIdx(uint32_t num)
+{
+    static std::random_device r;
+    static std::default_random_engine e(r());
+    static std::uniform_int_distribution<uint32_t> dist(0, -1);
+
+    return dist(e) % num;
+}
+
 bool Bitmap::isHave( uint32_t idx )
 {
     if (idx >= m_idxNum)
@@ -92,4 +156,19 @@ bool Bitmap::insert(const std::vector<uint32_t>& idxs)
         insert(*it);
     }
     return true;
-}
\ No newline at end of file
+}
+
+bool Bitmap::remove( uint32_t idx )
+{
+    if (idx >= m_idxNum)
+    {
+        return false;
+    }
+
+    uint8_t* dest = m_ptr + idx / 8;
+    uint8_t mask = 1 << idx % 8;
+
+    *dest &= ~mask;
+
+    return true;
+}
@@ -13,12 +13,25 @@ public:
 
     bool generateIdleChunkids(std::vector<uint32_t>& idleChunkids, uint32_t needChunkNum);
 
+    // 查找按 2^order 对齐的连续 2^order 个空闲位置，scanNum返回检查过的候选位置个数
+    bool generateIdleExtent(uint8_t order, uint32_t& startIdx, uint32_t& scanNum);
+
+    // [startIdx, startIdx + num) 全部空闲
+    bool isIdle(uint32_t startIdx, uint32_t num);
+
     bool isHave(uint32_t idx);
 
     bool insert(uint32_t idx);
 
     bool insert(const std::vector<uint32_t>& idxs);
 
+    bool remove(uint32_t idx);
+
+private:
+    bool isIdleRange(uint32_t startIdx, uint32_t num);
+
+    uint32_t randomIdx(uint32_t num);
+
 public:
     void* getPtr()
     {
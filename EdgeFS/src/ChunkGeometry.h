@@ -0,0 +1,106 @@
+#pragma once
+
+#include "common/SystemHead.h"
+
+/*
+chunk大小相关的计算策略，读写路径按照策略模板实例化，在initFS时根据chunk大小选择一次
+GenericGeometry : 任意chunk大小，使用乘除法
+Pow2Geometry    : chunk大小为2的幂，使用移位和掩码
+按照磁盘和内存计算出的chunk大小只做4K对齐，通常不是2的幂，设置SystemInfo::m_isPow2ChunkSize后才会取整使用Pow2Geometry
+*/
+
+class GenericGeometry
+{
+public:
+    explicit GenericGeometry(uint32_t chunkSize)
+    : m_chunkSize(chunkSize)
+    {}
+
+    static bool isMatch(uint32_t chunkSize)
+    {
+        return 0 != chunkSize;
+    }
+
+public:
+    uint32_t chunkSize() const
+    {
+        return m_chunkSize;
+    }
+
+    // chunk在数据文件中的偏移
+    uint64_t offset(uint32_t chunkid) const
+    {
+        return (uint64_t)chunkid * m_chunkSize;
+    }
+
+    // 数据文件偏移所在的chunk
+    uint32_t chunkid(uint64_t offset) const
+    {
+        return (uint32_t)(offset / m_chunkSize);
+    }
+
+    // 数据文件偏移在chunk内的偏移
+    uint32_t chunkOffset(uint64_t offset) const
+    {
+        return (uint32_t)(offset % m_chunkSize);
+    }
+
+    // 2^order个chunk组成的数据块大小
+    uint32_t extentSize(uint8_t order) const
+    {
+        return m_chunkSize << order;
+    }
+
+private:
+    uint32_t        m_chunkSize;
+};
+
+class Pow2Geometry
+{
+public:
+    explicit Pow2Geometry(uint32_t chunkSize)
+    : m_chunkShift(__builtin_ctz(chunkSize))
+    , m_chunkMask(chunkSize - 1)
+    {}
+
+    static bool isMatch(uint32_t chunkSize)
+    {
+        return 0 != chunkSize && 0 == (chunkSize & (chunkSize - 1));
+    }
+
+    // 向上取整到2的幂，调用者保证chunkSize不为0并且不超过2^31
+    static uint32_t roundUp(uint32_t chunkSize)
+    {
+        return isMatch(chunkSize) ? chunkSize : 1u << (32 - __builtin_clz(chunkSize));
+    }
+
+public:
+    uint32_t chunkSize() const
+    {
+        return 1u << m_chunkShift;
+    }
+
+    uint64_t offset(uint32_t chunkid) const
+    {
+        return (uint64_t)chunkid << m_chunkShift;
+    }
+
+    uint32_t chunkid(uint64_t offset) const
+    {
+        return (uint32_t)(offset >> m_chunkShift);
+    }
+
+    uint32_t chunkOffset(uint64_t offset) const
+    {
+        return (uint32_t)offset & m_chunkMask;
+    }
+
+    uint32_t extentSize(uint8_t order) const
+    {
+        return 1u << (m_chunkShift + order);
+    }
+
+private:
+    uint32_t        m_chunkShift;
+    uint32_t        m_chunkMask;
+};
@@ -2,33 +2,324 @@
 #include "EdgeFSConst.h"
 #include "./common/macro.h"
 
+thread_local std::vector<IoSegment> DataMgr::t_logSegments;
+thread_local std::vector<IoSegment> DataMgr::t_pieceSegments;
+thread_local std::vector<uint8_t> DataMgr::t_pieceOks;
+
 DataMgr::DataMgr()
+: m_pTraceMgr(NULL)
+, m_batchMode(BatchMode_NONE)
+, m_batchTag(0)
+, m_hostWriteBytes(0)
+, m_deviceWriteBytes(0)
 {
     m_pFileOper = new FileOper();
+    m_pLogMgr = new LogMgr();
+    m_pParallelReadMgr = new ParallelReadMgr();
 }
 
 DataMgr::~DataMgr()
 {
+    SAFE_DELETE(m_pParallelReadMgr);
+    SAFE_DELETE(m_pLogMgr);
     SAFE_DELETE(m_pFileOper);
 }
 
-void DataMgr::initDataMgr(const std::string& rootDir)
+void DataMgr::initDataMgr(const std::string& rootDir, TraceMgr* pTraceMgr)
 {
     std::string filePath = rootDir + "/" + kDataFileName;
     
+    m_pTraceMgr = pTraceMgr;
     m_pFileOper->setPath(filePath);
     m_pFileOper->open();
 }
 
+void DataMgr::initParallelReadMgr(uint32_t threadNum)
+{
+    m_pParallelReadMgr->initParallelReadMgr(m_pFileOper, m_pTraceMgr, threadNum);
+}
+
+void DataMgr::unitDataMgr()
+{
+    m_pParallelReadMgr->stop();
+}
+
+void DataMgr::initLogMgr(void* ptr, IndexMgr* pIndexMgr, uint32_t chunkNum, uint32_t chunkSize,
+    uint32_t segmentChunkNum, uint32_t segmentNum)
+{
+    m_pLogMgr->initLogMgr(ptr, m_pFileOper, pIndexMgr, chunkNum, chunkSize, segmentChunkNum, segmentNum);
+}
+
+void DataMgr::trim(uint32_t chunkid)
+{
+    m_pLogMgr->trim(chunkid);
+}
+
+bool DataMgr::flushLog()
+{
+    return m_pLogMgr->flush();
+}
+
 
 bool DataMgr::write(const char* buff, uint32_t len, uint64_t offset)
 {
+    // 日志结构模式下写入本来就会合并成整段，不需要排队
+    if (BatchMode_WRITE == m_batchMode && !m_pLogMgr->isEnable())
+    {
+        m_hostWriteBytes += len;
+        pushSegment(const_cast<char*>(buff), len, offset);
+        return true;
+    }
+    return writeDirect(buff, len, offset);
+}
+
+bool DataMgr::read(char* buff, uint32_t len, uint64_t offset)
+{
+    if (BatchMode_READ == m_batchMode)
+    {
+        if (!m_pLogMgr->isEnable())
+        {
+            pushSegment(buff, len, offset);
+            return true;
+        }
+
+        // 转换为物理位置后排队
+        m_logSegments.clear();
+        m_pLogMgr->mapRead(buff, len, offset, m_logSegments);
+        for (auto it = m_logSegments.begin(); it != m_logSegments.end(); ++it)
+        {
+            pushSegment(it->m_buff, it->m_len, it->m_offset);
+        }
+        return true;
+    }
+    return readDirect(buff, len, offset);
+}
+
+bool DataMgr::writeDirect(const char* buff, uint32_t len, uint64_t offset)
+{
+    TraceSpan span(m_pTraceMgr, TraceType_DISK_WRITE, len);
+    m_hostWriteBytes += len;
+    if (m_pLogMgr->isEnable())
+    {
+        return m_pLogMgr->write(buff, len, offset);
+    }
+
+    if (BatchMode_WRITE == m_batchMode)
+    {
+        // 保证同一位置的写入顺序
+        flushBatch();
+    }
+
     // TODO 可以做按照4K的倍数写入的优化
     // todo 这里需要继续修改FileOper::write的返回值
-    return m_pFileOper->write(buff, len, offset);
+    if (!m_pFileOper->write(buff, len, offset))
+    {
+        return false;
+    }
+    m_deviceWriteBytes += len;
+    return true;
 }
 
-bool DataMgr::read(char* buff, uint32_t len, uint64_t offset)
+bool DataMgr::readDirect(char* buff, uint32_t len, uint64_t offset)
+{
+    TraceSpan span(m_pTraceMgr, TraceType_DISK_READ, len);
+    if (BatchMode_WRITE == m_batchMode)
+    {
+        // 读取的数据可能还在写入队列中
+        flushBatch();
+    }
+    if (!m_pLogMgr->isEnable())
+    {
+        return m_pFileOper->read(buff, len, offset);
+    }
+
+    t_logSegments.clear();
+    m_pLogMgr->mapRead(buff, len, offset, t_logSegments);
+    for (auto it = t_logSegments.begin(); it != t_logSegments.end(); ++it)
+    {
+        if (!m_pFileOper->read(it->m_buff, it->m_len, it->m_offset))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DataMgr::readParallel(const IoSegment* segments, uint32_t num, uint8_t* pIsOks)
+{
+    // 拆分为小段，日志结构模式下先转换为物理位置，内存中的数据直接复制
+    // 每段太小时线程交替读取打乱内核的顺序预读，按照线程数平均拆分
+    uint64_t totalLen = 0;
+    for (uint32_t i = 0; i < num; i++)
+    {
+        totalLen += segments[i].m_len;
+    }
+    uint32_t readerNum = m_pParallelReadMgr->getReaderNum();
+    uint32_t pieceLen = std::max((uint64_t)kParallelReadPieceSize,
+        (totalLen + readerNum - 1) / readerNum + kDiskRWAlignSize - 1) / kDiskRWAlignSize * kDiskRWAlignSize;
+    t_pieceSegments.clear();
+    for (uint32_t i = 0; i < num; i++)
+    {
+        pIsOks[i] = 1;
+        t_logSegments.clear();
+        if (m_pLogMgr->isEnable())
+        {
+            m_pLogMgr->mapRead(segments[i].m_buff, segments[i].m_len, segments[i].m_offset, t_logSegments);
+        }
+        else
+        {
+            t_logSegments.push_back(segments[i]);
+        }
+        for (auto it = t_logSegments.begin(); it != t_logSegments.end(); ++it)
+        {
+            for (uint32_t pos = 0; pos < it->m_len; pos += pieceLen)
+            {
+                IoSegment piece = { it->m_offset + pos, it->m_buff + pos, std::min(pieceLen, it->m_len - pos), i };
+                t_pieceSegments.push_back(piece);
+            }
+        }
+    }
+    if (t_pieceSegments.empty())
+    {
+        return ;
+    }
+
+    t_pieceOks.resize(t_pieceSegments.size());
+    m_pParallelReadMgr->read(&t_pieceSegments[0], t_pieceSegments.size(), &t_pieceOks[0]);
+    for (uint32_t i = 0; i < t_pieceSegments.size(); i++)
+    {
+        if (0 == t_pieceOks[i])
+        {
+            pIsOks[t_pieceSegments[i].m_tag] = 0;
+        }
+    }
+}
+
+bool DataMgr::readahead(uint32_t len, uint64_t offset)
+{
+    if (!m_pLogMgr->isEnable())
+    {
+        return m_pFileOper->readahead(offset, len);
+    }
+
+    t_logSegments.clear();
+    m_pLogMgr->mapRead(NULL, len, offset, t_logSegments);
+    for (auto it = t_logSegments.begin(); it != t_logSegments.end(); ++it)
+    {
+        m_pFileOper->readahead(it->m_offset, it->m_len);
+    }
+    return true;
+}
+
+bool DataMgr::sync()
+{
+    TraceSpan span(m_pTraceMgr, TraceType_DISK_SYNC);
+    // 日志结构模式下打开的段只在内存中，需要先写入
+    return m_pLogMgr->flush() && m_pFileOper->sync();
+}
+
+bool DataMgr::syncFile()
+{
+    TraceSpan span(m_pTraceMgr, TraceType_DISK_SYNC);
+    return m_pFileOper->sync();
+}
+
+void DataMgr::beginBatch(BatchMode mode)
+{
+    m_batchMode = mode;
+    m_batchTag = 0;
+    m_segments.clear();
+    m_failedTags.clear();
+}
+
+void DataMgr::setBatchTag(uint32_t tag)
+{
+    m_batchTag = tag;
+}
+
+void DataMgr::pushSegment(char* buff, uint32_t len, uint64_t offset)
+{
+    if (0 == len)
+    {
+        return ;
+    }
+    IoSegment segment = { offset, buff, len, m_batchTag };
+    m_segments.push_back(segment);
+}
+
+bool DataMgr::flushBatch()
+{
+    if (m_segments.empty())
+    {
+        return true;
+    }
+
+    // 同一个请求的多段数据偏移不同，排序后顺序稳定即可
+    std::sort(m_segments.begin(), m_segments.end(), [](const IoSegment& a, const IoSegment& b) {
+        return a.m_offset < b.m_offset;
+    });
+
+    bool isOk = true;
+    uint32_t start = 0;
+    uint32_t runLen = m_segments[0].m_len;
+    for (uint32_t i = 1; i <= m_segments.size(); i++)
+    {
+        // 磁盘上连续的数据合并提交，受限于iovec个数和单次读写长度
+        if (i < m_segments.size() &&
+            m_segments[i-1].m_offset + m_segments[i-1].m_len == m_segments[i].m_offset &&
+            i - start < IOV_MAX &&
+            (uint64_t)runLen + m_segments[i].m_len <= kMaxChunkSize)
+        {
+            runLen += m_segments[i].m_len;
+            continue;
+        }
+
+        if (!submitSegments(start, i, runLen))
+        {
+            isOk = false;
+        }
+        if (i < m_segments.size())
+        {
+            start = i;
+            runLen = m_segments[i].m_len;
+        }
+    }
+
+    m_segments.clear();
+    return isOk;
+}
+
+bool DataMgr::submitSegments(uint32_t start, uint32_t end, uint32_t len)
+{
+    TraceSpan span(m_pTraceMgr, BatchMode_READ == m_batchMode ? TraceType_DISK_READ : TraceType_DISK_WRITE, len);
+    m_iovs.resize(end - start);
+    for (uint32_t i = start; i < end; i++)
+    {
+        m_iovs[i - start].iov_base = m_segments[i].m_buff;
+        m_iovs[i - start].iov_len = m_segments[i].m_len;
+    }
+
+    bool isOk = BatchMode_READ == m_batchMode ?
+        m_pFileOper->readv(&m_iovs[0], end - start, len, m_segments[start].m_offset) :
+        m_pFileOper->writev(&m_iovs[0], end - start, len, m_segments[start].m_offset);
+    if (isOk && BatchMode_WRITE == m_batchMode)
+    {
+        m_deviceWriteBytes += len;
+    }
+    if (!isOk)
+    {
+        for (uint32_t i = start; i < end; i++)
+        {
+            m_failedTags.push_back(m_segments[i].m_tag);
+        }
+    }
+    return isOk;
+}
+
+void DataMgr::endBatch(std::vector<uint32_t>& failedTags)
 {
-    return m_pFileOper->read(buff, len, offset);
+    flushBatch();
+    failedTags.swap(m_failedTags);
+    m_failedTags.clear();
+    m_batchMode = BatchMode_NONE;
 }
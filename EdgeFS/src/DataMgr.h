@@ -1,8 +1,29 @@
 #pragma once
 
 #include "./common/FileOper.h"
+#include "LogMgr.h"
+#include "ParallelReadMgr.h"
+#include "TraceMgr.h"
 #include <string>
+#include <vector>
 
+// 批量模式下排队的一段磁盘读写
+typedef struct IoSegment_
+{
+    uint64_t        m_offset;
+    char*           m_buff;
+    uint32_t        m_len;
+    uint32_t        m_tag;          // 所属的请求，提交失败时返回给调用者
+} IoSegment;
+
+typedef enum BatchMode_
+{
+    BatchMode_NONE = 0,
+    BatchMode_READ,                 // 读取排队，写入直接执行
+    BatchMode_WRITE,                // 写入排队，读取前先提交排队的写入
+} BatchMode;
+
+// 读取接口可以被持有EdgeFS共享锁的多个线程同时调用，写入和批量模式只在独占锁中使用
 class DataMgr
 {
 public:
@@ -10,12 +31,94 @@ public:
     ~DataMgr();
 
 public:
-    void initDataMgr(const std::string& rootDir);
+    void initDataMgr(const std::string& rootDir, TraceMgr* pTraceMgr);
+
+    // 并发读取的线程个数，0表示不并发读取
+    void initParallelReadMgr(uint32_t threadNum);
+
+    // 停止并发读取的线程
+    void unitDataMgr();
+
+    // 日志结构模式，ptr指向index文件中的映射表，segmentNum为0表示原地写入
+    void initLogMgr(void* ptr, IndexMgr* pIndexMgr, uint32_t chunkNum, uint32_t chunkSize, uint32_t segmentChunkNum,
+        uint32_t segmentNum);
+
+    // chunk被释放，日志结构模式下原来的物理位置可以被清理
+    void trim(uint32_t chunkid);
+
+    // 日志结构模式下打开的段中的数据写入磁盘
+    bool flushLog();
 
     bool write(const char* buff, uint32_t len, uint64_t offset);
 
     bool read(char* buff, uint32_t len, uint64_t offset);
-    
+
+    bool readahead(uint32_t len, uint64_t offset);
+
+    // 不进入批量队列立即执行，返回后buff可以复用，写入队列中有数据时先提交
+    bool writeDirect(const char* buff, uint32_t len, uint64_t offset);
+
+    bool readDirect(char* buff, uint32_t len, uint64_t offset);
+
+    // 并发读取多段数据，每段按照线程数拆分为小段，pIsOks[i]表示第i段是否读取成功
+    // 不能在批量模式下调用
+    void readParallel(const IoSegment* segments, uint32_t num, uint8_t* pIsOks);
+
+    // 读取线程已经启动，长度足够时使用并发读取
+    bool isParallelRead(uint32_t len)
+    {
+        return BatchMode_NONE == m_batchMode && m_pParallelReadMgr->isEnable() && len >= kParallelReadMinSize;
+    }
+
+    // 已经写入的数据落盘
+    bool sync();
+
+    // 只落盘已经写入数据文件的内容，日志结构模式下需要先调用flushLog，可以和读写并发调用
+    bool syncFile();
+
+public:
+    // 批量模式下读写只排队，提交时按照磁盘偏移排序，相邻的数据合并为一次向量读写
+    // 排队期间调用者的buff必须保持有效
+    void beginBatch(BatchMode mode);
+
+    void setBatchTag(uint32_t tag);
+
+    // 提交所有排队的读写，失败的tag记录下来
+    bool flushBatch();
+
+    // 提交并退出批量模式，返回所有失败的tag
+    void endBatch(std::vector<uint32_t>& failedTags);
+
+public:
+    LogMgr* getLogMgr()             { return m_pLogMgr; }
+    // 上层写入的字节数和实际写入磁盘的字节数，两者的比值即写放大
+    uint64_t getHostWriteBytes()    { return m_hostWriteBytes; }
+    uint64_t getDeviceWriteBytes()  { return m_deviceWriteBytes + m_pLogMgr->getDeviceWriteBytes(); }
+    // 数据文件的系统调用统计，包括并发读取线程和日志结构模式的读写
+    void addIoStats(IoStats& stats) { m_pFileOper->addIoStats(stats); }
+
+private:
+    void pushSegment(char* buff, uint32_t len, uint64_t offset);
+    bool submitSegments(uint32_t start, uint32_t end, uint32_t len);
+
 private:
     FileOper*       m_pFileOper;
-};
\ No newline at end of file
+    LogMgr*         m_pLogMgr;
+    ParallelReadMgr*    m_pParallelReadMgr;
+    TraceMgr*       m_pTraceMgr;
+
+    BatchMode               m_batchMode;
+    uint32_t                m_batchTag;
+    std::vector<IoSegment>  m_segments;
+    std::vector<uint32_t>   m_failedTags;
+    std::vector<iovec>      m_iovs;
+    // 批量读取排队时转换出的物理位置，批量模式只在EdgeFS的独占锁中使用
+    std::vector<IoSegment>  m_logSegments;
+    // 多个线程同时读取时各自使用的临时数组，保留容量，稳定状态下不申请内存
+    static thread_local std::vector<IoSegment>  t_logSegments;
+    static thread_local std::vector<IoSegment>  t_pieceSegments;
+    static thread_local std::vector<uint8_t>    t_pieceOks;
+
+    uint64_t        m_hostWriteBytes;
+    uint64_t        m_deviceWriteBytes;
+};
@@ -0,0 +1,69 @@
+#include "DedupMgr.h"
+#include "common/common.h"
+
+DedupMgr::DedupMgr()
+: m_pRecords(NULL)
+, m_recordNum(0)
+, m_pLinks(NULL)
+, m_linkNum(0)
+, m_pUsedLinkNum(NULL)
+{
+}
+
+DedupMgr::~DedupMgr()
+{
+}
+
+void DedupMgr::initDedupMgr(void* ptr, uint32_t recordNum, uint32_t linkNum, uint32_t* pUsedLinkNum)
+{
+    m_pRecords = (DedupRecord*)ptr;
+    m_recordNum = recordNum;
+    m_pLinks = (LinkInfo*)((char*)ptr + (uint64_t)recordNum * sizeof(DedupRecord));
+    m_linkNum = linkNum;
+    m_pUsedLinkNum = pUsedLinkNum;
+}
+
+DedupRecord* DedupMgr::find(const char* fingerprint, DedupRecord** pIdleRecord)
+{
+    if (NULL != pIdleRecord)
+    {
+        *pIdleRecord = NULL;
+    }
+    if (0 == m_recordNum)
+    {
+        return NULL;
+    }
+
+    uint32_t idx = (*(uint32_t*)fingerprint) % m_recordNum;
+
+    // 记录不会被删除，遇到空闲记录即可结束查找
+    for (uint32_t i = 0; i < m_recordNum; i++)
+    {
+        DedupRecord* pRecord = m_pRecords + idx;
+        if (DedupRecordState_IDLE == pRecord->m_state)
+        {
+            if (NULL != pIdleRecord)
+            {
+                *pIdleRecord = pRecord;
+            }
+            return NULL;
+        }
+        if (0 == memcmp(pRecord->m_fingerprint, fingerprint, sizeof(pRecord->m_fingerprint)))
+        {
+            return pRecord;
+        }
+        idx = idx + 1 == m_recordNum ? 0 : idx + 1;
+    }
+    return NULL;
+}
+
+LinkInfo* DedupMgr::allocLink(uint32_t& linkid)
+{
+    if (NULL == m_pUsedLinkNum || *m_pUsedLinkNum >= m_linkNum)
+    {
+        return NULL;
+    }
+    linkid = *m_pUsedLinkNum | kLinkChunkidFlag;
+    (*m_pUsedLinkNum)++;
+    return m_pLinks + (linkid & ~kLinkChunkidFlag);
+}
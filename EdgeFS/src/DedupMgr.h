@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include "EdgeFSProtocol.h"
+
+// 管理index文件中的去重指纹记录和引用节点
+// 指纹记录使用开放寻址的hash表组织，引用节点按顺序分配，目前没有删除文件的接口，两者都不会释放
+class DedupMgr
+{
+public:
+    DedupMgr();
+    ~DedupMgr();
+
+public:
+    void initDedupMgr(void* ptr, uint32_t recordNum, uint32_t linkNum, uint32_t* pUsedLinkNum);
+
+    // 查找指纹对应的记录，找不到时返回NULL，pIdleRecord返回可插入的空闲记录
+    DedupRecord* find(const char* fingerprint, DedupRecord** pIdleRecord);
+
+    // 分配一个引用节点，linkid带有kLinkChunkidFlag标记，节点用完时返回NULL
+    LinkInfo* allocLink(uint32_t& linkid);
+
+    LinkInfo* getLink(uint32_t linkid)
+    {
+        return m_pLinks + (linkid & ~kLinkChunkidFlag);
+    }
+
+    bool isEnable()
+    {
+        return 0 != m_recordNum && 0 != m_linkNum;
+    }
+
+    static bool isLinkid(uint32_t id)
+    {
+        return kInvalidChunkid != id && 0 != (id & kLinkChunkidFlag);
+    }
+
+public:
+    void* getPtr()
+    {
+        return (void*)m_pRecords;
+    }
+
+    uint32_t getRecordNum()
+    {
+        return m_recordNum;
+    }
+
+    DedupRecord* getRecord(uint32_t idx)
+    {
+        return m_pRecords + idx;
+    }
+
+    uint32_t getUsedLinkNum()
+    {
+        return NULL == m_pUsedLinkNum ? 0 : *m_pUsedLinkNum;
+    }
+
+private:
+    DedupRecord*    m_pRecords;
+    uint32_t        m_recordNum;
+    LinkInfo*       m_pLinks;
+    uint32_t        m_linkNum;
+    uint32_t*       m_pUsedLinkNum;     // 指向index文件头部，重启后继续分配
+};
@@ -1,8 +1,13 @@
 #include "EdgeFS.h"
 #include "EdgeFSConst.h"
 #include "./common/common.h"
+#include <chrono>
 
 EdgeFS* EdgeFS::m_pInstance = NULL;
+thread_local std::vector<char> EdgeFS::t_readChunkBuff;
+thread_local std::vector<char> EdgeFS::t_readCompressBuff;
+thread_local std::vector<IoSegment> EdgeFS::t_parallelSegments;
+thread_local std::vector<uint8_t> EdgeFS::t_parallelOks;
 
 IEdgeFS* CreateEdgeFS()
 {
@@ -15,6 +20,11 @@ void DestroyPcdnSdk(IEdgeFS* fs)
     EdgeFS::release();
 }
 
+void CalcFileKey(const char* fileName, uint32_t fileNameLen, FileKey& key)
+{
+    ShaHelper::calcShaToHex(fileName, fileNameLen, key.m_sha1);
+}
+
 void EdgeFS::create()
 {
     if (NULL == m_pInstance)
@@ -33,13 +43,45 @@ EdgeFS* EdgeFS::instance()
 }
 
 EdgeFS::EdgeFS()
+: m_pFSHead(NULL)
+, m_pMetaPool(NULL)
+, m_parallelReadNum(0)
+, m_packMaxFileSize(0)
+, m_maxExtentOrder(0)
+, m_isCompress(false)
+, m_journalCommitMs(0)
+, m_isFlushStop(true)
+, m_flushIntervalMs(0)
+, m_defragMoveIdx(0)
+, m_defragFileNum(0)
+, m_defragBytes(0)
+, m_isDefragStop(true)
+, m_defragBytesPerSec(0)
+, m_pWriteDataChunks(&EdgeFS::writeDataChunks<GenericGeometry>)
+, m_pReadDataChunks(&EdgeFS::readDataChunks<GenericGeometry>)
 {
     m_pDataMgr = new DataMgr();
     m_pIndexMgr = new IndexMgr();
     m_pBitMap = new Bitmap();
+    m_pPackMgr = new PackMgr();
+    m_pDedupMgr = new DedupMgr();
+    m_pReadaheadMgr = new ReadaheadMgr();
+    m_pStatsMgr = new StatsMgr();
+    m_pTraceMgr = new TraceMgr();
+    m_pPerfCounterMgr = new PerfCounterMgr();
+    m_pProgressMgr = new ProgressMgr();
+    m_pOriginMgr = new OriginMgr();
 }
 EdgeFS::~EdgeFS()
 {
+    SAFE_DELETE(m_pOriginMgr);
+    SAFE_DELETE(m_pProgressMgr);
+    SAFE_DELETE(m_pPerfCounterMgr);
+    SAFE_DELETE(m_pTraceMgr);
+    SAFE_DELETE(m_pStatsMgr);
+    SAFE_DELETE(m_pReadaheadMgr);
+    SAFE_DELETE(m_pDedupMgr);
+    SAFE_DELETE(m_pPackMgr);
     SAFE_DELETE(m_pBitMap);
     SAFE_DELETE(m_pIndexMgr);
     SAFE_DELETE(m_pDataMgr);
@@ -48,11 +90,19 @@ EdgeFS::~EdgeFS()
 bool EdgeFS::initFS(const SystemInfo& info)
 {
     AsyncLogging::create();
-    AsyncLogging::instance()->init(info.m_diskRootDir + "/" + kLogFileName);
+    AsyncLogging::instance()->init(info.m_diskRootDir + "/" + (info.m_isBinaryLog ? kBinaryLogFileName : kLogFileName),
+        info.m_isBinaryLog);
 
     linfo("========================");
-    lnotice("initFs, systemInfo disk %" PRIu64 " rootdir %s memory %" PRIu64, info.m_diskCapacity,
-        info.m_diskRootDir.c_str(), info.m_edgeFSUsableMemory);
+    lnotice("initFs, systemInfo disk %" PRIu64 " rootdir %s memory %" PRIu64 " isPow2ChunkSize %d"
+        " packMaxFileSize %u packRecordNum %u"
+        " readaheadMaxSize %u dedupRecordNum %u dedupLinkNum %u isCompress %d logSegmentSize %u isJournal %d"
+        " journalCommitMs %u flushIntervalMs %u defragBytesPerSec %u readThreadNum %u traceEventNum %u"
+        " traceSlowUs %u isPerfCounter %d isBinaryLog %d", info.m_diskCapacity, info.m_diskRootDir.c_str(), info.m_edgeFSUsableMemory,
+        info.m_isPow2ChunkSize, info.m_packMaxFileSize, info.m_packRecordNum, info.m_readaheadMaxSize, info.m_dedupRecordNum,
+        info.m_dedupLinkNum, info.m_isCompress, info.m_logSegmentSize, info.m_isJournal, info.m_journalCommitMs,
+        info.m_flushIntervalMs, info.m_defragBytesPerSec, info.m_readThreadNum, info.m_traceEventNum,
+        info.m_traceSlowUs, info.m_isPerfCounter, info.m_isBinaryLog);
 
     // 入参数检查
     if (!initFSCheckParam(info))
@@ -64,85 +114,229 @@ bool EdgeFS::initFS(const SystemInfo& info)
 
     // 初始化数据文件和index文件
     // TODO 目前不支持大文件，后续需要用mmap64, ftruncate64等
-    m_pDataMgr->initDataMgr(info.m_diskRootDir);
+    m_pTraceMgr->initTraceMgr(info.m_traceEventNum, info.m_traceSlowUs,
+        info.m_diskRootDir + "/" + kSlowTraceFileName);
+    m_pPerfCounterMgr->initPerfCounterMgr(info.m_isPerfCounter);
+    m_pDataMgr->initDataMgr(info.m_diskRootDir, m_pTraceMgr);
+    m_pDataMgr->initParallelReadMgr(info.m_readThreadNum);
     m_pIndexMgr->initIndexMgr(info.m_diskRootDir, isExistIdxFile);
 
+    // 映射index文件之前先恢复到最后一次提交的状态
+    if (!m_pIndexMgr->initJournalMgr(info.m_diskRootDir, info.m_isJournal, isExistIdxFile))
+    {
+        return false;
+    }
+
     // 根据收入的内存大小和磁盘大小，计算chunk个数，chunk大小，需要映射的内存
-    uint32_t chunkNum = 0, chunkSize = 0, bitmapSize = 0;
-    uint64_t diskSize = 0, mmapSize = 0;
-    if (!initFSCalcVariable(info, chunkNum, chunkSize, diskSize, bitmapSize, mmapSize))
+    IndexLayout layout;
+    if (!initFSCalcVariable(info, layout))
     {
         return false;
     }
 
-    if (!initFSCalcPointerAddr(isExistIdxFile, chunkNum, chunkSize, diskSize, bitmapSize, mmapSize))
+    if (!initFSCalcPointerAddr(isExistIdxFile, layout))
     {
         return false;
     }
+
+    // 打包的小文件不超过chunk的一半，否则一个chunk放不下几个文件
+    m_packMaxFileSize = 0 == layout.m_packRecordNum ? 0 : std::min(info.m_packMaxFileSize, layout.m_chunkSize / 2);
+
+    // 连续分配的数据块不超过kMaxChunkSize，保证块内长度可以用uint32_t表示
+    // 去重和压缩以chunk为单位，数据块固定为单个chunk
+    m_isCompress = info.m_isCompress;
+    m_maxExtentOrder = m_pDedupMgr->isEnable() || m_isCompress ? 0 : std::min(info.m_maxExtentOrder, kMaxExtentOrder);
+    while (0 != m_maxExtentOrder && ((uint64_t)layout.m_chunkSize << m_maxExtentOrder) > kMaxChunkSize)
+    {
+        m_maxExtentOrder--;
+    }
+    m_pReadaheadMgr->initReadaheadMgr(kReadaheadMinSize, info.m_readaheadMaxSize);
+    m_chunkBuff.resize(layout.m_chunkSize);
+    m_compressBuff.resize(layout.m_chunkSize);
+    linfo("packMaxFileSize %u maxExtentOrder %u readaheadMaxSize %u", m_packMaxFileSize, m_maxExtentOrder,
+        info.m_readaheadMaxSize);
+
+    initFSSelectGeometry(layout.m_chunkSize);
+
+    // 新建的index文件和bitmap的修正立即提交，之后index文件和日志都从这里开始
+    m_journalCommitMs = info.m_journalCommitMs;
+    m_pendingFreeChunkids.clear();
+    if (m_pIndexMgr->getJournalMgr()->isEnable())
+    {
+        reconcileBitmap();
+        if (!commitJournal(true) || !m_pIndexMgr->getJournalMgr()->checkpoint())
+        {
+            lfatal("initFS failed, journal commit failed");
+            return false;
+        }
+    }
+    if (0 != info.m_flushIntervalMs)
+    {
+        startFlushThread(info.m_flushIntervalMs);
+    }
+    if (0 != info.m_defragBytesPerSec)
+    {
+        if (isDefragEnable())
+        {
+            startDefragThread(info.m_defragBytesPerSec);
+        }
+        else
+        {
+            lwarn("defrag is not supported with dedup or log structured layout");
+        }
+    }
     return true;
 }
 
+void EdgeFS::initFSSelectGeometry(uint32_t chunkSize)
+{
+    if (Pow2Geometry::isMatch(chunkSize))
+    {
+        m_pWriteDataChunks = &EdgeFS::writeDataChunks<Pow2Geometry>;
+        m_pReadDataChunks = &EdgeFS::readDataChunks<Pow2Geometry>;
+        linfo("chunkSize %u use pow2 geometry", chunkSize);
+    }
+    else
+    {
+        m_pWriteDataChunks = &EdgeFS::writeDataChunks<GenericGeometry>;
+        m_pReadDataChunks = &EdgeFS::readDataChunks<GenericGeometry>;
+        linfo("chunkSize %u use generic geometry", chunkSize);
+    }
+}
+
 bool EdgeFS::initFSCheckParam(const SystemInfo& info)
 {
     // 内存检查，最少1个meta占用的内存
-    uint64_t minMemory = sizeof(EdgeFSHead) + 1 + sizeof(MetaInfo);
+    uint64_t minMemory = sizeof(EdgeFSHead) + 1 + sizeof(MetaInfo) + (uint64_t)info.m_packRecordNum * sizeof(PackRecord)
+        + (uint64_t)info.m_dedupRecordNum * sizeof(DedupRecord) + (uint64_t)info.m_dedupLinkNum * sizeof(LinkInfo);
     if (minMemory >= info.m_edgeFSUsableMemory)
     {
         lfatal("initFS failed, out of memory, minimum %" PRIu64 " memory", minMemory);
         return false;
     }
+    if ((0 == info.m_dedupRecordNum) != (0 == info.m_dedupLinkNum))
+    {
+        lfatal("initFS failed, dedupRecordNum %u and dedupLinkNum %u must be both set", info.m_dedupRecordNum,
+            info.m_dedupLinkNum);
+        return false;
+    }
+    // 日志结构模式下清理会在写入之外大量修改映射表，打开的段也不在磁盘上，暂不支持修改日志
+    if (info.m_isJournal && 0 != info.m_logSegmentSize)
+    {
+        lfatal("initFS failed, journal and log segment %u can not be both set", info.m_logSegmentSize);
+        return false;
+    }
     return true;
 }
 
-bool EdgeFS::initFSCalcVariable(const SystemInfo& info, uint32_t& chunkNum, uint32_t& chunkSize, uint64_t& diskSize,
-    uint32_t& bitmapSize, uint64_t& mmapSize)
+bool EdgeFS::initFSCalcVariable(const SystemInfo& info, IndexLayout& layout)
 {
-    chunkNum = DIV_ROUND_DOWN(info.m_edgeFSUsableMemory - sizeof(EdgeFSHead), sizeof(MetaInfo));
-    chunkSize = DIV_ROUND_DOWN(info.m_diskCapacity, chunkNum);
-    chunkSize = ALIGN_DOWN(chunkSize, kDiskRWAlignSize);
+    layout.m_packRecordNum = 0 == info.m_packMaxFileSize ? 0 : info.m_packRecordNum;
+    layout.m_dedupRecordNum = info.m_dedupRecordNum;
+    layout.m_dedupLinkNum = info.m_dedupLinkNum;
+    uint64_t recordSize = (uint64_t)layout.m_packRecordNum * sizeof(PackRecord) +
+        (uint64_t)layout.m_dedupRecordNum * sizeof(DedupRecord) + (uint64_t)layout.m_dedupLinkNum * sizeof(LinkInfo);
+
+    // 每个chunk占用一个MetaInfo和bitmap中的1bit
+    // 日志结构模式下还有逻辑和物理位置的双向映射，以及最多每个chunk一个的段计数
+    uint32_t chunkBits = sizeof(MetaInfo) * 8 + 1 + (0 == info.m_logSegmentSize ? 0 : 3 * sizeof(uint32_t) * 8);
+    uint32_t chunkNum = DIV_ROUND_DOWN((info.m_edgeFSUsableMemory - sizeof(EdgeFSHead) - recordSize) * 8, chunkBits);
+    uint32_t chunkSize = DIV_ROUND_UP(info.m_diskCapacity, chunkNum);
+    // 向上对齐，保证重新计算出的chunk个数不会超出内存
+    chunkSize = alignment_up(chunkSize, kDiskRWAlignSize);
     Utils::limit<uint32_t>(chunkSize, kMinChunkSize, kMaxChunkSize);
+    // 取整到2的幂之后读写路径使用Pow2Geometry，chunk变大，个数相应减少，内存用不满
+    if (info.m_isPow2ChunkSize)
+    {
+        chunkSize = Pow2Geometry::roundUp(chunkSize);
+    }
     chunkNum = DIV_ROUND_DOWN(info.m_diskCapacity, chunkSize);
-    bitmapSize = DIV_ROUND_UP(chunkNum, 8);
-    diskSize = (uint64_t)chunkNum * (uint64_t)chunkSize;
-    mmapSize = sizeof(EdgeFSHead) + bitmapSize + (uint64_t)chunkNum * sizeof(MetaInfo);
-
-    if (0 == chunkNum ||
-        0 == chunkSize ||
-        0 == bitmapSize ||
-        0 == diskSize ||
-        0 == mmapSize ||
-        diskSize > info.m_diskCapacity ||
-        mmapSize > info.m_edgeFSUsableMemory)
+    // 引用节点的id使用最高位做标记
+    chunkNum = std::min(chunkNum, kLinkChunkidFlag - 1);
+
+    // 日志结构模式下磁盘按段划分，预留一部分段用于清理，剩下的作为逻辑chunk
+    uint32_t physNum = chunkNum;
+    if (0 != info.m_logSegmentSize)
+    {
+        layout.m_logSegmentChunkNum = std::max(info.m_logSegmentSize / chunkSize, 1u);
+        layout.m_logSegmentNum = chunkNum / layout.m_logSegmentChunkNum;
+        uint32_t reserveNum = LogMgr::calcReserveSegmentNum(layout.m_logSegmentNum);
+        if (layout.m_logSegmentNum <= reserveNum)
+        {
+            lfatal("initFS failed, disk too small for log segment, segmentNum %u reserveNum %u",
+                layout.m_logSegmentNum, reserveNum);
+            return false;
+        }
+        physNum = layout.m_logSegmentNum * layout.m_logSegmentChunkNum;
+        chunkNum = (layout.m_logSegmentNum - reserveNum) * layout.m_logSegmentChunkNum;
+        recordSize += ((uint64_t)chunkNum + physNum + layout.m_logSegmentNum) * sizeof(uint32_t);
+    }
+
+    layout.m_chunkNum = chunkNum;
+    layout.m_chunkSize = chunkSize;
+    layout.m_bitmapSize = DIV_ROUND_UP(chunkNum, 8);
+    layout.m_diskSize = (uint64_t)physNum * (uint64_t)chunkSize;
+    layout.m_mmapSize = sizeof(EdgeFSHead) + layout.m_bitmapSize + (uint64_t)chunkNum * sizeof(MetaInfo) + recordSize;
+
+    if (0 == layout.m_chunkNum ||
+        0 == layout.m_chunkSize ||
+        0 == layout.m_bitmapSize ||
+        0 == layout.m_diskSize ||
+        0 == layout.m_mmapSize ||
+        layout.m_diskSize > info.m_diskCapacity ||
+        layout.m_mmapSize > info.m_edgeFSUsableMemory)
     {
         lfatal("initFS failed, calc variable failed, chunkNum %u chunkSize %u bitmapSize %u diskSize %" PRIu64
-            " mmapSize %" PRIu64, chunkNum, chunkSize, bitmapSize, diskSize, mmapSize);
+            " mmapSize %" PRIu64, layout.m_chunkNum, layout.m_chunkSize, layout.m_bitmapSize, layout.m_diskSize,
+            layout.m_mmapSize);
         lfatal("initFS failed, calc variable failed, diskSize too large: %d diskSize %" PRIu64
-            " info.m_diskCapacity %" PRIu64, diskSize >= info.m_diskCapacity, diskSize, info.m_diskCapacity);
+            " info.m_diskCapacity %" PRIu64, layout.m_diskSize >= info.m_diskCapacity, layout.m_diskSize,
+            info.m_diskCapacity);
         lfatal("initFS failed, calc variable failed, mmapSize too large: %d mmapSize %" PRIu64
-            " info.m_edgeFSUsableMemory %" PRIu64, mmapSize >= info.m_edgeFSUsableMemory, mmapSize,
+            " info.m_edgeFSUsableMemory %" PRIu64, layout.m_mmapSize >= info.m_edgeFSUsableMemory, layout.m_mmapSize,
             info.m_edgeFSUsableMemory);
         return false;
     }
 
-    linfo("chunkNum %d chunkSize %u bitmapSize %u mmapSize %" PRIu64 " diskSize %" PRIu64, chunkNum, chunkSize,
-        bitmapSize, mmapSize, diskSize);
-    linfo("EdgeFSHead size %zu MetaInfo size %zu", sizeof(EdgeFSHead), sizeof(MetaInfo));
+    linfo("chunkNum %d chunkSize %u bitmapSize %u packRecordNum %u dedupRecordNum %u dedupLinkNum %u"
+        " logSegmentChunkNum %u logSegmentNum %u mmapSize %" PRIu64 " diskSize %" PRIu64, layout.m_chunkNum,
+        layout.m_chunkSize, layout.m_bitmapSize, layout.m_packRecordNum, layout.m_dedupRecordNum,
+        layout.m_dedupLinkNum, layout.m_logSegmentChunkNum, layout.m_logSegmentNum, layout.m_mmapSize,
+        layout.m_diskSize);
+    linfo("EdgeFSHead size %zu MetaInfo size %zu PackRecord size %zu DedupRecord size %zu LinkInfo size %zu",
+        sizeof(EdgeFSHead), sizeof(MetaInfo), sizeof(PackRecord), sizeof(DedupRecord), sizeof(LinkInfo));
 
     return true;
 }
 
-bool EdgeFS::initFSCalcPointerAddr(bool isExistsIdxFile, uint32_t chunkNum, uint32_t chunkSize, uint64_t diskSize,
-    uint32_t bitmapSize, uint64_t mmapSize)
+bool EdgeFS::initFSCalcPointerAddr(bool isExistsIdxFile, const IndexLayout& layout)
 {
     if (isExistsIdxFile)
     {
-        return initFSCalcPointerAddrForReloadIdxFile(chunkNum, chunkSize, diskSize, bitmapSize, mmapSize);
+        return initFSCalcPointerAddrForReloadIdxFile(layout);
     }
-    return initFSCalcPointerAddrForCreateIdxFile(chunkNum, chunkSize, diskSize, bitmapSize, mmapSize);
+    return initFSCalcPointerAddrForCreateIdxFile(layout);
+}
+
+void EdgeFS::initFSSetPointerAddr(char* ptr, const IndexLayout& layout)
+{
+    m_pFSHead = (EdgeFSHead*)ptr;
+    m_pIndexMgr->setBase(ptr, layout.m_mmapSize);
+    m_pBitMap->initBitmap((char*)m_pFSHead + sizeof(EdgeFSHead), layout.m_bitmapSize, layout.m_chunkNum);
+    m_pMetaPool = (MetaInfo*)((char*)m_pBitMap->getPtr() + layout.m_bitmapSize);
+    m_pPackMgr->initPackMgr((char*)m_pMetaPool + (uint64_t)layout.m_chunkNum * sizeof(MetaInfo),
+        layout.m_packRecordNum);
+    m_pDedupMgr->initDedupMgr((char*)m_pPackMgr->getPtr() + (uint64_t)layout.m_packRecordNum * sizeof(PackRecord),
+        layout.m_dedupRecordNum, layout.m_dedupLinkNum, &m_pFSHead->m_usedLinkNum);
+    m_pDataMgr->initLogMgr((char*)m_pDedupMgr->getPtr() + (uint64_t)layout.m_dedupRecordNum * sizeof(DedupRecord) +
+        (uint64_t)layout.m_dedupLinkNum * sizeof(LinkInfo), m_pIndexMgr, layout.m_chunkNum, layout.m_chunkSize,
+        layout.m_logSegmentChunkNum, layout.m_logSegmentNum);
+
+    linfo("start %p fsHead %p bitmap %p metapool %p packRecords %p dedupRecords %p", ptr, m_pFSHead,
+        m_pBitMap->getPtr(), m_pMetaPool, m_pPackMgr->getPtr(), m_pDedupMgr->getPtr());
 }
 
-bool EdgeFS::initFSCalcPointerAddrForCreateIdxFile(uint32_t chunkNum, uint32_t chunkSize, uint64_t diskSize,
-    uint32_t bitmapSize, uint64_t mmapSize)
+bool EdgeFS::initFSCalcPointerAddrForCreateIdxFile(const IndexLayout& layout)
 {
     int fd = m_pIndexMgr->getfd();
     if (-1 == fd)
@@ -151,47 +345,63 @@ bool EdgeFS::initFSCalcPointerAddrForCreateIdxFile(uint32_t chunkNum, uint32_t c
         return false;
     }
 
-    char *ptr = (char *)mmap(0, mmapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // 日志模式下私有映射，修改只通过提交写入文件
+    int flags = m_pIndexMgr->getJournalMgr()->isEnable() ? MAP_PRIVATE : MAP_SHARED;
+    char *ptr = (char *)mmap(0, layout.m_mmapSize, PROT_READ | PROT_WRITE, flags, fd, 0);
     if (MAP_FAILED == ptr)
     {
-        lfatal("initFS failed, mmap failed, mmapSize %" PRIu64 " fd %d err %s", mmapSize, fd, strerror(errno));
+        lfatal("initFS failed, mmap failed, mmapSize %" PRIu64 " fd %d err %s", layout.m_mmapSize, fd,
+            strerror(errno));
         return false;
     }
     
-    if (ftruncate(fd, mmapSize))
+    if (ftruncate(fd, layout.m_mmapSize))
     {
-        lfatal("initFS failed, ftruncate failed, mmapSize %" PRIu64 " err %s", mmapSize, strerror(errno));
+        lfatal("initFS failed, ftruncate failed, mmapSize %" PRIu64 " err %s", layout.m_mmapSize, strerror(errno));
         return false;
     }
 
-    // 必须放在ftruncate后面
-    memset(ptr, 0, mmapSize);
+    // 必须放在ftruncate后面，新文件本来就是全0，私有映射写入会复制出所有页
+    if (MAP_SHARED == flags)
+    {
+        memset(ptr, 0, layout.m_mmapSize);
+    }
 
     // 赋值指针
-    m_pFSHead = (EdgeFSHead*)ptr;
-    m_pBitMap->initBitmap((char*)m_pFSHead + sizeof(EdgeFSHead), bitmapSize, chunkNum);
-    m_pMetaPool = (MetaInfo*)((char*)m_pBitMap->getPtr() + bitmapSize);
-
-    linfo("start %p fsHead %p bitmap %p metapool %p", ptr, m_pFSHead, m_pBitMap->getPtr(), m_pMetaPool);
+    initFSSetPointerAddr(ptr, layout);
+    if (MAP_SHARED == flags)
+    {
+        m_pIndexMgr->setAllDirty();
+    }
     
     // 赋值FS头部信息
     memcpy(m_pFSHead->m_magic, kEdgeFSMagic.c_str(), kEdgeFSMagic.size());
-    m_pFSHead->m_usableMemory = mmapSize;
-    m_pFSHead->m_coverableDiskSize = diskSize;
-    m_pFSHead->m_chunkNum = chunkNum;
-    m_pFSHead->m_chunkSize = chunkSize;
-    m_pFSHead->m_bitmapSize = bitmapSize;
-
-    linfo("index file EdgeFSHead, magic %s memory %" PRIu64 " diskSize %" PRIu64 " chunkNum %u chunkSize %u"
-        " bitmapSize %u",
-        m_pFSHead->m_magic, m_pFSHead->m_usableMemory, m_pFSHead->m_coverableDiskSize,
-        m_pFSHead->m_chunkNum, m_pFSHead->m_chunkSize, m_pFSHead->m_bitmapSize);
+    m_pFSHead->m_version = kEdgeFSVersion;
+    m_pFSHead->m_usableMemory = layout.m_mmapSize;
+    m_pFSHead->m_coverableDiskSize = layout.m_diskSize;
+    m_pFSHead->m_chunkNum = layout.m_chunkNum;
+    m_pFSHead->m_chunkSize = layout.m_chunkSize;
+    m_pFSHead->m_bitmapSize = layout.m_bitmapSize;
+    m_pFSHead->m_packRecordNum = layout.m_packRecordNum;
+    m_pFSHead->m_curPackChunkid = kInvalidChunkid;
+    m_pFSHead->m_dedupRecordNum = layout.m_dedupRecordNum;
+    m_pFSHead->m_dedupLinkNum = layout.m_dedupLinkNum;
+    m_pFSHead->m_usedLinkNum = 0;
+    m_pFSHead->m_logSegmentChunkNum = layout.m_logSegmentChunkNum;
+    m_pFSHead->m_logSegmentNum = layout.m_logSegmentNum;
+    m_pDataMgr->getLogMgr()->format();
+    recordIndex(m_pFSHead, sizeof(EdgeFSHead));
+
+    linfo("index file EdgeFSHead, magic %s version %u memory %" PRIu64 " diskSize %" PRIu64 " chunkNum %u"
+        " chunkSize %u bitmapSize %u packRecordNum %u dedupRecordNum %u dedupLinkNum %u",
+        m_pFSHead->m_magic, m_pFSHead->m_version, m_pFSHead->m_usableMemory, m_pFSHead->m_coverableDiskSize,
+        m_pFSHead->m_chunkNum, m_pFSHead->m_chunkSize, m_pFSHead->m_bitmapSize, m_pFSHead->m_packRecordNum,
+        m_pFSHead->m_dedupRecordNum, m_pFSHead->m_dedupLinkNum);
 
     return true;
 }
 
-bool EdgeFS::initFSCalcPointerAddrForReloadIdxFile(uint32_t chunkNum, uint32_t chunkSize, uint64_t diskSize,
-    uint32_t bitmapSize, uint64_t mmapSize)
+bool EdgeFS::initFSCalcPointerAddrForReloadIdxFile(const IndexLayout& layout)
 {
     int fd = m_pIndexMgr->getfd();
     if (-1 == fd)
@@ -199,41 +409,65 @@ bool EdgeFS::initFSCalcPointerAddrForReloadIdxFile(uint32_t chunkNum, uint32_t c
         lfatal("initFS failed, fd error");
         return false;
     }
-    char *ptr = (char *)mmap(0, mmapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // 日志模式下私有映射，修改只通过提交写入文件
+    int flags = m_pIndexMgr->getJournalMgr()->isEnable() ? MAP_PRIVATE : MAP_SHARED;
+    char *ptr = (char *)mmap(0, layout.m_mmapSize, PROT_READ | PROT_WRITE, flags, fd, 0);
     if (MAP_FAILED == ptr)
     {
-        lfatal("initFS failed, mmap failed, mmapSize %" PRIu64 " fd %d err %s", mmapSize, fd, strerror(errno));
+        lfatal("initFS failed, mmap failed, mmapSize %" PRIu64 " fd %d err %s", layout.m_mmapSize, fd,
+            strerror(errno));
         return false;
     }
 
-    m_pFSHead = (EdgeFSHead*)ptr;
-    m_pBitMap->initBitmap((char*)m_pFSHead + sizeof(EdgeFSHead), bitmapSize, chunkNum);
-    m_pMetaPool = (MetaInfo*)((char*)m_pBitMap->getPtr() + bitmapSize);
+    initFSSetPointerAddr(ptr, layout);
 
-    linfo("start %p fsHead %p bitmap %p metapool %p", ptr, m_pFSHead, m_pBitMap->getPtr(), m_pMetaPool);
+    // 其他版本的index文件布局不同，后面的字段没有意义，先单独校验版本
+    if (0 == memcmp(m_pFSHead->m_magic, kEdgeFSMagic.c_str(), kEdgeFSMagic.size()) &&
+        kEdgeFSVersion != m_pFSHead->m_version)
+    {
+        lfatal("initFS failed, index file version %u does not match supported version %u, remove %s and %s"
+            " to create a new fs", m_pFSHead->m_version, kEdgeFSVersion, kIndexFileName.c_str(),
+            kDataFileName.c_str());
+        munmap(ptr, layout.m_mmapSize);
+        m_pFSHead = NULL;
+        return false;
+    }
 
     // 对index文件中的FS头部信息做校验
     if (0 != memcmp(m_pFSHead->m_magic, kEdgeFSMagic.c_str(), kEdgeFSMagic.size()) ||
-        m_pFSHead->m_usableMemory != mmapSize ||
-        m_pFSHead->m_coverableDiskSize != diskSize ||
-        m_pFSHead->m_chunkNum != chunkNum ||
-        m_pFSHead->m_chunkSize != chunkSize ||
-        m_pFSHead->m_bitmapSize != bitmapSize
+        m_pFSHead->m_usableMemory != layout.m_mmapSize ||
+        m_pFSHead->m_coverableDiskSize != layout.m_diskSize ||
+        m_pFSHead->m_chunkNum != layout.m_chunkNum ||
+        m_pFSHead->m_chunkSize != layout.m_chunkSize ||
+        m_pFSHead->m_bitmapSize != layout.m_bitmapSize ||
+        m_pFSHead->m_packRecordNum != layout.m_packRecordNum ||
+        m_pFSHead->m_dedupRecordNum != layout.m_dedupRecordNum ||
+        m_pFSHead->m_dedupLinkNum != layout.m_dedupLinkNum ||
+        m_pFSHead->m_logSegmentChunkNum != layout.m_logSegmentChunkNum ||
+        m_pFSHead->m_logSegmentNum != layout.m_logSegmentNum
         )
     {
         lfatal("initFS failed, index file EdgeFSHead error, magic %s %s memory %" PRIu64
             " %" PRIu64 " diskSize %" PRIu64 " %" PRIu64 " chunkNum %u %u chunkSize %u %u"
-            " bitmapSize %u %u",
-            m_pFSHead->m_magic, kEdgeFSMagic.c_str(), m_pFSHead->m_usableMemory, mmapSize,
-            m_pFSHead->m_coverableDiskSize, diskSize, m_pFSHead->m_chunkNum, chunkNum,
-            m_pFSHead->m_chunkSize, chunkSize, m_pFSHead->m_bitmapSize, bitmapSize);
+            " bitmapSize %u %u packRecordNum %u %u dedupRecordNum %u %u dedupLinkNum %u %u"
+            " logSegmentChunkNum %u %u logSegmentNum %u %u",
+            m_pFSHead->m_magic, kEdgeFSMagic.c_str(), m_pFSHead->m_usableMemory, layout.m_mmapSize,
+            m_pFSHead->m_coverableDiskSize, layout.m_diskSize, m_pFSHead->m_chunkNum, layout.m_chunkNum,
+            m_pFSHead->m_chunkSize, layout.m_chunkSize, m_pFSHead->m_bitmapSize, layout.m_bitmapSize,
+            m_pFSHead->m_packRecordNum, layout.m_packRecordNum, m_pFSHead->m_dedupRecordNum,
+            layout.m_dedupRecordNum, m_pFSHead->m_dedupLinkNum, layout.m_dedupLinkNum,
+            m_pFSHead->m_logSegmentChunkNum, layout.m_logSegmentChunkNum, m_pFSHead->m_logSegmentNum,
+            layout.m_logSegmentNum);
+        munmap(ptr, layout.m_mmapSize);
+        m_pFSHead = NULL;
         return false;
     }
 
-    linfo("index file EdgeFSHead, magic %s memory %" PRIu64 " diskSize %" PRIu64 "chunkNum %u chunkSize %u"
-        " bitmapSize %u",
-        m_pFSHead->m_magic, m_pFSHead->m_usableMemory, m_pFSHead->m_coverableDiskSize,
-        m_pFSHead->m_chunkNum, m_pFSHead->m_chunkSize, m_pFSHead->m_bitmapSize);
+    linfo("index file EdgeFSHead, magic %s version %u memory %" PRIu64 " diskSize %" PRIu64 " chunkNum %u"
+        " chunkSize %u bitmapSize %u packRecordNum %u dedupRecordNum %u dedupLinkNum %u usedLinkNum %u",
+        m_pFSHead->m_magic, m_pFSHead->m_version, m_pFSHead->m_usableMemory, m_pFSHead->m_coverableDiskSize,
+        m_pFSHead->m_chunkNum, m_pFSHead->m_chunkSize, m_pFSHead->m_bitmapSize, m_pFSHead->m_packRecordNum,
+        m_pFSHead->m_dedupRecordNum, m_pFSHead->m_dedupLinkNum, m_pFSHead->m_usedLinkNum);
 
     printAllMetaInfo();
 
@@ -242,12 +476,49 @@ bool EdgeFS::initFSCalcPointerAddrForReloadIdxFile(uint32_t chunkNum, uint32_t c
 
 void EdgeFS::unitFS()
 {
+    // 后台线程停止前完成最后一次落盘
+    stopDefragThread();
+    stopFlushThread();
+
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    // 等待中的读取和回调按照下载结束处理
+    m_pProgressMgr->clear();
+    if (NULL != m_pFSHead)
+    {
+        // 整理到一半的文件放弃剩余的迁移，已经迁移的数据块保持有效
+        cancelDefrag();
+        linfo("defrag fileNum %" PRIu64 " bytes %" PRIu64, m_defragFileNum, m_defragBytes);
+    }
+    linfo("readahead hitNum %" PRIu64 " wasteNum %" PRIu64 " issueBytes %" PRIu64, m_pReadaheadMgr->getHitNum(),
+        m_pReadaheadMgr->getWasteNum(), m_pReadaheadMgr->getIssueBytes());
+    m_pDataMgr->flushLog();
+    if (NULL != m_pFSHead && m_pIndexMgr->getJournalMgr()->isEnable())
+    {
+        // 不会再有写入，释放的chunk可以和最后的修改一起提交
+        releasePendingChunks();
+        commitJournal(true);
+        m_pIndexMgr->getJournalMgr()->checkpoint();
+        linfo("journal commitNum %" PRIu64 " journalBytes %" PRIu64, m_pIndexMgr->getJournalMgr()->getCommitNum(),
+            m_pIndexMgr->getJournalMgr()->getJournalBytes());
+    }
+    linfo("index syncNum %" PRIu64 " syncBytes %" PRIu64, m_pIndexMgr->getSyncNum(), m_pIndexMgr->getSyncBytes());
+    linfo("write hostBytes %" PRIu64 " deviceBytes %" PRIu64 " logCleanSegmentNum %" PRIu64 " logCleanBytes %" PRIu64,
+        m_pDataMgr->getHostWriteBytes(), m_pDataMgr->getDeviceWriteBytes(),
+        m_pDataMgr->getLogMgr()->getCleanSegmentNum(), m_pDataMgr->getLogMgr()->getCleanBytes());
+    linfo("parallel readNum %" PRIu64, m_parallelReadNum.load());
+    m_pDataMgr->unitDataMgr();
+    if (NULL != m_pFSHead)
+    {
+        munmap((char*)m_pFSHead, m_pFSHead->m_usableMemory);
+        m_pFSHead = NULL;
+    }
     AsyncLogging::release();
 }
 
-void EdgeFS::calcWriteVariable(const MetaInfo* pTailMtInfo, uint32_t writeLen, uint32_t& firstWriteLen,
-    uint32_t& needChunkNum, uint32_t& lastChunkWriteLen)
+void EdgeFS::calcWriteVariable(const MetaInfo* pTailMtInfo, uint32_t writeLen, uint32_t& firstWriteLen)
 {
+    firstWriteLen = 0;
     if (NULL != pTailMtInfo)
     {
         if (!pTailMtInfo->m_isUsed)
@@ -262,32 +533,117 @@ void EdgeFS::calcWriteVariable(const MetaInfo* pTailMtInfo, uint32_t writeLen, u
                 pTailMtInfo->m_idleLen : writeLen;
         }
     }
-    uint64_t remainLen = writeLen - firstWriteLen;
-    needChunkNum = DIV_ROUND_UP(remainLen, m_pFSHead->m_chunkSize);
-    lastChunkWriteLen = remainLen % m_pFSHead->m_chunkSize;
 
-    linfo("pTailMtInfo %p writeLen %u firstWriteLen %u needChunkNum %u lastChunkWriteLen %u",
-        pTailMtInfo, writeLen, firstWriteLen, needChunkNum, lastChunkWriteLen);
+    linfo("pTailMtInfo %p writeLen %u firstWriteLen %u", pTailMtInfo, writeLen, firstWriteLen);
+}
+
+uint8_t EdgeFS::calcExtentOrder(uint64_t fileSize, uint64_t sizeHint, uint32_t remainLen)
+{
+    // 有大小提示时按照剩余的预期大小分配，否则按照文件当前大小倍增，大文件的块数量按对数增长
+    uint64_t expectLen = sizeHint > fileSize ? sizeHint - fileSize : std::max(fileSize, (uint64_t)remainLen);
+    uint8_t order = 0;
+    while (order < m_maxExtentOrder && (uint64_t)calcExtentSize(order + 1) <= expectLen)
+    {
+        order++;
+    }
+    return order;
+}
+
+bool EdgeFS::allocExtents(uint64_t fileSize, uint64_t sizeHint, uint32_t remainLen, ExtentList& extents)
+{
+    while (0 != remainLen)
+    {
+        // 连续空间不足时逐级减小块的大小
+        uint8_t order = calcExtentOrder(fileSize, sizeHint, remainLen);
+        uint32_t chunkid = kInvalidChunkid;
+        while (!generateIdleExtent(order, chunkid))
+        {
+            if (0 == order)
+            {
+                break;
+            }
+            order--;
+        }
+        if (kInvalidChunkid == chunkid)
+        {
+            break;
+        }
+
+        // 先占用bitmap，避免同一次写入分配到重叠的块
+        for (uint32_t i = 0; i < (1u << order); i++)
+        {
+            m_pBitMap->insert(chunkid + i);
+            recordBitmap(chunkid + i);
+        }
+        ExtentInfo extent = { chunkid, order };
+        extents.push_back(extent);
+
+        uint32_t extentWriteLen = std::min(remainLen, calcExtentSize(order));
+        remainLen -= extentWriteLen;
+        fileSize += extentWriteLen;
+    }
+
+    if (0 != remainLen)
+    {
+        for (auto it = extents.begin(); it != extents.end(); ++it)
+        {
+            releaseExtent(it->m_chunkid, it->m_order);
+        }
+        extents.clear();
+        return false;
+    }
+    return true;
+}
+
+bool EdgeFS::generateIdleExtent(uint8_t order, uint32_t& chunkid)
+{
+    TraceSpan span(m_pTraceMgr, TraceType_ALLOC);
+    uint32_t scanNum = 0;
+    bool isOk = m_pBitMap->generateIdleExtent(order, chunkid, scanNum);
+    span.setArg(scanNum);
+    m_pStatsMgr->add(StatType_ALLOC_NUM, StatType_ALLOC_SCAN_NUM, scanNum);
+    return isOk;
+}
+
+void EdgeFS::releaseExtent(uint32_t chunkid, uint8_t order)
+{
+    for (uint32_t i = 0; i < (1u << order); i++)
+    {
+        m_pBitMap->remove(chunkid + i);
+        recordBitmap(chunkid + i);
+        m_pDataMgr->trim(chunkid + i);
+    }
 }
 
-MetaInfo* EdgeFS::findTailMetaInfo(const MetaInfo* pHeadMtInfo, const char* sha1Val)
+MetaInfo* EdgeFS::findTailMetaInfo(const MetaInfo* pHeadMtInfo, const char* sha1Val, MetaInfo** pChainEndMtInfo,
+    MetaInfo** pEndMtInfo)
 {
     assert(NULL != pHeadMtInfo);
     assert(NULL != sha1Val);
 
+    // 链表中文件的最后一个块通常也是文件末尾的块，先写入后面分段的文件两者不同
+    TraceSpan span(m_pTraceMgr, TraceType_LOOKUP);
     const MetaInfo* pTailMtInfo = NULL;
+    const MetaInfo* pEndTmp = NULL;
     const MetaInfo* tmp = pHeadMtInfo;
+    uint32_t nodeNum = 0;
 
     while (1)
     {
+        nodeNum++;
         if (!tmp->m_isUsed)
         {
             pTailMtInfo = tmp;
             break;
         }
-        if (0 == memcmp(tmp->m_metaData.m_sha1, sha1Val, sizeof(tmp->m_metaData.m_sha1)))
+        if ((ChunkType_DATA == tmp->m_chunkType || ChunkType_LINK == tmp->m_chunkType) &&
+            0 == memcmp(tmp->m_metaData.m_sha1, sha1Val, sizeof(tmp->m_metaData.m_sha1)))
         {
             pTailMtInfo = tmp;
+            if (NULL == pEndTmp || tmp->m_metaData.m_fileSize > pEndTmp->m_metaData.m_fileSize)
+            {
+                pEndTmp = tmp;
+            }
         }
         if (kInvalidChunkid == tmp->m_nextChunkid)
         {
@@ -295,9 +651,41 @@ MetaInfo* EdgeFS::findTailMetaInfo(const MetaInfo* pHeadMtInfo, const char* sha1
         }
         tmp = calcMetaInfoPtr(tmp->m_nextChunkid);
     }
+    *pChainEndMtInfo = const_cast<MetaInfo*>(tmp);
+    *pEndMtInfo = const_cast<MetaInfo*>(pEndTmp);
+    countLookup(nodeNum);
+    span.setArg(nodeNum);
     return const_cast<MetaInfo*>(pTailMtInfo);
 }
 
+MetaInfo* EdgeFS::findFillMetaInfo(const MetaInfo* pHeadMtInfo, const char* sha1Val, uint64_t offset)
+{
+    // 数据在offset结束的块，剩余空间可以继续写入offset之后的数据
+    TraceSpan span(m_pTraceMgr, TraceType_LOOKUP);
+    const MetaInfo* tmp = pHeadMtInfo;
+    uint32_t nodeNum = 0;
+    MetaInfo* pFillMtInfo = NULL;
+    while (tmp->m_isUsed)
+    {
+        nodeNum++;
+        if ((ChunkType_DATA == tmp->m_chunkType || ChunkType_LINK == tmp->m_chunkType) &&
+            offset == tmp->m_metaData.m_fileSize &&
+            0 == memcmp(tmp->m_metaData.m_sha1, sha1Val, sizeof(tmp->m_metaData.m_sha1)))
+        {
+            pFillMtInfo = const_cast<MetaInfo*>(tmp);
+            break;
+        }
+        if (kInvalidChunkid == tmp->m_nextChunkid)
+        {
+            break;
+        }
+        tmp = calcMetaInfoPtr(tmp->m_nextChunkid);
+    }
+    countLookup(nodeNum);
+    span.setArg(nodeNum);
+    return pFillMtInfo;
+}
+
 uint32_t EdgeFS::calcChunkid(const MetaInfo* pMtInfo)
 {
     if (NULL == pMtInfo)
@@ -309,6 +697,10 @@ uint32_t EdgeFS::calcChunkid(const MetaInfo* pMtInfo)
 
 MetaInfo* EdgeFS::calcMetaInfoPtr(uint32_t chunkid)
 {
+    if (DedupMgr::isLinkid(chunkid))
+    {
+        return &m_pDedupMgr->getLink(chunkid)->m_mtInfo;
+    }
     return (MetaInfo*)((char*)m_pMetaPool + (uint64_t)chunkid * (uint64_t)sizeof(MetaInfo));
 }
 
@@ -317,146 +709,347 @@ uint64_t EdgeFS::calcOffset(uint32_t chunkid)
     return (uint64_t)chunkid * m_pFSHead->m_chunkSize;
 }
 
+uint32_t EdgeFS::calcExtentSize(uint8_t order)
+{
+    return m_pFSHead->m_chunkSize << order;
+}
+
 uint32_t EdgeFS::generateHashKey(const char* sha1Val)
 {
     return (*(uint32_t*)sha1Val) % m_pFSHead->m_chunkNum;
 }
 
+void EdgeFS::countRead(int64_t ret)
+{
+    m_pStatsMgr->add(StatType_READ_NUM, ret < 0 ? StatType_READ_FAIL_NUM : StatType_READ_BYTES, ret < 0 ? 1 : ret);
+}
+
+void EdgeFS::countWrite(int64_t ret)
+{
+    m_pStatsMgr->add(StatType_WRITE_NUM, ret < 0 ? StatType_WRITE_FAIL_NUM : StatType_WRITE_BYTES,
+        ret < 0 ? 1 : ret);
+}
+
+void EdgeFS::countLookup(uint32_t nodeNum)
+{
+    m_pStatsMgr->add(StatType_LOOKUP_NUM, StatType_LOOKUP_NODE_NUM, nodeNum);
+}
+
 int64_t EdgeFS::write(const std::string& fileName, const char* buff, uint32_t len)
+{
+    return write(fileName, buff, len, 0);
+}
+
+int64_t EdgeFS::write(const std::string& fileName, const char* buff, uint32_t len, uint64_t sizeHint)
 {
     if (NULL == buff)
     {
         return -1;
     }
-    lnotice("fileName %s len %u", fileName.c_str(), len);
+    uint64_t startNs = m_pStatsMgr->beginLatency();
+    // 在锁之前构造，析构时已经释放锁，慢操作触发的导出不阻塞其他调用
+    TraceSpan span(m_pTraceMgr, TraceType_WRITE, len);
+    PerfScope perfScope(m_pPerfCounterMgr, PerfOpType_WRITE);
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    lnotice("fileName %s len %u sizeHint %" PRIu64, fileName.c_str(), len, sizeHint);
 
     char sha1Val[SHA_DIGEST_LENGTH] = { '\0' };
-    ShaHelper::calcShaToHex(fileName, sha1Val);
+    {
+        TraceSpan hashSpan(m_pTraceMgr, TraceType_HASH, fileName.size());
+        ShaHelper::calcShaToHex(fileName, sha1Val);
+    }
+
+    int64_t realWriteLen = writeByKey(sha1Val, buff, len, sizeHint, kAppendOffset);
+    commitJournal(false);
+    notifyProgress(sha1Val);
+    countWrite(realWriteLen);
+    m_pStatsMgr->addLatency(LatencyType_WRITE, startNs);
+    return realWriteLen;
+}
+
+int64_t EdgeFS::write(const FileKey& key, const char* buff, uint32_t len, uint64_t sizeHint)
+{
+    if (NULL == buff)
+    {
+        return -1;
+    }
+    uint64_t startNs = m_pStatsMgr->beginLatency();
+    TraceSpan span(m_pTraceMgr, TraceType_WRITE, len);
+    PerfScope perfScope(m_pPerfCounterMgr, PerfOpType_WRITE);
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    int64_t realWriteLen = writeByKey(key.m_sha1, buff, len, sizeHint, kAppendOffset);
+    commitJournal(false);
+    notifyProgress(key.m_sha1);
+    countWrite(realWriteLen);
+    m_pStatsMgr->addLatency(LatencyType_WRITE, startNs);
+    return realWriteLen;
+}
+
+int64_t EdgeFS::writeByKey(const char* sha1Val, const char* buff, uint32_t len, uint64_t sizeHint, uint64_t offset)
+{
+    if (m_pPackMgr->isEnable())
+    {
+        PackRecord* pIdleRecord = NULL;
+        PackRecord* pRecord = m_pPackMgr->find(sha1Val, &pIdleRecord);
+        if (NULL != pRecord && PackRecordState_USED == pRecord->m_state)
+        {
+            return appendPackFile(sha1Val, pRecord, buff, len, sizeHint, offset);
+        }
+
+        if ((kAppendOffset == offset || 0 == offset) && isNewPackFile(sha1Val, pRecord, pIdleRecord, len, sizeHint))
+        {
+            return writePackFile(sha1Val, pIdleRecord, buff, len);
+        }
+    }
+
+    int64_t realWriteLen = (this->*m_pWriteDataChunks)(sha1Val, buff, len, sizeHint, offset);
+
+    printAllMetaInfo();
+
+    return realWriteLen;
+}
+
+template<typename Geometry>
+int64_t EdgeFS::writeDataChunks(const char* sha1Val, const char* buff, uint32_t len, uint64_t sizeHint,
+    uint64_t offset)
+{
+    const Geometry geometry(m_pFSHead->m_chunkSize);
 
     uint32_t hashKey = generateHashKey(sha1Val);
     MetaInfo* pHeadMtInfo = calcMetaInfoPtr(hashKey);
-    MetaInfo* pTailMtInfo = findTailMetaInfo(pHeadMtInfo, sha1Val);
+    MetaInfo* pChainEndMtInfo = NULL;
+    MetaInfo* pEndMtInfo = NULL;
+    MetaInfo* pTailMtInfo = findTailMetaInfo(pHeadMtInfo, sha1Val, &pChainEndMtInfo, &pEndMtInfo);
+
+    // 先写满数据在写入位置结束的块的剩余空间，追加时为文件末尾的块，文件不存在时为未使用的链表头chunk
+    // 调用者保证[offset, offset + len)中没有数据，新的块按照chunk的m_fileSize确定在文件中的位置
+    MetaInfo* pFillMtInfo = pTailMtInfo;
+    if (NULL != pEndMtInfo)
+    {
+        uint64_t endOffset = pEndMtInfo->m_metaData.m_fileSize;
+        offset = kAppendOffset == offset ? endOffset : offset;
+        pFillMtInfo = offset == endOffset ? pEndMtInfo : findFillMetaInfo(pHeadMtInfo, sha1Val, offset);
+    }
+    else if (kAppendOffset == offset)
+    {
+        offset = 0;
+    }
 
-    linfo("hashKey %u pHeadMtInfo %p %d pTailMtInfo %p %d", hashKey, pHeadMtInfo,
-        calcChunkid(pHeadMtInfo), pTailMtInfo, calcChunkid(pTailMtInfo));
+    linfo("hashKey %u pHeadMtInfo %p %d pTailMtInfo %p %d pFillMtInfo %p %d offset %" PRIu64, hashKey, pHeadMtInfo,
+        calcChunkid(pHeadMtInfo), pTailMtInfo, calcChunkid(pTailMtInfo), pFillMtInfo, calcChunkid(pFillMtInfo),
+        offset);
+
+    // 文件的链表从其他文件的chunk进入，该chunk不能被去重释放
+    if (m_pDedupMgr->isEnable() && NULL == pTailMtInfo)
+    {
+        pHeadMtInfo->m_extendArea.m_flags |= MetaFlag_PINNED;
+        recordMeta(pHeadMtInfo);
+    }
 
     uint32_t firstWriteLen = 0;
-    uint32_t needChunkNum = 0;
-    std::vector<uint32_t> idleChunkids;
-    uint32_t lastChunkWriteLen = 0;
-    
-    calcWriteVariable(pTailMtInfo, len, firstWriteLen, needChunkNum, lastChunkWriteLen);
+    calcWriteVariable(pFillMtInfo, len, firstWriteLen);
 
-    if (0 != needChunkNum)
+    // 未使用的链表头chunk先占用bitmap，避免被同一次写入分配为数据块
+    bool isNewTail = 0 != firstWriteLen && !pFillMtInfo->m_isUsed;
+    if (isNewTail)
     {
-        if (!m_pBitMap->generateIdleChunkids(idleChunkids, needChunkNum) || idleChunkids.empty())
+        m_pBitMap->insert(calcChunkid(pFillMtInfo));
+        recordBitmap(calcChunkid(pFillMtInfo));
+    }
+
+    uint64_t fileSize = offset;
+    ExtentList extents;
+    if (!allocExtents(fileSize + firstWriteLen, sizeHint, len - firstWriteLen, extents))
+    {
+        lwarn("no idle chunk");
+        if (isNewTail)
         {
-            lwarn("no idle chunk");
-            return -1;
+            releaseExtent(calcChunkid(pFillMtInfo), 0);
         }
+        return -1;
     }
-    ldebug("idleChunkSize %zu", idleChunkids.size());
+    ldebug("extentNum %u", extents.size());
 
-    uint64_t remainLen = len;
-    uint64_t offset = 0;
+    uint64_t diskOffset = 0;
     uint32_t chunkid = 0;
     uint64_t realWriteLen = 0;
-    uint32_t chunkSize = m_pFSHead->m_chunkSize;
 
-    do
+    if (0 != firstWriteLen)
     {
-        if (0 != firstWriteLen)
+        chunkid = calcChunkid(pFillMtInfo);
+        diskOffset = geometry.offset(chunkid);
+        // 要注意pFillMtInfo使用的是共享内存的地址，成员变量默认都是0
+        if (pFillMtInfo->m_isUsed)
+        {
+            diskOffset += geometry.extentSize(pFillMtInfo->m_order) - pFillMtInfo->m_idleLen;
+        }
+
+        linfo("first write, firstWriteLen %u offset %" PRIu64 "", firstWriteLen, diskOffset);
+
+        if (!m_pDataMgr->write(buff, firstWriteLen, diskOffset))
         {
-            chunkid = calcChunkid(pTailMtInfo);
-            offset = chunkid * chunkSize;
-            // 要注意pTailMtInfo使用的是共享内存的地址，成员变量默认都是0
-            if (pTailMtInfo->m_isUsed)
+            lerror("[err] write failed, writeLen %u offset %" PRIu64, len, diskOffset);
+            for (auto it = extents.begin(); it != extents.end(); ++it)
+            {
+                releaseExtent(it->m_chunkid, it->m_order);
+            }
+            if (isNewTail)
             {
-                offset += chunkSize - pTailMtInfo->m_idleLen;
+                releaseExtent(chunkid, 0);
             }
+            return -1;
+        }
+        realWriteLen += firstWriteLen;
+
+        // 文件变长之后不再是完成的大小
+        pFillMtInfo->m_extendArea.m_flags &= ~MetaFlag_COMPLETE;
+        if (pFillMtInfo->m_isUsed)
+        {
+            pFillMtInfo->m_idleLen -= firstWriteLen;
+            pFillMtInfo->m_metaData.m_fileSize += firstWriteLen;
+        }
+        else
+        {
+            pFillMtInfo->m_isUsed = true;
+            pFillMtInfo->m_chunkType = ChunkType_DATA;
+            pFillMtInfo->m_order = 0;
+            memcpy(pFillMtInfo->m_metaData.m_sha1, sha1Val, sizeof(pFillMtInfo->m_metaData.m_sha1));
+            pFillMtInfo->m_metaData.m_fileSize = offset + firstWriteLen;
+            pFillMtInfo->m_idleLen = geometry.chunkSize() - firstWriteLen;
+            pFillMtInfo->m_nextChunkid = kInvalidChunkid;
+        }
+        fileSize = pFillMtInfo->m_metaData.m_fileSize;
+        recordMeta(pFillMtInfo);
 
-            linfo("first write, firstWriteLen %u offset %" PRIu64 "", firstWriteLen, offset);
+        linfo("chunkid %u offset %" PRIu64 " fillMetaInfo order %u idleLen %u nextChunkid %d", chunkid, diskOffset,
+            pFillMtInfo->m_order, pFillMtInfo->m_idleLen, (int32_t)pFillMtInfo->m_nextChunkid);
+    }
+
+    uint32_t writeExtentNum = 0;
+    uint32_t firstNodeid = kInvalidChunkid;
+    MetaInfo* pLastNodeMtInfo = NULL;
+    for (uint32_t i = 0; i < extents.size(); i++)
+    {
+        chunkid = extents[i].m_chunkid;
+        uint8_t order = extents[i].m_order;
+        uint32_t extentSize = geometry.extentSize(order);
+        uint32_t writeLen = std::min((uint64_t)extentSize, len - realWriteLen);
+        diskOffset = geometry.offset(chunkid);
+        MetaInfo* pCurrMtInfo = NULL;
+        uint32_t nodeid = chunkid;
+
+        // 写满的chunk先查找相同内容的chunk，找到时只增加引用，不写入磁盘
+        char fingerprint[SHA_DIGEST_LENGTH] = { '\0' };
+        bool isDedupChunk = m_pDedupMgr->isEnable() && writeLen == extentSize;
+        if (isDedupChunk)
+        {
+            TraceSpan hashSpan(m_pTraceMgr, TraceType_HASH, writeLen);
+            ShaHelper::calcShaToHex(buff + realWriteLen, writeLen, fingerprint);
+            pCurrMtInfo = linkDedupChunk(sha1Val, fingerprint, nodeid);
+        }
 
-            if (!m_pDataMgr->write(buff+realWriteLen, firstWriteLen, offset))
+        if (NULL != pCurrMtInfo)
+        {
+            releaseExtent(chunkid, order);
+            linfo("chunkid %u dedup, linkid %u linkChunkid %u", chunkid, nodeid & ~kLinkChunkidFlag,
+                ((LinkInfo*)pCurrMtInfo)->m_linkChunkid);
+        }
+        else
+        {
+            linfo("chunkid %u order %u offset %" PRIu64 " writeLen %u", chunkid, order, diskOffset, writeLen);
+
+            // 写满的chunk尝试压缩，压缩后的数据在共用的缓冲区中，需要立即写入
+            uint32_t storedLen = 0;
+            bool isCompressed = m_isCompress && writeLen == extentSize &&
+                compressChunk(buff + realWriteLen, writeLen, storedLen);
+            bool isWriteOk = isCompressed ? m_pDataMgr->writeDirect(&m_compressBuff[0], storedLen, diskOffset) :
+                m_pDataMgr->write(buff+realWriteLen, writeLen, diskOffset);
+            if (!isWriteOk)
             {
-                lerror("[err] write failed, writeLen %u offset %" PRIu64, len, offset);
+                lerror("write failed, writeLen %u offset %" PRIu64, len, diskOffset);
                 break;
             }
-            realWriteLen += firstWriteLen;
-            remainLen -= firstWriteLen;
 
-            if (pTailMtInfo->m_isUsed)
+            // 写入成功更新metainfo，扩展块只标记占用
+            for (uint32_t j = 1; j < (1u << order); j++)
             {
-                pTailMtInfo->m_idleLen -= firstWriteLen;
+                MetaInfo* pExtMtInfo = calcMetaInfoPtr(chunkid + j);
+                pExtMtInfo->m_isUsed = true;
+                pExtMtInfo->m_chunkType = ChunkType_EXTENT;
+                pExtMtInfo->m_order = 0;
+                memset(pExtMtInfo->m_metaData.m_sha1, 0, sizeof(pExtMtInfo->m_metaData.m_sha1));
+                pExtMtInfo->m_idleLen = 0;
+                pExtMtInfo->m_nextChunkid = kInvalidChunkid;
+                recordMeta(pExtMtInfo);
             }
-            else
+            pCurrMtInfo = calcMetaInfoPtr(chunkid);
+            pCurrMtInfo->m_isUsed = true;
+            pCurrMtInfo->m_chunkType = ChunkType_DATA;
+            pCurrMtInfo->m_order = order;
+            memcpy(pCurrMtInfo->m_metaData.m_sha1, sha1Val, sizeof(pCurrMtInfo->m_metaData.m_sha1));
+            pCurrMtInfo->m_idleLen = extentSize - writeLen;
+            pCurrMtInfo->m_extendArea.m_flags &= ~MetaFlag_COMPLETE;
+            if (isCompressed)
             {
-                m_pBitMap->insert(chunkid);
-                pTailMtInfo->m_isUsed = true;
-                memcpy(pTailMtInfo->m_metaData.m_sha1, sha1Val, sizeof(pTailMtInfo->m_metaData.m_sha1));
-                pTailMtInfo->m_idleLen = chunkSize - firstWriteLen;
-                pTailMtInfo->m_nextChunkid = kInvalidChunkid;
+                pCurrMtInfo->m_extendArea.m_flags |= MetaFlag_COMPRESSED;
+                pCurrMtInfo->m_extendArea.m_storedLen = storedLen;
             }
-            if (0 == pTailMtInfo->m_idleLen)
+            else
             {
-                // 当前chunk已经下满了，赋值nextChunkid
-                pTailMtInfo->m_nextChunkid = idleChunkids.empty() ? kInvalidChunkid : idleChunkids[0];
+                pCurrMtInfo->m_extendArea.m_flags &= ~MetaFlag_COMPRESSED;
+                pCurrMtInfo->m_extendArea.m_storedLen = 0;
             }
 
-            linfo("chunkid %u offset %" PRIu64 " tailMetaInfo %s", chunkid, offset, pTailMtInfo->print().c_str());
-        }
-        else
-        {
-            // 前面一个chunk刚刚写满，但是nextChunkids还未赋值
-            if (!idleChunkids.empty())
+            if (isDedupChunk)
             {
-                pTailMtInfo->m_nextChunkid = idleChunkids[0];
+                addDedupRecord(fingerprint, chunkid);
             }
         }
-
-        if (0 != needChunkNum)
+        realWriteLen += writeLen;
+        fileSize += writeLen;
+        pCurrMtInfo->m_metaData.m_fileSize = fileSize;
+        pCurrMtInfo->m_nextChunkid = kInvalidChunkid;
+        recordMeta(pCurrMtInfo);
+
+        // 新节点依次连接，最后整体插入文件链表
+        if (NULL == pLastNodeMtInfo)
         {
-            for (uint32_t i = 0; i < needChunkNum; i++)
-            {
-                uint32_t writeLen = remainLen >=  chunkSize ? chunkSize : remainLen;
-                chunkid = idleChunkids[i];
-                offset = chunkid * chunkSize;
-                MetaInfo* pCurrMtInfo = calcMetaInfoPtr(chunkid);
-
-                linfo("chunkid %u offset %" PRIu64 " writeLen %u", chunkid, offset, writeLen);
-
-                if (!m_pDataMgr->write(buff+realWriteLen, writeLen, offset))
-                {
-                    lerror("write failed, writeLen %u offset %" PRIu64, len, offset);
-                    break;
-                }
-                remainLen -= writeLen;
-                realWriteLen += writeLen;
+            firstNodeid = nodeid;
+        }
+        else
+        {
+            pLastNodeMtInfo->m_nextChunkid = nodeid;
+        }
+        pLastNodeMtInfo = pCurrMtInfo;
+        writeExtentNum++;
 
-                // 写入成功更新bitmap、metainfo
-                m_pBitMap->insert(chunkid);
-                pCurrMtInfo->m_isUsed = true;
-                memcpy(pCurrMtInfo->m_metaData.m_sha1, sha1Val, sizeof(pCurrMtInfo->m_metaData.m_sha1));
+        linfo("metaInfo type %u order %u idleLen %u", pCurrMtInfo->m_chunkType, pCurrMtInfo->m_order,
+            pCurrMtInfo->m_idleLen);
+    }
 
-                pCurrMtInfo->m_idleLen = chunkSize - firstWriteLen;
+    // 写入失败的块归还给bitmap
+    for (uint32_t i = writeExtentNum; i < extents.size(); i++)
+    {
+        releaseExtent(extents[i].m_chunkid, extents[i].m_order);
+    }
 
-                if (i + 1 == needChunkNum)
-                {
-                    // 最后一个chunk
-                    pCurrMtInfo->m_nextChunkid = kInvalidChunkid;
-                    pCurrMtInfo->m_idleLen = chunkSize - lastChunkWriteLen;
-                }
-                else
-                {
-                    pCurrMtInfo->m_nextChunkid = idleChunkids[i+1];
-                    pCurrMtInfo->m_idleLen = 0;
-                }
-                linfo("metaInfo %s", pCurrMtInfo->print().c_str());
-            }
-        }
-    } while (0);
+    if (0 != writeExtentNum)
+    {
+        // 新的块插入到链表中文件的最后一个块之后，不存在时插入到链表末尾，链表中其他文件的块不能丢失
+        TraceSpan metaSpan(m_pTraceMgr, TraceType_META);
+        MetaInfo* pPrevMtInfo = NULL != pTailMtInfo ? pTailMtInfo : pChainEndMtInfo;
+        pLastNodeMtInfo->m_nextChunkid = pPrevMtInfo->m_nextChunkid;
+        pPrevMtInfo->m_nextChunkid = firstNodeid;
+        recordMeta(pPrevMtInfo);
+    }
 
-    printAllMetaInfo();
+    // 跨多次写入才写满的chunk，写满后再去重或者压缩
+    if ((m_pDedupMgr->isEnable() || m_isCompress) && 0 != firstWriteLen && 0 == pFillMtInfo->m_idleLen)
+    {
+        sealTailChunk(pHeadMtInfo, pFillMtInfo);
+    }
 
     return realWriteLen;
 }
@@ -467,83 +1060,230 @@ int64_t EdgeFS::read(const std::string& fileName, char* buff, uint32_t len, uint
     {
         return -1;
     }
+    uint64_t startNs = m_pStatsMgr->beginLatency();
+    TraceSpan span(m_pTraceMgr, TraceType_READ, len);
+    PerfScope perfScope(m_pPerfCounterMgr, PerfOpType_READ);
+    SharedLockGuard lock(m_mutex);
     lnotice("fileName %s len %u", fileName.c_str(), len);
 
     char sha1Val[SHA_DIGEST_LENGTH] = { '\0' };
-    ShaHelper::calcShaToHex(fileName, sha1Val);
-
-    uint32_t hashKey = generateHashKey(sha1Val);
-    MetaInfo* pHeadMtInfo = calcMetaInfoPtr(hashKey);
-    std::vector<uint32_t> writeChunkids;
-    uint32_t lastChunkWriteLen = 0;
-    uint64_t writeTotalLen = 0;
-
-    generateReadChunkids(pHeadMtInfo, sha1Val, writeChunkids, writeTotalLen, lastChunkWriteLen);
-
-    if (writeChunkids.empty())
-    {
-        lwarn("not found file, fileName %s", fileName.c_str());
-        return -1;
-    }
-    if (offset > writeTotalLen)
     {
-        lwarn("offset too large, offset %" PRIu64 " writeTotalLen %" PRIu64, offset, writeTotalLen);
-        return -1;
+        TraceSpan hashSpan(m_pTraceMgr, TraceType_HASH, fileName.size());
+        ShaHelper::calcShaToHex(fileName, sha1Val);
     }
 
-    linfo("writeChunkNum %zu writeTotalLen %" PRIu64 " lastChunkWriteLen %u", writeChunkids.size(), writeTotalLen,
-        lastChunkWriteLen);
-    linfo("write chunkids : ");
-    for (uint32_t i = 0; i < writeChunkids.size(); i++)
+    int64_t realReadLen = readByKey(sha1Val, buff, len, offset);
+    if (-1 == realReadLen)
     {
-        linfo("%d ", writeChunkids[i]);
+        lwarn("read failed, fileName %s offset %" PRIu64, fileName.c_str(), offset);
     }
+    countRead(realReadLen);
+    m_pStatsMgr->addLatency(LatencyType_READ, startNs);
+    return realReadLen;
+}
 
-    std::map<uint64_t, uint32_t> readInfo;     // offset -> len
-    calcReadVariable(writeChunkids, lastChunkWriteLen, len, offset, readInfo);
-
-    for (auto it = readInfo.begin(); it != readInfo.end(); ++it)
+int64_t EdgeFS::read(const FileKey& key, char* buff, uint32_t len, uint64_t offset)
+{
+    if (NULL == buff)
     {
-        linfo("read chunkId %u offset %" PRIu64 " len %u", (uint32_t)(it->first/m_pFSHead->m_chunkSize), it->first,
-            it->second);
+        return -1;
     }
+    uint64_t startNs = m_pStatsMgr->beginLatency();
+    TraceSpan span(m_pTraceMgr, TraceType_READ, len);
+    PerfScope perfScope(m_pPerfCounterMgr, PerfOpType_READ);
+    SharedLockGuard lock(m_mutex);
+    int64_t realReadLen = readByKey(key.m_sha1, buff, len, offset);
+    countRead(realReadLen);
+    m_pStatsMgr->addLatency(LatencyType_READ, startNs);
+    return realReadLen;
+}
 
-    uint32_t realReadLen = 0;
-    for (auto it = readInfo.begin(); it != readInfo.end(); ++it)
+int64_t EdgeFS::readByKey(const char* sha1Val, char* buff, uint32_t len, uint64_t offset)
+{
+    if (m_pPackMgr->isEnable())
     {
-        if (!m_pDataMgr->read(buff+realReadLen, it->second, it->first))
+        PackRecord* pRecord = m_pPackMgr->find(sha1Val, NULL);
+        if (NULL != pRecord && PackRecordState_USED == pRecord->m_state)
         {
-            lerror("read failed, chunkid %u offset %" PRIu64 " readLen %u", (uint32_t)(it->first/m_pFSHead->m_chunkSize),
-                it->first, it->second);
+            return readPackFile(pRecord, buff, len, offset);
+        }
+    }
+
+    return (this->*m_pReadDataChunks)(sha1Val, buff, len, offset);
+}
+
+template<typename Geometry>
+int64_t EdgeFS::readDataChunks(const char* sha1Val, char* buff, uint32_t len, uint64_t offset)
+{
+    const Geometry geometry(m_pFSHead->m_chunkSize);
+
+    uint32_t hashKey = generateHashKey(sha1Val);
+    MetaInfo* pHeadMtInfo = calcMetaInfoPtr(hashKey);
+    FileExtentList fileExtents;
+    uint64_t fileSize = 0;
+
+    generateReadChunkids(geometry, pHeadMtInfo, sha1Val, fileExtents, fileSize);
+
+    if (fileExtents.empty())
+    {
+        lwarn("not found file");
+        return -1;
+    }
+    if (offset > fileSize)
+    {
+        lwarn("offset too large, offset %" PRIu64 " fileSize %" PRIu64, offset, fileSize);
+        return -1;
+    }
+
+    linfo("writeChunkNum %u fileSize %" PRIu64, fileExtents.size(), fileSize);
+    linfo("write chunkids : ");
+    for (uint32_t i = 0; i < fileExtents.size(); i++)
+    {
+        linfo("%d begin %" PRIu64 " len %u", fileExtents[i].m_chunkid, fileExtents[i].m_begin, fileExtents[i].m_len);
+    }
+
+    // 按照文件中的顺序保存每段需要读取的 磁盘offset -> len
+    ReadSegmentList readInfo;
+    calcReadVariable(geometry, fileExtents, len, offset, readInfo);
+
+    for (auto it = readInfo.begin(); it != readInfo.end(); ++it)
+    {
+        linfo("read chunkId %u offset %" PRIu64 " len %u", geometry.chunkid(it->m_offset), it->m_offset,
+            it->m_len);
+    }
+
+    // 大段读取时没有压缩的数据并发读取到buff中对应的位置，压缩的chunk之后依次解压
+    bool isParallel = m_pDataMgr->isParallelRead(len);
+    if (isParallel)
+    {
+        t_parallelSegments.clear();
+        uint32_t buffOffset = 0;
+        for (auto it = readInfo.begin(); it != readInfo.end(); ++it)
+        {
+            if (0 == (calcMetaInfoPtr(geometry.chunkid(it->m_offset))->m_extendArea.m_flags & MetaFlag_COMPRESSED))
+            {
+                IoSegment segment = { it->m_offset, buff + buffOffset, it->m_len, 0 };
+                t_parallelSegments.push_back(segment);
+            }
+            buffOffset += it->m_len;
+        }
+        t_parallelOks.resize(t_parallelSegments.size());
+        if (!t_parallelSegments.empty())
+        {
+            m_pDataMgr->readParallel(&t_parallelSegments[0], t_parallelSegments.size(), &t_parallelOks[0]);
+        }
+        m_parallelReadNum.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 返回从头开始连续读取成功的长度
+    uint32_t realReadLen = 0;
+    uint32_t parallelIdx = 0;
+    for (auto it = readInfo.begin(); it != readInfo.end(); ++it)
+    {
+        bool isCompressed = 0 != (calcMetaInfoPtr(geometry.chunkid(it->m_offset))->m_extendArea.m_flags &
+            MetaFlag_COMPRESSED);
+        bool isOk = isParallel && !isCompressed ? 0 != t_parallelOks[parallelIdx++] :
+            readSegment(geometry, buff + realReadLen, it->m_len, it->m_offset);
+        if (!isOk)
+        {
+            lerror("read failed, chunkid %u offset %" PRIu64 " readLen %u", geometry.chunkid(it->m_offset),
+                it->m_offset, it->m_len);
             break;
         }
-        realReadLen += it->second;
+        realReadLen += it->m_len;
     }
+
+    readaheadDataChunks(geometry, sha1Val, fileExtents, fileSize, realReadLen, offset);
     return realReadLen;
 }
 
-void EdgeFS::generateReadChunkids(const MetaInfo* pHeadMtInfo, const char* sha1Val,
-    std::vector<uint32_t>& writeChunkids, uint64_t& writeTotalLen, uint32_t& lastChunkidWriteLen)
+template<typename Geometry>
+bool EdgeFS::readSegment(const Geometry& geometry, char* buff, uint32_t len, uint64_t offset)
+{
+    // 引用节点的读取位置已经是被引用的chunk
+    uint32_t chunkid = geometry.chunkid(offset);
+    const MetaInfo* pMtInfo = calcMetaInfoPtr(chunkid);
+    if (0 == (pMtInfo->m_extendArea.m_flags & MetaFlag_COMPRESSED))
+    {
+        return m_pDataMgr->read(buff, len, offset);
+    }
+
+    // 压缩的chunk只能整体解压，读取整个chunk时直接解压到调用者的buff
+    uint64_t chunkOffset = geometry.offset(chunkid);
+    uint32_t chunkSize = geometry.chunkSize();
+    uint32_t storedLen = pMtInfo->m_extendArea.m_storedLen;
+    t_readChunkBuff.resize(std::max((size_t)chunkSize, t_readChunkBuff.size()));
+    t_readCompressBuff.resize(std::max((size_t)chunkSize, t_readCompressBuff.size()));
+    char* pRawBuff = chunkSize == len ? buff : &t_readChunkBuff[0];
+    if (!m_pDataMgr->readDirect(&t_readCompressBuff[0], storedLen, chunkOffset) ||
+        !Lz4::decompress(&t_readCompressBuff[0], storedLen, pRawBuff, chunkSize))
+    {
+        lerror("read compressed chunk failed, chunkid %u storedLen %u", chunkid, storedLen);
+        return false;
+    }
+    if (pRawBuff != buff)
+    {
+        memcpy(buff, pRawBuff + (offset - chunkOffset), len);
+    }
+    return true;
+}
+
+template<typename Geometry>
+void EdgeFS::readaheadDataChunks(const Geometry& geometry, const char* sha1Val, const FileExtentList& fileExtents,
+    uint64_t fileSize, uint32_t readLen, uint64_t offset)
+{
+    uint64_t raOffset = 0;
+    uint32_t raLen = 0;
+    if (!m_pReadaheadMgr->onRead(sha1Val, offset, readLen, fileSize, raOffset, raLen))
+    {
+        return ;
+    }
+
+    // 预读范围按照文件中的顺序转换为磁盘上的多段数据
+    ReadSegmentList raInfo;
+    calcReadVariable(geometry, fileExtents, raLen, raOffset, raInfo);
+    for (auto it = raInfo.begin(); it != raInfo.end(); ++it)
+    {
+        m_pDataMgr->readahead(it->m_len, it->m_offset);
+    }
+    linfo("readahead, offset %" PRIu64 " len %u segmentNum %u", raOffset, raLen, raInfo.size());
+}
+
+template<typename Geometry>
+void EdgeFS::generateReadChunkids(const Geometry& geometry, const MetaInfo* pHeadMtInfo, const char* sha1Val,
+    FileExtentList& fileExtents, uint64_t& fileSize)
 {
     assert(NULL != pHeadMtInfo);
     assert(NULL != sha1Val);
 
+    TraceSpan span(m_pTraceMgr, TraceType_LOOKUP);
+    fileExtents.clear();
+    fileSize = 0;
+
     if (!pHeadMtInfo->m_isUsed)
     {
-        writeChunkids.clear();
-        writeTotalLen = 0;
-        lastChunkidWriteLen = 0;
+        countLookup(1);
         return ;
     }
 
+    // 块的m_fileSize是数据在文件中的结束位置，只有先写入后面分段的文件在链表中不是按照文件中的顺序
     const MetaInfo* tmp = pHeadMtInfo;
+    uint32_t nodeNum = 0;
+    bool isSorted = true;
     while (true)
     {
-        if (0 == memcmp(tmp->m_metaData.m_sha1, sha1Val, sizeof(tmp->m_metaData.m_sha1)))
+        nodeNum++;
+        if ((ChunkType_DATA == tmp->m_chunkType || ChunkType_LINK == tmp->m_chunkType) &&
+            0 == memcmp(tmp->m_metaData.m_sha1, sha1Val, sizeof(tmp->m_metaData.m_sha1)))
         {
-            writeChunkids.push_back(calcChunkid(tmp));
-            lastChunkidWriteLen = m_pFSHead->m_chunkSize - tmp->m_idleLen;
-            writeTotalLen += lastChunkidWriteLen;
+            // 引用节点的数据从被引用的chunk读取
+            uint32_t writeLen = geometry.extentSize(tmp->m_order) - tmp->m_idleLen;
+            FileExtent extent = { tmp->m_metaData.m_fileSize - writeLen,
+                ChunkType_LINK == tmp->m_chunkType ? ((const LinkInfo*)tmp)->m_linkChunkid : calcChunkid(tmp),
+                writeLen };
+            isSorted = isSorted && tmp->m_metaData.m_fileSize > fileSize;
+            fileExtents.push_back(extent);
+            fileSize = std::max(fileSize, tmp->m_metaData.m_fileSize);
         }
         if (kInvalidChunkid == tmp->m_nextChunkid)
         {
@@ -551,58 +1291,1768 @@ void EdgeFS::generateReadChunkids(const MetaInfo* pHeadMtInfo, const char* sha1V
         }
         tmp = calcMetaInfoPtr(tmp->m_nextChunkid);
     }
+    if (!isSorted)
+    {
+        std::sort(fileExtents.begin(), fileExtents.end(),
+            [](const FileExtent& a, const FileExtent& b) { return a.m_begin < b.m_begin; });
+    }
+    countLookup(nodeNum);
+    span.setArg(nodeNum);
 }
 
-void EdgeFS::calcReadVariable(const std::vector<uint32_t>& writeChunkids, uint32_t lastChunkWriteLen,
-    uint32_t readLen, uint64_t offset, std::map<uint64_t, uint32_t>& readInfo)
+template<typename Geometry>
+void EdgeFS::calcReadVariable(const Geometry& geometry, const FileExtentList& fileExtents, uint32_t readLen,
+    uint64_t offset, ReadSegmentList& readInfo)
 {
-    const uint32_t chunkSize = m_pFSHead->m_chunkSize;
-    const uint32_t firstReadIdx = DIV_ROUND_DOWN(offset, chunkSize);
-    const uint32_t firstChunkSkipLen = offset % chunkSize;
-    uint32_t firstChunkReadLen = 0;
+    // 从offset开始依次读取，遇到空洞时停止，只返回连续的部分
+    uint64_t pos = offset;
+    uint32_t remainLen = readLen;
 
-    if (firstReadIdx + 1 == writeChunkids.size())
+    for (uint32_t idx = 0; idx < fileExtents.size() && 0 != remainLen; idx++)
     {
-        // 已经读取到最后一个chunk了
-        firstChunkReadLen = std::min(lastChunkWriteLen - firstChunkSkipLen, readLen);
-        readInfo[calcOffset(writeChunkids[firstReadIdx]) + firstChunkSkipLen] = firstChunkReadLen;
-        return ;
+        const FileExtent& extent = fileExtents[idx];
+        uint32_t chunkid = extent.m_chunkid;
+        if (extent.m_begin + extent.m_len <= pos)
+        {
+            continue;
+        }
+        if (extent.m_begin > pos)
+        {
+            break;
+        }
+        uint32_t skipLen = (uint32_t)(pos - extent.m_begin);
+        uint32_t extentReadLen = std::min(remainLen, extent.m_len - skipLen);
+        ReadSegment segment = { geometry.offset(chunkid) + skipLen, extentReadLen };
+        // 磁盘上连续的块合并为一次读取，压缩的chunk需要单独解压
+        ReadSegment* pLast = readInfo.empty() ? NULL : &readInfo[readInfo.size() - 1];
+        if (NULL != pLast && pLast->m_offset + pLast->m_len == segment.m_offset &&
+            0 == (calcMetaInfoPtr(geometry.chunkid(pLast->m_offset))->m_extendArea.m_flags & MetaFlag_COMPRESSED) &&
+            0 == (calcMetaInfoPtr(chunkid)->m_extendArea.m_flags & MetaFlag_COMPRESSED))
+        {
+            pLast->m_len += extentReadLen;
+        }
+        else
+        {
+            readInfo.push_back(segment);
+        }
+        remainLen -= extentReadLen;
+        pos += extentReadLen;
     }
-    else
+}
+
+int64_t EdgeFS::writeRange(const std::string& fileName, const char* buff, uint32_t len, uint64_t offset)
+{
+    if (NULL == buff || offset > kAppendOffset - len)
+    {
+        return -1;
+    }
+    uint64_t startNs = m_pStatsMgr->beginLatency();
+    TraceSpan span(m_pTraceMgr, TraceType_WRITE, len);
+    PerfScope perfScope(m_pPerfCounterMgr, PerfOpType_WRITE);
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    lnotice("fileName %s len %u offset %" PRIu64, fileName.c_str(), len, offset);
+
+    char sha1Val[SHA_DIGEST_LENGTH] = { '\0' };
+    {
+        TraceSpan hashSpan(m_pTraceMgr, TraceType_HASH, fileName.size());
+        ShaHelper::calcShaToHex(fileName, sha1Val);
+    }
+
+    int64_t realWriteLen = writeRangeByKey(sha1Val, buff, len, offset);
+    commitJournal(false);
+    notifyProgress(sha1Val);
+    countWrite(realWriteLen);
+    m_pStatsMgr->addLatency(LatencyType_WRITE, startNs);
+    return realWriteLen;
+}
+
+int64_t EdgeFS::writeRange(const FileKey& key, const char* buff, uint32_t len, uint64_t offset)
+{
+    if (NULL == buff || offset > kAppendOffset - len)
+    {
+        return -1;
+    }
+    uint64_t startNs = m_pStatsMgr->beginLatency();
+    TraceSpan span(m_pTraceMgr, TraceType_WRITE, len);
+    PerfScope perfScope(m_pPerfCounterMgr, PerfOpType_WRITE);
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    int64_t realWriteLen = writeRangeByKey(key.m_sha1, buff, len, offset);
+    commitJournal(false);
+    notifyProgress(key.m_sha1);
+    countWrite(realWriteLen);
+    m_pStatsMgr->addLatency(LatencyType_WRITE, startNs);
+    return realWriteLen;
+}
+
+bool EdgeFS::getMissingRanges(const std::string& fileName, uint64_t fileSize, std::vector<ByteRange>& ranges)
+{
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+    return getMissingRanges(key, fileSize, ranges);
+}
+
+bool EdgeFS::getMissingRanges(const FileKey& key, uint64_t fileSize, std::vector<ByteRange>& ranges)
+{
+    // 只查找元数据，和读取一样持有共享锁
+    SharedLockGuard lock(m_mutex);
+    ranges.clear();
+    if (NULL == m_pFSHead)
     {
-        firstChunkReadLen = std::min(chunkSize - firstChunkSkipLen, readLen);
-        readInfo[calcOffset(writeChunkids[firstReadIdx]) + firstChunkSkipLen] = firstChunkReadLen;
+        return false;
     }
 
-    uint32_t remainLen = readLen - firstChunkReadLen;
-    uint32_t needChunkNum = DIV_ROUND_UP(remainLen, chunkSize);
+    ByteRangeList fileRanges;
+    ByteRangeList missingRanges;
+    getFileRanges(key.m_sha1, fileRanges);
+    calcMissingRanges(fileRanges, 0, fileSize, missingRanges);
+    ranges.assign(missingRanges.begin(), missingRanges.end());
+    linfo("fileSize %" PRIu64 " fileRangeNum %u missingRangeNum %u", fileSize, fileRanges.size(),
+        missingRanges.size());
+    return true;
+}
 
-    for (uint32_t i = 0; i < needChunkNum; i++)
+int64_t EdgeFS::writeRangeByKey(const char* sha1Val, const char* buff, uint32_t len, uint64_t offset)
+{
+    ByteRangeList fileRanges;
+    ByteRangeList missingRanges;
+    getFileRanges(sha1Val, fileRanges);
+    calcMissingRanges(fileRanges, offset, offset + len, missingRanges);
+    uint64_t fileSize = fileRanges.empty() ? 0 : fileRanges[fileRanges.size() - 1].m_offset +
+        fileRanges[fileRanges.size() - 1].m_len;
+
+    // 只写入缺失的部分，空洞按照空洞大小分配空间
+    // 最后一段数据之后的部分按照紧接的连续数据的长度倍增，和追加写入一致，按照偏移倍增会留下大量不会被写入的空间
+    for (auto it = missingRanges.begin(); it != missingRanges.end(); ++it)
     {
-        uint32_t idx = firstReadIdx + 1 + i;
-        if (idx >= writeChunkids.size())
+        uint64_t rangeEnd = it->m_offset + it->m_len;
+        uint64_t runLen = 0;
+        for (auto rangeIt = fileRanges.begin(); rangeIt != fileRanges.end(); ++rangeIt)
         {
-            break;
+            runLen = rangeIt->m_offset + rangeIt->m_len == it->m_offset ? rangeIt->m_len : runLen;
         }
-        uint32_t chunkid = writeChunkids[idx];
+        uint64_t sizeHint = rangeEnd < fileSize ? rangeEnd : it->m_offset + std::max(runLen, it->m_len);
+        int64_t ret = writeByKey(sha1Val, buff + (it->m_offset - offset), (uint32_t)it->m_len, sizeHint, it->m_offset);
+        if (ret != (int64_t)it->m_len)
+        {
+            // 返回从offset开始连续存在的长度
+            uint64_t okLen = it->m_offset - offset + std::max(ret, (int64_t)0);
+            lwarn("write range failed, offset %" PRIu64 " len %" PRIu64 " ret %" PRId64, it->m_offset, it->m_len,
+                ret);
+            return 0 == okLen ? -1 : (int64_t)okLen;
+        }
+    }
+    return len;
+}
 
-        if (idx + 1 == writeChunkids.size())
+void EdgeFS::getFileRanges(const char* sha1Val, ByteRangeList& ranges)
+{
+    ranges.clear();
+    if (m_pPackMgr->isEnable())
+    {
+        PackRecord* pRecord = m_pPackMgr->find(sha1Val, NULL);
+        if (NULL != pRecord && PackRecordState_USED == pRecord->m_state)
         {
-            // 最后一个chunk需要读的长度
-            MetaInfo* pMtInfo = calcMetaInfoPtr(chunkid);
-            uint32_t lastChunkReadlen = std::min(remainLen % chunkSize, chunkSize - pMtInfo->m_idleLen);
-            readInfo[calcOffset(chunkid)] = lastChunkReadlen;
+            ByteRange range = { 0, pRecord->m_len };
+            ranges.push_back(range);
+            return ;
         }
-        else
+    }
+
+    // 文件的范围由每个块在文件中的位置得到，不单独存储，相邻的块合并为一段
+    const GenericGeometry geometry(m_pFSHead->m_chunkSize);
+    FileExtentList fileExtents;
+    uint64_t fileSize = 0;
+    generateReadChunkids(geometry, calcMetaInfoPtr(generateHashKey(sha1Val)), sha1Val, fileExtents, fileSize);
+    for (auto it = fileExtents.begin(); it != fileExtents.end(); ++it)
+    {
+        ByteRange* pLast = ranges.empty() ? NULL : &ranges[ranges.size() - 1];
+        if (NULL != pLast && pLast->m_offset + pLast->m_len >= it->m_begin)
         {
-            readInfo[calcOffset(chunkid)] = chunkSize;
+            pLast->m_len = std::max(pLast->m_offset + pLast->m_len, it->m_begin + it->m_len) - pLast->m_offset;
+            continue;
         }
+        ByteRange range = { it->m_begin, it->m_len };
+        ranges.push_back(range);
     }
 }
 
-void EdgeFS::printAllMetaInfo()
+void EdgeFS::calcMissingRanges(const ByteRangeList& fileRanges, uint64_t beginOffset, uint64_t endOffset,
+    ByteRangeList& ranges)
+{
+    ranges.clear();
+    uint64_t pos = beginOffset;
+    for (auto it = fileRanges.begin(); it != fileRanges.end() && pos < endOffset; ++it)
+    {
+        if (it->m_offset > pos)
+        {
+            ByteRange range = { pos, std::min(it->m_offset, endOffset) - pos };
+            ranges.push_back(range);
+        }
+        pos = std::max(pos, it->m_offset + it->m_len);
+    }
+    if (pos < endOffset)
+    {
+        ByteRange range = { pos, endOffset - pos };
+        ranges.push_back(range);
+    }
+}
+
+bool EdgeFS::markInProgress(const std::string& fileName)
+{
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    if (NULL == m_pFSHead)
+    {
+        return false;
+    }
+    lnotice("fileName %s", fileName.c_str());
+
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+    // 续传的文件已经有数据，从已有的连续长度开始
+    if (!m_pProgressMgr->begin(key.m_sha1, calcAvailLen(key.m_sha1)))
+    {
+        lwarn("file is already in progress, fileName %s", fileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool EdgeFS::complete(const std::string& fileName, uint64_t totalSize)
+{
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+    return completeByKey(fileName, key, totalSize, true);
+}
+
+bool EdgeFS::completeByKey(const std::string& fileName, const FileKey& key, uint64_t totalSize, bool isWhole)
+{
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    if (NULL == m_pFSHead)
+    {
+        return false;
+    }
+    lnotice("fileName %s totalSize %" PRIu64 " isWhole %d", fileName.c_str(), totalSize, isWhole);
+
+    uint64_t availLen = calcAvailLen(key.m_sha1);
+    if (isWhole && availLen != totalSize)
+    {
+        lwarn("complete with different size, fileName %s availLen %" PRIu64 " totalSize %" PRIu64,
+            fileName.c_str(), availLen, totalSize);
+    }
+    if (!m_pProgressMgr->complete(key.m_sha1, availLen))
+    {
+        lwarn("file is not in progress, fileName %s", fileName.c_str());
+        return false;
+    }
+
+    // 完整写入的文件记录完成的大小，重启之后读到末尾时也不再回源
+    if (isWhole && availLen == totalSize && markComplete(key.m_sha1, totalSize))
+    {
+        commitJournal(false);
+    }
+    return true;
+}
+
+bool EdgeFS::markComplete(const char* sha1Val, uint64_t totalSize)
+{
+    if (m_pPackMgr->isEnable())
+    {
+        PackRecord* pRecord = m_pPackMgr->find(sha1Val, NULL);
+        if (NULL != pRecord && PackRecordState_USED == pRecord->m_state)
+        {
+            if (pRecord->m_len != totalSize)
+            {
+                return false;
+            }
+            pRecord->m_flags |= PackFlag_COMPLETE;
+            recordIndex(pRecord, sizeof(PackRecord));
+            return true;
+        }
+    }
+
+    MetaInfo* pChainEndMtInfo = NULL;
+    MetaInfo* pEndMtInfo = NULL;
+    findTailMetaInfo(calcMetaInfoPtr(generateHashKey(sha1Val)), sha1Val, &pChainEndMtInfo, &pEndMtInfo);
+    if (NULL == pEndMtInfo || pEndMtInfo->m_metaData.m_fileSize != totalSize)
+    {
+        return false;
+    }
+    pEndMtInfo->m_extendArea.m_flags |= MetaFlag_COMPLETE;
+    recordMeta(pEndMtInfo);
+    return true;
+}
+
+bool EdgeFS::getCompleteSize(const char* sha1Val, uint64_t& totalSize)
+{
+    if (m_pPackMgr->isEnable())
+    {
+        PackRecord* pRecord = m_pPackMgr->find(sha1Val, NULL);
+        if (NULL != pRecord && PackRecordState_USED == pRecord->m_state)
+        {
+            totalSize = pRecord->m_len;
+            return 0 != (pRecord->m_flags & PackFlag_COMPLETE);
+        }
+    }
+
+    // 完成之后写入的数据会清除标记，或者写在没有标记的新的末尾块中
+    MetaInfo* pChainEndMtInfo = NULL;
+    MetaInfo* pEndMtInfo = NULL;
+    findTailMetaInfo(calcMetaInfoPtr(generateHashKey(sha1Val)), sha1Val, &pChainEndMtInfo, &pEndMtInfo);
+    if (NULL == pEndMtInfo || 0 == (pEndMtInfo->m_extendArea.m_flags & MetaFlag_COMPLETE))
+    {
+        return false;
+    }
+    totalSize = pEndMtInfo->m_metaData.m_fileSize;
+    return true;
+}
+
+int64_t EdgeFS::readWait(const std::string& fileName, char* buff, uint32_t len, uint64_t offset, uint32_t timeoutMs)
+{
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+    return readWait(key, buff, len, offset, timeoutMs);
+}
+
+int64_t EdgeFS::readWait(const FileKey& key, char* buff, uint32_t len, uint64_t offset, uint32_t timeoutMs)
+{
+    return readWaitByKey(key, buff, len, offset, timeoutMs, NULL);
+}
+
+int64_t EdgeFS::readWaitByKey(const FileKey& key, char* buff, uint32_t len, uint64_t offset, uint32_t timeoutMs,
+    bool* pIsWaited)
+{
+    if (NULL == buff)
+    {
+        return -1;
+    }
+    // 没有要读取的数据，不等待写入
+    if (0 == len)
+    {
+        return 0;
+    }
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(timeoutMs);
+    while (true)
+    {
+        // 先取写入次数再读取，读取之后的写入会让等待立即返回，不会漏掉唤醒
+        uint64_t writeNum = 0;
+        bool isInProgress = m_pProgressMgr->getWriteNum(key.m_sha1, writeNum);
+        int64_t realReadLen = read(key, buff, len, offset);
+        if (realReadLen > 0 || !isInProgress)
+        {
+            return realReadLen;
+        }
+        // 文件还不存在、offset超过已经写入的长度或者位于空洞中，等待下一次写入
+        if (NULL != pIsWaited)
+        {
+            *pIsWaited = true;
+        }
+        if (!m_pProgressMgr->wait(key.m_sha1, writeNum, deadline))
+        {
+            return kEdgeFSWaitTimeout;
+        }
+    }
+}
+
+bool EdgeFS::watch(const std::string& fileName, uint64_t offset, const ProgressCallback& callback)
+{
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    if (NULL == m_pFSHead)
+    {
+        return false;
+    }
+
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+    m_pProgressMgr->addWatcher(key.m_sha1, offset, calcAvailLen(key.m_sha1), callback);
+    return true;
+}
+
+void EdgeFS::setOriginFetcher(const OriginFetcher& fetcher)
+{
+    m_pOriginMgr->setFetcher(fetcher);
+}
+
+int64_t EdgeFS::readThrough(const std::string& fileName, char* buff, uint32_t len, uint64_t offset,
+    uint32_t timeoutMs)
+{
+    if (NULL == buff)
+    {
+        return -1;
+    }
+    FileKey key;
+    CalcFileKey(fileName.c_str(), fileName.size(), key);
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(timeoutMs);
+    bool isFetched = false;
+    while (true)
+    {
+        int64_t remainMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+            std::chrono::steady_clock::now()).count();
+        // 其他调用正在回源时等待它写入的数据，不重复回源
+        bool isWaited = false;
+        int64_t realReadLen = readWaitByKey(key, buff, len, offset, (uint32_t)std::max(remainMs, (int64_t)0),
+            &isWaited);
+        if (isWaited && realReadLen > 0)
+        {
+            m_pOriginMgr->addCoalesce();
+        }
+        if (realReadLen > 0 || kEdgeFSWaitTimeout == realReadLen || isFetched)
+        {
+            return realReadLen;
+        }
+        // 下载完成的文件读到末尾时不回源
+        bool isEnd = false;
+        {
+            SharedLockGuard lock(m_mutex);
+            uint64_t totalSize = 0;
+            isEnd = NULL != m_pFSHead && getCompleteSize(key.m_sha1, totalSize) && offset >= totalSize;
+        }
+        if (isEnd)
+        {
+            return realReadLen;
+        }
+        isFetched = true;
+        if (!fetchOrigin(fileName, key))
+        {
+            return realReadLen;
+        }
+    }
+}
+
+bool EdgeFS::fetchOrigin(const std::string& fileName, const FileKey& key)
 {
-    linfo("start");
+    OriginFetcher fetcher;
+    if (!m_pOriginMgr->getFetcher(fetcher))
+    {
+        return false;
+    }
+
+    uint64_t availLen = 0;
+    bool isEnd = false;
+    {
+        std::lock_guard<SharedMutex> lock(m_mutex);
+        if (NULL == m_pFSHead)
+        {
+            return false;
+        }
+        // 已经有调用在回源或者写入，等待它写入的数据
+        availLen = calcAvailLen(key.m_sha1);
+        if (!m_pProgressMgr->begin(key.m_sha1, availLen))
+        {
+            return true;
+        }
+        uint64_t totalSize = 0;
+        isEnd = getCompleteSize(key.m_sha1, totalSize) && availLen >= totalSize;
+    }
+
+    // 未命中之后其他调用的回源已经完成
+    if (isEnd)
+    {
+        completeByKey(fileName, key, availLen, true);
+        return true;
+    }
+
+    linfo("fetch origin, fileName %s offset %" PRIu64, fileName.c_str(), availLen);
+    uint64_t pos = availLen;
+    int64_t fetchSize = fetcher(fileName, availLen, [this, &key, &pos](const char* buff, uint32_t len)
+        {
+            if ((int64_t)len != writeRange(key, buff, len, pos))
+            {
+                return false;
+            }
+            pos += len;
+            return true;
+        });
+    m_pOriginMgr->addFetch(pos - availLen, fetchSize >= 0);
+    if (fetchSize < 0)
+    {
+        lwarn("fetch origin failed, fileName %s offset %" PRIu64 " fetchLen %" PRIu64, fileName.c_str(), availLen,
+            pos - availLen);
+    }
+    // 回源失败时不知道完整大小，只结束下载
+    completeByKey(fileName, key, fetchSize < 0 ? pos : (uint64_t)fetchSize, fetchSize >= 0);
+    return true;
+}
+
+uint64_t EdgeFS::calcAvailLen(const char* sha1Val)
+{
+    ByteRangeList fileRanges;
+    getFileRanges(sha1Val, fileRanges);
+    return fileRanges.empty() || 0 != fileRanges[0].m_offset ? 0 : fileRanges[0].m_len;
+}
+
+void EdgeFS::notifyProgress(const char* sha1Val)
+{
+    // 没有下载中的文件时不查找文件范围
+    if (m_pProgressMgr->isInProgress(sha1Val))
+    {
+        m_pProgressMgr->onWrite(sha1Val, calcAvailLen(sha1Val));
+    }
+}
+
+
+MetaInfo* EdgeFS::getPackChunk(uint32_t needLen)
+{
+    if (kInvalidChunkid != m_pFSHead->m_curPackChunkid)
+    {
+        MetaInfo* pMtInfo = calcMetaInfoPtr(m_pFSHead->m_curPackChunkid);
+        if (pMtInfo->m_idleLen >= needLen)
+        {
+            return pMtInfo;
+        }
+    }
+
+    // 当前打包chunk剩余空间不足，分配新的打包chunk，旧chunk剩余的空间只用于其中最后一个文件的追加
+    uint32_t chunkid = kInvalidChunkid;
+    if (!generateIdleExtent(0, chunkid))
+    {
+        lwarn("no idle chunk for pack");
+        return NULL;
+    }
+
+    MetaInfo* pMtInfo = calcMetaInfoPtr(chunkid);
+    m_pBitMap->insert(chunkid);
+    pMtInfo->m_isUsed = true;
+    pMtInfo->m_chunkType = ChunkType_PACK;
+    memset(pMtInfo->m_metaData.m_sha1, 0, sizeof(pMtInfo->m_metaData.m_sha1));
+    pMtInfo->m_idleLen = m_pFSHead->m_chunkSize;
+    pMtInfo->m_nextChunkid = kInvalidChunkid;
+    m_pFSHead->m_curPackChunkid = chunkid;
+    recordBitmap(chunkid);
+    recordMeta(pMtInfo);
+    recordIndex(&m_pFSHead->m_curPackChunkid, sizeof(m_pFSHead->m_curPackChunkid));
+
+    linfo("new pack chunk, chunkid %u", chunkid);
+    return pMtInfo;
+}
+
+int64_t EdgeFS::writePackFile(const char* sha1Val, PackRecord* pIdleRecord, const char* buff, uint32_t len)
+{
+    MetaInfo* pPackMtInfo = getPackChunk(len);
+    if (NULL == pPackMtInfo)
+    {
+        return -1;
+    }
+
+    uint32_t chunkid = calcChunkid(pPackMtInfo);
+    uint32_t chunkOffset = m_pFSHead->m_chunkSize - pPackMtInfo->m_idleLen;
+    uint64_t offset = calcOffset(chunkid) + chunkOffset;
+
+    linfo("pack write, chunkid %u chunkOffset %u len %u", chunkid, chunkOffset, len);
+
+    if (0 != len && !m_pDataMgr->write(buff, len, offset))
+    {
+        lerror("pack write failed, len %u offset %" PRIu64, len, offset);
+        return -1;
+    }
+    pPackMtInfo->m_idleLen -= len;
+    recordMeta(pPackMtInfo);
+
+    addPackRecord(sha1Val, pIdleRecord, chunkid, chunkOffset, len);
+    return len;
+}
+
+bool EdgeFS::isNewPackFile(const char* sha1Val, const PackRecord* pRecord, const PackRecord* pIdleRecord,
+    uint32_t len, uint64_t sizeHint)
+{
+    // 从头写入的新的小文件打包存储，已经存在于数据chunk中的文件继续写入数据chunk
+    if (NULL != pRecord || NULL == pIdleRecord || len > m_packMaxFileSize || sizeHint > m_packMaxFileSize)
+    {
+        return false;
+    }
+    MetaInfo* pChainEndMtInfo = NULL;
+    MetaInfo* pEndMtInfo = NULL;
+    MetaInfo* pHeadMtInfo = calcMetaInfoPtr(generateHashKey(sha1Val));
+    MetaInfo* pTailMtInfo = findTailMetaInfo(pHeadMtInfo, sha1Val, &pChainEndMtInfo, &pEndMtInfo);
+    return NULL == pTailMtInfo || !pTailMtInfo->m_isUsed;
+}
+
+void EdgeFS::addPackRecord(const char* sha1Val, PackRecord* pIdleRecord, uint32_t chunkid, uint32_t chunkOffset,
+    uint32_t len)
+{
+    memcpy(pIdleRecord->m_sha1, sha1Val, sizeof(pIdleRecord->m_sha1));
+    pIdleRecord->m_chunkid = chunkid;
+    pIdleRecord->m_offset = chunkOffset;
+    pIdleRecord->m_len = len;
+    pIdleRecord->m_flags = 0;
+    // 最后修改状态，记录生效
+    pIdleRecord->m_state = PackRecordState_USED;
+    recordIndex(pIdleRecord, sizeof(PackRecord));
+}
+
+int64_t EdgeFS::appendPackFile(const char* sha1Val, PackRecord* pRecord, const char* buff, uint32_t len,
+    uint64_t sizeHint, uint64_t offset)
+{
+    MetaInfo* pPackMtInfo = calcMetaInfoPtr(pRecord->m_chunkid);
+    uint32_t usedLen = m_pFSHead->m_chunkSize - pPackMtInfo->m_idleLen;
+
+    // 写入位置紧接文件末尾，文件是打包chunk中的最后一个，并且剩余空间足够，直接追加
+    if ((kAppendOffset == offset || pRecord->m_len == offset) &&
+        pRecord->m_offset + pRecord->m_len == usedLen &&
+        pRecord->m_len + len <= m_packMaxFileSize &&
+        pPackMtInfo->m_idleLen >= len)
+    {
+        uint64_t offset = calcOffset(pRecord->m_chunkid) + usedLen;
+        if (0 != len && !m_pDataMgr->write(buff, len, offset))
+        {
+            lerror("pack append failed, len %u offset %" PRIu64, len, offset);
+            return -1;
+        }
+        pPackMtInfo->m_idleLen -= len;
+        pRecord->m_len += len;
+        pRecord->m_flags &= ~PackFlag_COMPLETE;
+        recordMeta(pPackMtInfo);
+        recordIndex(pRecord, sizeof(PackRecord));
+        return len;
+    }
+
+    // 否则迁移到独占的数据chunk中，再写入新数据
+    linfo("move pack file to data chunks, chunkid %u offset %u len %u appendLen %u", pRecord->m_chunkid,
+        pRecord->m_offset, pRecord->m_len, len);
+
+    std::vector<char> packData(pRecord->m_len);
+    if (0 != pRecord->m_len)
+    {
+        if (!m_pDataMgr->read(&packData[0], pRecord->m_len, calcOffset(pRecord->m_chunkid) + pRecord->m_offset))
+        {
+            lerror("pack read failed, chunkid %u offset %u len %u", pRecord->m_chunkid, pRecord->m_offset,
+                pRecord->m_len);
+            return -1;
+        }
+        if (pRecord->m_len != (this->*m_pWriteDataChunks)(sha1Val, &packData[0], pRecord->m_len, sizeHint, 0))
+        {
+            lerror("move pack file failed, len %u", pRecord->m_len);
+            return -1;
+        }
+    }
+    pRecord->m_state = PackRecordState_MOVED;
+    recordIndex(pRecord, sizeof(PackRecord));
+
+    return (this->*m_pWriteDataChunks)(sha1Val, buff, len, sizeHint, offset);
+}
+
+MetaInfo* EdgeFS::linkDedupChunk(const char* sha1Val, const char* fingerprint, uint32_t& linkid)
+{
+    DedupRecord* pRecord = m_pDedupMgr->find(fingerprint, NULL);
+    if (NULL == pRecord)
+    {
+        return NULL;
+    }
+
+    // 引用节点用完后正常存储
+    LinkInfo* pLink = m_pDedupMgr->allocLink(linkid);
+    if (NULL == pLink)
+    {
+        lwarn("no idle dedup link");
+        return NULL;
+    }
+    pRecord->m_refCount++;
+
+    MetaInfo* pMtInfo = &pLink->m_mtInfo;
+    pMtInfo->m_isUsed = true;
+    pMtInfo->m_chunkType = ChunkType_LINK;
+    pMtInfo->m_order = 0;
+    memcpy(pMtInfo->m_metaData.m_sha1, sha1Val, sizeof(pMtInfo->m_metaData.m_sha1));
+    pMtInfo->m_idleLen = 0;
+    pMtInfo->m_nextChunkid = kInvalidChunkid;
+    pLink->m_linkChunkid = pRecord->m_chunkid;
+    recordIndex(pRecord, sizeof(DedupRecord));
+    recordIndex(pLink, sizeof(LinkInfo));
+    recordIndex(&m_pFSHead->m_usedLinkNum, sizeof(m_pFSHead->m_usedLinkNum));
+    return pMtInfo;
+}
+
+void EdgeFS::addDedupRecord(const char* fingerprint, uint32_t chunkid)
+{
+    DedupRecord* pIdleRecord = NULL;
+    if (NULL != m_pDedupMgr->find(fingerprint, &pIdleRecord) || NULL == pIdleRecord)
+    {
+        return ;
+    }
+
+    // 只有写满的chunk会被记录，之后内容不会再改变
+    memcpy(pIdleRecord->m_fingerprint, fingerprint, sizeof(pIdleRecord->m_fingerprint));
+    pIdleRecord->m_chunkid = chunkid;
+    pIdleRecord->m_refCount = 1;
+    pIdleRecord->m_state = DedupRecordState_USED;
+    recordIndex(pIdleRecord, sizeof(DedupRecord));
+}
+
+void EdgeFS::sealTailChunk(MetaInfo* pHeadMtInfo, MetaInfo* pTailMtInfo)
+{
+    uint32_t chunkid = calcChunkid(pTailMtInfo);
+    if (ChunkType_DATA != pTailMtInfo->m_chunkType ||
+        0 != pTailMtInfo->m_order ||
+        0 != (pTailMtInfo->m_extendArea.m_flags & MetaFlag_COMPRESSED))
+    {
+        return ;
+    }
+
+    uint32_t chunkSize = m_pFSHead->m_chunkSize;
+    if (!m_pDataMgr->readDirect(&m_chunkBuff[0], chunkSize, calcOffset(chunkid)))
+    {
+        lerror("seal read failed, chunkid %u", chunkid);
+        return ;
+    }
+
+    // 链表头所在的chunk和其他文件的链表入口不能释放
+    bool isDedup = m_pDedupMgr->isEnable() && pTailMtInfo != pHeadMtInfo &&
+        0 == (pTailMtInfo->m_extendArea.m_flags & MetaFlag_PINNED);
+    char fingerprint[SHA_DIGEST_LENGTH] = { '\0' };
+    if (isDedup)
+    {
+        {
+            TraceSpan hashSpan(m_pTraceMgr, TraceType_HASH, chunkSize);
+            ShaHelper::calcShaToHex(&m_chunkBuff[0], chunkSize, fingerprint);
+        }
+
+        uint32_t linkid = kInvalidChunkid;
+        MetaInfo* pLinkMtInfo = linkDedupChunk(pTailMtInfo->m_metaData.m_sha1, fingerprint, linkid);
+        if (NULL != pLinkMtInfo)
+        {
+            replaceChainNode(pHeadMtInfo, pTailMtInfo, pLinkMtInfo, linkid);
+            linfo("dedup tail chunkid %u, linkid %u linkChunkid %u", chunkid, linkid & ~kLinkChunkidFlag,
+                ((LinkInfo*)pLinkMtInfo)->m_linkChunkid);
+            return ;
+        }
+    }
+
+    // 压缩后的数据写入新的chunk再替换原来的chunk，同样不能移动链表头和其他文件的链表入口
+    if (m_isCompress && pTailMtInfo != pHeadMtInfo && !isChainEntry(chunkid, 0))
+    {
+        writeCompressedChunk(pHeadMtInfo, pTailMtInfo, &m_chunkBuff[0], chunkSize, chunkid);
+    }
+
+    // 没有相同内容的chunk，记录指纹供后续写入引用
+    if (isDedup)
+    {
+        addDedupRecord(fingerprint, chunkid);
+    }
+}
+
+void EdgeFS::replaceChainNode(MetaInfo* pHeadMtInfo, MetaInfo* pOldMtInfo, MetaInfo* pNewMtInfo, uint32_t nodeid)
+{
+    uint32_t chunkid = calcChunkid(pOldMtInfo);
+
+    // 新节点替换链表中的chunk，然后释放chunk
+    MetaInfo* pPrevMtInfo = pHeadMtInfo;
+    while (pPrevMtInfo->m_nextChunkid != chunkid)
+    {
+        pPrevMtInfo = calcMetaInfoPtr(pPrevMtInfo->m_nextChunkid);
+    }
+    pNewMtInfo->m_metaData.m_fileSize = pOldMtInfo->m_metaData.m_fileSize;
+    pNewMtInfo->m_nextChunkid = pOldMtInfo->m_nextChunkid;
+    pPrevMtInfo->m_nextChunkid = nodeid;
+    recordMeta(pNewMtInfo);
+    recordMeta(pPrevMtInfo);
+
+    // 已经提交的index可能还引用原来的chunk，日志模式下等替换提交后再释放
+    *pOldMtInfo = MetaInfo();
+    recordMeta(pOldMtInfo);
+    if (m_pIndexMgr->getJournalMgr()->isEnable())
+    {
+        m_pendingFreeChunkids.push_back(chunkid);
+    }
+    else
+    {
+        m_pBitMap->remove(chunkid);
+        recordBitmap(chunkid);
+    }
+    m_pDataMgr->trim(chunkid);
+}
+
+bool EdgeFS::compressChunk(const char* buff, uint32_t len, uint32_t& storedLen)
+{
+    // 至少节省1/8才压缩存储，否则读取时解压的开销不值得
+    storedLen = Lz4::compress(buff, len, &m_compressBuff[0], len - len / 8);
+    return 0 != storedLen;
+}
+
+bool EdgeFS::writeCompressedChunk(MetaInfo* pHeadMtInfo, MetaInfo* pMtInfo, const char* buff, uint32_t len,
+    uint32_t& chunkid)
+{
+    uint32_t storedLen = 0;
+    if (!compressChunk(buff, len, storedLen))
+    {
+        return false;
+    }
+
+    // 原来的chunk在替换生效之前保持完整，写入失败或者崩溃时文件仍然引用原始数据
+    uint32_t newChunkid = kInvalidChunkid;
+    if (!generateIdleExtent(0, newChunkid))
+    {
+        return false;
+    }
+    m_pBitMap->insert(newChunkid);
+    recordBitmap(newChunkid);
+    if (!m_pDataMgr->writeDirect(&m_compressBuff[0], storedLen, calcOffset(newChunkid)))
+    {
+        lerror("write compressed chunk failed, chunkid %u storedLen %u", newChunkid, storedLen);
+        releaseExtent(newChunkid, 0);
+        return false;
+    }
+
+    MetaInfo* pNewMtInfo = calcMetaInfoPtr(newChunkid);
+    *pNewMtInfo = *pMtInfo;
+    pNewMtInfo->m_extendArea.m_flags |= MetaFlag_COMPRESSED;
+    pNewMtInfo->m_extendArea.m_storedLen = storedLen;
+    replaceChainNode(pHeadMtInfo, pMtInfo, pNewMtInfo, newChunkid);
+    linfo("compress tail chunkid %u to chunkid %u storedLen %u", chunkid, newChunkid, storedLen);
+    chunkid = newChunkid;
+    return true;
+}
+
+int64_t EdgeFS::readPackFile(const PackRecord* pRecord, char* buff, uint32_t len, uint64_t offset)
+{
+    if (offset > pRecord->m_len)
+    {
+        lwarn("offset too large, offset %" PRIu64 " fileLen %u", offset, pRecord->m_len);
+        return -1;
+    }
+
+    uint32_t readLen = std::min((uint64_t)len, pRecord->m_len - offset);
+    uint64_t diskOffset = calcOffset(pRecord->m_chunkid) + pRecord->m_offset + offset;
+
+    linfo("pack read, chunkid %u offset %" PRIu64 " len %u", pRecord->m_chunkid, diskOffset, readLen);
+
+    if (0 != readLen && !m_pDataMgr->read(buff, readLen, diskOffset))
+    {
+        lerror("pack read failed, offset %" PRIu64 " len %u", diskOffset, readLen);
+        return -1;
+    }
+    return readLen;
+}
+
+uint32_t EdgeFS::readBatch(std::vector<ReadRequest>& reqs)
+{
+    TraceSpan span(m_pTraceMgr, TraceType_READ_BATCH, reqs.size());
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    if (NULL == m_pFSHead)
+    {
+        return 0;
+    }
+    lnotice("readBatch, reqNum %zu", reqs.size());
+
+    // 先计算所有文件的key，查找元数据时不再穿插hash计算
+    m_batchKeys.resize(reqs.size());
+    for (uint32_t i = 0; i < reqs.size(); i++)
+    {
+        TraceSpan hashSpan(m_pTraceMgr, TraceType_HASH, reqs[i].m_fileName.size());
+        CalcFileKey(reqs[i].m_fileName.c_str(), reqs[i].m_fileName.size(), m_batchKeys[i]);
+    }
+
+    // 磁盘读取只排队，最后统一按照偏移提交
+    m_pDataMgr->beginBatch(BatchMode_READ);
+    for (uint32_t i = 0; i < reqs.size(); i++)
+    {
+        m_pDataMgr->setBatchTag(i);
+        reqs[i].m_ret = NULL == reqs[i].m_buff ? -1 : readByKey(m_batchKeys[i].m_sha1, reqs[i].m_buff, reqs[i].m_len,
+            reqs[i].m_offset);
+    }
+    m_pDataMgr->endBatch(m_batchFailedIdxs);
+
+    for (auto it = m_batchFailedIdxs.begin(); it != m_batchFailedIdxs.end(); ++it)
+    {
+        lwarn("readBatch failed, fileName %s offset %" PRIu64, reqs[*it].m_fileName.c_str(), reqs[*it].m_offset);
+        reqs[*it].m_ret = -1;
+    }
+
+    uint32_t okNum = 0;
+    for (uint32_t i = 0; i < reqs.size(); i++)
+    {
+        okNum += -1 == reqs[i].m_ret ? 0 : 1;
+        countRead(reqs[i].m_ret);
+    }
+    return okNum;
+}
+
+uint32_t EdgeFS::writeBatch(std::vector<WriteRequest>& reqs)
+{
+    TraceSpan span(m_pTraceMgr, TraceType_WRITE_BATCH, reqs.size());
+    ProgressDispatch progressDispatch(m_pProgressMgr);
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    if (NULL == m_pFSHead)
+    {
+        return 0;
+    }
+    lnotice("writeBatch, reqNum %zu", reqs.size());
+
+    m_batchKeys.resize(reqs.size());
+    for (uint32_t i = 0; i < reqs.size(); i++)
+    {
+        TraceSpan hashSpan(m_pTraceMgr, TraceType_HASH, reqs[i].m_fileName.size());
+        CalcFileKey(reqs[i].m_fileName.c_str(), reqs[i].m_fileName.size(), m_batchKeys[i]);
+    }
+
+    // 新的小文件只在打包chunk中预留空间，连续的一组一起写入，写入成功后才生效
+    // 其他请求的元数据依赖之前请求的结果，先提交已经预留的文件，再按照单次写入的流程执行
+    m_packStages.clear();
+    for (uint32_t i = 0; i < reqs.size(); i++)
+    {
+        if (NULL == reqs[i].m_buff)
+        {
+            reqs[i].m_ret = -1;
+            continue;
+        }
+        if (stagePackFile(i, reqs[i]))
+        {
+            continue;
+        }
+        flushPackStages(reqs);
+        reqs[i].m_ret = writeByKey(m_batchKeys[i].m_sha1, reqs[i].m_buff, reqs[i].m_len, reqs[i].m_sizeHint,
+            kAppendOffset);
+    }
+    flushPackStages(reqs);
+    // 一批写入的修改合并为一次提交，返回时已经落盘
+    commitJournal(true);
+
+    uint32_t okNum = 0;
+    for (uint32_t i = 0; i < reqs.size(); i++)
+    {
+        okNum += -1 == reqs[i].m_ret ? 0 : 1;
+        countWrite(reqs[i].m_ret);
+        notifyProgress(m_batchKeys[i].m_sha1);
+    }
+    return okNum;
+}
+
+bool EdgeFS::stagePackFile(uint32_t reqIdx, const WriteRequest& req)
+{
+    if (!m_pPackMgr->isEnable())
+    {
+        return false;
+    }
+    const char* sha1Val = m_batchKeys[reqIdx].m_sha1;
+    PackRecord* pIdleRecord = NULL;
+    PackRecord* pRecord = m_pPackMgr->find(sha1Val, &pIdleRecord);
+    if (!isNewPackFile(sha1Val, pRecord, pIdleRecord, req.m_len, req.m_sizeHint))
+    {
+        return false;
+    }
+    // 预留的记录还没有生效，同一个空闲记录会被再次找到，包括同一个文件的后续写入
+    for (auto it = m_packStages.begin(); it != m_packStages.end(); ++it)
+    {
+        if (it->m_pRecord == pIdleRecord)
+        {
+            return false;
+        }
+    }
+
+    MetaInfo* pPackMtInfo = getPackChunk(req.m_len);
+    if (NULL == pPackMtInfo)
+    {
+        return false;
+    }
+    PackStage stage;
+    stage.m_reqIdx = reqIdx;
+    stage.m_pRecord = pIdleRecord;
+    stage.m_chunkid = calcChunkid(pPackMtInfo);
+    stage.m_chunkOffset = m_pFSHead->m_chunkSize - pPackMtInfo->m_idleLen;
+    m_packStages.push_back(stage);
+
+    // 写入失败时预留的空间不再使用，和迁移走的文件一样留在打包chunk中
+    pPackMtInfo->m_idleLen -= req.m_len;
+    recordMeta(pPackMtInfo);
+    return true;
+}
+
+void EdgeFS::flushPackStages(std::vector<WriteRequest>& reqs)
+{
+    if (m_packStages.empty())
+    {
+        return ;
+    }
+
+    // 同一个打包chunk中的文件是连续的，排序后合并为一次向量写入
+    m_pDataMgr->beginBatch(BatchMode_WRITE);
+    for (uint32_t i = 0; i < m_packStages.size(); i++)
+    {
+        const PackStage& stage = m_packStages[i];
+        WriteRequest& req = reqs[stage.m_reqIdx];
+        m_pDataMgr->setBatchTag(stage.m_reqIdx);
+        req.m_ret = req.m_len;
+        // 日志结构模式下写入不排队，直接返回结果
+        if (0 != req.m_len &&
+            !m_pDataMgr->write(req.m_buff, req.m_len, calcOffset(stage.m_chunkid) + stage.m_chunkOffset))
+        {
+            req.m_ret = -1;
+        }
+    }
+    m_pDataMgr->endBatch(m_batchFailedIdxs);
+    for (auto it = m_batchFailedIdxs.begin(); it != m_batchFailedIdxs.end(); ++it)
+    {
+        reqs[*it].m_ret = -1;
+    }
+
+    for (auto it = m_packStages.begin(); it != m_packStages.end(); ++it)
+    {
+        const WriteRequest& req = reqs[it->m_reqIdx];
+        if (-1 == req.m_ret)
+        {
+            lerror("writeBatch failed, fileName %s len %u", req.m_fileName.c_str(), req.m_len);
+            continue;
+        }
+        addPackRecord(m_batchKeys[it->m_reqIdx].m_sha1, it->m_pRecord, it->m_chunkid, it->m_chunkOffset, req.m_len);
+    }
+    m_packStages.clear();
+}
+
+bool EdgeFS::getSpaceInfo(SpaceInfo& info)
+{
+    std::lock_guard<SharedMutex> lock(m_mutex);
+    if (NULL == m_pFSHead)
+    {
+        return false;
+    }
+
+    info = SpaceInfo();
+    info.m_chunkSize = m_pFSHead->m_chunkSize;
+    info.m_chunkNum = m_pFSHead->m_chunkNum;
+
+    for (uint32_t chunkid = 0; chunkid < m_pFSHead->m_chunkNum; chunkid++)
+    {
+        MetaInfo* pMtInfo = calcMetaInfoPtr(chunkid);
+        if (!pMtInfo->m_isUsed)
+        {
+            continue;
+        }
+        info.m_usedChunkNum++;
+        if (ChunkType_PACK == pMtInfo->m_chunkType)
+        {
+            info.m_packChunkNum++;
+            continue;
+        }
+        if (ChunkType_DATA == pMtInfo->m_chunkType)
+        {
+            info.m_dataExtentNum++;
+            info.m_fileBytes += calcExtentSize(pMtInfo->m_order) - pMtInfo->m_idleLen;
+            if (0 != (pMtInfo->m_extendArea.m_flags & MetaFlag_COMPRESSED))
+            {
+                info.m_compressedChunkNum++;
+                info.m_compressedBytes += pMtInfo->m_extendArea.m_storedLen;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < m_pPackMgr->getRecordNum(); i++)
+    {
+        PackRecord* pRecord = m_pPackMgr->getRecord(i);
+        if (PackRecordState_USED != pRecord->m_state)
+        {
+            continue;
+        }
+        info.m_packFileNum++;
+        info.m_packFileBytes += pRecord->m_len;
+    }
+    info.m_fileBytes += info.m_packFileBytes;
+
+    // 引用节点都是写满的chunk
+    for (uint32_t i = 0; i < m_pDedupMgr->getUsedLinkNum(); i++)
+    {
+        if (ChunkType_LINK == calcMetaInfoPtr(i | kLinkChunkidFlag)->m_chunkType)
+        {
+            info.m_dedupChunkNum++;
+        }
+    }
+    info.m_dedupBytes = (uint64_t)info.m_dedupChunkNum * m_pFSHead->m_chunkSize;
+    info.m_fileBytes += info.m_dedupBytes;
+
+    info.m_logSegmentNum = m_pDataMgr->getLogMgr()->getSegmentNum();
+    info.m_logFreeSegmentNum = m_pDataMgr->getLogMgr()->getFreeSegmentNum();
+    info.m_hostWriteBytes = m_pDataMgr->getHostWriteBytes();
+    info.m_deviceWriteBytes = m_pDataMgr->getDeviceWriteBytes();
+    info.m_journalCommitNum = m_pIndexMgr->getJournalMgr()->getCommitNum();
+    info.m_journalBytes = m_pIndexMgr->getJournalMgr()->getJournalBytes();
+    info.m_indexSyncNum = m_pIndexMgr->getSyncNum();
+    info.m_indexSyncBytes = m_pIndexMgr->getSyncBytes();
+    scanFragments(info, NULL);
+    info.m_defragFileNum = m_defragFileNum;
+    info.m_defragBytes = m_defragBytes;
+    info.m_parallelReadNum = m_parallelReadNum;
+    return true;
+}
+
+bool EdgeFS::sync()
+{
+    uint64_t startNs = StatsMgr::nowNs();
+    TraceSpan span(m_pTraceMgr, TraceType_SYNC);
+    bool isOk = syncChanges();
+    m_pStatsMgr->addLatency(LatencyType_SYNC, startNs);
+    return isOk;
+}
+
+bool EdgeFS::getStats(StatsInfo& info)
+{
+    {
+        // 预读状态只在持有锁时修改
+        std::lock_guard<SharedMutex> lock(m_mutex);
+        if (NULL == m_pFSHead)
+        {
+            return false;
+        }
+        info.m_readaheadHitNum = m_pReadaheadMgr->getHitNum();
+        info.m_readaheadWasteNum = m_pReadaheadMgr->getWasteNum();
+    }
+    info.m_originFetchNum = m_pOriginMgr->getFetchNum();
+    info.m_originFetchBytes = m_pOriginMgr->getFetchBytes();
+    info.m_originFailNum = m_pOriginMgr->getFailNum();
+    info.m_originCoalesceNum = m_pOriginMgr->getCoalesceNum();
+
+    // 各线程的计数不加锁汇总
+    info.m_timeNs = StatsMgr::nowNs();
+    m_pStatsMgr->snapshot(info);
+    m_pPerfCounterMgr->snapshot(info);
+
+    IoStats ioStats;
+    m_pDataMgr->addIoStats(ioStats);
+    m_pIndexMgr->addIoStats(ioStats);
+    info.m_diskReadNum = ioStats.m_readNum;
+    info.m_diskReadBytes = ioStats.m_readBytes;
+    info.m_diskWriteNum = ioStats.m_writeNum;
+    info.m_diskWriteBytes = ioStats.m_writeBytes;
+    info.m_diskSyncNum = ioStats.m_syncNum;
+    return true;
+}
+
+bool EdgeFS::dumpTrace(const std::string& path)
+{
+    return m_pTraceMgr->dump(path);
+}
+
+bool EdgeFS::syncChanges()
+{
+    std::vector<IndexSpan> spans;
+    {
+        std::lock_guard<SharedMutex> lock(m_mutex);
+        if (NULL == m_pFSHead)
+        {
+            return false;
+        }
+        if (m_pIndexMgr->getJournalMgr()->isEnable())
+        {
+            return commitJournal(true);
+        }
+        // 打开的段写入数据文件后，当前被修改的页引用的数据都在数据文件中
+        if (!m_pDataMgr->flushLog())
+        {
+            return false;
+        }
+        // 写入都会修改index，没有被修改的页说明上次落盘后没有写入
+        if (!m_pIndexMgr->hasDirty())
+        {
+            return true;
+        }
+        m_pIndexMgr->takeDirtySpans(spans);
+    }
+
+    // 数据先于index落盘，落盘期间的写入重新标记修改的页，由下一次sync落盘
+    if (!m_pDataMgr->syncFile() || !syncIndexSpans(spans))
+    {
+        std::lock_guard<SharedMutex> lock(m_mutex);
+        m_pIndexMgr->restoreSpans(spans);
+        lerror("sync failed, spanNum %zu", spans.size());
+        return false;
+    }
+    ldebug("sync, spanNum %zu", spans.size());
+    return true;
+}
+
+bool EdgeFS::syncIndexSpans(const std::vector<IndexSpan>& spans)
+{
+    TraceSpan span(m_pTraceMgr, TraceType_META);
+    return m_pIndexMgr->syncSpans(spans);
+}
+
+bool EdgeFS::commitJournal(bool isForce)
+{
+    JournalMgr* pJournalMgr = m_pIndexMgr->getJournalMgr();
+    if (!pJournalMgr->isEnable() || (!isForce && !pJournalMgr->isCommitDue(m_journalCommitMs)))
+    {
+        return true;
+    }
+
+    // index引用的数据必须先落盘
+    if (pJournalMgr->hasPending() && (!m_pDataMgr->sync() || !commitJournalRanges()))
+    {
+        lerror("journal commit failed");
+        return false;
+    }
+
+    // 释放的chunk随下一次提交写入
+    releasePendingChunks();
+    return true;
+}
+
+bool EdgeFS::commitJournalRanges()
+{
+    TraceSpan span(m_pTraceMgr, TraceType_META);
+    return m_pIndexMgr->getJournalMgr()->commit();
+}
+
+void EdgeFS::releasePendingChunks()
+{
+    for (auto it = m_pendingFreeChunkids.begin(); it != m_pendingFreeChunkids.end(); ++it)
+    {
+        m_pBitMap->remove(*it);
+        recordBitmap(*it);
+    }
+    m_pendingFreeChunkids.clear();
+}
+
+void EdgeFS::reconcileBitmap()
+{
+    // 提交后释放的chunk在崩溃时可能还没有写入bitmap，没有被使用的chunk都可以释放
+    uint32_t freeNum = 0;
+    for (uint32_t chunkid = 0; chunkid < m_pFSHead->m_chunkNum; chunkid++)
+    {
+        if (m_pBitMap->isHave(chunkid) && !calcMetaInfoPtr(chunkid)->m_isUsed)
+        {
+            m_pBitMap->remove(chunkid);
+            recordBitmap(chunkid);
+            freeNum++;
+        }
+    }
+    linfo("reconcile bitmap, freeNum %u", freeNum);
+}
+
+void EdgeFS::recordIndex(const void* ptr, uint32_t len)
+{
+    m_pIndexMgr->record(ptr, len);
+}
+
+void EdgeFS::recordMeta(const MetaInfo* pMtInfo)
+{
+    recordIndex(pMtInfo, sizeof(MetaInfo));
+}
+
+void EdgeFS::recordBitmap(uint32_t chunkid)
+{
+    recordIndex((char*)m_pBitMap->getPtr() + chunkid / 8, 1);
+}
+
+void EdgeFS::startFlushThread(uint32_t intervalMs)
+{
+    if (!m_isFlushStop)
+    {
+        return ;
+    }
+    m_flushIntervalMs = intervalMs;
+    m_isFlushStop = false;
+    m_flushThread = std::thread(EdgeFS::flushThreadFunc, this);
+}
+
+void EdgeFS::stopFlushThread()
+{
+    if (m_isFlushStop)
+    {
+        return ;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_bgMutex);
+        m_isFlushStop = true;
+    }
+    m_bgCond.notify_all();
+    m_flushThread.join();
+}
+
+void EdgeFS::flushThreadFunc(EdgeFS* p)
+{
+    bool isStop = false;
+    while (!isStop)
+    {
+        {
+            std::unique_lock<std::mutex> lock(p->m_bgMutex);
+            p->m_bgCond.wait_for(lock, std::chrono::milliseconds(p->m_flushIntervalMs),
+                [p] { return (bool)p->m_isFlushStop; });
+            isStop = p->m_isFlushStop;
+        }
+
+        // 日志模式下只提交等待超时的修改，避免写入停止后最后的修改一直不提交
+        if (p->m_pIndexMgr->getJournalMgr()->isEnable())
+        {
+            std::lock_guard<SharedMutex> lock(p->m_mutex);
+            p->commitJournal(false);
+            continue;
+        }
+        p->sync();
+    }
+}
+
+uint64_t EdgeFS::defrag(uint64_t maxBytes)
+{
+    uint64_t movedBytes = 0;
+    bool isScanned = false;
+    while (movedBytes < maxBytes)
+    {
+        // 每次只迁移一个数据块，读写可以在两次迁移之间进行
+        std::lock_guard<SharedMutex> lock(m_mutex);
+        if (NULL == m_pFSHead || !isDefragEnable())
+        {
+            break;
+        }
+        if (m_defragMoveIdx < m_defragMoves.size())
+        {
+            int64_t moveLen = moveDefragExtent();
+            if (moveLen <= 0)
+            {
+                continue;
+            }
+            movedBytes += moveLen;
+            // 日志模式下原来chunk的元数据已经清空，链表头落在该chunk的文件会直接写入
+            // 在同一次加锁中提交并释放，否则提交前写入的数据会覆盖已提交的index仍然引用的内容
+            if (!commitJournal(true))
+            {
+                cancelDefrag();
+                break;
+            }
+            continue;
+        }
+        if (!m_defragFiles.empty())
+        {
+            FragmentFile file = m_defragFiles.back();
+            m_defragFiles.pop_back();
+            planDefrag(file.m_sha1);
+            continue;
+        }
+        // 一次调用只扫描一次，扫描出的文件都不能整理时直接返回
+        if (isScanned)
+        {
+            break;
+        }
+        SpaceInfo info;
+        scanFragments(info, &m_defragFiles);
+        isScanned = true;
+        linfo("defrag scan, dataFileNum %u fragmentedFileNum %u fragmentNum %u", info.m_dataFileNum,
+            info.m_fragmentedFileNum, info.m_fragmentNum);
+        if (m_defragFiles.empty())
+        {
+            break;
+        }
+    }
+    return movedBytes;
+}
+
+bool EdgeFS::isDefragEnable()
+{
+    // 去重的引用节点按chunkid引用数据，日志结构模式下chunk的物理位置由段决定
+    return !m_pDedupMgr->isEnable() && !m_pDataMgr->getLogMgr()->isEnable();
+}
+
+void EdgeFS::scanFragments(SpaceInfo& info, std::vector<FragmentFile>* pFiles)
+{
+    // 文件的链表入口是文件名hash对应的chunk，先找出所有入口
+    uint32_t chunkNum = m_pFSHead->m_chunkNum;
+    std::vector<bool> isHeads(chunkNum, false);
+    for (uint32_t chunkid = 0; chunkid < chunkNum; chunkid++)
+    {
+        const MetaInfo* pMtInfo = calcMetaInfoPtr(chunkid);
+        if (pMtInfo->m_isUsed && ChunkType_DATA == pMtInfo->m_chunkType)
+        {
+            isHeads[generateHashKey(pMtInfo->m_metaData.m_sha1)] = true;
+        }
+    }
+    for (uint32_t i = 0; i < m_pDedupMgr->getUsedLinkNum(); i++)
+    {
+        const MetaInfo* pMtInfo = calcMetaInfoPtr(i | kLinkChunkidFlag);
+        if (ChunkType_LINK == pMtInfo->m_chunkType)
+        {
+            isHeads[generateHashKey(pMtInfo->m_metaData.m_sha1)] = true;
+        }
+    }
+
+    // 从入口遍历链表时只统计从该入口进入的文件，每个文件只统计一次
+    typedef struct FileCursor_
+    {
+        const char*     m_sha1;
+        uint32_t        m_lastEnd;
+        uint32_t        m_breakNum;
+    } FileCursor;
+    for (uint32_t head = 0; head < chunkNum; head++)
+    {
+        if (!isHeads[head])
+        {
+            continue;
+        }
+        SmallVector<FileCursor, 8> cursors;
+        const MetaInfo* tmp = calcMetaInfoPtr(head);
+        while (tmp->m_isUsed)
+        {
+            if ((ChunkType_DATA == tmp->m_chunkType || ChunkType_LINK == tmp->m_chunkType) &&
+                generateHashKey(tmp->m_metaData.m_sha1) == head)
+            {
+                uint32_t start = ChunkType_LINK == tmp->m_chunkType ? ((const LinkInfo*)tmp)->m_linkChunkid :
+                    calcChunkid(tmp);
+                uint32_t idx = 0;
+                while (idx < cursors.size() &&
+                    0 != memcmp(cursors[idx].m_sha1, tmp->m_metaData.m_sha1, SHA_DIGEST_LENGTH))
+                {
+                    idx++;
+                }
+                if (idx == cursors.size())
+                {
+                    FileCursor cursor = { tmp->m_metaData.m_sha1, start, 0 };
+                    cursors.push_back(cursor);
+                }
+                if (start != cursors[idx].m_lastEnd)
+                {
+                    cursors[idx].m_breakNum++;
+                }
+                cursors[idx].m_lastEnd = start + (1u << tmp->m_order);
+            }
+            if (kInvalidChunkid == tmp->m_nextChunkid)
+            {
+                break;
+            }
+            tmp = calcMetaInfoPtr(tmp->m_nextChunkid);
+        }
+
+        for (auto it = cursors.begin(); it != cursors.end(); ++it)
+        {
+            info.m_dataFileNum++;
+            if (0 == it->m_breakNum)
+            {
+                continue;
+            }
+            info.m_fragmentedFileNum++;
+            info.m_fragmentNum += it->m_breakNum;
+            if (NULL != pFiles)
+            {
+                FragmentFile file;
+                memcpy(file.m_sha1, it->m_sha1, SHA_DIGEST_LENGTH);
+                file.m_breakNum = it->m_breakNum;
+                pFiles->push_back(file);
+            }
+        }
+    }
+
+    if (NULL != pFiles && !pFiles->empty())
+    {
+        // 只保留碎片最多的文件
+        std::sort(pFiles->begin(), pFiles->end(),
+            [](const FragmentFile& a, const FragmentFile& b) { return a.m_breakNum < b.m_breakNum; });
+        if (pFiles->size() > kDefragScanFileNum)
+        {
+            pFiles->erase(pFiles->begin(), pFiles->end() - kDefragScanFileNum);
+        }
+    }
+}
+
+bool EdgeFS::isChainEntry(uint32_t chunkid, uint8_t order)
+{
+    // 扩展块没有被链表指向，有后继时一定是其他文件的链表入口
+    for (uint32_t i = 1; i < (1u << order); i++)
+    {
+        if (kInvalidChunkid != calcMetaInfoPtr(chunkid + i)->m_nextChunkid)
+        {
+            return true;
+        }
+    }
+
+    // 其他文件的链表从该chunk进入时，该文件的块都在这个chunk之后
+    const MetaInfo* tmp = calcMetaInfoPtr(chunkid);
+    while (true)
+    {
+        if ((ChunkType_DATA == tmp->m_chunkType || ChunkType_LINK == tmp->m_chunkType) &&
+            generateHashKey(tmp->m_metaData.m_sha1) == chunkid)
+        {
+            return true;
+        }
+        if (kInvalidChunkid == tmp->m_nextChunkid)
+        {
+            break;
+        }
+        tmp = calcMetaInfoPtr(tmp->m_nextChunkid);
+    }
+    return false;
+}
+
+bool EdgeFS::planDefrag(const char* sha1Val)
+{
+    // 按照文件中的顺序收集数据块，有引用节点的文件不整理
+    ExtentList extents;
+    const MetaInfo* tmp = calcMetaInfoPtr(generateHashKey(sha1Val));
+    while (tmp->m_isUsed)
+    {
+        if ((ChunkType_DATA == tmp->m_chunkType || ChunkType_LINK == tmp->m_chunkType) &&
+            0 == memcmp(tmp->m_metaData.m_sha1, sha1Val, SHA_DIGEST_LENGTH))
+        {
+            if (ChunkType_LINK == tmp->m_chunkType)
+            {
+                return false;
+            }
+            ExtentInfo extent = { calcChunkid(tmp), tmp->m_order };
+            extents.push_back(extent);
+        }
+        if (kInvalidChunkid == tmp->m_nextChunkid)
+        {
+            break;
+        }
+        tmp = calcMetaInfoPtr(tmp->m_nextChunkid);
+    }
+
+    uint32_t breakNum = 0;
+    for (uint32_t i = 1; i < extents.size(); i++)
+    {
+        breakNum += extents[i].m_chunkid != extents[i - 1].m_chunkid + (1u << extents[i - 1].m_order) ? 1 : 0;
+    }
+    if (0 == breakNum)
+    {
+        return false;
+    }
+
+    // 数据块是随机分配的，通常没有能放下整个文件的连续空间，每次只消除一个断点
+    // 已经连续的部分记为当前段，下一段能放到当前段之后时迁移下一段，否则尝试把当前段迁移到下一段之前
+    // 第一个块通常是链表入口，不能迁移，此时当前段从下一段重新开始
+    m_defragMoves.clear();
+    m_defragMoveIdx = 0;
+    std::vector<bool> isMoved(extents.size(), false);
+    uint32_t curIdx = 0;
+    uint32_t curStart = extents[0].m_chunkid;
+    uint32_t curLen = 1u << extents[0].m_order;
+    uint32_t nextIdx = 1;
+    while (nextIdx < extents.size())
+    {
+        uint32_t endIdx = nextIdx;
+        uint32_t nextStart = extents[nextIdx].m_chunkid;
+        uint32_t nextLen = 0;
+        while (endIdx < extents.size() && extents[endIdx].m_chunkid == nextStart + nextLen)
+        {
+            nextLen += 1u << extents[endIdx].m_order;
+            endIdx++;
+        }
+
+        if (isDefragIdle(curStart + curLen, nextLen) &&
+            planDefragGroup(extents, isMoved, nextIdx, endIdx, curStart + curLen))
+        {
+            curLen += nextLen;
+        }
+        else if (nextStart >= curLen && isDefragIdle(nextStart - curLen, curLen) &&
+            planDefragGroup(extents, isMoved, curIdx, nextIdx, nextStart - curLen))
+        {
+            curStart = nextStart - curLen;
+            curLen += nextLen;
+        }
+        else
+        {
+            curIdx = nextIdx;
+            curStart = nextStart;
+            curLen = nextLen;
+        }
+        nextIdx = endIdx;
+    }
+    if (m_defragMoves.empty())
+    {
+        return false;
+    }
+    memcpy(m_defragSha1, sha1Val, SHA_DIGEST_LENGTH);
+    linfo("defrag plan, extentNum %u breakNum %u moveNum %zu", extents.size(), breakNum, m_defragMoves.size());
+    return true;
+}
+
+bool EdgeFS::isDefragIdle(uint32_t chunkid, uint32_t num)
+{
+    // 计划中的目标chunk在迁移前仍然是空闲的，不能重复使用
+    for (auto it = m_defragMoves.begin(); it != m_defragMoves.end(); ++it)
+    {
+        if (chunkid < it->m_toChunkid + (1u << it->m_order) && it->m_toChunkid < chunkid + num)
+        {
+            return false;
+        }
+    }
+    return m_pBitMap->isIdle(chunkid, num);
+}
+
+bool EdgeFS::planDefragGroup(ExtentList& extents, std::vector<bool>& isMoved, uint32_t beginIdx, uint32_t endIdx,
+    uint32_t toChunkid)
+{
+    // 迁移过的块在之前空闲的位置，不会是链表入口
+    for (uint32_t i = beginIdx; i < endIdx; i++)
+    {
+        if (!isMoved[i] && isChainEntry(extents[i].m_chunkid, extents[i].m_order))
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = beginIdx; i < endIdx; i++)
+    {
+        DefragMove move = { extents[i].m_chunkid, toChunkid, extents[i].m_order };
+        m_defragMoves.push_back(move);
+        extents[i].m_chunkid = toChunkid;
+        isMoved[i] = true;
+        toChunkid += 1u << extents[i].m_order;
+    }
+    return true;
+}
+
+int64_t EdgeFS::moveDefragExtent()
+{
+    const DefragMove& move = m_defragMoves[m_defragMoveIdx];
+
+    // 计划之后文件可能被追加、有新文件从该块进入链表或者目标chunk被写入占用，变化后放弃整理
+    MetaInfo* pFromMtInfo = calcMetaInfoPtr(move.m_fromChunkid);
+    if (!pFromMtInfo->m_isUsed || ChunkType_DATA != pFromMtInfo->m_chunkType ||
+        move.m_order != pFromMtInfo->m_order ||
+        0 != memcmp(pFromMtInfo->m_metaData.m_sha1, m_defragSha1, SHA_DIGEST_LENGTH) ||
+        isChainEntry(move.m_fromChunkid, move.m_order) || !m_pBitMap->isIdle(move.m_toChunkid, 1u << move.m_order))
+    {
+        cancelDefrag();
+        return -1;
+    }
+    MetaInfo* pPrevMtInfo = calcMetaInfoPtr(generateHashKey(m_defragSha1));
+    while (pPrevMtInfo->m_nextChunkid != move.m_fromChunkid)
+    {
+        if (kInvalidChunkid == pPrevMtInfo->m_nextChunkid)
+        {
+            cancelDefrag();
+            return -1;
+        }
+        pPrevMtInfo = calcMetaInfoPtr(pPrevMtInfo->m_nextChunkid);
+    }
+
+    for (uint32_t i = 0; i < (1u << move.m_order); i++)
+    {
+        m_pBitMap->insert(move.m_toChunkid + i);
+        recordBitmap(move.m_toChunkid + i);
+    }
+
+    // 压缩的chunk原样复制压缩后的数据
+    uint32_t chunkSize = m_pFSHead->m_chunkSize;
+    uint32_t copyLen = 0 != (pFromMtInfo->m_extendArea.m_flags & MetaFlag_COMPRESSED) ?
+        pFromMtInfo->m_extendArea.m_storedLen : calcExtentSize(move.m_order) - pFromMtInfo->m_idleLen;
+    for (uint32_t pos = 0; pos < copyLen; pos += chunkSize)
+    {
+        uint32_t pieceLen = std::min(chunkSize, copyLen - pos);
+        if (!m_pDataMgr->readDirect(&m_chunkBuff[0], pieceLen, calcOffset(move.m_fromChunkid) + pos) ||
+            !m_pDataMgr->writeDirect(&m_chunkBuff[0], pieceLen, calcOffset(move.m_toChunkid) + pos))
+        {
+            lerror("defrag copy failed, fromChunkid %u toChunkid %u", move.m_fromChunkid, move.m_toChunkid);
+            for (uint32_t i = 0; i < (1u << move.m_order); i++)
+            {
+                m_pBitMap->remove(move.m_toChunkid + i);
+                recordBitmap(move.m_toChunkid + i);
+            }
+            cancelDefrag();
+            return -1;
+        }
+    }
+
+    // 数据复制完成后再修改链表，读取看到的是迁移前或者迁移后的完整状态
+    for (uint32_t i = 1; i < (1u << move.m_order); i++)
+    {
+        MetaInfo* pExtMtInfo = calcMetaInfoPtr(move.m_toChunkid + i);
+        pExtMtInfo->m_isUsed = true;
+        pExtMtInfo->m_chunkType = ChunkType_EXTENT;
+        pExtMtInfo->m_order = 0;
+        memset(pExtMtInfo->m_metaData.m_sha1, 0, sizeof(pExtMtInfo->m_metaData.m_sha1));
+        pExtMtInfo->m_idleLen = 0;
+        pExtMtInfo->m_nextChunkid = kInvalidChunkid;
+        recordMeta(pExtMtInfo);
+    }
+    MetaInfo* pToMtInfo = calcMetaInfoPtr(move.m_toChunkid);
+    *pToMtInfo = *pFromMtInfo;
+    recordMeta(pToMtInfo);
+    pPrevMtInfo->m_nextChunkid = move.m_toChunkid;
+    recordMeta(pPrevMtInfo);
+
+    // 日志模式下原来的chunk可能还被已经提交的index引用，提交后才能重新分配
+    for (uint32_t i = 0; i < (1u << move.m_order); i++)
+    {
+        MetaInfo* pMtInfo = calcMetaInfoPtr(move.m_fromChunkid + i);
+        *pMtInfo = MetaInfo();
+        recordMeta(pMtInfo);
+        if (m_pIndexMgr->getJournalMgr()->isEnable())
+        {
+            m_pendingFreeChunkids.push_back(move.m_fromChunkid + i);
+        }
+    }
+    if (!m_pIndexMgr->getJournalMgr()->isEnable())
+    {
+        releaseExtent(move.m_fromChunkid, move.m_order);
+    }
+
+    m_defragBytes += copyLen;
+    if (++m_defragMoveIdx == m_defragMoves.size())
+    {
+        m_defragFileNum++;
+        m_defragMoves.clear();
+        m_defragMoveIdx = 0;
+        linfo("defrag file done, defragFileNum %" PRIu64, m_defragFileNum);
+    }
+    return copyLen;
+}
+
+void EdgeFS::cancelDefrag()
+{
+    if (m_defragMoveIdx < m_defragMoves.size())
+    {
+        linfo("defrag cancel, moveIdx %u moveNum %zu", m_defragMoveIdx, m_defragMoves.size());
+    }
+    m_defragMoves.clear();
+    m_defragMoveIdx = 0;
+}
+
+void EdgeFS::startDefragThread(uint32_t bytesPerSec)
+{
+    if (!m_isDefragStop)
+    {
+        return ;
+    }
+    m_defragBytesPerSec = bytesPerSec;
+    m_isDefragStop = false;
+    m_defragThread = std::thread(EdgeFS::defragThreadFunc, this);
+}
+
+void EdgeFS::stopDefragThread()
+{
+    if (m_isDefragStop)
+    {
+        return ;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_bgMutex);
+        m_isDefragStop = true;
+    }
+    m_bgCond.notify_all();
+    m_defragThread.join();
+}
+
+void EdgeFS::defragThreadFunc(EdgeFS* p)
+{
+    // 每个间隔迁移一个间隔的额度，超出额度的数据块按照限速推迟下一次整理
+    uint64_t waitMs = kDefragIntervalMs;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(p->m_bgMutex);
+            p->m_bgCond.wait_for(lock, std::chrono::milliseconds(waitMs), [p] { return (bool)p->m_isDefragStop; });
+            if (p->m_isDefragStop)
+            {
+                break;
+            }
+        }
+        uint64_t quota = std::max<uint64_t>((uint64_t)p->m_defragBytesPerSec * kDefragIntervalMs / 1000, 1);
+        uint64_t movedBytes = p->defrag(quota);
+        waitMs = 0 == movedBytes ? kDefragIdleIntervalMs :
+            std::max<uint64_t>(kDefragIntervalMs, movedBytes * 1000 / p->m_defragBytesPerSec);
+    }
+}
+
+void EdgeFS::printAllMetaInfo()
+{
+    // 遍历所有chunk的开销很大，只在debug级别输出，编译时去掉了debug日志则直接返回
+    if (EDGEFS_LOG_MIN_LEVEL > LogLevel_DEBUG || NULL == AsyncLogging::instance() ||
+        LogLevel_DEBUG != AsyncLogging::instance()->getLogLevel())
+    {
+        return ;
+    }
+
+    ldebug("start");
     for (uint32_t chunkid = 0; chunkid < m_pFSHead->m_chunkNum; chunkid++)
     {
         MetaInfo* pMtInfo = calcMetaInfoPtr(chunkid);
@@ -610,7 +3060,8 @@ void EdgeFS::printAllMetaInfo()
         {
             continue;
         }
-        linfo("chunkid %u idleLen %u nextChunkId %d", chunkid, pMtInfo->m_idleLen, pMtInfo->m_nextChunkid);
+        ldebug("chunkid %u type %u order %u idleLen %u nextChunkId %d", chunkid, pMtInfo->m_chunkType,
+            pMtInfo->m_order, pMtInfo->m_idleLen, pMtInfo->m_nextChunkid);
     }
-    linfo("end");
+    ldebug("end");
 }
@@ -3,10 +3,99 @@
 #include "DataMgr.h"
 #include "IndexMgr.h"
 #include "Bitmap.h"
+#include "PackMgr.h"
+#include "DedupMgr.h"
+#include "ReadaheadMgr.h"
+#include "StatsMgr.h"
+#include "TraceMgr.h"
+#include "PerfCounterMgr.h"
+#include "ProgressMgr.h"
+#include "OriginMgr.h"
+#include "ChunkGeometry.h"
 #include "IEdgeFS.h"
 #include "EdgeFSConst.h"
 #include "EdgeFSProtocol.h"
 
+// 一段需要读取的磁盘数据
+typedef struct ReadSegment_
+{
+    uint64_t        m_offset;
+    uint32_t        m_len;
+} ReadSegment;
+
+// 文件中的一段数据，从文件的m_begin开始，保存在m_chunkid开始的数据块中
+typedef struct FileExtent_
+{
+    uint64_t        m_begin;
+    uint32_t        m_chunkid;
+    uint32_t        m_len;
+} FileExtent;
+
+// 2^m_order个连续chunk组成的数据块
+typedef struct ExtentInfo_
+{
+    uint32_t        m_chunkid;
+    uint8_t         m_order;
+} ExtentInfo;
+
+// 一个文件的碎片情况
+typedef struct FragmentFile_
+{
+    char            m_sha1[SHA_DIGEST_LENGTH];
+    uint32_t        m_breakNum;     // 相邻数据块在磁盘上不连续的次数
+} FragmentFile;
+
+// 碎片整理中一个数据块的迁移
+typedef struct DefragMove_
+{
+    uint32_t        m_fromChunkid;
+    uint32_t        m_toChunkid;
+    uint8_t         m_order;
+} DefragMove;
+
+// 批量写入中预留了打包空间的小文件，写入成功后记录才生效
+typedef struct PackStage_
+{
+    uint32_t        m_reqIdx;
+    PackRecord*     m_pRecord;
+    uint32_t        m_chunkid;
+    uint32_t        m_chunkOffset;
+} PackStage;
+
+// index文件中各区域的大小
+typedef struct IndexLayout_
+{
+    uint32_t        m_chunkNum;
+    uint32_t        m_chunkSize;
+    uint64_t        m_diskSize;
+    uint32_t        m_bitmapSize;
+    uint32_t        m_packRecordNum;
+    uint32_t        m_dedupRecordNum;
+    uint32_t        m_dedupLinkNum;
+    uint32_t        m_logSegmentChunkNum;
+    uint32_t        m_logSegmentNum;
+    uint64_t        m_mmapSize;
+
+    IndexLayout_()
+    : m_chunkNum(0)
+    , m_chunkSize(0)
+    , m_diskSize(0)
+    , m_bitmapSize(0)
+    , m_packRecordNum(0)
+    , m_dedupRecordNum(0)
+    , m_dedupLinkNum(0)
+    , m_logSegmentChunkNum(0)
+    , m_logSegmentNum(0)
+    , m_mmapSize(0)
+    {}
+} IndexLayout;
+
+// 读写路径上使用的列表，一般情况下不申请堆内存
+typedef SmallVector<FileExtent, 32>     FileExtentList;
+typedef SmallVector<ByteRange, 16>      ByteRangeList;
+typedef SmallVector<ReadSegment, 32>    ReadSegmentList;
+typedef SmallVector<ExtentInfo, 16>     ExtentList;
+
 class EdgeFS : public IEdgeFS
 {
 public:
@@ -23,39 +112,171 @@ public:
     virtual void unitFS();
     virtual int64_t read(const std::string& fileName, char* buff, uint32_t len, uint64_t offset);
     virtual int64_t write(const std::string& fileName, const char* buff, uint32_t len);
+    virtual int64_t write(const std::string& fileName, const char* buff, uint32_t len, uint64_t sizeHint);
+    virtual int64_t read(const FileKey& key, char* buff, uint32_t len, uint64_t offset);
+    virtual int64_t write(const FileKey& key, const char* buff, uint32_t len, uint64_t sizeHint);
+    virtual int64_t writeRange(const std::string& fileName, const char* buff, uint32_t len, uint64_t offset);
+    virtual int64_t writeRange(const FileKey& key, const char* buff, uint32_t len, uint64_t offset);
+    virtual bool getMissingRanges(const std::string& fileName, uint64_t fileSize, std::vector<ByteRange>& ranges);
+    virtual bool getMissingRanges(const FileKey& key, uint64_t fileSize, std::vector<ByteRange>& ranges);
+    virtual bool markInProgress(const std::string& fileName);
+    virtual bool complete(const std::string& fileName, uint64_t totalSize);
+    virtual int64_t readWait(const std::string& fileName, char* buff, uint32_t len, uint64_t offset,
+        uint32_t timeoutMs);
+    virtual int64_t readWait(const FileKey& key, char* buff, uint32_t len, uint64_t offset, uint32_t timeoutMs);
+    virtual bool watch(const std::string& fileName, uint64_t offset, const ProgressCallback& callback);
+    virtual void setOriginFetcher(const OriginFetcher& fetcher);
+    virtual int64_t readThrough(const std::string& fileName, char* buff, uint32_t len, uint64_t offset,
+        uint32_t timeoutMs);
+    virtual bool getSpaceInfo(SpaceInfo& info);
+    virtual uint32_t readBatch(std::vector<ReadRequest>& reqs);
+    virtual uint32_t writeBatch(std::vector<WriteRequest>& reqs);
+    virtual bool sync();
+    virtual uint64_t defrag(uint64_t maxBytes);
+    virtual bool getStats(StatsInfo& info);
+    virtual bool dumpTrace(const std::string& path);
 
 private:
     // init
     bool initFSCheckParam(const SystemInfo& info);
-    bool initFSCalcVariable(const SystemInfo& info, uint32_t& chunkNum, uint32_t& chunkSize, uint64_t& diskSize,
-        uint32_t& bitmapSize, uint64_t& mmapSize);
-    bool initFSCalcPointerAddr(bool isExistsIdxFile, uint32_t chunkNum, uint32_t chunkSize, uint64_t diskSize, uint32_t bitmapSize,
-        uint64_t mmapSize);
-    bool initFSCalcPointerAddrForCreateIdxFile(uint32_t chunkNum, uint32_t chunkSize, uint64_t diskSize, uint32_t bitmapSize,
-        uint64_t mmapSize);
-    bool initFSCalcPointerAddrForReloadIdxFile(uint32_t chunkNum, uint32_t chunkSize, uint64_t diskSize, uint32_t bitmapSize,
-        uint64_t mmapSize);
+    bool initFSCalcVariable(const SystemInfo& info, IndexLayout& layout);
+    bool initFSCalcPointerAddr(bool isExistsIdxFile, const IndexLayout& layout);
+    bool initFSCalcPointerAddrForCreateIdxFile(const IndexLayout& layout);
+    bool initFSCalcPointerAddrForReloadIdxFile(const IndexLayout& layout);
+    void initFSSetPointerAddr(char* ptr, const IndexLayout& layout);
+
+    void initFSSelectGeometry(uint32_t chunkSize);
 
     // write
-    void calcWriteVariable(const MetaInfo* pTailMtInfo, uint32_t writeLen, uint32_t& firstWriteLen,
-        uint32_t& needChunkNum, uint32_t& lastChunkWriteLen);
-    MetaInfo* findTailMetaInfo(const MetaInfo* pHeadMtInfo, const char* sha1Val);
+    int64_t writeByKey(const char* sha1Val, const char* buff, uint32_t len, uint64_t sizeHint, uint64_t offset);
+    template<typename Geometry>
+    int64_t writeDataChunks(const char* sha1Val, const char* buff, uint32_t len, uint64_t sizeHint,
+        uint64_t offset);
+    void calcWriteVariable(const MetaInfo* pTailMtInfo, uint32_t writeLen, uint32_t& firstWriteLen);
+    bool allocExtents(uint64_t fileSize, uint64_t sizeHint, uint32_t remainLen, ExtentList& extents);
+    bool generateIdleExtent(uint8_t order, uint32_t& chunkid);
+    void releaseExtent(uint32_t chunkid, uint8_t order);
+    uint8_t calcExtentOrder(uint64_t fileSize, uint64_t sizeHint, uint32_t remainLen);
+    MetaInfo* findTailMetaInfo(const MetaInfo* pHeadMtInfo, const char* sha1Val, MetaInfo** pChainEndMtInfo,
+        MetaInfo** pEndMtInfo);
+    MetaInfo* findFillMetaInfo(const MetaInfo* pHeadMtInfo, const char* sha1Val, uint64_t offset);
+
+    // range
+    int64_t writeRangeByKey(const char* sha1Val, const char* buff, uint32_t len, uint64_t offset);
+    void getFileRanges(const char* sha1Val, ByteRangeList& ranges);
+    void calcMissingRanges(const ByteRangeList& fileRanges, uint64_t beginOffset, uint64_t endOffset,
+        ByteRangeList& ranges);
+
+    // progress
+    uint64_t calcAvailLen(const char* sha1Val);
+    void notifyProgress(const char* sha1Val);
+    // isWhole为false时totalSize不是完整大小，只结束下载，不记录完成
+    bool completeByKey(const std::string& fileName, const FileKey& key, uint64_t totalSize, bool isWhole);
+    // 完成的大小记录在打包记录或者文件末尾块的标记中，和index一起保存，文件长度不是totalSize时返回false
+    bool markComplete(const char* sha1Val, uint64_t totalSize);
+    bool getCompleteSize(const char* sha1Val, uint64_t& totalSize);
+    // pIsWaited不为NULL时返回是否等待过写入
+    int64_t readWaitByKey(const FileKey& key, char* buff, uint32_t len, uint64_t offset, uint32_t timeoutMs,
+        bool* pIsWaited);
+
+    // origin
+    bool fetchOrigin(const std::string& fileName, const FileKey& key);
 
     // read
-    void generateReadChunkids(const MetaInfo* pHeadMtInfo, const char* sha1Val,
-        std::vector<uint32_t>& writeChunkids, uint64_t& writeTotalLen, uint32_t& lastChunkidWriteLen);
-    void calcReadVariable(const std::vector<uint32_t>& writeChunkids, uint32_t lastChunkWriteLen,
-        uint32_t readLen, uint64_t offset, std::map<uint64_t, uint32_t>& readInfo);
+    int64_t readByKey(const char* sha1Val, char* buff, uint32_t len, uint64_t offset);
+    template<typename Geometry>
+    int64_t readDataChunks(const char* sha1Val, char* buff, uint32_t len, uint64_t offset);
+    template<typename Geometry>
+    void generateReadChunkids(const Geometry& geometry, const MetaInfo* pHeadMtInfo, const char* sha1Val,
+        FileExtentList& fileExtents, uint64_t& fileSize);
+    template<typename Geometry>
+    void calcReadVariable(const Geometry& geometry, const FileExtentList& fileExtents, uint32_t readLen,
+        uint64_t offset, ReadSegmentList& readInfo);
+    template<typename Geometry>
+    bool readSegment(const Geometry& geometry, char* buff, uint32_t len, uint64_t offset);
+    template<typename Geometry>
+    void readaheadDataChunks(const Geometry& geometry, const char* sha1Val, const FileExtentList& fileExtents,
+        uint64_t fileSize, uint32_t readLen, uint64_t offset);
+
+    // pack
+    int64_t writePackFile(const char* sha1Val, PackRecord* pIdleRecord, const char* buff, uint32_t len);
+    int64_t appendPackFile(const char* sha1Val, PackRecord* pRecord, const char* buff, uint32_t len,
+        uint64_t sizeHint, uint64_t offset);
+    int64_t readPackFile(const PackRecord* pRecord, char* buff, uint32_t len, uint64_t offset);
+    MetaInfo* getPackChunk(uint32_t needLen);
+    bool isNewPackFile(const char* sha1Val, const PackRecord* pRecord, const PackRecord* pIdleRecord, uint32_t len,
+        uint64_t sizeHint);
+    void addPackRecord(const char* sha1Val, PackRecord* pIdleRecord, uint32_t chunkid, uint32_t chunkOffset,
+        uint32_t len);
+
+    // batch
+    // 新的小文件预留打包空间后返回true，写入和生效由flushPackStages完成
+    bool stagePackFile(uint32_t reqIdx, const WriteRequest& req);
+    void flushPackStages(std::vector<WriteRequest>& reqs);
+
+    // dedup
+    MetaInfo* linkDedupChunk(const char* sha1Val, const char* fingerprint, uint32_t& linkid);
+    void addDedupRecord(const char* fingerprint, uint32_t chunkid);
+    void sealTailChunk(MetaInfo* pHeadMtInfo, MetaInfo* pTailMtInfo);
+    // 链表中的chunk替换为引用节点或者新的chunk，释放原来的chunk
+    void replaceChainNode(MetaInfo* pHeadMtInfo, MetaInfo* pOldMtInfo, MetaInfo* pNewMtInfo, uint32_t nodeid);
+
+    // compress
+    bool compressChunk(const char* buff, uint32_t len, uint32_t& storedLen);
+    // 压缩后写入新的chunk并替换链表中的pMtInfo，成功时chunkid返回新的chunk
+    bool writeCompressedChunk(MetaInfo* pHeadMtInfo, MetaInfo* pMtInfo, const char* buff, uint32_t len,
+        uint32_t& chunkid);
+
+    // journal
+    bool commitJournal(bool isForce);
+    bool commitJournalRanges();
+    void releasePendingChunks();
+    void reconcileBitmap();
+    void recordIndex(const void* ptr, uint32_t len);
+    void recordMeta(const MetaInfo* pMtInfo);
+    void recordBitmap(uint32_t chunkid);
+
+    // flush
+    void startFlushThread(uint32_t intervalMs);
+    void stopFlushThread();
+    static void flushThreadFunc(EdgeFS* p);
+    bool syncChanges();
+    bool syncIndexSpans(const std::vector<IndexSpan>& spans);
+
+    // defrag
+    bool isDefragEnable();
+    void scanFragments(SpaceInfo& info, std::vector<FragmentFile>* pFiles);
+    bool isChainEntry(uint32_t chunkid, uint8_t order);
+    bool planDefrag(const char* sha1Val);
+    bool isDefragIdle(uint32_t chunkid, uint32_t num);
+    bool planDefragGroup(ExtentList& extents, std::vector<bool>& isMoved, uint32_t beginIdx, uint32_t endIdx,
+        uint32_t toChunkid);
+    int64_t moveDefragExtent();
+    void cancelDefrag();
+    void startDefragThread(uint32_t bytesPerSec);
+    void stopDefragThread();
+    static void defragThreadFunc(EdgeFS* p);
 
     // common
     uint32_t calcChunkid(const MetaInfo* pMtInfo);
     MetaInfo* calcMetaInfoPtr(uint32_t chunkid);
     uint64_t calcOffset(uint32_t chunkid);
+    uint32_t calcExtentSize(uint8_t order);
     uint32_t generateHashKey(const char* sha1Val);
 
+    // stats
+    void countRead(int64_t ret);
+    void countWrite(int64_t ret);
+    void countLookup(uint32_t nodeNum);
+
 private:
     void printAllMetaInfo();
 
+private:
+    typedef int64_t (EdgeFS::*WriteDataChunksFunc)(const char* sha1Val, const char* buff, uint32_t len,
+        uint64_t sizeHint, uint64_t offset);
+    typedef int64_t (EdgeFS::*ReadDataChunksFunc)(const char* sha1Val, char* buff, uint32_t len, uint64_t offset);
+
 private:
     static EdgeFS*          m_pInstance;
     // mmap映射在文件中
@@ -65,4 +286,70 @@ private:
 
     DataMgr*                m_pDataMgr;
     IndexMgr*               m_pIndexMgr;
+    PackMgr*                m_pPackMgr;
+    DedupMgr*               m_pDedupMgr;
+    ReadaheadMgr*           m_pReadaheadMgr;
+    StatsMgr*               m_pStatsMgr;
+    TraceMgr*               m_pTraceMgr;
+    PerfCounterMgr*         m_pPerfCounterMgr;
+    ProgressMgr*            m_pProgressMgr;
+    OriginMgr*              m_pOriginMgr;
+
+    // 批量读写时保存所有请求的key和提交失败的请求
+    std::vector<FileKey>    m_batchKeys;
+    std::vector<uint32_t>   m_batchFailedIdxs;
+    // 批量写入中已经预留空间、还没有写入的小文件
+    std::vector<PackStage>  m_packStages;
+
+    // 读取写满的chunk计算指纹或者压缩，只在独占锁中使用
+    std::vector<char>       m_chunkBuff;
+    // 压缩后的chunk数据
+    std::vector<char>       m_compressBuff;
+    // 读取持有共享锁，多个线程同时解压时各自使用自己的缓冲
+    static thread_local std::vector<char>   t_readChunkBuff;
+    static thread_local std::vector<char>   t_readCompressBuff;
+    // 并发读取的数据段和每段是否读取成功，每个读取线程保留自己的容量
+    static thread_local std::vector<IoSegment>  t_parallelSegments;
+    static thread_local std::vector<uint8_t>    t_parallelOks;
+
+    std::atomic<uint64_t>   m_parallelReadNum;
+
+    // 日志模式下被释放的chunk，已经提交的index可能还引用它们，提交后才能重新分配
+    std::vector<uint32_t>   m_pendingFreeChunkids;
+
+    uint32_t                m_packMaxFileSize;
+    uint8_t                 m_maxExtentOrder;
+    bool                    m_isCompress;
+    uint32_t                m_journalCommitMs;
+
+    // 保护所有对外接口，后台线程和调用者并发访问
+    // read和getMissingRanges只查找元数据和读取数据，持有共享锁，多个读取的磁盘IO可以同时进行
+    // 其他接口和后台线程持有独占锁
+    SharedMutex             m_mutex;
+
+    // 后台线程等待间隔和停止通知
+    std::mutex              m_bgMutex;
+    std::condition_variable m_bgCond;
+
+    // 后台落盘线程
+    std::atomic<bool>       m_isFlushStop;
+    uint32_t                m_flushIntervalMs;
+    std::thread             m_flushThread;
+
+    // 碎片整理，待整理的文件按照碎片数从小到大排列，从末尾取出
+    std::vector<FragmentFile>   m_defragFiles;
+    std::vector<DefragMove>     m_defragMoves;
+    uint32_t                    m_defragMoveIdx;
+    char                        m_defragSha1[SHA_DIGEST_LENGTH];
+    uint64_t                    m_defragFileNum;
+    uint64_t                    m_defragBytes;
+
+    // 后台碎片整理线程
+    std::atomic<bool>       m_isDefragStop;
+    uint32_t                m_defragBytesPerSec;
+    std::thread             m_defragThread;
+
+    // 按照chunk大小选择的读写实现
+    WriteDataChunksFunc     m_pWriteDataChunks;
+    ReadDataChunksFunc      m_pReadDataChunks;
 };
\ No newline at end of file
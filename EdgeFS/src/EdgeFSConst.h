@@ -4,6 +4,11 @@
 
 const std::string kEdgeFSMagic = "edgefs";
 
+// index文件格式的版本，index中结构体的布局或者字段含义变化时增加，和已有index文件不一致时拒绝加载
+// 1: 加入小文件打包记录、去重、压缩、日志结构和修改日志之后的格式
+// 2: 打包记录加入m_flags，记录文件下载完成
+const uint32_t kEdgeFSVersion = 2;
+
 const uint32_t kInvalidChunkid = -1;
 
 const std::string kDataFileName = "edgefs.data";
@@ -12,10 +17,60 @@ const std::string kIndexFileName = "edgefs.idx";
 
 const std::string kLogFileName = "edgefs.log";
 
+const std::string kBinaryLogFileName = "edgefs.blog";
+
+const std::string kJournalFileName = "edgefs.journal";
+
+const std::string kSlowTraceFileName = "edgefs_slow_trace.json";
+
+// 写入位置为文件末尾，即已有数据的最大偏移
+const uint64_t kAppendOffset = UINT64_MAX;
+
 //const uint32_t kMinChunkSize = 1024 * 1024;
 const uint32_t kMinChunkSize = 1024;
 
 const uint32_t kMaxChunkSize = 128 * 1024 * 1024;
 
+// 一个数据块最多由 2^kMaxExtentOrder 个连续chunk组成，且总大小不超过kMaxChunkSize
+const uint8_t kMaxExtentOrder = 10;
+
+// 链表中带有该标记的id表示引用节点池中的节点，chunk个数不会达到该值
+const uint32_t kLinkChunkidFlag = 0x80000000;
+
+// 顺序读的初始预读窗口
+const uint32_t kReadaheadMinSize = 64 * 1024;
+
+// 单次读取达到该长度时并发读取，按照参与读取的线程数平均拆分，每段不小于kParallelReadPieceSize
+const uint32_t kParallelReadMinSize = 1024 * 1024;
+const uint32_t kParallelReadPieceSize = 1024 * 1024;
+
+// 日志结构模式下打开新段后至少保留的空闲段，保证清理时有位置迁移有效数据
+const uint32_t kLogMinFreeSegmentNum = 2;
+
+// 日志结构模式下为清理预留的空间比例
+const uint32_t kLogReservePercent = 10;
+
+// 空闲段不足预留个数时，只清理有效数据低于该比例的段
+const uint32_t kLogCleanLivePercent = 50;
+
+// index修改日志中每次提交的标记
+const uint32_t kJournalMagic = 0x4A534645;
+
+// 修改日志超过该大小后，index文件落盘并清空日志
+const uint64_t kJournalCheckpointSize = 16 * 1024 * 1024;
+
+// index落盘时间隔不超过该页数的被修改的页合并为一段回写
+const uint64_t kIndexSyncGapPages = 16;
+
+// 碎片整理每次扫描后从碎片最多的这些文件中依次整理
+const uint32_t kDefragScanFileNum = 64;
+
+// 后台碎片整理的间隔，没有可以整理的文件时等待更久
+const uint32_t kDefragIntervalMs = 100;
+const uint32_t kDefragIdleIntervalMs = 10000;
+
+// 慢操作触发的追踪导出最多每隔这么久一次，避免持续变慢时反复写文件
+const uint32_t kSlowTraceIntervalMs = 1000;
+
 // 磁盘操作比较按照4K对齐
 const uint32_t kDiskRWAlignSize = 4096;
\ No newline at end of file
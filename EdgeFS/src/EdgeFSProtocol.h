@@ -8,18 +8,34 @@
 typedef struct EdgeFSHead_
 {
     char            m_magic[12];
+    uint32_t        m_version;              // index文件格式版本，kEdgeFSVersion
     uint64_t        m_coverableDiskSize;    // 有限的内存可以覆盖的磁盘大小
     uint64_t        m_usableMemory;         // fs需要使用的内存
     uint32_t        m_chunkSize;            // 每个chunk块的大小
     uint32_t        m_chunkNum;             // chunk块的个数
     uint32_t        m_bitmapSize;           // bitmap占用的字节数
+    uint32_t        m_packRecordNum;        // 小文件打包记录的个数
+    uint32_t        m_curPackChunkid;       // 当前用于追加小文件的打包chunk
+    uint32_t        m_dedupRecordNum;       // 去重指纹记录的个数
+    uint32_t        m_dedupLinkNum;         // 去重引用节点的个数
+    uint32_t        m_usedLinkNum;          // 已经分配的引用节点个数
+    uint32_t        m_logSegmentChunkNum;   // 日志结构模式下每个段的chunk个数
+    uint32_t        m_logSegmentNum;        // 日志结构模式下段的个数，0表示原地写入
 
     EdgeFSHead_()
-    : m_coverableDiskSize(0)
+    : m_version(0)
+    , m_coverableDiskSize(0)
     , m_usableMemory(0)
     , m_chunkSize(0)
     , m_chunkNum(0)
     , m_bitmapSize(0)
+    , m_packRecordNum(0)
+    , m_curPackChunkid(kInvalidChunkid)
+    , m_dedupRecordNum(0)
+    , m_dedupLinkNum(0)
+    , m_usedLinkNum(0)
+    , m_logSegmentChunkNum(0)
+    , m_logSegmentNum(0)
     {
         memset(m_magic, 0, sizeof(m_magic));
     }
@@ -33,7 +49,7 @@ typedef struct MetaData_
     */
 
     char        m_sha1[SHA_DIGEST_LENGTH];
-    uint64_t    m_fileSize;     // TODO暂时未使用
+    uint64_t    m_fileSize;
     uint32_t    m_crc32;        // TODO暂时未使用
 
     MetaData_()
@@ -44,24 +60,43 @@ typedef struct MetaData_
     }
 } MetaData;
 
+enum MetaFlag
+{
+    MetaFlag_PINNED = 0x01,     // chunk是其他文件链表的入口，不能被释放
+    MetaFlag_COMPRESSED = 0x02, // chunk中的数据是压缩后的，长度为m_storedLen
+    MetaFlag_COMPLETE = 0x04,   // 文件下载完成，只标记在文件末尾的块上，完整大小为该块的m_fileSize
+};
+
 // 最大不超过8KB
 typedef struct ExtendArea_
 {
-    /*
-    暂时未使用
-    */
-   ExtendArea_()
-   {}
+    uint8_t     m_flags;        // MetaFlag，原来空结构体占用的1个字节
+    uint32_t    m_storedLen;    // 压缩后存储在磁盘上的长度
+
+    ExtendArea_()
+    : m_flags(0)
+    , m_storedLen(0)
+    {}
 } ExtendArea;
 
+enum ChunkType
+{
+    ChunkType_DATA = 0,     // 单个文件独占的数据chunk
+    ChunkType_PACK = 1,     // 多个小文件共享的打包chunk
+    ChunkType_EXTENT = 2,   // 属于前面某个数据chunk的连续扩展块，不单独存储数据信息
+    ChunkType_LINK = 3,     // 去重引用节点，数据存储在其他文件的chunk中，只存在于引用节点池
+};
+
 typedef struct MetaInfo_
 {
     bool            m_isUsed;   // 是否被占用
+    uint8_t         m_chunkType;    // ChunkType
+    uint8_t         m_order;        // 数据块由 2^m_order 个连续的chunk组成
 
     // 整个文件的信息，存储该文件的每个chunk块应该一致
     MetaData        m_metaData;
 
-    // 当前chunk块的信息
+    // 当前chunk块的信息，m_metaData.m_fileSize为文件到当前块为止的长度
     uint32_t                m_idleLen;     // chunk空闲的长度
 
     // 下一个chunk块的信息
@@ -72,6 +107,8 @@ typedef struct MetaInfo_
 
     MetaInfo_()
     : m_isUsed(false)
+    , m_chunkType(ChunkType_DATA)
+    , m_order(0)
     , m_idleLen(0)
     , m_nextChunkid(kInvalidChunkid)
     {}
@@ -81,6 +118,8 @@ typedef struct MetaInfo_
         std::stringstream ss;
 
         ss << "used " << m_isUsed
+            << " type " << (uint32_t)m_chunkType
+            << " order " << (uint32_t)m_order
             //<< " sha1 " << m_metaData.m_sha1
             //<< " fileSize " << m_metaData.m_fileSize
             << " idleLen " << m_idleLen
@@ -90,5 +129,103 @@ typedef struct MetaInfo_
     }
 } MetaInfo;
 
+enum PackRecordState
+{
+    PackRecordState_IDLE = 0,       // 空闲
+    PackRecordState_USED = 1,       // 文件打包存储在chunk中
+    PackRecordState_MOVED = 2,      // 文件变大后已经迁移到独占的数据chunk
+};
+
+enum PackFlag
+{
+    PackFlag_COMPLETE = 0x01,       // 文件下载完成，m_len为完整大小
+};
+
+// 小文件打包记录，通过(chunkid, offset, len)定位文件数据
+typedef struct PackRecord_
+{
+    char            m_sha1[SHA_DIGEST_LENGTH];
+    uint8_t         m_state;        // PackRecordState
+    uint32_t        m_chunkid;      // 所在的打包chunk
+    uint32_t        m_offset;       // 在chunk内的偏移
+    uint32_t        m_len;          // 文件长度
+    uint8_t         m_flags;        // PackFlag
+
+    PackRecord_()
+    : m_state(PackRecordState_IDLE)
+    , m_chunkid(kInvalidChunkid)
+    , m_offset(0)
+    , m_len(0)
+    , m_flags(0)
+    {
+        memset(m_sha1, 0, sizeof(m_sha1));
+    }
+} PackRecord;
+
+enum DedupRecordState
+{
+    DedupRecordState_IDLE = 0,      // 空闲
+    DedupRecordState_USED = 1,      // 指纹对应的chunk可以被引用
+};
+
+// 写满的chunk的内容指纹 -> chunk
+typedef struct DedupRecord_
+{
+    char            m_fingerprint[SHA_DIGEST_LENGTH];
+    uint8_t         m_state;        // DedupRecordState
+    uint32_t        m_chunkid;      // 存储数据的chunk
+    uint32_t        m_refCount;     // 引用该chunk的文件块个数，包括chunk本身所属的文件
+
+    DedupRecord_()
+    : m_state(DedupRecordState_IDLE)
+    , m_chunkid(kInvalidChunkid)
+    , m_refCount(0)
+    {
+        memset(m_fingerprint, 0, sizeof(m_fingerprint));
+    }
+} DedupRecord;
+
+// 引用节点，作为文件链表中的一个满chunk，数据从m_linkChunkid读取
+// m_mtInfo必须是第一个成员，链表中通过MetaInfo指针访问
+typedef struct LinkInfo_
+{
+    MetaInfo        m_mtInfo;
+    uint32_t        m_linkChunkid;
+
+    LinkInfo_()
+    : m_linkChunkid(kInvalidChunkid)
+    {}
+} LinkInfo;
+
+// index修改日志中的一次提交，后面跟随m_entryNum个JournalEntry，每个entry后面是修改后的数据
+typedef struct JournalGroup_
+{
+    uint32_t        m_magic;
+    uint32_t        m_entryNum;
+    uint64_t        m_seq;          // 提交的序号，日志中的提交序号连续
+    uint32_t        m_len;          // 后面所有entry和数据的总长度
+    uint32_t        m_checksum;     // 后面所有entry和数据的crc32，不完整的提交重放时丢弃
+
+    JournalGroup_()
+    : m_magic(kJournalMagic)
+    , m_entryNum(0)
+    , m_seq(0)
+    , m_len(0)
+    , m_checksum(0)
+    {}
+} JournalGroup;
+
+// index文件中一段连续的修改
+typedef struct JournalEntry_
+{
+    uint64_t        m_offset;       // 在index文件中的偏移
+    uint32_t        m_len;
+
+    JournalEntry_()
+    : m_offset(0)
+    , m_len(0)
+    {}
+} JournalEntry;
+
 #pragma pack()
 
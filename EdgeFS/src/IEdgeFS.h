@@ -2,19 +2,318 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
+#include <functional>
 
 typedef struct SystemInfo_
 {
     uint64_t        m_diskCapacity;
     std::string     m_diskRootDir;
     uint64_t        m_edgeFSUsableMemory;
+    bool            m_isPow2ChunkSize;      // chunk大小向上取整到2的幂，读写中的位置计算用移位代替乘除，chunk个数最多减少一半，已有的index必须使用相同的设置
+    uint32_t        m_packMaxFileSize;      // 不超过该大小的新文件打包存储，0表示不打包
+    uint32_t        m_packRecordNum;        // 打包记录的个数，即最多可以打包存储的小文件个数
+    uint8_t         m_maxExtentOrder;       // 文件变大后一次最多分配 2^m_maxExtentOrder 个连续chunk，0表示按chunk分配
+    uint32_t        m_readaheadMaxSize;     // 顺序读时最大的预读窗口，0表示不预读
+    uint32_t        m_dedupRecordNum;       // 去重指纹记录的个数，即最多可以被引用的chunk个数，0表示不去重
+    uint32_t        m_dedupLinkNum;         // 去重引用节点的个数，即最多可以省去的chunk个数，0表示不去重
+    bool            m_isCompress;           // 写满的chunk压缩后存储，压缩率不足的chunk保持原样，读取压缩的chunk中任意一段都要解压整个chunk，小段随机读的吞吐会大幅下降
+    uint32_t        m_logSegmentSize;       // 日志结构模式的段大小，写入在内存中凑满整段后顺序写入磁盘，0表示原地写入
+    bool            m_isJournal;            // index的修改先写入日志再更新index文件，掉电后重启时恢复到最后一次提交，不能和日志结构模式同时使用
+    uint32_t        m_journalCommitMs;      // 日志模式下写入后最多等待多久提交，期间的修改合并为一次提交，0表示每次写入都提交
+    uint32_t        m_flushIntervalMs;      // 后台线程定期落盘的间隔，日志模式下提交到期的修改，否则同sync()，0表示不启动后台线程
+    uint32_t        m_defragBytesPerSec;    // 后台碎片整理每秒最多迁移的字节数，0表示不启动后台整理，去重和日志结构模式下不整理
+    uint32_t        m_readThreadNum;        // 大段读取时并发读取的线程个数，调用线程也参与读取，0表示不并发读取
+    uint32_t        m_traceEventNum;        // 每个线程保留最近的追踪事件个数，0表示不追踪
+    uint32_t        m_traceSlowUs;          // 读写或落盘超过该耗时时把最近的事件导出到diskRootDir下，最多每秒一次，0表示不自动导出
+    bool            m_isPerfCounter;        // 统计读写调用期间的cpu周期、指令和缓存、TLB未命中，每次调用增加几次系统调用
+    bool            m_isBinaryLog;          // 日志以二进制写到diskRootDir下的edgefs.blog，调用线程不格式化，用edgefs_logdecode转换为文本
     
     SystemInfo_()
     : m_diskCapacity(0)
     , m_edgeFSUsableMemory(0)
+    , m_isPow2ChunkSize(false)
+    , m_packMaxFileSize(0)
+    , m_packRecordNum(0)
+    , m_maxExtentOrder(10)
+    , m_readaheadMaxSize(1024 * 1024)
+    , m_dedupRecordNum(0)
+    , m_dedupLinkNum(0)
+    , m_isCompress(false)
+    , m_logSegmentSize(0)
+    , m_isJournal(false)
+    , m_journalCommitMs(10)
+    , m_flushIntervalMs(0)
+    , m_defragBytesPerSec(0)
+    , m_readThreadNum(0)
+    , m_traceEventNum(0)
+    , m_traceSlowUs(0)
+    , m_isPerfCounter(false)
+    , m_isBinaryLog(false)
     {}
 } SystemInfo;
 
+typedef struct SpaceInfo_
+{
+    uint32_t        m_chunkSize;
+    uint32_t        m_chunkNum;
+    uint32_t        m_usedChunkNum;         // 已占用的chunk个数，包括打包chunk
+    uint32_t        m_packChunkNum;         // 打包chunk的个数
+    uint32_t        m_packFileNum;          // 打包存储的小文件个数
+    uint32_t        m_dataExtentNum;        // 数据块的个数，即文件占用的元数据条数
+    uint64_t        m_fileBytes;            // 所有文件的有效数据字节数
+    uint64_t        m_packFileBytes;        // 打包存储的小文件的有效数据字节数
+    uint32_t        m_dedupChunkNum;        // 引用其他chunk而没有实际存储的chunk个数
+    uint64_t        m_dedupBytes;           // 去重省去的字节数，已经包含在m_fileBytes中
+    uint32_t        m_compressedChunkNum;   // 压缩存储的chunk个数
+    uint64_t        m_compressedBytes;      // 压缩存储的chunk压缩后的字节数，压缩前为 m_compressedChunkNum * m_chunkSize
+    uint32_t        m_logSegmentNum;        // 日志结构模式的段个数
+    uint32_t        m_logFreeSegmentNum;    // 没有有效数据的段个数
+    uint64_t        m_hostWriteBytes;       // 启动以来写入数据文件的字节数
+    uint64_t        m_deviceWriteBytes;     // 启动以来实际写入磁盘的字节数，包括日志结构模式下迁移和清理的数据
+    uint64_t        m_journalCommitNum;     // 启动以来index修改日志的提交次数
+    uint64_t        m_journalBytes;         // 启动以来写入index修改日志的字节数
+    uint64_t        m_indexSyncNum;         // 启动以来index文件按修改范围落盘的次数
+    uint64_t        m_indexSyncBytes;       // 启动以来index文件落盘的被修改的页的字节数
+    uint32_t        m_dataFileNum;          // 存储在数据chunk中的文件个数
+    uint32_t        m_fragmentedFileNum;    // 相邻数据块在磁盘上不连续的文件个数
+    uint32_t        m_fragmentNum;          // 所有文件中相邻数据块不连续的次数，完全连续时为0
+    uint64_t        m_defragFileNum;        // 启动以来完成的整理次数，碎片较多的文件可能经过多次整理
+    uint64_t        m_defragBytes;          // 启动以来碎片整理迁移的字节数
+    uint64_t        m_parallelReadNum;      // 启动以来并发读取的次数
+
+    SpaceInfo_()
+    : m_chunkSize(0)
+    , m_chunkNum(0)
+    , m_usedChunkNum(0)
+    , m_packChunkNum(0)
+    , m_packFileNum(0)
+    , m_dataExtentNum(0)
+    , m_fileBytes(0)
+    , m_packFileBytes(0)
+    , m_dedupChunkNum(0)
+    , m_dedupBytes(0)
+    , m_compressedChunkNum(0)
+    , m_compressedBytes(0)
+    , m_logSegmentNum(0)
+    , m_logFreeSegmentNum(0)
+    , m_hostWriteBytes(0)
+    , m_deviceWriteBytes(0)
+    , m_journalCommitNum(0)
+    , m_journalBytes(0)
+    , m_indexSyncNum(0)
+    , m_indexSyncBytes(0)
+    , m_dataFileNum(0)
+    , m_fragmentedFileNum(0)
+    , m_fragmentNum(0)
+    , m_defragFileNum(0)
+    , m_defragBytes(0)
+    , m_parallelReadNum(0)
+    {}
+} SpaceInfo;
+
+// 延迟分布，按照最高位分组，每组再等分为16个桶，统计值的相对误差不超过1/16
+typedef struct LatencyHistogram_
+{
+    static const uint32_t   kSubBucketBits = 4;
+    static const uint32_t   kSubBucketNum = 1u << kSubBucketBits;
+    static const uint32_t   kMaxBit = 40;       // 超过2^41ns(约36分钟)的值计入最后一个桶
+    static const uint32_t   kBucketNum = (kMaxBit - kSubBucketBits + 2) * kSubBucketNum;
+
+    uint64_t        m_count;
+    uint64_t        m_sumNs;
+    uint64_t        m_buckets[kBucketNum];
+
+    LatencyHistogram_()
+    : m_count(0)
+    , m_sumNs(0)
+    , m_buckets()
+    {}
+
+    static uint32_t bucketIdx(uint64_t ns)
+    {
+        if (ns < kSubBucketNum)
+        {
+            return (uint32_t)ns;
+        }
+        uint32_t bit = 63 - __builtin_clzll(ns);
+        if (bit > kMaxBit)
+        {
+            return kBucketNum - 1;
+        }
+        uint32_t sub = (uint32_t)(ns >> (bit - kSubBucketBits)) & (kSubBucketNum - 1);
+        return (bit - kSubBucketBits + 1) * kSubBucketNum + sub;
+    }
+
+    // 桶内的最大值
+    static uint64_t bucketMaxNs(uint32_t idx);
+
+    // percent取值0~100，返回不小于该比例样本的最小桶上限，没有样本时返回0
+    uint64_t percentile(double percent) const;
+
+    uint64_t averageNs() const
+    {
+        return 0 == m_count ? 0 : m_sumNs / m_count;
+    }
+
+    void subtract(const LatencyHistogram_& prev);
+} LatencyHistogram;
+
+typedef enum PerfMode_
+{
+    PerfMode_NONE = 0,          // 没有开启
+    PerfMode_HARDWARE,          // perf_event_open硬件计数，PerfCounterInfo所有字段有效
+    PerfMode_SOFTWARE,          // 内核不允许硬件计数，只有perf_event_open软件计数
+    PerfMode_RUSAGE,            // perf_event_open不可用，使用线程cpu时间和getrusage
+} PerfMode;
+
+// 一类调用期间调用线程的性能计数累计值，除以m_callNum为单次调用的平均值
+typedef struct PerfCounterInfo_
+{
+    uint64_t        m_callNum;              // 成功计数的调用次数，批量读写不计数
+    uint64_t        m_cycles;               // 以下四个只在PerfMode_HARDWARE时有效
+    uint64_t        m_instructions;
+    uint64_t        m_llcMisses;            // 最后一级缓存的读取未命中
+    uint64_t        m_dtlbMisses;           // 数据TLB的读取未命中
+    uint64_t        m_taskClockNs;          // 调用线程占用cpu的时间
+    uint64_t        m_pageFaults;
+    uint64_t        m_contextSwitches;
+
+    PerfCounterInfo_()
+    : m_callNum(0)
+    , m_cycles(0)
+    , m_instructions(0)
+    , m_llcMisses(0)
+    , m_dtlbMisses(0)
+    , m_taskClockNs(0)
+    , m_pageFaults(0)
+    , m_contextSwitches(0)
+    {}
+
+    void subtract(const PerfCounterInfo_& prev);
+} PerfCounterInfo;
+
+// 启动以来的累计统计，每个线程单独计数，获取时汇总，读写路径上不加锁
+// 定期获取时用本次的快照减去上次的快照得到区间内的增量
+typedef struct StatsInfo_
+{
+    uint64_t        m_timeNs;               // 获取快照的单调时钟时间，相减后为区间长度
+    uint64_t        m_readNum;              // 读取调用次数，包括批量读取中的每个请求
+    uint64_t        m_readBytes;            // 读取成功的字节数
+    uint64_t        m_readFailNum;          // 返回-1的读取次数
+    uint64_t        m_writeNum;             // 写入调用次数，包括批量写入中的每个请求
+    uint64_t        m_writeBytes;           // 写入成功的字节数
+    uint64_t        m_writeFailNum;         // 返回-1的写入次数
+    uint64_t        m_lookupNum;            // 在hash链中查找文件的次数
+    uint64_t        m_lookupNodeNum;        // 查找时遍历的节点数，除以m_lookupNum为平均链长
+    uint64_t        m_allocNum;             // 在bitmap中查找连续空闲空间的次数
+    uint64_t        m_allocScanNum;         // 查找时检查的候选位置个数，除以m_allocNum为平均扫描长度
+    uint64_t        m_diskReadNum;          // 数据、index和日志文件的读取系统调用次数
+    uint64_t        m_diskReadBytes;
+    uint64_t        m_diskWriteNum;         // 写入系统调用次数
+    uint64_t        m_diskWriteBytes;
+    uint64_t        m_diskSyncNum;          // 落盘系统调用次数，包括index按范围回写
+    uint64_t        m_readaheadHitNum;      // 读取完全落在预读范围内的次数
+    uint64_t        m_readaheadWasteNum;    // 预读的数据没有被读取就中断的次数
+    uint64_t        m_originFetchNum;       // readThrough发起的回源次数
+    uint64_t        m_originFetchBytes;     // 回源写入的字节数
+    uint64_t        m_originFailNum;        // 回源失败的次数
+    uint64_t        m_originCoalesceNum;    // 等待其他调用回源写入的数据后读到数据，没有重复回源的readThrough次数
+    LatencyHistogram    m_readLatency;      // 单个读取调用的延迟，包括等锁时间，每个线程每16次调用采样一次，批量读写不采样
+    LatencyHistogram    m_writeLatency;
+    LatencyHistogram    m_syncLatency;      // 每次落盘都记录
+    uint32_t            m_perfMode;         // PerfMode，开启SystemInfo::m_isPerfCounter时有效
+    PerfCounterInfo     m_readPerf;
+    PerfCounterInfo     m_writePerf;
+
+    StatsInfo_()
+    : m_timeNs(0)
+    , m_readNum(0)
+    , m_readBytes(0)
+    , m_readFailNum(0)
+    , m_writeNum(0)
+    , m_writeBytes(0)
+    , m_writeFailNum(0)
+    , m_lookupNum(0)
+    , m_lookupNodeNum(0)
+    , m_allocNum(0)
+    , m_allocScanNum(0)
+    , m_diskReadNum(0)
+    , m_diskReadBytes(0)
+    , m_diskWriteNum(0)
+    , m_diskWriteBytes(0)
+    , m_diskSyncNum(0)
+    , m_readaheadHitNum(0)
+    , m_readaheadWasteNum(0)
+    , m_originFetchNum(0)
+    , m_originFetchBytes(0)
+    , m_originFailNum(0)
+    , m_originCoalesceNum(0)
+    , m_perfMode(PerfMode_NONE)
+    {}
+
+    // 减去之前的快照，变为两次快照之间的增量
+    void subtract(const StatsInfo_& prev);
+} StatsInfo;
+
+// 文件名的sha1，可以提前计算好重复使用
+typedef struct FileKey_
+{
+    char            m_sha1[20];
+} FileKey;
+
+// 文件中的一段字节范围 [m_offset, m_offset + m_len)
+typedef struct ByteRange_
+{
+    uint64_t        m_offset;
+    uint64_t        m_len;
+} ByteRange;
+
+// readWait等待超时的返回值
+const int64_t kEdgeFSWaitTimeout = -2;
+
+// 下载中的文件有数据到达时的回调，availLen为从头连续可读的长度，isComplete表示下载已经结束
+typedef std::function<void(uint64_t availLen, bool isComplete)> ProgressCallback;
+
+// 回源获取的数据按顺序交给该函数写入，返回false时应该停止回源
+typedef std::function<bool(const char* buff, uint32_t len)> OriginWriter;
+
+// 从源站获取文件从offset开始到末尾的数据，依次交给writer，成功时返回文件的完整大小，失败返回-1
+typedef std::function<int64_t(const std::string& fileName, uint64_t offset, const OriginWriter& writer)> OriginFetcher;
+
+// 批量读写中的一个请求，m_ret返回该请求的结果，含义与单个读写的返回值相同
+typedef struct ReadRequest_
+{
+    std::string     m_fileName;
+    char*           m_buff;
+    uint32_t        m_len;
+    uint64_t        m_offset;
+    int64_t         m_ret;
+
+    ReadRequest_()
+    : m_buff(NULL)
+    , m_len(0)
+    , m_offset(0)
+    , m_ret(-1)
+    {}
+} ReadRequest;
+
+typedef struct WriteRequest_
+{
+    std::string     m_fileName;
+    const char*     m_buff;
+    uint32_t        m_len;
+    uint64_t        m_sizeHint;
+    int64_t         m_ret;
+
+    WriteRequest_()
+    : m_buff(NULL)
+    , m_len(0)
+    , m_sizeHint(0)
+    , m_ret(-1)
+    {}
+} WriteRequest;
+
 class IEdgeFS
 {
 public:
@@ -24,18 +323,146 @@ public:
     virtual void unitFS() = 0;
     
     /*
+    有空洞的文件只返回从offset开始到第一个空洞之前的数据，offset位于空洞中时返回0
     @return : -1表示读取失败，否则返回写入成功的字节数
     // TODO 需要定义详细读取错误的错误码
     */
     virtual int64_t read(const std::string& fileName, char* buff, uint32_t len, uint64_t offset) = 0;
 
     /*
+    追加到文件末尾，有空洞的文件追加到最后一段数据之后
     @return : -1表示写入失败，否则返回写入成功的字节数
     // TODO 需要定义详细写入错误的错误码
     */
     virtual int64_t write(const std::string& fileName, const char* buff, uint32_t len) = 0;
+
+    /*
+    @sizeHint : 文件预期的总大小，用于一次分配合适大小的连续空间，0表示未知
+    @return : -1表示写入失败，否则返回写入成功的字节数
+    */
+    virtual int64_t write(const std::string& fileName, const char* buff, uint32_t len, uint64_t sizeHint) = 0;
+
+    /*
+    使用CalcFileKey提前计算的key读写，省去每次调用的文件名hash计算，读写过程中没有内存申请
+    @return : 同上
+    */
+    virtual int64_t read(const FileKey& key, char* buff, uint32_t len, uint64_t offset) = 0;
+
+    virtual int64_t write(const FileKey& key, const char* buff, uint32_t len, uint64_t sizeHint) = 0;
+
+    /*
+    写入文件中任意位置的一段数据，例如回源时先收到文件中间的分段，之前的部分留作空洞，之后再补齐
+    已经存在的部分保持不变，只写入其中缺失的部分，打包存储的小文件写入不相邻的位置时先迁移到数据chunk
+    @return : -1表示写入失败，否则返回从offset开始已经存在的字节数，全部成功时为len
+    */
+    virtual int64_t writeRange(const std::string& fileName, const char* buff, uint32_t len, uint64_t offset) = 0;
+
+    virtual int64_t writeRange(const FileKey& key, const char* buff, uint32_t len, uint64_t offset) = 0;
+
+    /*
+    获取文件在[0, fileSize)中缺失的范围，按照偏移排列，文件不存在时整个范围缺失，用于只回源空洞部分
+    @fileSize : 文件的完整大小，通常来自源站的响应
+    @return : 未初始化时返回false
+    */
+    virtual bool getMissingRanges(const std::string& fileName, uint64_t fileSize, std::vector<ByteRange>& ranges) = 0;
+
+    virtual bool getMissingRanges(const FileKey& key, uint64_t fileSize, std::vector<ByteRange>& ranges) = 0;
+
+    /*
+    标记文件正在下载，之后写入的同时其他线程可以通过readWait和watch读取已经到达的部分，以complete结束
+    标记只保存在内存中，重启之后不再是下载中
+    @return : 未初始化或者已经在下载中时返回false
+    */
+    virtual bool markInProgress(const std::string& fileName) = 0;
+
+    /*
+    结束下载，唤醒所有等待的读取并触发所有回调，之后读到数据末尾时返回0
+    @totalSize : 文件的完整大小，和已经写入的连续长度不一致时记录警告，读取以实际写入的数据为准
+                 一致时在index中记录文件完成，重启之后readThrough读到末尾时不再回源，之后的追加写入清除记录
+    @return : 未初始化或者不在下载中时返回false
+    */
+    virtual bool complete(const std::string& fileName, uint64_t totalSize) = 0;
+
+    /*
+    同read，文件在下载中并且offset处还没有数据时等待写入，最多等待timeoutMs，len为0时立即返回0
+    @return : kEdgeFSWaitTimeout表示等待超时，文件仍在下载中，其他同read
+    */
+    virtual int64_t readWait(const std::string& fileName, char* buff, uint32_t len, uint64_t offset,
+        uint32_t timeoutMs) = 0;
+
+    virtual int64_t readWait(const FileKey& key, char* buff, uint32_t len, uint64_t offset, uint32_t timeoutMs) = 0;
+
+    /*
+    文件从头连续可读的长度超过offset或者下载结束时回调一次，不在下载中时立即回调
+    回调在写入线程释放锁之后执行，其中可以读写，但是不能长时间阻塞
+    @return : 未初始化时返回false
+    */
+    virtual bool watch(const std::string& fileName, uint64_t offset, const ProgressCallback& callback) = 0;
+
+    /*
+    设置readThrough未命中时调用的回源函数，可以在任何时候设置，空函数表示不回源
+    回源函数在发起回源的调用线程中执行，不持有锁
+    */
+    virtual void setOriginFetcher(const OriginFetcher& fetcher) = 0;
+
+    /*
+    同read，offset处没有数据时回源，从文件已经连续存在的长度开始获取并写入
+    同一个文件同时只有一个回源，其他未命中的调用同readWait等待回源写入的数据，发起回源的调用在回源结束后读取
+    每次调用最多回源一次，回源失败时返回已经写入的数据，没有数据时同read返回0或者-1
+    已经完成的文件（见complete）读到末尾时直接返回0，不回源
+    @timeoutMs : 等待其他调用回源的最长时间，不限制自己发起的回源
+    @return : 同readWait
+    */
+    virtual int64_t readThrough(const std::string& fileName, char* buff, uint32_t len, uint64_t offset,
+        uint32_t timeoutMs) = 0;
+
+    /*
+    @return : 获取磁盘空间的使用情况，用于统计空间利用率
+    */
+    virtual bool getSpaceInfo(SpaceInfo& info) = 0;
+
+    /*
+    批量读写，先计算所有文件名的hash，再把所有磁盘读写按照偏移排序，相邻的合并为一次向量读写
+    批量写入只合并新的打包小文件，数据写入成功后才更新元数据，其他请求逐个写入，修改合并为一次提交
+    同一批中对同一个文件的多次写入按照请求的顺序追加
+    @return : 成功的请求个数，每个请求的结果保存在m_ret中
+    */
+    virtual uint32_t readBatch(std::vector<ReadRequest>& reqs) = 0;
+
+    virtual uint32_t writeBatch(std::vector<WriteRequest>& reqs) = 0;
+
+    /*
+    调用前完成的写入全部落盘，日志模式下立即提交，否则数据文件落盘后只把被修改的index页写回磁盘
+    落盘期间不阻塞其他线程的读写
+    @return : 落盘失败返回false，之后可以重试
+    */
+    virtual bool sync() = 0;
+
+    /*
+    碎片整理，把文件的数据块迁移到相邻数据块旁边的空闲chunk，每迁移一个数据块释放一次锁，不会长时间阻塞读写
+    日志模式下每迁移一个数据块提交一次
+    去重和日志结构模式下不整理
+    @maxBytes : 本次最多迁移的字节数，没有整理完的文件下次调用继续
+    @return : 迁移的字节数，0表示没有需要整理的文件
+    */
+    virtual uint64_t defrag(uint64_t maxBytes) = 0;
+
+    /*
+    获取读写次数、字节数、查找和分配的扫描长度、系统调用次数和延迟分布，开销很小可以一直开启
+    @return : 未初始化时返回false
+    */
+    virtual bool getStats(StatsInfo& info) = 0;
+
+    /*
+    把所有线程最近的追踪事件导出为chrome trace格式的json，包括hash计算、链表查找、空间分配、磁盘读写和元数据更新的耗时
+    可以在chrome://tracing或者Perfetto中打开
+    @return : 没有开启追踪或者写入文件失败时返回false
+    */
+    virtual bool dumpTrace(const std::string& path) = 0;
 };
 
 IEdgeFS* CreateEdgeFS();
 
+void CalcFileKey(const char* fileName, uint32_t fileNameLen, FileKey& key);
+
 void DestroyPcdnSdk(IEdgeFS* fs);
\ No newline at end of file
@@ -1,15 +1,23 @@
 #include "./IndexMgr.h"
 #include "./EdgeFSConst.h"
-#include "./common/macro.h"
+#include "./common/common.h"
 #include <string>
 #include <unistd.h>
 
 IndexMgr::IndexMgr()
+: m_pBase(NULL)
+, m_size(0)
+, m_pageShift(12)
+, m_dirtyNum(0)
+, m_syncNum(0)
+, m_syncBytes(0)
 {
     m_pFileOper = new FileOper();
+    m_pJournalMgr = new JournalMgr();
 }
 IndexMgr::~IndexMgr()
 {
+    SAFE_DELETE(m_pJournalMgr);
     SAFE_DELETE(m_pFileOper);
 }
 
@@ -19,4 +27,123 @@ void IndexMgr::initIndexMgr(const std::string& rootDir, bool& isExistIdxFile)
     m_pFileOper->setPath(filePath);
     isExistIdxFile = 0 == access(m_pFileOper->getPath().c_str(), F_OK) ? true : false;
     m_pFileOper->open();
-}
\ No newline at end of file
+}
+
+bool IndexMgr::initJournalMgr(const std::string& rootDir, bool isEnable, bool isExistIdxFile)
+{
+    return m_pJournalMgr->initJournalMgr(rootDir, m_pFileOper, isEnable, isExistIdxFile);
+}
+
+void IndexMgr::setBase(char* pBase, uint64_t size)
+{
+    m_pJournalMgr->setBase(pBase);
+
+    // 按照内存页记录，和内核回写的粒度一致，页大小不一定是4K
+    long pageSize = sysconf(_SC_PAGESIZE);
+    m_pageShift = 0;
+    while (pageSize > 1 && (1l << m_pageShift) < pageSize)
+    {
+        m_pageShift++;
+    }
+    m_pBase = pBase;
+    m_size = size;
+    uint64_t pageNum = (size + (1ull << m_pageShift) - 1) >> m_pageShift;
+    m_dirtyPages.assign((pageNum + 63) / 64, 0);
+    m_dirtyNum = 0;
+}
+
+void IndexMgr::setAllDirty()
+{
+    std::fill(m_dirtyPages.begin(), m_dirtyPages.end(), ~0ull);
+    m_dirtyNum++;
+}
+
+void IndexMgr::takeDirtySpans(std::vector<IndexSpan>& spans)
+{
+    spans.clear();
+    if (0 == m_dirtyNum)
+    {
+        return ;
+    }
+
+    // 回写时跳过干净的页的开销很小，间隔不超过kIndexSyncGapPages的页合并为一段，减少调用次数
+    uint64_t pageSize = 1ull << m_pageShift;
+    uint64_t lastPage = 0;
+    for (uint64_t word = 0; word < m_dirtyPages.size(); word++)
+    {
+        uint64_t bits = m_dirtyPages[word];
+        m_dirtyPages[word] = 0;
+        while (0 != bits)
+        {
+            uint64_t page = word * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (page * pageSize >= m_size)
+            {
+                break;
+            }
+            if (!spans.empty() && page - lastPage <= kIndexSyncGapPages + 1)
+            {
+                spans.back().m_len = (page + 1) * pageSize - spans.back().m_offset;
+                spans.back().m_dirtyLen += pageSize;
+            }
+            else
+            {
+                IndexSpan span = { page * pageSize, pageSize, pageSize };
+                spans.push_back(span);
+            }
+            lastPage = page;
+        }
+    }
+    // 最后一页可能超出文件
+    if (!spans.empty() && spans.back().m_offset + spans.back().m_len > m_size)
+    {
+        spans.back().m_len = m_size - spans.back().m_offset;
+    }
+    m_dirtyNum = 0;
+}
+
+void IndexMgr::restoreSpans(const std::vector<IndexSpan>& spans)
+{
+    for (auto it = spans.begin(); it != spans.end(); ++it)
+    {
+        for (uint64_t page = it->m_offset >> m_pageShift; page << m_pageShift < it->m_offset + it->m_len; page++)
+        {
+            m_dirtyPages[page >> 6] |= 1ull << (page & 63);
+        }
+        m_dirtyNum++;
+    }
+}
+
+bool IndexMgr::syncSpans(const std::vector<IndexSpan>& spans)
+{
+    if (spans.empty())
+    {
+        return true;
+    }
+
+    // 逐段msync每次都会刷新磁盘缓存，先对所有段发起回写，最后一次fdatasync等待回写完成并刷新磁盘缓存
+    for (auto it = spans.begin(); it != spans.end(); ++it)
+    {
+        if (!m_pFileOper->syncRange(it->m_offset, it->m_len))
+        {
+            lerror("sync index range failed, offset %" PRIu64 " len %" PRIu64, it->m_offset, it->m_len);
+            return false;
+        }
+    }
+    if (!m_pFileOper->sync())
+    {
+        return false;
+    }
+    for (auto it = spans.begin(); it != spans.end(); ++it)
+    {
+        m_syncBytes += it->m_dirtyLen;
+    }
+    m_syncNum++;
+    return true;
+}
+
+void IndexMgr::addIoStats(IoStats& stats)
+{
+    m_pFileOper->addIoStats(stats);
+    m_pJournalMgr->addIoStats(stats);
+}
@@ -1,7 +1,18 @@
 #pragma once
 
 #include "./common/FileOper.h"
+#include "JournalMgr.h"
 #include <string>
+#include <vector>
+#include <atomic>
+
+// index文件中一段需要落盘的范围，按页对齐
+typedef struct IndexSpan_
+{
+    uint64_t        m_offset;
+    uint64_t        m_len;
+    uint64_t        m_dirtyLen;     // 段内被修改的页的字节数，合并进来的干净的页不计算
+} IndexSpan;
 
 class IndexMgr
 {
@@ -11,13 +22,80 @@ public:
 
 public:
     void initIndexMgr(const std::string& rootDir, bool& isExistIdxFile);
-    
+
+    // 重放上次遗留的修改日志，isEnable为true时之后的index修改都通过日志提交
+    bool initJournalMgr(const std::string& rootDir, bool isEnable, bool isExistIdxFile);
+
+    // index文件映射后调用，之后按页记录被修改的位置
+    void setBase(char* pBase, uint64_t size);
+
+    // 日志模式下记录到日志，否则只标记所在的页
+    void record(const void* ptr, uint32_t len)
+    {
+        if (m_pJournalMgr->isEnable())
+        {
+            m_pJournalMgr->record(ptr, len);
+            return ;
+        }
+        if (0 == len)
+        {
+            return ;
+        }
+        uint64_t offset = (const char*)ptr - m_pBase;
+        uint64_t firstPage = offset >> m_pageShift;
+        uint64_t lastPage = (offset + len - 1) >> m_pageShift;
+        for (uint64_t page = firstPage; page <= lastPage; page++)
+        {
+            m_dirtyPages[page >> 6] |= 1ull << (page & 63);
+        }
+        m_dirtyNum++;
+    }
+
+    // 新建的index文件全部需要落盘
+    void setAllDirty();
+
+    // 取出所有被修改的页并清空标记，相邻和间隔很小的页合并为一段
+    void takeDirtySpans(std::vector<IndexSpan>& spans);
+
+    // 被修改的页落盘，调用期间不需要持有写入时的锁
+    bool syncSpans(const std::vector<IndexSpan>& spans);
+
+    // 落盘失败时重新标记取出的页
+    void restoreSpans(const std::vector<IndexSpan>& spans);
+
+    bool hasDirty()
+    {
+        return 0 != m_dirtyNum;
+    }
+
 public:
     int getfd()
     {
         return m_pFileOper->getfd();
     }
 
+    JournalMgr* getJournalMgr()
+    {
+        return m_pJournalMgr;
+    }
+
+    uint64_t getSyncNum()       { return m_syncNum; }
+    uint64_t getSyncBytes()     { return m_syncBytes; }
+
+    // index文件和日志文件的系统调用统计
+    void addIoStats(IoStats& stats);
+
 private:
     FileOper*       m_pFileOper;
-};
\ No newline at end of file
+    JournalMgr*     m_pJournalMgr;
+
+    // 每个页1bit，标记上次落盘后被修改的页
+    char*                   m_pBase;
+    uint64_t                m_size;
+    uint32_t                m_pageShift;
+    std::vector<uint64_t>   m_dirtyPages;
+    uint64_t                m_dirtyNum;
+
+    std::atomic<uint64_t>   m_syncNum;
+    std::atomic<uint64_t>   m_syncBytes;
+};
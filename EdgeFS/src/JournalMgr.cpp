@@ -0,0 +1,251 @@
+#include "JournalMgr.h"
+#include "EdgeFSProtocol.h"
+#include "common/common.h"
+#include <chrono>
+
+JournalMgr::JournalMgr()
+: m_pIndexFile(NULL)
+, m_pBase(NULL)
+, m_isEnable(false)
+, m_isIndexStale(false)
+, m_firstRecordMs(0)
+, m_journalSize(0)
+, m_seq(0)
+, m_commitNum(0)
+, m_journalBytes(0)
+{
+    m_pFileOper = new FileOper();
+}
+
+JournalMgr::~JournalMgr()
+{
+    SAFE_DELETE(m_pFileOper);
+}
+
+bool JournalMgr::initJournalMgr(const std::string& rootDir, FileOper* pIndexFile, bool isEnable,
+    bool isExistIdxFile)
+{
+    m_pIndexFile = pIndexFile;
+    m_isEnable = isEnable;
+    m_pFileOper->close();
+    m_pFileOper->setPath(rootDir + "/" + kJournalFileName);
+    m_ranges.clear();
+    m_journalSize = 0;
+    m_seq = 0;
+    m_isIndexStale = false;
+
+    bool isExistJournal = 0 == access(m_pFileOper->getPath().c_str(), F_OK);
+    if (!isExistJournal && !m_isEnable)
+    {
+        return true;
+    }
+    if (!m_pFileOper->open())
+    {
+        lfatal("open journal failed, path %s", m_pFileOper->getPath().c_str());
+        return false;
+    }
+
+    // index文件是新建的，遗留的日志已经没有意义
+    if (isExistJournal && isExistIdxFile && !replay())
+    {
+        return false;
+    }
+    if (!m_pFileOper->truncate(0) || !m_pFileOper->sync())
+    {
+        return false;
+    }
+    if (!m_isEnable)
+    {
+        m_pFileOper->close();
+        unlink(m_pFileOper->getPath().c_str());
+    }
+    return true;
+}
+
+void JournalMgr::setBase(const char* pBase)
+{
+    m_pBase = pBase;
+}
+
+bool JournalMgr::replay()
+{
+    uint64_t size = 0;
+    if (!m_pFileOper->getSize(size))
+    {
+        return false;
+    }
+    if (0 == size)
+    {
+        return true;
+    }
+
+    std::vector<char> buff(size);
+    if (!m_pFileOper->read(&buff[0], size, 0))
+    {
+        lfatal("read journal failed, size %" PRIu64, size);
+        return false;
+    }
+
+    // 逐个校验提交，遇到不完整或者序号不连续的提交时停止，之后的内容是崩溃时没有写完的或者清空前的旧提交
+    uint64_t pos = 0;
+    uint64_t groupNum = 0;
+    uint64_t entryNum = 0;
+    while (pos + sizeof(JournalGroup) <= size)
+    {
+        JournalGroup group;
+        memcpy(&group, &buff[pos], sizeof(group));
+        const char* payload = &buff[pos + sizeof(JournalGroup)];
+        if (kJournalMagic != group.m_magic || (0 != groupNum && group.m_seq != m_seq) ||
+            group.m_len > size - pos - sizeof(JournalGroup) ||
+            group.m_checksum != Utils::crc32(payload, group.m_len))
+        {
+            break;
+        }
+
+        uint32_t entryPos = 0;
+        for (uint32_t i = 0; i < group.m_entryNum; i++)
+        {
+            JournalEntry entry;
+            memcpy(&entry, payload + entryPos, sizeof(entry));
+            entryPos += sizeof(entry);
+            if (!m_pIndexFile->write(payload + entryPos, entry.m_len, entry.m_offset))
+            {
+                lfatal("replay journal failed, seq %" PRIu64 " offset %" PRIu64 " len %u", group.m_seq,
+                    entry.m_offset, entry.m_len);
+                return false;
+            }
+            entryPos += entry.m_len;
+        }
+        pos += sizeof(JournalGroup) + group.m_len;
+        m_seq = group.m_seq + 1;
+        groupNum++;
+        entryNum += group.m_entryNum;
+    }
+
+    // 重放的内容落盘后日志才能清空
+    if (0 != groupNum && !m_pIndexFile->sync())
+    {
+        lfatal("replay journal failed, sync index file failed");
+        return false;
+    }
+    lnotice("replay journal, size %" PRIu64 " validSize %" PRIu64 " groupNum %" PRIu64 " entryNum %" PRIu64, size,
+        pos, groupNum, entryNum);
+    return true;
+}
+
+void JournalMgr::mergeRanges()
+{
+    // 按照偏移排序，重叠和间隔小于一个entry的范围合并，合并后的entry更少，日志更短
+    std::sort(m_ranges.begin(), m_ranges.end(),
+        [](const Range& a, const Range& b) { return a.m_offset < b.m_offset; });
+    uint32_t num = 0;
+    for (uint32_t i = 0; i < m_ranges.size(); i++)
+    {
+        if (0 != num)
+        {
+            Range& last = m_ranges[num - 1];
+            uint64_t lastEnd = last.m_offset + last.m_len;
+            if (m_ranges[i].m_offset <= lastEnd + sizeof(JournalEntry))
+            {
+                uint64_t end = std::max(lastEnd, m_ranges[i].m_offset + m_ranges[i].m_len);
+                last.m_len = end - last.m_offset;
+                continue;
+            }
+        }
+        m_ranges[num++] = m_ranges[i];
+    }
+    m_ranges.resize(num);
+}
+
+bool JournalMgr::commit()
+{
+    if (!m_isEnable || m_ranges.empty())
+    {
+        return true;
+    }
+
+    mergeRanges();
+
+    JournalGroup group;
+    group.m_entryNum = m_ranges.size();
+    group.m_seq = m_seq;
+    uint64_t groupLen = sizeof(JournalGroup);
+    for (auto it = m_ranges.begin(); it != m_ranges.end(); ++it)
+    {
+        groupLen += sizeof(JournalEntry) + it->m_len;
+    }
+    m_groupBuff.resize(groupLen);
+
+    char* pos = &m_groupBuff[sizeof(JournalGroup)];
+    for (auto it = m_ranges.begin(); it != m_ranges.end(); ++it)
+    {
+        JournalEntry entry;
+        entry.m_offset = it->m_offset;
+        entry.m_len = it->m_len;
+        memcpy(pos, &entry, sizeof(entry));
+        pos += sizeof(entry);
+        memcpy(pos, m_pBase + it->m_offset, it->m_len);
+        pos += it->m_len;
+    }
+    group.m_len = groupLen - sizeof(JournalGroup);
+    group.m_checksum = Utils::crc32(&m_groupBuff[sizeof(JournalGroup)], group.m_len);
+    memcpy(&m_groupBuff[0], &group, sizeof(group));
+
+    // 日志落盘即提交完成，失败时保留记录的范围，下次提交时重写到同一位置
+    if (!m_pFileOper->write(&m_groupBuff[0], groupLen, m_journalSize) || !m_pFileOper->sync())
+    {
+        lerror("journal commit failed, seq %" PRIu64 " len %" PRIu64, m_seq, groupLen);
+        return false;
+    }
+    m_journalSize += groupLen;
+    m_seq++;
+    m_commitNum++;
+    m_journalBytes += groupLen;
+
+    // 写入index文件不需要落盘，崩溃时从日志重放
+    for (auto it = m_ranges.begin(); it != m_ranges.end(); ++it)
+    {
+        if (!m_pIndexFile->write(m_pBase + it->m_offset, it->m_len, it->m_offset))
+        {
+            lerror("journal write back failed, offset %" PRIu64 " len %u", it->m_offset, it->m_len);
+            m_isIndexStale = true;
+            break;
+        }
+    }
+    ldebug("journal commit, seq %" PRIu64 " entryNum %u len %" PRIu64, group.m_seq, group.m_entryNum, groupLen);
+    m_ranges.clear();
+
+    if (m_journalSize >= kJournalCheckpointSize)
+    {
+        return checkpoint();
+    }
+    return true;
+}
+
+bool JournalMgr::checkpoint()
+{
+    if (!m_isEnable || 0 == m_journalSize || m_isIndexStale)
+    {
+        return true;
+    }
+    // 清空需要落盘，否则崩溃后新的提交后面可能跟着清空前的旧提交
+    if (!m_pIndexFile->sync() || !m_pFileOper->truncate(0) || !m_pFileOper->sync())
+    {
+        lerror("journal checkpoint failed, journalSize %" PRIu64, m_journalSize);
+        return false;
+    }
+    linfo("journal checkpoint, journalSize %" PRIu64 " seq %" PRIu64, m_journalSize, m_seq);
+    m_journalSize = 0;
+    return true;
+}
+
+uint64_t JournalMgr::nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void JournalMgr::addIoStats(IoStats& stats)
+{
+    m_pFileOper->addIoStats(stats);
+}
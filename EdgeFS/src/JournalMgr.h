@@ -0,0 +1,95 @@
+#pragma once
+
+#include "common/SystemHead.h"
+
+class FileOper;
+typedef struct IoStats_ IoStats;
+
+// index文件的重做日志，日志模式下index文件以私有方式映射，内存中的修改不会直接写回文件
+// 修改的范围先记录下来，提交时把修改后的内容追加到日志并落盘，再写入index文件
+// 一次提交包含多次写入的修改，重启时只重放完整的提交，index文件始终对应某次提交后的状态
+class JournalMgr
+{
+public:
+    JournalMgr();
+    ~JournalMgr();
+
+public:
+    // 映射index文件之前调用，上次遗留的日志无论是否开启日志模式都会重放到index文件
+    bool initJournalMgr(const std::string& rootDir, FileOper* pIndexFile, bool isEnable, bool isExistIdxFile);
+
+    // index文件映射的起始地址，记录的指针都在该映射范围内
+    void setBase(const char* pBase);
+
+    // 记录被修改的范围，提交时保存范围内最新的内容
+    void record(const void* ptr, uint32_t len)
+    {
+        if (!m_isEnable)
+        {
+            return ;
+        }
+        if (m_ranges.empty())
+        {
+            m_firstRecordMs = nowMs();
+        }
+        Range range = { (uint64_t)((const char*)ptr - m_pBase), len };
+        m_ranges.push_back(range);
+    }
+
+    // 调用者需要保证修改引用的数据已经落盘
+    bool commit();
+
+    // index文件落盘后清空日志
+    bool checkpoint();
+
+    // 最早的未提交修改已经等待超过commitMs
+    bool isCommitDue(uint32_t commitMs)
+    {
+        return !m_ranges.empty() && nowMs() - m_firstRecordMs >= commitMs;
+    }
+
+    bool hasPending()
+    {
+        return !m_ranges.empty();
+    }
+
+    bool isEnable()
+    {
+        return m_isEnable;
+    }
+
+public:
+    uint64_t getCommitNum()         { return m_commitNum; }
+    uint64_t getJournalBytes()      { return m_journalBytes; }
+
+    void addIoStats(IoStats& stats);
+
+private:
+    typedef struct Range_
+    {
+        uint64_t    m_offset;
+        uint32_t    m_len;
+    } Range;
+
+    bool replay();
+    void mergeRanges();
+
+    static uint64_t nowMs();
+
+private:
+    FileOper*       m_pFileOper;
+    FileOper*       m_pIndexFile;
+    const char*     m_pBase;
+    bool            m_isEnable;
+    // 日志已经落盘但写入index文件失败，日志只能在下次启动时重放，不能清空
+    bool            m_isIndexStale;
+
+    std::vector<Range>  m_ranges;
+    uint64_t            m_firstRecordMs;
+    std::vector<char>   m_groupBuff;
+    uint64_t            m_journalSize;
+    uint64_t            m_seq;
+
+    uint64_t        m_commitNum;
+    uint64_t        m_journalBytes;
+};
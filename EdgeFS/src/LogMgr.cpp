@@ -0,0 +1,340 @@
+#include "LogMgr.h"
+#include "DataMgr.h"
+#include "IndexMgr.h"
+#include "common/common.h"
+
+LogMgr::LogMgr()
+: m_pFileOper(NULL)
+, m_pIndexMgr(NULL)
+, m_pLogMap(NULL)
+, m_pPhysMap(NULL)
+, m_pSegmentLive(NULL)
+, m_chunkNum(0)
+, m_chunkSize(0)
+, m_segmentChunkNum(0)
+, m_segmentNum(0)
+, m_reserveSegmentNum(0)
+, m_openSegment(kInvalidChunkid)
+, m_openUsedNum(0)
+, m_deviceWriteBytes(0)
+, m_cleanSegmentNum(0)
+, m_cleanBytes(0)
+{
+}
+
+LogMgr::~LogMgr()
+{
+}
+
+void LogMgr::initLogMgr(void* ptr, FileOper* pFileOper, IndexMgr* pIndexMgr, uint32_t chunkNum,
+    uint32_t chunkSize, uint32_t segmentChunkNum, uint32_t segmentNum)
+{
+    m_pFileOper = pFileOper;
+    m_pIndexMgr = pIndexMgr;
+    m_chunkNum = chunkNum;
+    m_chunkSize = chunkSize;
+    m_segmentChunkNum = segmentChunkNum;
+    m_segmentNum = segmentNum;
+    if (0 == m_segmentNum)
+    {
+        return ;
+    }
+
+    uint32_t physNum = segmentChunkNum * segmentNum;
+    m_pLogMap = (uint32_t*)ptr;
+    m_pPhysMap = m_pLogMap + chunkNum;
+    m_pSegmentLive = m_pPhysMap + physNum;
+    m_reserveSegmentNum = calcReserveSegmentNum(segmentNum);
+
+    // 没有有效chunk的段都可以直接使用，上次打开的段当作普通的段
+    m_freeSegments.clear();
+    for (uint32_t i = 0; i < m_segmentNum; i++)
+    {
+        if (0 == m_pSegmentLive[i])
+        {
+            m_freeSegments.push_back(i);
+        }
+    }
+    m_openSegment = kInvalidChunkid;
+    m_openUsedNum = m_segmentChunkNum;
+    m_segmentBuff.resize((uint64_t)m_segmentChunkNum * m_chunkSize);
+    m_cleanBuff.resize((uint64_t)m_segmentChunkNum * m_chunkSize);
+
+    linfo("log segmentChunkNum %u segmentNum %u reserveSegmentNum %u freeSegmentNum %zu", m_segmentChunkNum,
+        m_segmentNum, m_reserveSegmentNum, m_freeSegments.size());
+}
+
+void LogMgr::format()
+{
+    if (!isEnable())
+    {
+        return ;
+    }
+    memset(m_pLogMap, 0xff, (uint64_t)m_chunkNum * sizeof(uint32_t));
+    memset(m_pPhysMap, 0xff, (uint64_t)m_segmentChunkNum * m_segmentNum * sizeof(uint32_t));
+    m_pIndexMgr->record(m_pLogMap, m_chunkNum * sizeof(uint32_t));
+    m_pIndexMgr->record(m_pPhysMap, m_segmentChunkNum * m_segmentNum * sizeof(uint32_t));
+}
+
+bool LogMgr::write(const char* buff, uint32_t len, uint64_t offset)
+{
+    uint32_t doneLen = 0;
+    while (doneLen < len)
+    {
+        uint64_t curOffset = offset + doneLen;
+        uint32_t chunkid = curOffset / m_chunkSize;
+        uint32_t inOffset = curOffset % m_chunkSize;
+        uint32_t writeLen = std::min(len - doneLen, m_chunkSize - inOffset);
+        if (chunkid >= m_chunkNum)
+        {
+            lerror("log write out of range, offset %" PRIu64 " len %u", offset, len);
+            return false;
+        }
+
+        uint32_t physid = m_pLogMap[chunkid];
+        if (kInvalidChunkid == physid || physid / m_segmentChunkNum != m_openSegment)
+        {
+            if (!ensureSlot())
+            {
+                return false;
+            }
+            // 清理时可能已经把该chunk迁移到打开的段
+            physid = m_pLogMap[chunkid];
+        }
+
+        if (kInvalidChunkid == physid || physid / m_segmentChunkNum != m_openSegment)
+        {
+            // 迁移到打开的段，没有被覆盖的部分保留原来的数据
+            uint32_t newPhysid = kInvalidChunkid;
+            takeSlot(newPhysid);
+            char* pSlot = calcSlotPtr(newPhysid);
+            if (writeLen != m_chunkSize)
+            {
+                if (kInvalidChunkid == physid)
+                {
+                    memset(pSlot, 0, m_chunkSize);
+                }
+                else if (!m_pFileOper->read(pSlot, m_chunkSize, calcPhysOffset(physid)))
+                {
+                    lerror("log read old chunk failed, chunkid %u physid %u", chunkid, physid);
+                    return false;
+                }
+            }
+            if (kInvalidChunkid != physid)
+            {
+                unmapPhys(physid);
+            }
+            mapChunk(chunkid, newPhysid);
+            physid = newPhysid;
+        }
+
+        memcpy(calcSlotPtr(physid) + inOffset, buff + doneLen, writeLen);
+        doneLen += writeLen;
+    }
+    return true;
+}
+
+void LogMgr::mapRead(char* buff, uint32_t len, uint64_t offset, std::vector<IoSegment>& segments)
+{
+    uint32_t doneLen = 0;
+    while (doneLen < len)
+    {
+        uint64_t curOffset = offset + doneLen;
+        uint32_t chunkid = curOffset / m_chunkSize;
+        uint32_t inOffset = curOffset % m_chunkSize;
+        uint32_t readLen = std::min(len - doneLen, m_chunkSize - inOffset);
+        char* pBuff = NULL == buff ? NULL : buff + doneLen;
+        doneLen += readLen;
+
+        uint32_t physid = chunkid < m_chunkNum ? m_pLogMap[chunkid] : kInvalidChunkid;
+        if (kInvalidChunkid == physid)
+        {
+            if (NULL != pBuff)
+            {
+                memset(pBuff, 0, readLen);
+            }
+            continue;
+        }
+        if (physid / m_segmentChunkNum == m_openSegment)
+        {
+            if (NULL != pBuff)
+            {
+                memcpy(pBuff, calcSlotPtr(physid) + inOffset, readLen);
+            }
+            continue;
+        }
+
+        uint64_t physOffset = calcPhysOffset(physid) + inOffset;
+        if (!segments.empty() && segments.back().m_offset + segments.back().m_len == physOffset &&
+            (NULL == pBuff || segments.back().m_buff + segments.back().m_len == pBuff))
+        {
+            segments.back().m_len += readLen;
+            continue;
+        }
+        IoSegment segment = { physOffset, pBuff, readLen, 0 };
+        segments.push_back(segment);
+    }
+}
+
+void LogMgr::trim(uint32_t chunkid)
+{
+    if (!isEnable() || chunkid >= m_chunkNum || kInvalidChunkid == m_pLogMap[chunkid])
+    {
+        return ;
+    }
+    unmapPhys(m_pLogMap[chunkid]);
+    m_pLogMap[chunkid] = kInvalidChunkid;
+    m_pIndexMgr->record(&m_pLogMap[chunkid], sizeof(uint32_t));
+}
+
+bool LogMgr::flush()
+{
+    if (!isEnable() || kInvalidChunkid == m_openSegment || 0 == m_openUsedNum)
+    {
+        return true;
+    }
+
+    uint32_t len = m_openUsedNum * m_chunkSize;
+    if (!m_pFileOper->write(&m_segmentBuff[0], len, calcPhysOffset(m_openSegment * m_segmentChunkNum)))
+    {
+        lerror("log flush failed, segment %u len %u", m_openSegment, len);
+        return false;
+    }
+    m_deviceWriteBytes += len;
+    return true;
+}
+
+bool LogMgr::ensureSlot()
+{
+    if (m_openUsedNum < m_segmentChunkNum)
+    {
+        return true;
+    }
+    if (!openSegment())
+    {
+        return false;
+    }
+
+    // 空闲段必须足够迁移下一个被清理的段，空闲段少于预留个数时只清理有效数据少的段
+    while (m_freeSegments.size() < kLogMinFreeSegmentNum && cleanSegment(100))
+    {
+    }
+    if (m_freeSegments.size() < m_reserveSegmentNum)
+    {
+        cleanSegment(kLogCleanLivePercent);
+    }
+    return m_openUsedNum < m_segmentChunkNum || openSegment();
+}
+
+bool LogMgr::takeSlot(uint32_t& physid)
+{
+    if (m_openUsedNum == m_segmentChunkNum && !openSegment())
+    {
+        return false;
+    }
+    physid = m_openSegment * m_segmentChunkNum + m_openUsedNum;
+    m_openUsedNum++;
+    return true;
+}
+
+bool LogMgr::openSegment()
+{
+    if (kInvalidChunkid != m_openSegment)
+    {
+        if (!flush())
+        {
+            return false;
+        }
+        if (0 == m_pSegmentLive[m_openSegment])
+        {
+            m_freeSegments.push_back(m_openSegment);
+        }
+    }
+
+    if (m_freeSegments.empty())
+    {
+        lerror("log no free segment, segmentNum %u", m_segmentNum);
+        return false;
+    }
+    m_openSegment = m_freeSegments.front();
+    m_freeSegments.pop_front();
+    m_openUsedNum = 0;
+    return true;
+}
+
+bool LogMgr::cleanSegment(uint32_t maxLivePercent)
+{
+    // 选择有效chunk最少的段
+    uint32_t victim = kInvalidChunkid;
+    uint32_t minLive = m_segmentChunkNum;
+    for (uint32_t i = 0; i < m_segmentNum; i++)
+    {
+        uint32_t live = m_pSegmentLive[i];
+        if (i != m_openSegment && 0 != live && live < minLive)
+        {
+            victim = i;
+            minLive = live;
+        }
+    }
+    if (kInvalidChunkid == victim || (uint64_t)minLive * 100 >= (uint64_t)m_segmentChunkNum * maxLivePercent)
+    {
+        return false;
+    }
+
+    // 只读取到最后一个有效的chunk，段的后半部分可能从未写入磁盘
+    uint32_t firstPhysid = victim * m_segmentChunkNum;
+    uint32_t readNum = m_segmentChunkNum;
+    while (kInvalidChunkid == m_pPhysMap[firstPhysid + readNum - 1])
+    {
+        readNum--;
+    }
+    if (!m_pFileOper->read(&m_cleanBuff[0], readNum * m_chunkSize, calcPhysOffset(firstPhysid)))
+    {
+        lerror("log clean read failed, segment %u", victim);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < readNum; i++)
+    {
+        uint32_t chunkid = m_pPhysMap[firstPhysid + i];
+        if (kInvalidChunkid == chunkid)
+        {
+            continue;
+        }
+        uint32_t newPhysid = kInvalidChunkid;
+        if (!takeSlot(newPhysid))
+        {
+            return false;
+        }
+        memcpy(calcSlotPtr(newPhysid), &m_cleanBuff[(uint64_t)i * m_chunkSize], m_chunkSize);
+        unmapPhys(firstPhysid + i);
+        mapChunk(chunkid, newPhysid);
+        m_cleanBytes += m_chunkSize;
+    }
+    m_cleanSegmentNum++;
+
+    linfo("log clean segment %u liveNum %u freeSegmentNum %zu", victim, minLive, m_freeSegments.size());
+    return true;
+}
+
+void LogMgr::mapChunk(uint32_t chunkid, uint32_t physid)
+{
+    m_pLogMap[chunkid] = physid;
+    m_pPhysMap[physid] = chunkid;
+    m_pSegmentLive[physid / m_segmentChunkNum]++;
+    m_pIndexMgr->record(&m_pLogMap[chunkid], sizeof(uint32_t));
+    m_pIndexMgr->record(&m_pPhysMap[physid], sizeof(uint32_t));
+    m_pIndexMgr->record(&m_pSegmentLive[physid / m_segmentChunkNum], sizeof(uint32_t));
+}
+
+void LogMgr::unmapPhys(uint32_t physid)
+{
+    uint32_t segment = physid / m_segmentChunkNum;
+    m_pPhysMap[physid] = kInvalidChunkid;
+    m_pIndexMgr->record(&m_pPhysMap[physid], sizeof(uint32_t));
+    m_pIndexMgr->record(&m_pSegmentLive[segment], sizeof(uint32_t));
+    if (0 == --m_pSegmentLive[segment] && segment != m_openSegment)
+    {
+        m_freeSegments.push_back(segment);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include "EdgeFSConst.h"
+#include <deque>
+
+class FileOper;
+class IndexMgr;
+typedef struct IoSegment_ IoSegment;
+
+// 日志结构的数据布局，chunk的逻辑位置和磁盘上的物理位置分离
+// 写入先追加到内存中打开的段，段写满后整段写入磁盘，chunk再次写入时迁移到打开的段，原位置失效
+// 空闲段不足时清理有效数据比例低的段，有效的chunk迁移后整段回收
+// index文件中保存 逻辑chunk -> 物理chunk，物理chunk -> 逻辑chunk，以及每个段的有效chunk个数
+class LogMgr
+{
+public:
+    LogMgr();
+    ~LogMgr();
+
+public:
+    // segmentNum为0表示不使用日志结构，映射表的修改记录到pIndexMgr
+    void initLogMgr(void* ptr, FileOper* pFileOper, IndexMgr* pIndexMgr, uint32_t chunkNum, uint32_t chunkSize,
+        uint32_t segmentChunkNum, uint32_t segmentNum);
+
+    // 新建index文件后调用，所有chunk都没有物理位置
+    void format();
+
+    // offset和len都是逻辑位置，数据复制到打开的段中，调用返回后buff可以复用
+    bool write(const char* buff, uint32_t len, uint64_t offset);
+
+    // 逻辑范围转换为物理位置，打开的段中的数据直接复制，没有写入过的数据填0
+    // 需要从磁盘读取的部分追加到segments，物理上连续的合并为一段，buff为NULL时只做转换
+    void mapRead(char* buff, uint32_t len, uint64_t offset, std::vector<IoSegment>& segments);
+
+    // chunk被释放，原来的物理位置失效
+    void trim(uint32_t chunkid);
+
+    // 打开的段中已经写入的部分写入磁盘，段保持打开
+    bool flush();
+
+    bool isEnable()
+    {
+        return 0 != m_segmentNum;
+    }
+
+    // 为清理预留的空闲段个数，这部分空间不能分配给逻辑chunk
+    static uint32_t calcReserveSegmentNum(uint32_t segmentNum)
+    {
+        return std::max(kLogMinFreeSegmentNum + 1, (uint32_t)((uint64_t)segmentNum * kLogReservePercent / 100));
+    }
+
+public:
+    uint32_t getSegmentNum()            { return m_segmentNum; }
+    uint32_t getFreeSegmentNum()        { return m_freeSegments.size(); }
+    uint64_t getDeviceWriteBytes()      { return m_deviceWriteBytes; }
+    uint64_t getCleanSegmentNum()       { return m_cleanSegmentNum; }
+    uint64_t getCleanBytes()            { return m_cleanBytes; }
+
+private:
+    bool ensureSlot();
+    bool takeSlot(uint32_t& physid);
+    bool openSegment();
+    bool cleanSegment(uint32_t maxLivePercent);
+
+    void mapChunk(uint32_t chunkid, uint32_t physid);
+    void unmapPhys(uint32_t physid);
+
+    uint64_t calcPhysOffset(uint32_t physid)
+    {
+        return (uint64_t)physid * m_chunkSize;
+    }
+
+    char* calcSlotPtr(uint32_t physid)
+    {
+        return &m_segmentBuff[(uint64_t)(physid % m_segmentChunkNum) * m_chunkSize];
+    }
+
+private:
+    FileOper*       m_pFileOper;
+    IndexMgr*       m_pIndexMgr;
+    uint32_t*       m_pLogMap;          // 逻辑chunk -> 物理chunk
+    uint32_t*       m_pPhysMap;         // 物理chunk -> 逻辑chunk
+    uint32_t*       m_pSegmentLive;     // 每个段中有效的chunk个数
+    uint32_t        m_chunkNum;
+    uint32_t        m_chunkSize;
+    uint32_t        m_segmentChunkNum;
+    uint32_t        m_segmentNum;
+    uint32_t        m_reserveSegmentNum;    // 空闲段低于该值时开始清理有效数据少的段
+
+    // 当前追加写入的段
+    uint32_t                m_openSegment;
+    uint32_t                m_openUsedNum;
+    std::vector<char>       m_segmentBuff;
+    std::vector<char>       m_cleanBuff;
+    std::deque<uint32_t>    m_freeSegments;
+
+    uint64_t        m_deviceWriteBytes;
+    uint64_t        m_cleanSegmentNum;
+    uint64_t        m_cleanBytes;
+};
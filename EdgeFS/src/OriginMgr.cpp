@@ -0,0 +1,42 @@
+#include "OriginMgr.h"
+#include "common/common.h"
+
+OriginMgr::OriginMgr()
+: m_fetchNum(0)
+, m_fetchBytes(0)
+, m_failNum(0)
+, m_coalesceNum(0)
+{
+}
+
+OriginMgr::~OriginMgr()
+{
+}
+
+void OriginMgr::setFetcher(const OriginFetcher& fetcher)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fetcher = fetcher;
+}
+
+bool OriginMgr::getFetcher(OriginFetcher& fetcher)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fetcher = m_fetcher;
+    return static_cast<bool>(fetcher);
+}
+
+void OriginMgr::addFetch(uint64_t bytes, bool isOk)
+{
+    m_fetchNum.fetch_add(1, std::memory_order_relaxed);
+    m_fetchBytes.fetch_add(bytes, std::memory_order_relaxed);
+    if (!isOk)
+    {
+        m_failNum.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void OriginMgr::addCoalesce()
+{
+    m_coalesceNum.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include "IEdgeFS.h"
+
+// 回源函数和回源的统计，同一个文件的并发回源由ProgressMgr合并为一次
+// 回源成功的文件的完整大小由EdgeFS记录在index中
+class OriginMgr
+{
+public:
+    OriginMgr();
+    ~OriginMgr();
+
+public:
+    void setFetcher(const OriginFetcher& fetcher);
+
+    // 没有设置回源函数时返回false
+    bool getFetcher(OriginFetcher& fetcher);
+
+    void addFetch(uint64_t bytes, bool isOk);
+    void addCoalesce();
+
+public:
+    uint64_t getFetchNum()      { return m_fetchNum.load(std::memory_order_relaxed); }
+    uint64_t getFetchBytes()    { return m_fetchBytes.load(std::memory_order_relaxed); }
+    uint64_t getFailNum()       { return m_failNum.load(std::memory_order_relaxed); }
+    uint64_t getCoalesceNum()   { return m_coalesceNum.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex              m_mutex;
+    OriginFetcher           m_fetcher;
+
+    std::atomic<uint64_t>   m_fetchNum;
+    std::atomic<uint64_t>   m_fetchBytes;
+    std::atomic<uint64_t>   m_failNum;
+    std::atomic<uint64_t>   m_coalesceNum;
+};
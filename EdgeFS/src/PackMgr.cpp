@@ -0,0 +1,53 @@
+#include "PackMgr.h"
+#include "common/common.h"
+
+PackMgr::PackMgr()
+: m_pRecords(NULL)
+, m_recordNum(0)
+{
+}
+
+PackMgr::~PackMgr()
+{
+}
+
+void PackMgr::initPackMgr(void* ptr, uint32_t recordNum)
+{
+    m_pRecords = (PackRecord*)ptr;
+    m_recordNum = recordNum;
+}
+
+PackRecord* PackMgr::find(const char* sha1Val, PackRecord** pIdleRecord)
+{
+    if (NULL != pIdleRecord)
+    {
+        *pIdleRecord = NULL;
+    }
+    if (0 == m_recordNum)
+    {
+        return NULL;
+    }
+
+    // 使用与chunk hash不同的字节，避免两个hash表的冲突叠加
+    uint32_t idx = (*(uint32_t*)(sha1Val + 4)) % m_recordNum;
+
+    // 记录不会被删除，遇到空闲记录即可结束查找
+    for (uint32_t i = 0; i < m_recordNum; i++)
+    {
+        PackRecord* pRecord = m_pRecords + idx;
+        if (PackRecordState_IDLE == pRecord->m_state)
+        {
+            if (NULL != pIdleRecord)
+            {
+                *pIdleRecord = pRecord;
+            }
+            return NULL;
+        }
+        if (0 == memcmp(pRecord->m_sha1, sha1Val, sizeof(pRecord->m_sha1)))
+        {
+            return pRecord;
+        }
+        idx = idx + 1 == m_recordNum ? 0 : idx + 1;
+    }
+    return NULL;
+}
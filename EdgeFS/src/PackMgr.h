@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include "EdgeFSProtocol.h"
+
+// 管理index文件中的小文件打包记录，记录使用开放寻址的hash表组织
+class PackMgr
+{
+public:
+    PackMgr();
+    ~PackMgr();
+
+public:
+    void initPackMgr(void* ptr, uint32_t recordNum);
+
+    // 查找sha1对应的记录，找不到时返回NULL，pIdleRecord返回可插入的空闲记录
+    PackRecord* find(const char* sha1Val, PackRecord** pIdleRecord);
+
+    bool isEnable()
+    {
+        return 0 != m_recordNum;
+    }
+
+public:
+    void* getPtr()
+    {
+        return (void*)m_pRecords;
+    }
+
+    uint32_t getRecordNum()
+    {
+        return m_recordNum;
+    }
+
+    PackRecord* getRecord(uint32_t idx)
+    {
+        return m_pRecords + idx;
+    }
+
+private:
+    PackRecord*     m_pRecords;
+    uint32_t        m_recordNum;
+};
@@ -0,0 +1,115 @@
+#include "ParallelReadMgr.h"
+#include "DataMgr.h"
+#include "TraceMgr.h"
+#include "common/common.h"
+
+ParallelReadMgr::ParallelReadMgr()
+: m_pFileOper(NULL)
+, m_pTraceMgr(NULL)
+, m_isStop(false)
+, m_pSegments(NULL)
+, m_pIsOks(NULL)
+, m_segmentNum(0)
+, m_jobSeq(0)
+, m_nextIdx(0)
+, m_activeNum(0)
+{
+}
+
+ParallelReadMgr::~ParallelReadMgr()
+{
+    stop();
+}
+
+void ParallelReadMgr::initParallelReadMgr(FileOper* pFileOper, TraceMgr* pTraceMgr, uint32_t threadNum)
+{
+    stop();
+    m_pFileOper = pFileOper;
+    m_pTraceMgr = pTraceMgr;
+    m_isStop = false;
+    for (uint32_t i = 0; i < threadNum; i++)
+    {
+        m_threads.push_back(std::thread(ParallelReadMgr::threadFunc, this));
+    }
+}
+
+void ParallelReadMgr::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStop = true;
+    }
+    m_jobCond.notify_all();
+    for (auto it = m_threads.begin(); it != m_threads.end(); ++it)
+    {
+        it->join();
+    }
+    m_threads.clear();
+}
+
+void ParallelReadMgr::read(const IoSegment* segments, uint32_t num, uint8_t* pIsOks)
+{
+    std::lock_guard<std::mutex> jobLock(m_jobMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pSegments = segments;
+        m_pIsOks = pIsOks;
+        m_segmentNum = num;
+        m_nextIdx = 0;
+        m_jobSeq++;
+        m_activeNum++;
+    }
+    m_jobCond.notify_all();
+
+    runJob();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_activeNum--;
+    m_doneCond.wait(lock, [this] { return 0 == m_activeNum; });
+    m_pSegments = NULL;
+    m_pIsOks = NULL;
+    m_segmentNum = 0;
+}
+
+void ParallelReadMgr::runJob()
+{
+    while (true)
+    {
+        uint32_t idx = m_nextIdx.fetch_add(1);
+        if (idx >= m_segmentNum)
+        {
+            break;
+        }
+        const IoSegment& segment = m_pSegments[idx];
+        TraceSpan span(m_pTraceMgr, TraceType_DISK_READ, segment.m_len);
+        m_pIsOks[idx] = m_pFileOper->read(segment.m_buff, segment.m_len, segment.m_offset) ? 1 : 0;
+    }
+}
+
+void ParallelReadMgr::threadFunc(ParallelReadMgr* p)
+{
+    uint64_t doneSeq = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(p->m_mutex);
+            p->m_jobCond.wait(lock, [p, doneSeq] {
+                return p->m_isStop || (NULL != p->m_pSegments && p->m_jobSeq != doneSeq);
+            });
+            if (p->m_isStop)
+            {
+                break;
+            }
+            doneSeq = p->m_jobSeq;
+            p->m_activeNum++;
+        }
+
+        p->runJob();
+
+        {
+            std::lock_guard<std::mutex> lock(p->m_mutex);
+            p->m_activeNum--;
+        }
+        p->m_doneCond.notify_one();
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common/SystemHead.h"
+
+class FileOper;
+class TraceMgr;
+typedef struct IoSegment_ IoSegment;
+
+// 大段读取拆分后由固定的线程并发读取，提高单次读取的队列深度
+// 同一时间只有一次读取，并发的调用依次执行，调用线程也参与读取，所有段完成后返回
+class ParallelReadMgr
+{
+public:
+    ParallelReadMgr();
+    ~ParallelReadMgr();
+
+public:
+    // threadNum为0表示不启动线程，读取全部在调用线程中完成
+    void initParallelReadMgr(FileOper* pFileOper, TraceMgr* pTraceMgr, uint32_t threadNum);
+
+    void stop();
+
+    // 读取每一段到各自的buff，pIsOks[i]表示第i段是否读取成功
+    void read(const IoSegment* segments, uint32_t num, uint8_t* pIsOks);
+
+    bool isEnable()
+    {
+        return !m_threads.empty();
+    }
+
+    // 参与读取的线程数，包括调用线程
+    uint32_t getReaderNum()
+    {
+        return m_threads.size() + 1;
+    }
+
+private:
+    static void threadFunc(ParallelReadMgr* p);
+
+    // 取出未读取的段依次读取，直到没有剩余
+    void runJob();
+
+private:
+    FileOper*                   m_pFileOper;
+    TraceMgr*                   m_pTraceMgr;
+    std::vector<std::thread>    m_threads;
+    bool                        m_isStop;
+
+    // 当前的读取，m_jobSeq变化时线程开始读取
+    const IoSegment*            m_pSegments;
+    uint8_t*                    m_pIsOks;
+    uint32_t                    m_segmentNum;
+    uint64_t                    m_jobSeq;
+    std::atomic<uint32_t>       m_nextIdx;
+    // 正在读取当前任务的线程数，为0后调用者才能返回，避免线程访问已经结束的任务
+    uint32_t                    m_activeNum;
+
+    // 持有到读取结束，保证同一时间只有一次读取
+    std::mutex                  m_jobMutex;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_jobCond;
+    std::condition_variable     m_doneCond;
+};
@@ -0,0 +1,258 @@
+#include "PerfCounterMgr.h"
+#include "common/common.h"
+#include <time.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+
+typedef struct PerfEventDesc_
+{
+    uint32_t        m_type;
+    uint64_t        m_config;
+} PerfEventDesc;
+
+// 和PerfValue的顺序一致
+static const PerfEventDesc kPerfEvents[PerfValue_NUM] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+static const char* const kPerfModeNames[] = { "none", "hardware", "software", "rusage" };
+
+static std::atomic<uint64_t> s_nextPerfId(1);
+
+thread_local PerfSlotCache PerfCounterMgr::t_slotCache = { 0, NULL };
+
+// 该模式下计数组中第一个事件对应的PerfValue
+static uint32_t firstValue(PerfMode mode)
+{
+    return PerfMode_HARDWARE == mode ? PerfValue_CYCLES : PerfValue_TASK_CLOCK_NS;
+}
+
+static int openEvent(const PerfEventDesc& desc, bool isUserOnly, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = desc.m_type;
+    attr.config = desc.m_config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = isUserOnly ? 1 : 0;
+    attr.exclude_hv = 1;
+    // 组长常驻，计数器不足时整组不计数，而不是和其他事件分时复用
+    attr.pinned = -1 == groupFd ? 1 : 0;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+}
+
+PerfSlot_::PerfSlot_()
+: m_threadId(std::this_thread::get_id())
+, m_leaderFd(-1)
+{
+    for (uint32_t type = 0; type < PerfOpType_NUM; type++)
+    {
+        m_callNums[type] = 0;
+        for (uint32_t i = 0; i < PerfValue_NUM; i++)
+        {
+            m_sums[type][i] = 0;
+        }
+    }
+}
+
+PerfCounterMgr::PerfCounterMgr()
+: m_id(s_nextPerfId++)
+, m_mode(PerfMode_NONE)
+, m_isUserOnly(false)
+{
+}
+
+PerfCounterMgr::~PerfCounterMgr()
+{
+    clearSlots();
+}
+
+void PerfCounterMgr::initPerfCounterMgr(bool isEnable)
+{
+    clearSlots();
+    m_id = s_nextPerfId++;
+    m_mode = PerfMode_NONE;
+    if (!isEnable)
+    {
+        return ;
+    }
+
+    // 优先统计包括内核态的硬件计数，依次退化，探测用的计数组随即关闭
+    const PerfMode modes[] = { PerfMode_HARDWARE, PerfMode_HARDWARE, PerfMode_SOFTWARE, PerfMode_SOFTWARE };
+    const bool userOnlys[] = { false, true, false, true };
+    for (uint32_t i = 0; i < sizeof(modes) / sizeof(modes[0]) && PerfMode_NONE == m_mode; i++)
+    {
+        PerfSlot slot;
+        m_mode = modes[i];
+        m_isUserOnly = userOnlys[i];
+        if (!openGroup(&slot))
+        {
+            m_mode = PerfMode_NONE;
+        }
+        for (auto it = slot.m_fds.begin(); it != slot.m_fds.end(); ++it)
+        {
+            close(*it);
+        }
+    }
+    if (PerfMode_NONE == m_mode)
+    {
+        m_mode = PerfMode_RUSAGE;
+        m_isUserOnly = false;
+    }
+    linfo("perf counter mode %s userOnly %d", kPerfModeNames[m_mode], m_isUserOnly);
+}
+
+bool PerfCounterMgr::readValues(uint64_t values[PerfValue_NUM])
+{
+    PerfSlot* pSlot = getSlot();
+    if (PerfMode_RUSAGE == m_mode)
+    {
+        struct timespec ts;
+        struct rusage usage;
+        if (0 != clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) || 0 != getrusage(RUSAGE_THREAD, &usage))
+        {
+            return false;
+        }
+        values[PerfValue_TASK_CLOCK_NS] = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+        values[PerfValue_PAGE_FAULTS] = usage.ru_minflt + usage.ru_majflt;
+        values[PerfValue_CONTEXT_SWITCHES] = usage.ru_nvcsw + usage.ru_nivcsw;
+        return true;
+    }
+
+    if (-1 == pSlot->m_leaderFd)
+    {
+        return false;
+    }
+    // PERF_FORMAT_GROUP格式为事件个数和每个事件的计数，整组不计数时读取长度为0
+    uint64_t buff[1 + PerfValue_NUM];
+    ssize_t expectLen = (1 + pSlot->m_fds.size()) * sizeof(uint64_t);
+    if (expectLen != read(pSlot->m_leaderFd, buff, sizeof(buff)) || buff[0] != pSlot->m_fds.size())
+    {
+        return false;
+    }
+    uint32_t first = firstValue(m_mode);
+    for (uint32_t i = 0; i < buff[0]; i++)
+    {
+        values[first + i] = buff[1 + i];
+    }
+    return true;
+}
+
+void PerfCounterMgr::addValues(PerfOpType type, const uint64_t startValues[PerfValue_NUM])
+{
+    uint64_t values[PerfValue_NUM];
+    if (!readValues(values))
+    {
+        return ;
+    }
+    // 只有所属线程修改，不需要原子的读改写
+    PerfSlot* pSlot = getSlot();
+    pSlot->m_callNums[type].store(pSlot->m_callNums[type].load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+    for (uint32_t i = firstValue(m_mode); i < PerfValue_NUM; i++)
+    {
+        std::atomic<uint64_t>& sum = pSlot->m_sums[type][i];
+        sum.store(sum.load(std::memory_order_relaxed) + values[i] - startValues[i], std::memory_order_relaxed);
+    }
+}
+
+void PerfCounterMgr::snapshot(StatsInfo& info)
+{
+    info.m_perfMode = m_mode;
+    PerfCounterInfo* infos[PerfOpType_NUM] = { &info.m_readPerf, &info.m_writePerf };
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    for (uint32_t type = 0; type < PerfOpType_NUM; type++)
+    {
+        uint64_t sums[PerfValue_NUM] = { 0 };
+        PerfCounterInfo* pInfo = infos[type];
+        *pInfo = PerfCounterInfo();
+        for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+        {
+            pInfo->m_callNum += (*it)->m_callNums[type].load(std::memory_order_relaxed);
+            for (uint32_t i = 0; i < PerfValue_NUM; i++)
+            {
+                sums[i] += (*it)->m_sums[type][i].load(std::memory_order_relaxed);
+            }
+        }
+        pInfo->m_cycles = sums[PerfValue_CYCLES];
+        pInfo->m_instructions = sums[PerfValue_INSTRUCTIONS];
+        pInfo->m_llcMisses = sums[PerfValue_LLC_MISSES];
+        pInfo->m_dtlbMisses = sums[PerfValue_DTLB_MISSES];
+        pInfo->m_taskClockNs = sums[PerfValue_TASK_CLOCK_NS];
+        pInfo->m_pageFaults = sums[PerfValue_PAGE_FAULTS];
+        pInfo->m_contextSwitches = sums[PerfValue_CONTEXT_SWITCHES];
+    }
+}
+
+PerfSlot* PerfCounterMgr::registerSlot()
+{
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    std::thread::id threadId = std::this_thread::get_id();
+    PerfSlot* pSlot = NULL;
+    for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+    {
+        if ((*it)->m_threadId == threadId)
+        {
+            pSlot = *it;
+            break;
+        }
+    }
+    if (NULL == pSlot)
+    {
+        pSlot = new PerfSlot();
+        m_slots.push_back(pSlot);
+        // 计数组只统计打开它的线程
+        if (PerfMode_RUSAGE != m_mode && !openGroup(pSlot))
+        {
+            lwarn("open perf counter failed, mode %s errno %d", kPerfModeNames[m_mode], errno);
+        }
+    }
+    t_slotCache.m_ownerId = m_id;
+    t_slotCache.m_pSlot = pSlot;
+    return pSlot;
+}
+
+bool PerfCounterMgr::openGroup(PerfSlot* pSlot)
+{
+    for (uint32_t i = firstValue(m_mode); i < PerfValue_NUM; i++)
+    {
+        int fd = openEvent(kPerfEvents[i], m_isUserOnly, pSlot->m_fds.empty() ? -1 : pSlot->m_fds[0]);
+        if (-1 == fd)
+        {
+            int err = errno;
+            for (auto it = pSlot->m_fds.begin(); it != pSlot->m_fds.end(); ++it)
+            {
+                close(*it);
+            }
+            pSlot->m_fds.clear();
+            errno = err;
+            return false;
+        }
+        pSlot->m_fds.push_back(fd);
+    }
+    pSlot->m_leaderFd = pSlot->m_fds[0];
+    return true;
+}
+
+void PerfCounterMgr::clearSlots()
+{
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+    {
+        for (auto fdIt = (*it)->m_fds.begin(); fdIt != (*it)->m_fds.end(); ++fdIt)
+        {
+            close(*fdIt);
+        }
+        SAFE_DELETE(*it);
+    }
+    m_slots.clear();
+}
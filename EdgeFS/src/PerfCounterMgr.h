@@ -0,0 +1,121 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include "IEdgeFS.h"
+
+typedef enum PerfOpType_
+{
+    PerfOpType_READ = 0,
+    PerfOpType_WRITE,
+    PerfOpType_NUM,
+} PerfOpType;
+
+// 一次采集的计数，顺序和硬件模式下计数组中事件的顺序一致，软件模式只有后三个
+typedef enum PerfValue_
+{
+    PerfValue_CYCLES = 0,
+    PerfValue_INSTRUCTIONS,
+    PerfValue_LLC_MISSES,
+    PerfValue_DTLB_MISSES,
+    PerfValue_TASK_CLOCK_NS,
+    PerfValue_PAGE_FAULTS,
+    PerfValue_CONTEXT_SWITCHES,
+    PerfValue_NUM,
+} PerfValue;
+
+// 一个线程的计数组和累计值，累计值只有所属线程修改
+typedef struct PerfSlot_
+{
+    std::thread::id         m_threadId;
+    int                     m_leaderFd;     // 计数组的组长，-1表示没有计数组
+    std::vector<int>        m_fds;
+    std::atomic<uint64_t>   m_callNums[PerfOpType_NUM];
+    std::atomic<uint64_t>   m_sums[PerfOpType_NUM][PerfValue_NUM];
+
+    PerfSlot_();
+} PerfSlot;
+
+typedef struct PerfSlotCache_
+{
+    uint64_t        m_ownerId;
+    PerfSlot*       m_pSlot;
+} PerfSlotCache;
+
+// 读写调用期间调用线程的硬件性能计数，每个线程第一次调用时通过perf_event_open打开自己的计数组
+// 内核不允许硬件计数时退化为软件计数，perf_event_open不可用时使用线程cpu时间和getrusage
+// 每次调用前后各读取一次计数，增加两到四次系统调用，只在开启时使用
+// 并发读取线程中的开销不计入调用线程
+class PerfCounterMgr
+{
+public:
+    PerfCounterMgr();
+    ~PerfCounterMgr();
+
+public:
+    // 探测可用的计数方式，调用时不能有其他线程在计数
+    void initPerfCounterMgr(bool isEnable);
+
+    bool isEnable()
+    {
+        return PerfMode_NONE != m_mode;
+    }
+
+    // 读取调用线程当前的计数，失败时该次调用不计入
+    bool readValues(uint64_t values[PerfValue_NUM]);
+
+    // 把从startValues到现在的增量计入type
+    void addValues(PerfOpType type, const uint64_t startValues[PerfValue_NUM]);
+
+    // 汇总所有线程的计数
+    void snapshot(StatsInfo& info);
+
+private:
+    PerfSlot* getSlot()
+    {
+        return t_slotCache.m_ownerId == m_id ? t_slotCache.m_pSlot : registerSlot();
+    }
+
+    PerfSlot* registerSlot();
+
+    // 按m_mode在调用线程上打开计数组
+    bool openGroup(PerfSlot* pSlot);
+
+    void clearSlots();
+
+private:
+    static thread_local PerfSlotCache   t_slotCache;
+
+    uint64_t                    m_id;
+    PerfMode                    m_mode;
+    bool                        m_isUserOnly;   // 内核只允许统计用户态时，系统调用内部的开销不计入
+    std::vector<PerfSlot*>      m_slots;
+    std::mutex                  m_slotMutex;
+};
+
+// 作用域内的一次调用，析构时计入
+class PerfScope
+{
+public:
+    PerfScope(PerfCounterMgr* pPerfCounterMgr, PerfOpType type)
+    : m_pPerfCounterMgr(NULL)
+    , m_type(type)
+    {
+        if (pPerfCounterMgr->isEnable() && pPerfCounterMgr->readValues(m_values))
+        {
+            m_pPerfCounterMgr = pPerfCounterMgr;
+        }
+    }
+
+    ~PerfScope()
+    {
+        if (NULL != m_pPerfCounterMgr)
+        {
+            m_pPerfCounterMgr->addValues(m_type, m_values);
+        }
+    }
+
+private:
+    PerfCounterMgr* m_pPerfCounterMgr;
+    PerfOpType      m_type;
+    uint64_t        m_values[PerfValue_NUM];
+};
@@ -0,0 +1,166 @@
+#include "ProgressMgr.h"
+#include "common/common.h"
+
+ProgressMgr::ProgressMgr()
+: m_entryNum(0)
+, m_hasPending(false)
+{
+}
+
+ProgressMgr::~ProgressMgr()
+{
+}
+
+ProgressEntry* ProgressMgr::findEntry(const char* sha1Val)
+{
+    auto it = m_entries.find(std::string(sha1Val, SHA_DIGEST_LENGTH));
+    return it == m_entries.end() ? NULL : &it->second;
+}
+
+bool ProgressMgr::begin(const char* sha1Val, uint64_t availLen)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (NULL != findEntry(sha1Val))
+    {
+        return false;
+    }
+    m_entries[std::string(sha1Val, SHA_DIGEST_LENGTH)].m_availLen = availLen;
+    m_entryNum.store((uint32_t)m_entries.size(), std::memory_order_relaxed);
+    return true;
+}
+
+void ProgressMgr::finishEntry(ProgressEntry& entry, uint64_t availLen)
+{
+    for (auto it = entry.m_watchers.begin(); it != entry.m_watchers.end(); ++it)
+    {
+        m_pendingCallbacks.push_back(std::bind(it->m_callback, availLen, true));
+    }
+    m_hasPending.store(!m_pendingCallbacks.empty(), std::memory_order_relaxed);
+}
+
+bool ProgressMgr::complete(const char* sha1Val, uint64_t availLen)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(std::string(sha1Val, SHA_DIGEST_LENGTH));
+    if (it == m_entries.end())
+    {
+        return false;
+    }
+    finishEntry(it->second, availLen);
+    m_entries.erase(it);
+    m_entryNum.store((uint32_t)m_entries.size(), std::memory_order_relaxed);
+    m_cond.notify_all();
+    return true;
+}
+
+void ProgressMgr::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        finishEntry(it->second, it->second.m_availLen);
+    }
+    m_entries.clear();
+    m_entryNum.store(0, std::memory_order_relaxed);
+    m_cond.notify_all();
+}
+
+bool ProgressMgr::isInProgress(const char* sha1Val)
+{
+    if (0 == m_entryNum.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return NULL != findEntry(sha1Val);
+}
+
+void ProgressMgr::onWrite(const char* sha1Val, uint64_t availLen)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ProgressEntry* pEntry = findEntry(sha1Val);
+    if (NULL == pEntry)
+    {
+        return ;
+    }
+    pEntry->m_writeNum++;
+    pEntry->m_availLen = availLen;
+
+    // 触发的回调移到待执行列表，没有触发的保持原来的顺序
+    uint32_t keepNum = 0;
+    for (uint32_t i = 0; i < pEntry->m_watchers.size(); i++)
+    {
+        ProgressWatcher& watcher = pEntry->m_watchers[i];
+        if (watcher.m_offset < availLen)
+        {
+            m_pendingCallbacks.push_back(std::bind(watcher.m_callback, availLen, false));
+            continue;
+        }
+        if (keepNum != i)
+        {
+            pEntry->m_watchers[keepNum] = watcher;
+        }
+        keepNum++;
+    }
+    pEntry->m_watchers.resize(keepNum);
+    m_hasPending.store(!m_pendingCallbacks.empty(), std::memory_order_relaxed);
+    m_cond.notify_all();
+}
+
+bool ProgressMgr::getWriteNum(const char* sha1Val, uint64_t& writeNum)
+{
+    if (0 == m_entryNum.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ProgressEntry* pEntry = findEntry(sha1Val);
+    if (NULL == pEntry)
+    {
+        return false;
+    }
+    writeNum = pEntry->m_writeNum;
+    return true;
+}
+
+bool ProgressMgr::wait(const char* sha1Val, uint64_t writeNum, const std::chrono::steady_clock::time_point& deadline)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_cond.wait_until(lock, deadline, [this, sha1Val, writeNum]()
+        {
+            ProgressEntry* pEntry = findEntry(sha1Val);
+            return NULL == pEntry || pEntry->m_writeNum != writeNum;
+        });
+}
+
+void ProgressMgr::addWatcher(const char* sha1Val, uint64_t offset, uint64_t availLen, const ProgressCallback& callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ProgressEntry* pEntry = findEntry(sha1Val);
+    if (NULL == pEntry || offset < availLen)
+    {
+        m_pendingCallbacks.push_back(std::bind(callback, availLen, NULL == pEntry));
+        m_hasPending.store(true, std::memory_order_relaxed);
+        return ;
+    }
+    ProgressWatcher watcher = { offset, callback };
+    pEntry->m_watchers.push_back(watcher);
+}
+
+void ProgressMgr::dispatch()
+{
+    if (!m_hasPending.load(std::memory_order_relaxed))
+    {
+        return ;
+    }
+    std::vector<std::function<void()> > callbacks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        callbacks.swap(m_pendingCallbacks);
+        m_hasPending.store(false, std::memory_order_relaxed);
+    }
+    for (auto it = callbacks.begin(); it != callbacks.end(); ++it)
+    {
+        (*it)();
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include "IEdgeFS.h"
+
+// 等待数据到达的一次回调
+typedef struct ProgressWatcher_
+{
+    uint64_t            m_offset;
+    ProgressCallback    m_callback;
+} ProgressWatcher;
+
+// 一个正在下载的文件
+typedef struct ProgressEntry_
+{
+    uint64_t        m_writeNum;         // 写入次数，等待中的读取据此判断是否有新的数据
+    uint64_t        m_availLen;         // 从头连续可读的长度
+    std::vector<ProgressWatcher> m_watchers;
+
+    ProgressEntry_()
+    : m_writeNum(0)
+    , m_availLen(0)
+    {}
+} ProgressEntry;
+
+// 记录正在下载的文件，读取在数据到达或者下载结束时被唤醒，只保存在内存中
+// 调用onWrite时可以持有EdgeFS的锁，wait只持有自己的锁，触发的回调由dispatch在释放EdgeFS的锁之后执行
+class ProgressMgr
+{
+public:
+    ProgressMgr();
+    ~ProgressMgr();
+
+public:
+    // 已经在下载中时返回false
+    bool begin(const char* sha1Val, uint64_t availLen);
+
+    // 唤醒所有等待的读取，触发所有回调，不在下载中时返回false
+    bool complete(const char* sha1Val, uint64_t availLen);
+
+    // 结束所有文件的下载，用于unitFS
+    void clear();
+
+    bool isInProgress(const char* sha1Val);
+
+    // 写入之后调用，触发offset在availLen之前的回调
+    void onWrite(const char* sha1Val, uint64_t availLen);
+
+    // 读取之前获取写入次数，不在下载中时返回false
+    bool getWriteNum(const char* sha1Val, uint64_t& writeNum);
+
+    // 等待writeNum之后的写入或者下载结束，超时返回false
+    bool wait(const char* sha1Val, uint64_t writeNum, const std::chrono::steady_clock::time_point& deadline);
+
+    // 数据已经到达或者不在下载中时回调立即进入待执行列表，否则等待之后的写入
+    void addWatcher(const char* sha1Val, uint64_t offset, uint64_t availLen, const ProgressCallback& callback);
+
+    // 执行已经触发的回调，调用时不能持有EdgeFS的锁
+    void dispatch();
+
+private:
+    ProgressEntry* findEntry(const char* sha1Val);
+
+    // 调用时持有m_mutex
+    void finishEntry(ProgressEntry& entry, uint64_t availLen);
+
+private:
+    std::mutex                              m_mutex;
+    std::condition_variable                 m_cond;
+    std::map<std::string, ProgressEntry>    m_entries;
+    std::atomic<uint32_t>                   m_entryNum;     // 没有下载中的文件时写入不加锁直接返回
+    std::vector<std::function<void()> >     m_pendingCallbacks;
+    std::atomic<bool>                       m_hasPending;
+};
+
+// 在EdgeFS的锁之前构造，析构时已经释放锁，回调中可以继续读写
+class ProgressDispatch
+{
+public:
+    explicit ProgressDispatch(ProgressMgr* pProgressMgr)
+    : m_pProgressMgr(pProgressMgr)
+    {}
+
+    ~ProgressDispatch()
+    {
+        m_pProgressMgr->dispatch();
+    }
+
+private:
+    ProgressMgr*    m_pProgressMgr;
+};
@@ -0,0 +1,94 @@
+#include "ReadaheadMgr.h"
+#include "common/common.h"
+
+ReadaheadMgr::ReadaheadMgr()
+: m_minWindow(0)
+, m_maxWindow(0)
+, m_hitNum(0)
+, m_wasteNum(0)
+, m_issueBytes(0)
+{
+    memset(m_streams, 0, sizeof(m_streams));
+}
+
+ReadaheadMgr::~ReadaheadMgr()
+{
+}
+
+void ReadaheadMgr::initReadaheadMgr(uint32_t minWindow, uint32_t maxWindow)
+{
+    m_minWindow = std::min(minWindow, maxWindow);
+    m_maxWindow = maxWindow;
+    memset(m_streams, 0, sizeof(m_streams));
+}
+
+ReadStream* ReadaheadMgr::findStream(const char* sha1Val)
+{
+    // 直接映射，冲突时新文件替换旧文件的状态
+    ReadStream* pStream = m_streams + (*(uint32_t*)(sha1Val + 8)) % kStreamNum;
+    if (!pStream->m_isUsed || 0 != memcmp(pStream->m_sha1, sha1Val, sizeof(pStream->m_sha1)))
+    {
+        memcpy(pStream->m_sha1, sha1Val, sizeof(pStream->m_sha1));
+        pStream->m_isUsed = false;
+        pStream->m_seqNum = 0;
+        pStream->m_window = m_minWindow;
+        pStream->m_nextOffset = 0;
+        pStream->m_raEnd = 0;
+    }
+    return pStream;
+}
+
+bool ReadaheadMgr::onRead(const char* sha1Val, uint64_t offset, uint32_t len, uint64_t fileSize, uint64_t& raOffset,
+    uint32_t& raLen)
+{
+    if (!isEnable() || 0 == len)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ReadStream* pStream = findStream(sha1Val);
+    uint64_t readEnd = offset + len;
+
+    if (pStream->m_isUsed && offset == pStream->m_nextOffset)
+    {
+        pStream->m_seqNum++;
+        // 本次读取的数据已经预读，说明窗口有效，继续增大
+        if (readEnd <= pStream->m_raEnd)
+        {
+            m_hitNum++;
+            pStream->m_window = std::min(pStream->m_window * 2, m_maxWindow);
+        }
+    }
+    else
+    {
+        // 顺序读中断，预读的数据没有用完，减小窗口
+        if (pStream->m_isUsed && pStream->m_raEnd > pStream->m_nextOffset)
+        {
+            m_wasteNum++;
+            pStream->m_window = std::max(pStream->m_window / 2, m_minWindow);
+        }
+        pStream->m_isUsed = true;
+        pStream->m_seqNum = 1;
+        pStream->m_raEnd = 0;
+    }
+    pStream->m_nextOffset = readEnd;
+
+    if (pStream->m_seqNum < kSeqThreshold)
+    {
+        return false;
+    }
+
+    // 已经预读但还没有读取的数据不足半个窗口时，从预读的结束位置继续预读
+    uint64_t start = std::max(pStream->m_raEnd, readEnd);
+    if (start - readEnd >= pStream->m_window / 2 || start >= fileSize)
+    {
+        return false;
+    }
+
+    raOffset = start;
+    raLen = std::min((uint64_t)pStream->m_window, fileSize - start);
+    pStream->m_raEnd = start + raLen;
+    m_issueBytes += raLen;
+    return true;
+}
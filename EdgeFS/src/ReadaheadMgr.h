@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common/SystemHead.h"
+
+// 单个文件的顺序读状态
+typedef struct ReadStream_
+{
+    char            m_sha1[20];
+    bool            m_isUsed;
+    uint32_t        m_seqNum;           // 连续顺序读的次数
+    uint32_t        m_window;           // 当前预读窗口大小
+    uint64_t        m_nextOffset;       // 顺序读时下一次读取的文件内偏移
+    uint64_t        m_raEnd;            // 已经发起预读的文件内结束位置
+} ReadStream;
+
+// 识别文件的顺序读，计算需要预读的范围，预读窗口按照命中情况增大或减小
+// 读取只持有EdgeFS的共享锁，onRead由自己的锁保护
+class ReadaheadMgr
+{
+public:
+    ReadaheadMgr();
+    ~ReadaheadMgr();
+
+public:
+    // maxWindow为0表示不预读
+    void initReadaheadMgr(uint32_t minWindow, uint32_t maxWindow);
+
+    // 记录一次读取，需要预读时返回true，raOffset和raLen为文件内的预读范围
+    bool onRead(const char* sha1Val, uint64_t offset, uint32_t len, uint64_t fileSize, uint64_t& raOffset,
+        uint32_t& raLen);
+
+    bool isEnable()
+    {
+        return 0 != m_maxWindow;
+    }
+
+public:
+    uint64_t getHitNum()        { return m_hitNum; }
+    uint64_t getWasteNum()      { return m_wasteNum; }
+    uint64_t getIssueBytes()    { return m_issueBytes; }
+
+private:
+    ReadStream* findStream(const char* sha1Val);
+
+private:
+    static const uint32_t   kStreamNum = 64;
+    // 连续顺序读达到该次数后开始预读
+    static const uint32_t   kSeqThreshold = 2;
+
+    std::mutex      m_mutex;
+    ReadStream      m_streams[kStreamNum];
+    uint32_t        m_minWindow;
+    uint32_t        m_maxWindow;
+
+    uint64_t        m_hitNum;           // 读取完全落在预读范围内的次数
+    uint64_t        m_wasteNum;         // 预读的数据没有被读取就中断的次数
+    uint64_t        m_issueBytes;       // 发起预读的总字节数
+};
@@ -0,0 +1,200 @@
+#include "StatsMgr.h"
+#include "common/common.h"
+
+static std::atomic<uint64_t> s_nextStatsId(1);
+
+thread_local SlotCache StatsMgr::t_slotCache = { 0, NULL };
+
+uint64_t LatencyHistogram_::bucketMaxNs(uint32_t idx)
+{
+    if (idx < kSubBucketNum)
+    {
+        return idx;
+    }
+    uint32_t bit = idx / kSubBucketNum + kSubBucketBits - 1;
+    uint64_t sub = idx % kSubBucketNum;
+    uint64_t width = 1ull << (bit - kSubBucketBits);
+    return ((kSubBucketNum + sub) << (bit - kSubBucketBits)) + width - 1;
+}
+
+uint64_t LatencyHistogram_::percentile(double percent) const
+{
+    if (0 == m_count)
+    {
+        return 0;
+    }
+    uint64_t target = (uint64_t)(m_count * percent / 100.0 + 0.5);
+    target = std::max(target, (uint64_t)1);
+    uint64_t count = 0;
+    for (uint32_t idx = 0; idx < kBucketNum; idx++)
+    {
+        count += m_buckets[idx];
+        if (count >= target)
+        {
+            return bucketMaxNs(idx);
+        }
+    }
+    return bucketMaxNs(kBucketNum - 1);
+}
+
+void LatencyHistogram_::subtract(const LatencyHistogram_& prev)
+{
+    m_count -= prev.m_count;
+    m_sumNs -= prev.m_sumNs;
+    for (uint32_t idx = 0; idx < kBucketNum; idx++)
+    {
+        m_buckets[idx] -= prev.m_buckets[idx];
+    }
+}
+
+void PerfCounterInfo_::subtract(const PerfCounterInfo_& prev)
+{
+    m_callNum -= prev.m_callNum;
+    m_cycles -= prev.m_cycles;
+    m_instructions -= prev.m_instructions;
+    m_llcMisses -= prev.m_llcMisses;
+    m_dtlbMisses -= prev.m_dtlbMisses;
+    m_taskClockNs -= prev.m_taskClockNs;
+    m_pageFaults -= prev.m_pageFaults;
+    m_contextSwitches -= prev.m_contextSwitches;
+}
+
+void StatsInfo_::subtract(const StatsInfo_& prev)
+{
+    m_timeNs -= prev.m_timeNs;
+    m_readNum -= prev.m_readNum;
+    m_readBytes -= prev.m_readBytes;
+    m_readFailNum -= prev.m_readFailNum;
+    m_writeNum -= prev.m_writeNum;
+    m_writeBytes -= prev.m_writeBytes;
+    m_writeFailNum -= prev.m_writeFailNum;
+    m_lookupNum -= prev.m_lookupNum;
+    m_lookupNodeNum -= prev.m_lookupNodeNum;
+    m_allocNum -= prev.m_allocNum;
+    m_allocScanNum -= prev.m_allocScanNum;
+    m_diskReadNum -= prev.m_diskReadNum;
+    m_diskReadBytes -= prev.m_diskReadBytes;
+    m_diskWriteNum -= prev.m_diskWriteNum;
+    m_diskWriteBytes -= prev.m_diskWriteBytes;
+    m_diskSyncNum -= prev.m_diskSyncNum;
+    m_readaheadHitNum -= prev.m_readaheadHitNum;
+    m_readaheadWasteNum -= prev.m_readaheadWasteNum;
+    m_originFetchNum -= prev.m_originFetchNum;
+    m_originFetchBytes -= prev.m_originFetchBytes;
+    m_originFailNum -= prev.m_originFailNum;
+    m_originCoalesceNum -= prev.m_originCoalesceNum;
+    m_readLatency.subtract(prev.m_readLatency);
+    m_writeLatency.subtract(prev.m_writeLatency);
+    m_syncLatency.subtract(prev.m_syncLatency);
+    m_readPerf.subtract(prev.m_readPerf);
+    m_writePerf.subtract(prev.m_writePerf);
+}
+
+StatsSlot_::StatsSlot_()
+: m_threadId(std::this_thread::get_id())
+, m_callNum(0)
+{
+    for (uint32_t i = 0; i < StatType_NUM; i++)
+    {
+        m_counters[i] = 0;
+    }
+    for (uint32_t type = 0; type < LatencyType_NUM; type++)
+    {
+        m_latencyCounts[type] = 0;
+        m_latencySums[type] = 0;
+        for (uint32_t idx = 0; idx < LatencyHistogram::kBucketNum; idx++)
+        {
+            m_buckets[type][idx] = 0;
+        }
+    }
+}
+
+StatsMgr::StatsMgr()
+: m_id(s_nextStatsId++)
+{
+}
+
+StatsMgr::~StatsMgr()
+{
+    for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+    {
+        SAFE_DELETE(*it);
+    }
+    m_slots.clear();
+}
+
+void StatsMgr::recordLatency(LatencyType type, uint64_t ns)
+{
+    StatsSlot* pSlot = getSlot();
+    increase(pSlot->m_latencyCounts[type], 1);
+    increase(pSlot->m_latencySums[type], ns);
+    increase(pSlot->m_buckets[type][LatencyHistogram::bucketIdx(ns)], 1);
+}
+
+void StatsMgr::snapshot(StatsInfo& info)
+{
+    uint64_t counters[StatType_NUM] = { 0 };
+    LatencyHistogram* histograms[LatencyType_NUM] = { &info.m_readLatency, &info.m_writeLatency,
+        &info.m_syncLatency };
+    for (uint32_t type = 0; type < LatencyType_NUM; type++)
+    {
+        *histograms[type] = LatencyHistogram();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_slotMutex);
+        for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+        {
+            const StatsSlot* pSlot = *it;
+            for (uint32_t i = 0; i < StatType_NUM; i++)
+            {
+                counters[i] += pSlot->m_counters[i].load(std::memory_order_relaxed);
+            }
+            for (uint32_t type = 0; type < LatencyType_NUM; type++)
+            {
+                LatencyHistogram* pHistogram = histograms[type];
+                pHistogram->m_count += pSlot->m_latencyCounts[type].load(std::memory_order_relaxed);
+                pHistogram->m_sumNs += pSlot->m_latencySums[type].load(std::memory_order_relaxed);
+                for (uint32_t idx = 0; idx < LatencyHistogram::kBucketNum; idx++)
+                {
+                    pHistogram->m_buckets[idx] += pSlot->m_buckets[type][idx].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    info.m_readNum = counters[StatType_READ_NUM];
+    info.m_readBytes = counters[StatType_READ_BYTES];
+    info.m_readFailNum = counters[StatType_READ_FAIL_NUM];
+    info.m_writeNum = counters[StatType_WRITE_NUM];
+    info.m_writeBytes = counters[StatType_WRITE_BYTES];
+    info.m_writeFailNum = counters[StatType_WRITE_FAIL_NUM];
+    info.m_lookupNum = counters[StatType_LOOKUP_NUM];
+    info.m_lookupNodeNum = counters[StatType_LOOKUP_NODE_NUM];
+    info.m_allocNum = counters[StatType_ALLOC_NUM];
+    info.m_allocScanNum = counters[StatType_ALLOC_SCAN_NUM];
+}
+
+StatsSlot* StatsMgr::registerSlot()
+{
+    // 线程第一次计数，或者上次计数的是其他实例
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    std::thread::id threadId = std::this_thread::get_id();
+    StatsSlot* pSlot = NULL;
+    for (auto it = m_slots.begin(); it != m_slots.end(); ++it)
+    {
+        if ((*it)->m_threadId == threadId)
+        {
+            pSlot = *it;
+            break;
+        }
+    }
+    if (NULL == pSlot)
+    {
+        pSlot = new StatsSlot();
+        m_slots.push_back(pSlot);
+    }
+    t_slotCache.m_ownerId = m_id;
+    t_slotCache.m_pSlot = pSlot;
+    return pSlot;
+}
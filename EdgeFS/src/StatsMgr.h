@@ -0,0 +1,118 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include <time.h>
+#include "IEdgeFS.h"
+
+typedef enum StatType_
+{
+    StatType_READ_NUM = 0,
+    StatType_READ_BYTES,
+    StatType_READ_FAIL_NUM,
+    StatType_WRITE_NUM,
+    StatType_WRITE_BYTES,
+    StatType_WRITE_FAIL_NUM,
+    StatType_LOOKUP_NUM,
+    StatType_LOOKUP_NODE_NUM,
+    StatType_ALLOC_NUM,
+    StatType_ALLOC_SCAN_NUM,
+    StatType_NUM,
+} StatType;
+
+typedef enum LatencyType_
+{
+    LatencyType_READ = 0,
+    LatencyType_WRITE,
+    LatencyType_SYNC,
+    LatencyType_NUM,
+} LatencyType;
+
+// 一个线程的计数，只有所属线程修改，汇总时其他线程读取
+typedef struct StatsSlot_
+{
+    std::thread::id         m_threadId;
+    uint32_t                m_callNum;      // 用于延迟采样，只有所属线程访问
+    std::atomic<uint64_t>   m_counters[StatType_NUM];
+    std::atomic<uint64_t>   m_latencyCounts[LatencyType_NUM];
+    std::atomic<uint64_t>   m_latencySums[LatencyType_NUM];
+    std::atomic<uint64_t>   m_buckets[LatencyType_NUM][LatencyHistogram::kBucketNum];
+
+    StatsSlot_();
+} StatsSlot;
+
+// 线程最近使用的slot，同一线程交替访问多个实例时每次切换需要加锁查找
+typedef struct SlotCache_
+{
+    uint64_t        m_ownerId;
+    StatsSlot*      m_pSlot;
+} SlotCache;
+
+// 读写路径上的计数和延迟分布，每个线程第一次计数时分配自己的slot，之后只修改自己的slot
+// 计数时没有锁和原子读改写，获取统计时汇总所有slot
+// 读取时钟比计数慢得多，每个线程每kLatencySampleInterval次调用采样一次延迟
+class StatsMgr
+{
+public:
+    StatsMgr();
+    ~StatsMgr();
+
+public:
+    // numType加1，sumType加value，只查找一次slot
+    void add(StatType numType, StatType sumType, uint64_t value)
+    {
+        StatsSlot* pSlot = getSlot();
+        increase(pSlot->m_counters[numType], 1);
+        increase(pSlot->m_counters[sumType], value);
+    }
+
+    // 调用开始时获取，不采样的调用返回0
+    uint64_t beginLatency()
+    {
+        StatsSlot* pSlot = getSlot();
+        return 0 == pSlot->m_callNum++ % kLatencySampleInterval ? nowNs() : 0;
+    }
+
+    // 记录从beginLatency到现在的耗时，startNs为0时不记录
+    void addLatency(LatencyType type, uint64_t startNs)
+    {
+        if (0 != startNs)
+        {
+            recordLatency(type, nowNs() - startNs);
+        }
+    }
+
+    // 汇总所有线程的计数，不包括m_timeNs和磁盘、预读的统计
+    void snapshot(StatsInfo& info);
+
+    static uint64_t nowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+private:
+    StatsSlot* getSlot()
+    {
+        return t_slotCache.m_ownerId == m_id ? t_slotCache.m_pSlot : registerSlot();
+    }
+
+    StatsSlot* registerSlot();
+
+    void recordLatency(LatencyType type, uint64_t ns);
+
+    // 只有一个线程修改，不需要原子的读改写
+    static void increase(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+private:
+    static const uint32_t       kLatencySampleInterval = 16;
+    static thread_local SlotCache   t_slotCache;
+
+    // 区分不同的实例，线程缓存的slot属于已经销毁的实例时不会被误用
+    uint64_t                    m_id;
+    std::vector<StatsSlot*>     m_slots;
+    std::mutex                  m_slotMutex;
+};
@@ -0,0 +1,174 @@
+#include "TraceMgr.h"
+#include "EdgeFSConst.h"
+#include "common/common.h"
+
+// 事件名称和参数名称，参数名称为NULL时不输出参数
+static const char* const kTraceNames[TraceType_NUM] = {
+    "read", "write", "readBatch", "writeBatch", "sync", "hash", "lookup", "alloc", "diskRead", "diskWrite",
+    "diskSync", "meta"
+};
+static const char* const kTraceArgNames[TraceType_NUM] = {
+    "len", "len", "reqNum", "reqNum", NULL, "len", "nodeNum", "scanNum", "len", "len", NULL, NULL
+};
+
+static std::atomic<uint64_t> s_nextTraceId(1);
+
+thread_local TraceRingCache TraceMgr::t_ringCache = { 0, NULL };
+
+TraceRing_::TraceRing_(uint32_t eventNum)
+: m_threadId(std::this_thread::get_id())
+, m_tid((uint32_t)syscall(SYS_gettid))
+, m_events(eventNum)
+, m_writeNum(0)
+{
+}
+
+TraceMgr::TraceMgr()
+: m_id(s_nextTraceId++)
+, m_eventNum(0)
+, m_slowNs(0)
+, m_lastSlowDumpNs(0)
+{
+}
+
+TraceMgr::~TraceMgr()
+{
+    clearRings();
+}
+
+void TraceMgr::initTraceMgr(uint32_t eventNum, uint32_t slowUs, const std::string& slowPath)
+{
+    clearRings();
+    m_id = s_nextTraceId++;
+    m_eventNum = eventNum;
+    m_slowNs = slowUs * 1000ull;
+    m_slowPath = slowPath;
+    m_lastSlowDumpNs = 0;
+}
+
+void TraceMgr::record(TraceType type, uint64_t startNs, uint64_t arg)
+{
+    uint64_t endNs = StatsMgr::nowNs();
+    TraceRing* pRing = getRing();
+    uint64_t writeNum = pRing->m_writeNum.load(std::memory_order_relaxed);
+    TraceEvent& event = pRing->m_events[writeNum % pRing->m_events.size()];
+    event.m_startNs = startNs;
+    event.m_durNs = endNs - startNs;
+    event.m_arg = arg;
+    event.m_type = type;
+    pRing->m_writeNum.store(writeNum + 1, std::memory_order_release);
+
+    if (0 == m_slowNs || type > TraceType_SYNC || endNs - startNs < m_slowNs)
+    {
+        return ;
+    }
+    // 多个线程同时变慢时只有一个导出
+    uint64_t lastNs = m_lastSlowDumpNs.load();
+    if (endNs - lastNs >= kSlowTraceIntervalMs * 1000000ull && m_lastSlowDumpNs.compare_exchange_strong(lastNs, endNs))
+    {
+        lwarn("slow %s cost %" PRIu64 "us, dump trace to %s", kTraceNames[type], (endNs - startNs) / 1000,
+            m_slowPath.c_str());
+        dump(m_slowPath);
+    }
+}
+
+bool TraceMgr::dump(const std::string& path)
+{
+    if (!isEnable())
+    {
+        return false;
+    }
+
+    std::vector<TraceEvent> events;
+    std::vector<uint32_t> tids;
+    {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        for (auto it = m_rings.begin(); it != m_rings.end(); ++it)
+        {
+            const TraceRing* pRing = *it;
+            uint64_t size = pRing->m_events.size();
+            uint64_t endNum = pRing->m_writeNum.load(std::memory_order_acquire);
+            uint64_t beginNum = endNum > size ? endNum - size : 0;
+            size_t oldSize = events.size();
+            for (uint64_t num = beginNum; num < endNum; num++)
+            {
+                events.push_back(pRing->m_events[num % size]);
+            }
+            // 复制期间被覆盖的事件可能不完整，丢弃
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t newEndNum = pRing->m_writeNum.load(std::memory_order_relaxed);
+            uint64_t validNum = newEndNum > size ? newEndNum - size : 0;
+            uint64_t dropNum = validNum > beginNum ? std::min(validNum - beginNum, endNum - beginNum) : 0;
+            events.erase(events.begin() + oldSize, events.begin() + oldSize + dropNum);
+            tids.resize(events.size(), pRing->m_tid);
+        }
+    }
+
+    uint64_t baseNs = UINT64_MAX;
+    for (auto it = events.begin(); it != events.end(); ++it)
+    {
+        baseNs = std::min(baseNs, it->m_startNs);
+    }
+
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    char line[256];
+    int pid = getpid();
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const TraceEvent& event = events[i];
+        int len = snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"cat\":\"edgefs\",\"ph\":\"X\",\"ts\":%.3f,"
+            "\"dur\":%.3f,\"pid\":%d,\"tid\":%u", 0 == i ? "" : ",", kTraceNames[event.m_type],
+            (event.m_startNs - baseNs) / 1000.0, event.m_durNs / 1000.0, pid, tids[i]);
+        json.append(line, len);
+        if (NULL != kTraceArgNames[event.m_type])
+        {
+            len = snprintf(line, sizeof(line), ",\"args\":{\"%s\":%" PRIu64 "}", kTraceArgNames[event.m_type],
+                event.m_arg);
+            json.append(line, len);
+        }
+        json += "}";
+    }
+    json += "\n]}\n";
+
+    FileOper file(path);
+    if (!file.open(O_WRONLY | O_CREAT | O_TRUNC) || !file.write(json.c_str(), json.size()))
+    {
+        lerror("dump trace failed, path %s", path.c_str());
+        return false;
+    }
+    linfo("dump trace, path %s eventNum %zu", path.c_str(), events.size());
+    return true;
+}
+
+TraceRing* TraceMgr::registerRing()
+{
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    std::thread::id threadId = std::this_thread::get_id();
+    TraceRing* pRing = NULL;
+    for (auto it = m_rings.begin(); it != m_rings.end(); ++it)
+    {
+        if ((*it)->m_threadId == threadId)
+        {
+            pRing = *it;
+            break;
+        }
+    }
+    if (NULL == pRing)
+    {
+        pRing = new TraceRing(m_eventNum);
+        m_rings.push_back(pRing);
+    }
+    t_ringCache.m_ownerId = m_id;
+    t_ringCache.m_pRing = pRing;
+    return pRing;
+}
+
+void TraceMgr::clearRings()
+{
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    for (auto it = m_rings.begin(); it != m_rings.end(); ++it)
+    {
+        SAFE_DELETE(*it);
+    }
+    m_rings.clear();
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "common/SystemHead.h"
+#include "StatsMgr.h"
+
+// READ到SYNC是对外接口的调用，耗时超过阈值时触发导出
+typedef enum TraceType_
+{
+    TraceType_READ = 0,
+    TraceType_WRITE,
+    TraceType_READ_BATCH,
+    TraceType_WRITE_BATCH,
+    TraceType_SYNC,
+    TraceType_HASH,
+    TraceType_LOOKUP,
+    TraceType_ALLOC,
+    TraceType_DISK_READ,
+    TraceType_DISK_WRITE,
+    TraceType_DISK_SYNC,
+    TraceType_META,
+    TraceType_NUM,
+} TraceType;
+
+typedef struct TraceEvent_
+{
+    uint64_t        m_startNs;
+    uint64_t        m_durNs;
+    uint64_t        m_arg;
+    uint32_t        m_type;
+} TraceEvent;
+
+// 一个线程最近的事件，只有所属线程写入，写满后覆盖最早的事件
+typedef struct TraceRing_
+{
+    std::thread::id         m_threadId;
+    uint32_t                m_tid;
+    std::vector<TraceEvent> m_events;
+    std::atomic<uint64_t>   m_writeNum;     // 写入过的事件总数
+
+    TraceRing_(uint32_t eventNum);
+} TraceRing;
+
+typedef struct TraceRingCache_
+{
+    uint64_t        m_ownerId;
+    TraceRing*      m_pRing;
+} TraceRingCache;
+
+// 按操作记录耗时，每个线程写入自己的环形缓冲区，导出为chrome trace格式的json
+// 可以在chrome://tracing或者Perfetto中打开，不开启时只有一次判断
+class TraceMgr
+{
+public:
+    TraceMgr();
+    ~TraceMgr();
+
+public:
+    // eventNum为0表示不追踪，slowUs为0表示不按耗时自动导出
+    // 调用时不能有其他线程在记录
+    void initTraceMgr(uint32_t eventNum, uint32_t slowUs, const std::string& slowPath);
+
+    bool isEnable()
+    {
+        return 0 != m_eventNum;
+    }
+
+    // 记录从startNs到现在的一个事件
+    void record(TraceType type, uint64_t startNs, uint64_t arg);
+
+    // 导出所有线程最近的事件，可以和记录并发调用，正在被覆盖的事件会被丢弃
+    bool dump(const std::string& path);
+
+private:
+    TraceRing* getRing()
+    {
+        return t_ringCache.m_ownerId == m_id ? t_ringCache.m_pRing : registerRing();
+    }
+
+    TraceRing* registerRing();
+
+    void clearRings();
+
+private:
+    static thread_local TraceRingCache  t_ringCache;
+
+    // 每次初始化重新分配，线程缓存的旧缓冲区不会被误用
+    uint64_t                    m_id;
+    uint32_t                    m_eventNum;
+    uint64_t                    m_slowNs;
+    std::string                 m_slowPath;
+    std::atomic<uint64_t>       m_lastSlowDumpNs;
+
+    std::vector<TraceRing*>     m_rings;
+    std::mutex                  m_ringMutex;
+};
+
+// 作用域内的一个事件，析构时记录
+class TraceSpan
+{
+public:
+    TraceSpan(TraceMgr* pTraceMgr, TraceType type, uint64_t arg = 0)
+    : m_pTraceMgr(NULL != pTraceMgr && pTraceMgr->isEnable() ? pTraceMgr : NULL)
+    , m_type(type)
+    , m_arg(arg)
+    , m_startNs(NULL != m_pTraceMgr ? StatsMgr::nowNs() : 0)
+    {}
+
+    ~TraceSpan()
+    {
+        if (NULL != m_pTraceMgr)
+        {
+            m_pTraceMgr->record(m_type, m_startNs, m_arg);
+        }
+    }
+
+    void setArg(uint64_t arg)
+    {
+        m_arg = arg;
+    }
+
+private:
+    TraceMgr*       m_pTraceMgr;
+    TraceType       m_type;
+    uint64_t        m_arg;
+    uint64_t        m_startNs;
+};
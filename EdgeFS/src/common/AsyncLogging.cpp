@@ -1,124 +1,522 @@
-#include "common.h"
-
-AsyncLogging* AsyncLogging::m_pInstance = NULL;
-
-void AsyncLogging::create()
-{
-    if (NULL == m_pInstance)
-    {
-        m_pInstance = new AsyncLogging();
-    }
-}
-
-void AsyncLogging::release()
-{
-    if (NULL != m_pInstance)
-    {
-        delete m_pInstance;
-        m_pInstance = NULL;
-    }
-}
-
-AsyncLogging* AsyncLogging::instance()
-{
-    return m_pInstance;
-}
-
-AsyncLogging::AsyncLogging()
-: m_loglevel(LogLevel_INFO)
-, m_isStop(true)
-{
-    m_pFileOper = new FileOper();
-    start();
-}
-
-AsyncLogging::~AsyncLogging()
-{
-    stop();
-    m_pFileOper->close();
-    SAFE_DELETE(m_pFileOper);
-}
-
-void AsyncLogging::init(const std::string& path)
-{
-    m_pFileOper->setPath(path);
-    m_pFileOper->open(O_RDWR | O_CREAT | O_APPEND);
-}
-
-void AsyncLogging::start()
-{
-    if (!m_isStop)
-    {
-        return ;
-    }
-    m_isStop = false;
-    m_threadHandler = std::thread(AsyncLogging::threadFunc, this);
-}
-
-void AsyncLogging::stop()
-{
-    if (m_isStop)
-    {
-        return ;
-    }
-    m_isStop = true;
-    m_condQueue.notify_one();
-    m_threadHandler.join();
-}
-
-void AsyncLogging::log( const std::string& msg )
-{
-    if (m_shareQueue.size() > 1000)
-    {
-        return;
-    }
-
-    std::string info = getCurrentTimeString() + " ";
-    info.append(msg);
-    info.append("\n");
-
-    {
-        std::unique_lock<std::mutex> lock(m_MutexQueue);
-        m_shareQueue.push_back(info);
-    }
-    m_condQueue.notify_one();
-}
-
-void AsyncLogging::threadFunc(AsyncLogging* p)
-{
-    p->logOutput();
-}
-
-void AsyncLogging::logOutput()
-{
-    while(!m_isStop)
-    {
-        std::deque<std::string> logQ;
-        {
-            std::unique_lock<std::mutex> lock(m_MutexQueue);
-            if (m_shareQueue.empty())
-            {
-                m_condQueue.wait(lock);
-            }
-            logQ.swap(m_shareQueue);
-        }
-
-        for (auto && msg : logQ)
-        {
-            m_pFileOper->write(msg.c_str(), msg.size());
-        }
-    }
-}
-
-std::string AsyncLogging::getCurrentTimeString()
-{
-    struct timeval curTime;
-    gettimeofday(&curTime, NULL);
-
-    char buf[100]  = { '\0' };
-    strftime(buf, sizeof(buf), "%F %T", localtime(&curTime.tv_sec));
-
-    std::stringstream os;
-    os << buf << "." << (uint32_t)(curTime.tv_usec / 1000);
-    return os.str();
-}
\ No newline at end of file
+#include "common.h"
+#include <time.h>
+
+// "2006-01-02 15:04:05.000"的长度
+static const uint32_t kLogTimeLen = 23;
+
+// 每个线程缓存上次格式化的时间，秒不变时只改写毫秒，毫秒不变时直接复制
+typedef struct LogTimeCache_
+{
+    int64_t         m_sec;
+    int64_t         m_msec;
+    char            m_str[kLogTimeLen + 1];
+} LogTimeCache;
+
+static thread_local LogTimeCache t_timeCache = { -1, -1, { 0 } };
+
+static void formatLogTime(char* buf)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t msec = ts.tv_nsec / 1000000;
+    if (ts.tv_sec != t_timeCache.m_sec)
+    {
+        struct tm tmInfo;
+        localtime_r(&ts.tv_sec, &tmInfo);
+        strftime(t_timeCache.m_str, sizeof(t_timeCache.m_str), "%F %T", &tmInfo);
+        t_timeCache.m_str[kLogTimeLen - 4] = '.';
+        t_timeCache.m_sec = ts.tv_sec;
+        t_timeCache.m_msec = -1;
+    }
+    if (msec != t_timeCache.m_msec)
+    {
+        t_timeCache.m_str[kLogTimeLen - 3] = (char)('0' + msec / 100);
+        t_timeCache.m_str[kLogTimeLen - 2] = (char)('0' + msec / 10 % 10);
+        t_timeCache.m_str[kLogTimeLen - 1] = (char)('0' + msec % 10);
+        t_timeCache.m_msec = msec;
+    }
+    memcpy(buf, t_timeCache.m_str, kLogTimeLen);
+}
+
+static uint64_t realtimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void appendLogString(std::string& buf, const char* str)
+{
+    uint16_t len = (uint16_t)std::min<size_t>(strlen(str), UINT16_MAX);
+    buf.append((const char*)&len, sizeof(len));
+    buf.append(str, len);
+}
+
+// 追加一条记录的头部，返回长度字段的位置，内容写完后再填
+static size_t beginBinaryRecord(std::string& buf, BinaryLogType type)
+{
+    size_t start = buf.size();
+    uint16_t len = 0;
+    uint8_t recordType = type;
+    buf.append((const char*)&len, sizeof(len));
+    buf.append((const char*)&recordType, sizeof(recordType));
+    return start;
+}
+
+static void endBinaryRecord(std::string& buf, size_t start)
+{
+    uint16_t len = (uint16_t)(buf.size() - start);
+    memcpy(&buf[start], &len, sizeof(len));
+}
+
+template<typename T>
+static void appendLogValue(std::string& buf, T value)
+{
+    buf.append((const char*)&value, sizeof(value));
+}
+
+AsyncLogging* AsyncLogging::m_pInstance = NULL;
+std::mutex AsyncLogging::m_siteMutex;
+std::vector<LogSite*> AsyncLogging::m_sites;
+
+void AsyncLogging::create()
+{
+    if (NULL == m_pInstance)
+    {
+        m_pInstance = new AsyncLogging();
+    }
+}
+
+void AsyncLogging::release()
+{
+    if (NULL != m_pInstance)
+    {
+        delete m_pInstance;
+        m_pInstance = NULL;
+    }
+}
+
+AsyncLogging::AsyncLogging()
+: m_loglevel(LogLevel_INFO)
+, m_isStop(true)
+, m_tail(0)
+, m_head(0)
+, m_dropNum(0)
+, m_reportDropNum(0)
+, m_isWaiting(false)
+, m_fileSize(0)
+, m_maxFileSize(kLogMaxFileSize)
+, m_keepNum(kLogKeepNum)
+, m_isBinary(false)
+, m_writtenSiteNum(0)
+, m_startTick(0)
+, m_startNs(0)
+, m_tickPerSec(1000000000ull)
+, m_lastClockNs(0)
+, m_siteRatePerSec(kLogSiteRatePerSec)
+, m_siteBurst(kLogSiteBurst)
+, m_suppressNum(0)
+{
+    m_pRecords = new LogRecord[kLogRecordNum];
+    for (uint32_t i = 0; i < kLogRecordNum; i++)
+    {
+        m_pRecords[i].m_seq.store(i, std::memory_order_relaxed);
+        m_pRecords[i].m_len = 0;
+    }
+    m_pFileOper = new FileOper();
+    start();
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    stop();
+    m_pFileOper->close();
+    SAFE_DELETE(m_pFileOper);
+    delete[] m_pRecords;
+    m_pRecords = NULL;
+}
+
+void AsyncLogging::init(const std::string& path, bool isBinary)
+{
+    // 缓冲区中可能有另一种格式的日志
+    flush();
+
+    // 先用一小段时间估计每秒的计数，之后每次写CLOCK记录时按运行的总时长修正
+    uint64_t startTick = readLogTick();
+    uint64_t startNs = realtimeNs();
+    uint64_t tickPerSec = 1000000000ull;
+    if (isBinary)
+    {
+        usleep(10 * 1000);
+        tickPerSec = (uint64_t)((readLogTick() - startTick) * 1e9 / (realtimeNs() - startNs));
+    }
+
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    m_pFileOper->close();
+    m_pFileOper->setPath(path);
+    m_fileSize = 0;
+    if (m_pFileOper->open(O_RDWR | O_CREAT | O_APPEND))
+    {
+        m_pFileOper->getSize(m_fileSize);
+    }
+    m_startTick = startTick;
+    m_startNs = startNs;
+    m_tickPerSec = tickPerSec;
+    m_writtenSiteNum = 0;
+    m_lastClockNs = 0;
+    m_isBinary = isBinary;
+}
+
+void AsyncLogging::setRotate(uint64_t maxFileSize, uint32_t keepNum)
+{
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    m_maxFileSize = maxFileSize;
+    m_keepNum = keepNum;
+}
+
+void AsyncLogging::setSiteRateLimit(uint32_t ratePerSec, uint32_t burst)
+{
+    m_siteRatePerSec = ratePerSec;
+    m_siteBurst = std::max<uint32_t>(burst, 1);
+}
+
+bool AsyncLogging::acquireSite(LogSite* pSite)
+{
+    // GCRA形式的令牌桶，只用一个原子变量: 每条日志把理论到达时间推后一个间隔，超前当前时间太多时限速
+    // 只用于输出的日志，粗粒度时钟足够，比精确时钟开销小
+    uint32_t ratePerSec = m_siteRatePerSec.load(std::memory_order_relaxed);
+    if (0 == ratePerSec)
+    {
+        return true;
+    }
+    uint64_t intervalNs = 1000000000ull / ratePerSec;
+    uint64_t toleranceNs = intervalNs * (m_siteBurst.load(std::memory_order_relaxed) - 1);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    uint64_t nowNs = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+    uint64_t tatNs = pSite->m_tatNs.load(std::memory_order_relaxed);
+    while (true)
+    {
+        uint64_t startNs = std::max(tatNs, nowNs);
+        if (startNs - nowNs > toleranceNs)
+        {
+            pSite->m_suppressNum.fetch_add(1, std::memory_order_relaxed);
+            m_suppressNum.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (pSite->m_tatNs.compare_exchange_weak(tatNs, startNs + intervalNs, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    if (0 != pSite->m_suppressNum.load(std::memory_order_relaxed))
+    {
+        uint64_t suppressNum = pSite->m_suppressNum.exchange(0, std::memory_order_relaxed);
+        const char* fileName = strrchr(pSite->m_file, '/');
+        char buf[256];
+        int len = snprintf(buf, sizeof(buf), "W [%s-%s:%u] rate limited, suppressed %" PRIu64 " messages",
+            NULL == fileName ? pSite->m_file : fileName + 1, pSite->m_function, pSite->m_line, suppressNum);
+        log(buf, (uint32_t)std::min<int>(len, sizeof(buf) - 1));
+    }
+    return true;
+}
+
+void AsyncLogging::start()
+{
+    if (!m_isStop)
+    {
+        return ;
+    }
+    m_isStop = false;
+    m_threadHandler = std::thread(AsyncLogging::threadFunc, this);
+}
+
+void AsyncLogging::stop()
+{
+    if (m_isStop)
+    {
+        return ;
+    }
+    m_isStop = true;
+    {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_waitCond.notify_one();
+    }
+    m_threadHandler.join();
+}
+
+void AsyncLogging::flush()
+{
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    while (!m_isStop && m_head.load(std::memory_order_acquire) < tail)
+    {
+        m_waitCond.notify_one();
+        usleep(1000);
+    }
+}
+
+void AsyncLogging::log(const char* msg, uint32_t len)
+{
+    uint64_t pos = 0;
+    LogRecord* pRecord = claimRecord(pos);
+    if (NULL == pRecord)
+    {
+        return ;
+    }
+
+    if (isBinary())
+    {
+        char* p = pRecord->m_data + sizeof(uint16_t);
+        p = putLogValue<uint8_t>(p, BinaryLogType_TEXT);
+        p = putLogValue(p, readLogTick());
+        uint32_t copyLen = std::min<uint32_t>(len, pRecord->m_data + kLogRecordSize - p);
+        memcpy(p, msg, copyLen);
+        publishRecord(pos, pRecord, (uint32_t)(p + copyLen - pRecord->m_data));
+        return ;
+    }
+
+    formatLogTime(pRecord->m_data);
+    pRecord->m_data[kLogTimeLen] = ' ';
+    uint32_t copyLen = std::min(len, kLogRecordSize - kLogTimeLen - 2);
+    memcpy(pRecord->m_data + kLogTimeLen + 1, msg, copyLen);
+    pRecord->m_data[kLogTimeLen + 1 + copyLen] = '\n';
+    publishRecord(pos, pRecord, kLogTimeLen + 2 + copyLen);
+}
+
+LogRecord* AsyncLogging::claimRecord(uint64_t& pos)
+{
+    // 记录的m_seq小于位置说明上一轮还没输出，缓冲区已满
+    pos = m_tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+        LogRecord* pRecord = &m_pRecords[pos & (kLogRecordNum - 1)];
+        int64_t diff = (int64_t)(pRecord->m_seq.load(std::memory_order_acquire) - pos);
+        if (0 == diff)
+        {
+            if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                return pRecord;
+            }
+        }
+        else if (diff < 0)
+        {
+            m_dropNum.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+        else
+        {
+            pos = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncLogging::publishRecord(uint64_t pos, LogRecord* pRecord, uint32_t len)
+{
+    if (isBinary())
+    {
+        uint16_t recordLen = (uint16_t)len;
+        memcpy(pRecord->m_data, &recordLen, sizeof(recordLen));
+    }
+    pRecord->m_len = len;
+    pRecord->m_seq.store(pos + 1, std::memory_order_release);
+
+    // 写线程最多等待kLogWaitMs，积压超过一半时才通知，并且只通知一次，避免调用线程频繁系统调用和切换
+    if (m_isWaiting.load(std::memory_order_relaxed) &&
+        pos - m_head.load(std::memory_order_relaxed) >= kLogRecordNum / 2 && m_isWaiting.exchange(false))
+    {
+        m_waitCond.notify_one();
+    }
+}
+
+uint32_t AsyncLogging::registerSite(LogSite* pSite)
+{
+    std::lock_guard<std::mutex> lock(m_siteMutex);
+    uint32_t siteId = pSite->m_id.load(std::memory_order_relaxed);
+    if (0 == siteId)
+    {
+        m_sites.push_back(pSite);
+        siteId = (uint32_t)m_sites.size();
+        pSite->m_id.store(siteId, std::memory_order_release);
+    }
+    return siteId;
+}
+
+void AsyncLogging::threadFunc(AsyncLogging* p)
+{
+    p->logOutput();
+}
+
+void AsyncLogging::logOutput()
+{
+    while (true)
+    {
+        if (0 != flushBatch())
+        {
+            continue;
+        }
+        // 先确认缓冲区为空再退出，停止前写入的日志不会丢失
+        if (m_isStop)
+        {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        m_isWaiting = true;
+        if (!isReady(m_head.load(std::memory_order_relaxed)) && !m_isStop)
+        {
+            m_waitCond.wait_for(lock, std::chrono::milliseconds(kLogWaitMs));
+        }
+        m_isWaiting = false;
+    }
+}
+
+bool AsyncLogging::isReady(uint64_t pos)
+{
+    return m_pRecords[pos & (kLogRecordNum - 1)].m_seq.load(std::memory_order_acquire) == pos + 1;
+}
+
+uint32_t AsyncLogging::flushBatch()
+{
+    // 第一个留给二进制模式的前缀，最后一个留给丢弃条数
+    struct iovec iov[kLogBatchNum + 2];
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    uint32_t num = 0;
+    uint64_t len = 0;
+    while (num < kLogBatchNum && isReady(head + num))
+    {
+        LogRecord& record = m_pRecords[(head + num) & (kLogRecordNum - 1)];
+        iov[1 + num].iov_base = record.m_data;
+        iov[1 + num].iov_len = record.m_len;
+        len += record.m_len;
+        num++;
+    }
+    if (0 == num)
+    {
+        return 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_fileMutex);
+        uint32_t iovcnt = 1 + num;
+        char dropLine[128];
+        uint64_t dropNum = m_dropNum.load(std::memory_order_relaxed);
+        if (dropNum != m_reportDropNum)
+        {
+            uint32_t lineLen = 0;
+            if (m_isBinary)
+            {
+                char* p = putLogValue<uint16_t>(dropLine, 0);
+                p = putLogValue<uint8_t>(p, BinaryLogType_DROP);
+                p = putLogValue(p, readLogTick());
+                p = putLogValue(p, dropNum - m_reportDropNum);
+                p = putLogValue(p, dropNum);
+                lineLen = (uint32_t)(p - dropLine);
+                putLogValue<uint16_t>(dropLine, (uint16_t)lineLen);
+            }
+            else
+            {
+                formatLogTime(dropLine);
+                lineLen = kLogTimeLen + snprintf(dropLine + kLogTimeLen, sizeof(dropLine) - kLogTimeLen,
+                    " W [AsyncLogging] log buffer full, dropped %" PRIu64 " total %" PRIu64 "\n",
+                    dropNum - m_reportDropNum, dropNum);
+            }
+            iov[iovcnt].iov_base = dropLine;
+            iov[iovcnt].iov_len = lineLen;
+            len += lineLen;
+            iovcnt++;
+            m_reportDropNum = dropNum;
+        }
+
+        if (0 != m_maxFileSize && 0 != m_fileSize && m_fileSize + len > m_maxFileSize)
+        {
+            rotate();
+        }
+        m_prefix.clear();
+        if (m_isBinary)
+        {
+            buildBinaryPrefix();
+        }
+        iov[0].iov_base = &m_prefix[0];
+        iov[0].iov_len = m_prefix.size();
+
+        // 写日志失败不能再记录日志，否则会不停地产生新的日志
+        int fd = m_pFileOper->getfd();
+        ssize_t retLen = fd > 0 ? ::writev(fd, iov, iovcnt) : -1;
+        if (retLen > 0)
+        {
+            m_fileSize += retLen;
+        }
+    }
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        m_pRecords[(head + i) & (kLogRecordNum - 1)].m_seq.store(head + i + kLogRecordNum,
+            std::memory_order_release);
+    }
+    m_head.store(head + num, std::memory_order_release);
+    return num;
+}
+
+void AsyncLogging::buildBinaryPrefix()
+{
+    // 新文件要写文件头，并且重新写入所有调用点，滚动后的文件可以单独解码
+    if (0 == m_fileSize)
+    {
+        m_prefix.append(kBinaryLogMagic, sizeof(kBinaryLogMagic));
+        m_writtenSiteNum = 0;
+        m_lastClockNs = 0;
+    }
+
+    uint64_t nowNs = realtimeNs();
+    if (0 == m_lastClockNs || nowNs - m_lastClockNs >= kLogClockIntervalNs)
+    {
+        uint64_t tick = readLogTick();
+        if (nowNs - m_startNs >= kLogClockIntervalNs)
+        {
+            m_tickPerSec = (uint64_t)((tick - m_startTick) * 1e9 / (nowNs - m_startNs));
+        }
+        size_t start = beginBinaryRecord(m_prefix, BinaryLogType_CLOCK);
+        appendLogValue(m_prefix, tick);
+        appendLogValue(m_prefix, nowNs);
+        appendLogValue(m_prefix, m_tickPerSec);
+        endBinaryRecord(m_prefix, start);
+        m_lastClockNs = nowNs;
+    }
+
+    std::lock_guard<std::mutex> lock(m_siteMutex);
+    for (; m_writtenSiteNum < m_sites.size(); m_writtenSiteNum++)
+    {
+        const LogSite* pSite = m_sites[m_writtenSiteNum];
+        const char* fileName = strrchr(pSite->m_file, '/');
+        size_t start = beginBinaryRecord(m_prefix, BinaryLogType_SITE);
+        appendLogValue<uint32_t>(m_prefix, m_writtenSiteNum + 1);
+        appendLogValue<uint8_t>(m_prefix, pSite->m_level);
+        appendLogValue<uint32_t>(m_prefix, pSite->m_line);
+        appendLogString(m_prefix, pSite->m_levelStr);
+        appendLogString(m_prefix, NULL == fileName ? pSite->m_file : fileName + 1);
+        appendLogString(m_prefix, pSite->m_function);
+        appendLogString(m_prefix, pSite->m_format);
+        endBinaryRecord(m_prefix, start);
+    }
+}
+
+void AsyncLogging::rotate()
+{
+    const std::string path = m_pFileOper->getPath();
+    m_pFileOper->close();
+    if (0 == m_keepNum)
+    {
+        ::unlink(path.c_str());
+    }
+    else
+    {
+        for (uint32_t i = m_keepNum - 1; i > 0; i--)
+        {
+            ::rename((path + "." + std::to_string(i)).c_str(), (path + "." + std::to_string(i + 1)).c_str());
+        }
+        ::rename(path.c_str(), (path + ".1").c_str());
+    }
+    m_pFileOper->open(O_RDWR | O_CREAT | O_APPEND);
+    m_fileSize = 0;
+}
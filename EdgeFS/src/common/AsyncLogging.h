@@ -1,52 +1,226 @@
-#pragma once
-
-#include "common.h"
-
-class AsyncLogging
-    : noncopyable
-{
-public:
-    static void create();
-    static void release();
-    static AsyncLogging* instance();
-
-public:
-    AsyncLogging();
-    ~AsyncLogging();
-
-public:
-    void init(const std::string& path);
-
-    void start(); 
-    void stop();
-
-public:
-    void log(const std::string& msg);
-    
-    LogLevel getLogLevel()
-    {
-        return m_loglevel;
-    }
-
-private:
-    static void threadFunc(AsyncLogging* p);
-
-    void logOutput();
-
-private:
-    std::string getCurrentTimeString();
-
-private:
-    static AsyncLogging*        m_pInstance;
-
-    LogLevel                    m_loglevel;
-
-    std::atomic<bool>           m_isStop;
-    std::thread                 m_threadHandler;
-
-    std::deque<std::string>     m_shareQueue;
-    std::mutex                  m_MutexQueue;
-    std::condition_variable     m_condQueue;
-
-    FileOper*                   m_pFileOper;
-};
\ No newline at end of file
+#pragma once
+
+#include "common.h"
+#include "BinaryLog.h"
+
+// 一条日志的最大长度，包括时间和换行，超过的部分截断
+const uint32_t kLogRecordSize = 1024;
+// 环形缓冲区的日志条数，必须是2的幂
+const uint32_t kLogRecordNum = 1024;
+// 写线程一次writev最多的条数
+const uint32_t kLogBatchNum = 256;
+// 写线程空闲时的最长等待，生产者不加锁通知，漏掉的唤醒最多延迟这么久
+const uint32_t kLogWaitMs = 20;
+// 默认的日志文件大小上限和保留的历史文件个数
+const uint64_t kLogMaxFileSize = 64 * 1024 * 1024;
+const uint32_t kLogKeepNum = 3;
+// 二进制日志写入CLOCK记录的间隔
+const uint64_t kLogClockIntervalNs = 1000000000ull;
+// 每个调用点默认的限速，每秒的条数和允许的突发条数，只对warn及以上级别生效
+const uint32_t kLogSiteRatePerSec = 1000;
+const uint32_t kLogSiteBurst = 1000;
+
+// 预分配的定长日志记录，m_seq表示状态:
+// 等于位置时可以写入，等于位置+1时已经写完可以输出，输出后加上kLogRecordNum留给下一轮
+typedef struct LogRecord_
+{
+    std::atomic<uint64_t>   m_seq;
+    uint32_t                m_len;
+    char                    m_data[kLogRecordSize];
+} LogRecord;
+
+// 多生产者单消费者的无锁环形缓冲区，写线程批量writev到文件，按大小滚动
+// 丢弃策略: 缓冲区满时直接丢弃新日志，生产者从不阻塞，丢弃条数累加到m_dropNum
+// 写线程在下一批日志后追加一行丢弃的条数，停止时写完缓冲区中剩余的日志
+// 二进制模式下调用线程不格式化，只复制调用点编号和参数，由edgefs_logdecode还原为文本
+class AsyncLogging
+    : noncopyable
+{
+public:
+    static void create();
+    static void release();
+    static AsyncLogging* instance()
+    {
+        return m_pInstance;
+    }
+
+public:
+    AsyncLogging();
+    ~AsyncLogging();
+
+public:
+    // 切换文件前等待已有的日志写完，调用时不能有其他线程在写日志
+    void init(const std::string& path, bool isBinary = false);
+
+    // maxFileSize为0表示不滚动，超过时path依次改名为path.1到path.keepNum，keepNum为0表示直接清空
+    void setRotate(uint64_t maxFileSize, uint32_t keepNum);
+
+    void start();
+    void stop();
+
+    // 等待调用之前的日志都写到文件
+    void flush();
+
+    // 每个调用点的令牌桶限速，避免循环中的错误日志占满缓冲区，ratePerSec为0表示不限速
+    // 只限制warn及以上级别，info和notice是每次读写的正常输出，由日志级别控制，不会被限速丢弃
+    void setSiteRateLimit(uint32_t ratePerSec, uint32_t burst);
+
+    bool isSiteRateLimit()
+    {
+        return 0 != m_siteRatePerSec.load(std::memory_order_relaxed);
+    }
+
+    // 取一个令牌，失败时计入调用点和总的限速条数，成功时先报告该调用点之前限速的条数
+    bool acquireSite(LogSite* pSite);
+
+public:
+    void log(const char* msg, uint32_t len);
+
+    template<typename... Args>
+    void logBinary(LogSite* pSite, Args... args)
+    {
+        uint32_t siteId = pSite->m_id.load(std::memory_order_acquire);
+        if (0 == siteId)
+        {
+            siteId = registerSite(pSite);
+        }
+        uint64_t pos = 0;
+        LogRecord* pRecord = claimRecord(pos);
+        if (NULL == pRecord)
+        {
+            return ;
+        }
+        char* p = pRecord->m_data + sizeof(uint16_t);
+        p = putLogValue<uint8_t>(p, BinaryLogType_MSG);
+        p = putLogValue(p, siteId);
+        p = putLogValue(p, readLogTick());
+        p = encodeLogArgs(p, pRecord->m_data + kLogRecordSize, args...);
+        publishRecord(pos, pRecord, (uint32_t)(p - pRecord->m_data));
+    }
+
+    bool isBinary()
+    {
+        return m_isBinary.load(std::memory_order_relaxed);
+    }
+
+    void log(const std::string& msg)
+    {
+        log(msg.c_str(), (uint32_t)msg.size());
+    }
+
+    // 缓冲区满丢弃的日志条数
+    uint64_t getDropNum()
+    {
+        return m_dropNum.load(std::memory_order_relaxed);
+    }
+
+    // 调用点限速丢弃的日志条数
+    uint64_t getSuppressNum()
+    {
+        return m_suppressNum.load(std::memory_order_relaxed);
+    }
+
+    LogLevel getLogLevel()
+    {
+        return m_loglevel;
+    }
+
+    void setLogLevel(LogLevel level)
+    {
+        m_loglevel = level;
+    }
+
+private:
+    static void threadFunc(AsyncLogging* p);
+
+    void logOutput();
+
+    // 输出一批写完的日志，返回条数
+    uint32_t flushBatch();
+
+    bool isReady(uint64_t pos);
+
+    // 缓冲区满时返回NULL并计入丢弃
+    LogRecord* claimRecord(uint64_t& pos);
+
+    // 二进制记录的长度同时写到记录头部
+    void publishRecord(uint64_t pos, LogRecord* pRecord, uint32_t len);
+
+    uint32_t registerSite(LogSite* pSite);
+
+    // 二进制模式下写在一批日志之前的文件头、新的调用点和时钟，调用时持有m_fileMutex
+    void buildBinaryPrefix();
+
+    // 调用时持有m_fileMutex
+    void rotate();
+
+private:
+    static AsyncLogging*        m_pInstance;
+
+    LogLevel                    m_loglevel;
+
+    std::atomic<bool>           m_isStop;
+    std::thread                 m_threadHandler;
+
+    LogRecord*                  m_pRecords;
+    std::atomic<uint64_t>       m_tail;             // 生产者下一个申请的位置
+    char                        m_pad[64];          // 避免和写线程的位置共享缓存行
+    std::atomic<uint64_t>       m_head;             // 写线程下一个输出的位置
+    std::atomic<uint64_t>       m_dropNum;
+    uint64_t                    m_reportDropNum;    // 已经写到文件中的丢弃条数
+
+    std::atomic<bool>           m_isWaiting;
+    std::mutex                  m_waitMutex;
+    std::condition_variable     m_waitCond;
+
+    // 保护文件和滚动参数，写线程每批加锁一次
+    std::mutex                  m_fileMutex;
+    FileOper*                   m_pFileOper;
+    uint64_t                    m_fileSize;
+    uint64_t                    m_maxFileSize;
+    uint32_t                    m_keepNum;
+
+    // 调用点按编号顺序保存，编号从1开始，调用点是静态变量，重新创建实例后编号仍然有效
+    static std::mutex           m_siteMutex;
+    static std::vector<LogSite*> m_sites;
+
+    std::atomic<bool>           m_isBinary;
+    uint32_t                    m_writtenSiteNum;   // 当前文件中已经写入的调用点个数
+    uint64_t                    m_startTick;
+    uint64_t                    m_startNs;
+    uint64_t                    m_tickPerSec;
+    uint64_t                    m_lastClockNs;      // 上次写CLOCK记录的时间，0表示当前文件还没有写
+    std::string                 m_prefix;
+
+    std::atomic<uint32_t>       m_siteRatePerSec;
+    std::atomic<uint32_t>       m_siteBurst;
+    std::atomic<uint64_t>       m_suppressNum;
+};
+
+inline bool mediaLogIsOn(LogLevel level)
+{
+    AsyncLogging* pLogging = AsyncLogging::instance();
+    return NULL != pLogging && LogLevel_NONE != level && (uint32_t)level >= (uint32_t)pLogging->getLogLevel();
+}
+
+// 限速只针对循环中反复出现的警告和错误，warn以下的级别按日志级别全部输出
+inline bool mediaLogAcquire(LogSite* pSite)
+{
+    AsyncLogging* pLogging = AsyncLogging::instance();
+    return (uint32_t)pSite->m_level < (uint32_t)LogLevel_WARN || !pLogging->isSiteRateLimit() ||
+        pLogging->acquireSite(pSite);
+}
+
+// logger宏在级别和限速检查之后调用，按模式输出文本或者二进制日志
+template<typename... Args>
+void mediaLogSite(LogSite* pSite, Args... args)
+{
+    AsyncLogging* pLogging = AsyncLogging::instance();
+    if (pLogging->isBinary())
+    {
+        pLogging->logBinary(pSite, args...);
+        return ;
+    }
+    mediaLog(pSite->m_level, pSite->m_levelStr, pSite->m_file, pSite->m_format, pSite->m_function, pSite->m_line,
+        args...);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "SystemHead.h"
+#include <type_traits>
+#include <time.h>
+
+// 二进制日志的格式，写入和edgefs_logdecode共用，按本机字节序
+// 文件以kBinaryLogMagic开头，之后是连续的记录，每条记录为 uint16_t总长度 uint8_t类型 内容
+// 调用点第一次输出前写入SITE记录，MSG记录只有调用点编号、时钟计数和原始参数
+const char kBinaryLogMagic[8] = "EFSBLOG";
+
+typedef enum BinaryLogType_
+{
+    BinaryLogType_SITE = 1,     // uint32_t编号 uint8_t级别 uint32_t行号 字符串:级别 文件 函数 格式
+    BinaryLogType_CLOCK,        // uint64_t计数 uint64_t对应的unix时间(ns) uint64_t每秒的计数
+    BinaryLogType_MSG,          // uint32_t编号 uint64_t计数 参数
+    BinaryLogType_TEXT,         // uint64_t计数 已经格式化的文本
+    BinaryLogType_DROP,         // uint64_t计数 uint64_t本次丢弃条数 uint64_t丢弃总数
+} BinaryLogType;
+
+// 每个参数为 uint8_t类型 值，整数、浮点数和指针为8字节，字符串为uint16_t长度加内容
+typedef enum BinaryLogArg_
+{
+    BinaryLogArg_INT = 1,
+    BinaryLogArg_UINT,
+    BinaryLogArg_DOUBLE,
+    BinaryLogArg_STRING,
+    BinaryLogArg_POINTER,
+} BinaryLogArg;
+
+// 记录头部: 长度和类型
+const uint32_t kBinaryLogHeadLen = sizeof(uint16_t) + sizeof(uint8_t);
+
+// 调用点的格式以"-%s:%d] "开头，对应函数名和行号，不在MSG记录的参数中
+const uint32_t kLogSitePrefixLen = 8;
+
+// 日志时间用的计数，x86下为tsc，由写线程定期写入CLOCK记录换算为unix时间
+inline uint64_t readLogTick()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+template<typename T>
+inline char* putLogValue(char* p, T value)
+{
+    memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+inline char* putLogString(char* p, char* end, const char* str)
+{
+    if (end - p < (ptrdiff_t)(sizeof(uint8_t) + sizeof(uint16_t)))
+    {
+        return p;
+    }
+    if (NULL == str)
+    {
+        str = "(null)";
+    }
+    size_t maxLen = end - p - sizeof(uint8_t) - sizeof(uint16_t);
+    uint16_t len = (uint16_t)strnlen(str, std::min<size_t>(maxLen, UINT16_MAX));
+    p = putLogValue<uint8_t>(p, BinaryLogArg_STRING);
+    p = putLogValue(p, len);
+    memcpy(p, str, len);
+    return p + len;
+}
+
+// 整数和枚举按符号扩展到8字节，空间不足时丢弃后面的参数，解码时显示为缺失
+template<typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, char*>::type
+encodeLogArg(char* p, char* end, T value)
+{
+    if (end - p < (ptrdiff_t)(sizeof(uint8_t) + sizeof(uint64_t)))
+    {
+        return p;
+    }
+    if (std::is_enum<T>::value || std::is_signed<T>::value)
+    {
+        p = putLogValue<uint8_t>(p, BinaryLogArg_INT);
+        return putLogValue<int64_t>(p, (int64_t)value);
+    }
+    p = putLogValue<uint8_t>(p, BinaryLogArg_UINT);
+    return putLogValue<uint64_t>(p, (uint64_t)value);
+}
+
+inline char* encodeLogArg(char* p, char* end, double value)
+{
+    if (end - p < (ptrdiff_t)(sizeof(uint8_t) + sizeof(double)))
+    {
+        return p;
+    }
+    p = putLogValue<uint8_t>(p, BinaryLogArg_DOUBLE);
+    return putLogValue(p, value);
+}
+
+inline char* encodeLogArg(char* p, char* end, const char* value)
+{
+    return putLogString(p, end, value);
+}
+
+inline char* encodeLogArg(char* p, char* end, char* value)
+{
+    return putLogString(p, end, value);
+}
+
+template<typename T>
+inline char* encodeLogArg(char* p, char* end, T* value)
+{
+    if (end - p < (ptrdiff_t)(sizeof(uint8_t) + sizeof(uint64_t)))
+    {
+        return p;
+    }
+    p = putLogValue<uint8_t>(p, BinaryLogArg_POINTER);
+    return putLogValue<uint64_t>(p, (uint64_t)(uintptr_t)value);
+}
+
+inline char* encodeLogArgs(char* p, char*)
+{
+    return p;
+}
+
+template<typename T, typename... Rest>
+inline char* encodeLogArgs(char* p, char* end, T value, Rest... rest)
+{
+    p = encodeLogArg(p, end, value);
+    return encodeLogArgs(p, end, rest...);
+}
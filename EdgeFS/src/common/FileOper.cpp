@@ -2,12 +2,22 @@
 
 FileOper::FileOper()
 : m_fd(-1)
+, m_readNum(0)
+, m_readBytes(0)
+, m_writeNum(0)
+, m_writeBytes(0)
+, m_syncNum(0)
 {
 }
 
 FileOper::FileOper( const std::string &path )
 : m_fd(-1)
 , m_path(path)
+, m_readNum(0)
+, m_readBytes(0)
+, m_writeNum(0)
+, m_writeBytes(0)
+, m_syncNum(0)
 {    
 }
 
@@ -24,7 +34,9 @@ bool FileOper::write(const char* buff, uint32_t len)
     }
 
     errno = 0;
-    if (len != ::write(m_fd, buff, len))
+    bool isOk = len == ::write(m_fd, buff, len);
+    countWrite(len, isOk);
+    if (!isOk)
     {
         lerror("[fileOper] write failed, len %u err %s\n", len, strerror(errno));
         return false;
@@ -39,13 +51,17 @@ bool FileOper::write(const char* buff, uint32_t len, uint64_t offset)
         return false;
     }
 
+    // 不修改文件偏移，可以多线程并发读写
     errno = 0;
-    if (::lseek(m_fd, offset, SEEK_SET) < 0)
+    ssize_t retLen = ::pwrite(m_fd, buff, len, offset);
+    countWrite(len, (ssize_t)len == retLen);
+    if ((ssize_t)len != retLen)
     {
-        lerror("[fileOper] lseek failed, offset %" PRIu64 " err %s\n", offset, strerror(errno));
+        lerror("[fileOper] pwrite failed, len %u retLen %zd offset %" PRIu64 " err %s", len, retLen, offset,
+            strerror(errno));
         return false;
     }
-    return write(buff, len);
+    return true;
 }
 
 bool FileOper::read(char* buff, uint32_t len)
@@ -57,6 +73,7 @@ bool FileOper::read(char* buff, uint32_t len)
 
     errno = 0;
     int32_t retLen = ::read(m_fd, buff, len);
+    countRead(len, len == (uint32_t)retLen);
     if (len != (uint32_t)retLen)
     {
         lerror("[fileOper] read failed, len %u retLen %d fd %d path %s err %s", len, retLen, m_fd, m_path.c_str(),
@@ -75,12 +92,143 @@ bool FileOper::read(char* buff, uint32_t len, uint64_t offset)
     }
 
     errno = 0;
-    if (::lseek(m_fd, offset, SEEK_SET) < 0)
+    ssize_t retLen = ::pread(m_fd, buff, len, offset);
+    countRead(len, (ssize_t)len == retLen);
+    if ((ssize_t)len != retLen)
     {
-        lerror("[fileOper] fseek failed, offset %" PRIu64 " err %s\n", offset, strerror(errno));
+        lerror("[fileOper] pread failed, len %u retLen %zd offset %" PRIu64 " fd %d path %s err %s", len, retLen,
+            offset, m_fd, m_path.c_str(), strerror(errno));
         return false;
     }
-    return read(buff, len);
+    return true;
+}
+
+bool FileOper::readv(const struct iovec* iov, int iovcnt, uint32_t len, uint64_t offset)
+{
+    if (m_fd <= 0)
+    {
+        return false;
+    }
+
+    errno = 0;
+    ssize_t retLen = ::preadv(m_fd, iov, iovcnt, offset);
+    countRead(len, (ssize_t)len == retLen);
+    if ((ssize_t)len != retLen)
+    {
+        lerror("[fileOper] readv failed, iovcnt %d len %u retLen %zd offset %" PRIu64 " err %s", iovcnt, len, retLen,
+            offset, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileOper::writev(const struct iovec* iov, int iovcnt, uint32_t len, uint64_t offset)
+{
+    if (m_fd <= 0)
+    {
+        return false;
+    }
+
+    errno = 0;
+    ssize_t retLen = ::pwritev(m_fd, iov, iovcnt, offset);
+    countWrite(len, (ssize_t)len == retLen);
+    if ((ssize_t)len != retLen)
+    {
+        lerror("[fileOper] writev failed, iovcnt %d len %u retLen %zd offset %" PRIu64 " err %s", iovcnt, len, retLen,
+            offset, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileOper::readahead(uint64_t offset, uint32_t len)
+{
+    if (m_fd <= 0)
+    {
+        return false;
+    }
+
+#ifdef POSIX_FADV_WILLNEED
+    int ret = ::posix_fadvise(m_fd, offset, len, POSIX_FADV_WILLNEED);
+    if (0 != ret)
+    {
+        lerror("[fileOper] fadvise failed, offset %" PRIu64 " len %u err %s", offset, len, strerror(ret));
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool FileOper::sync()
+{
+    if (m_fd <= 0)
+    {
+        return false;
+    }
+
+    errno = 0;
+    m_syncNum.fetch_add(1, std::memory_order_relaxed);
+    if (0 != ::fdatasync(m_fd))
+    {
+        lerror("[fileOper] fdatasync failed, path %s err %s", m_path.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileOper::syncRange(uint64_t offset, uint64_t len)
+{
+    if (m_fd <= 0)
+    {
+        return false;
+    }
+
+    errno = 0;
+    m_syncNum.fetch_add(1, std::memory_order_relaxed);
+    if (0 != ::sync_file_range(m_fd, offset, len, SYNC_FILE_RANGE_WRITE))
+    {
+        lerror("[fileOper] sync_file_range failed, path %s offset %" PRIu64 " len %" PRIu64 " err %s",
+            m_path.c_str(), offset, len, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileOper::truncate(uint64_t size)
+{
+    if (m_fd <= 0)
+    {
+        return false;
+    }
+
+    errno = 0;
+    if (0 != ::ftruncate(m_fd, size))
+    {
+        lerror("[fileOper] ftruncate failed, path %s size %" PRIu64 " err %s", m_path.c_str(), size,
+            strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FileOper::getSize(uint64_t& size)
+{
+    if (m_fd <= 0)
+    {
+        return false;
+    }
+
+    errno = 0;
+    struct stat st;
+    if (0 != ::fstat(m_fd, &st))
+    {
+        lerror("[fileOper] fstat failed, path %s err %s", m_path.c_str(), strerror(errno));
+        return false;
+    }
+    size = st.st_size;
+    return true;
 }
 
 bool FileOper::open(int oflag)
@@ -124,3 +272,12 @@ int FileOper::getfd()
 {
     return m_fd;
 }
+
+void FileOper::addIoStats(IoStats& stats)
+{
+    stats.m_readNum += m_readNum.load(std::memory_order_relaxed);
+    stats.m_readBytes += m_readBytes.load(std::memory_order_relaxed);
+    stats.m_writeNum += m_writeNum.load(std::memory_order_relaxed);
+    stats.m_writeBytes += m_writeBytes.load(std::memory_order_relaxed);
+    stats.m_syncNum += m_syncNum.load(std::memory_order_relaxed);
+}
@@ -1,6 +1,24 @@
 #pragma once
 #include "common.h"
 
+// 系统调用的次数和成功的字节数
+typedef struct IoStats_
+{
+    uint64_t        m_readNum;
+    uint64_t        m_readBytes;
+    uint64_t        m_writeNum;
+    uint64_t        m_writeBytes;
+    uint64_t        m_syncNum;
+
+    IoStats_()
+    : m_readNum(0)
+    , m_readBytes(0)
+    , m_writeNum(0)
+    , m_writeBytes(0)
+    , m_syncNum(0)
+    {}
+} IoStats;
+
 class FileOper
 {
 public:
@@ -11,12 +29,30 @@ public:
 public:
     void setPath(const std::string &path);
 
+    // 指定offset的读写不修改文件偏移，可以多线程并发调用
     bool write(const char* buff, uint32_t len, uint64_t offset);
     bool write(const char* buff, uint32_t len);
 
     bool read(char* buff, uint32_t len, uint64_t offset);
     bool read(char* buff, uint32_t len);
 
+    // 从offset开始连续读写到多个buff中，总长度为len
+    bool readv(const struct iovec* iov, int iovcnt, uint32_t len, uint64_t offset);
+    bool writev(const struct iovec* iov, int iovcnt, uint32_t len, uint64_t offset);
+
+    // 通知内核异步读取指定范围到page cache，不等待读取完成
+    bool readahead(uint64_t offset, uint32_t len);
+
+    // 已经写入的数据落盘，不等待文件的时间戳等元数据
+    bool sync();
+
+    // 对范围内的脏页发起回写，不等待完成，之后调用sync等待
+    bool syncRange(uint64_t offset, uint64_t len);
+
+    bool truncate(uint64_t size);
+
+    bool getSize(uint64_t& size);
+
     void close();
     
     bool open(int oflag = O_RDWR | O_CREAT);
@@ -26,7 +62,30 @@ public:
 
     int getfd();
 
+    // 累加到stats中，可以和读写并发调用
+    void addIoStats(IoStats& stats);
+
+private:
+    void countRead(uint32_t len, bool isOk)
+    {
+        m_readNum.fetch_add(1, std::memory_order_relaxed);
+        m_readBytes.fetch_add(isOk ? len : 0, std::memory_order_relaxed);
+    }
+
+    void countWrite(uint32_t len, bool isOk)
+    {
+        m_writeNum.fetch_add(1, std::memory_order_relaxed);
+        m_writeBytes.fetch_add(isOk ? len : 0, std::memory_order_relaxed);
+    }
+
 private:
     int             m_fd;
     std::string     m_path;
+
+    // 系统调用远比原子操作耗时，多个线程共用一份计数
+    std::atomic<uint64_t>   m_readNum;
+    std::atomic<uint64_t>   m_readBytes;
+    std::atomic<uint64_t>   m_writeNum;
+    std::atomic<uint64_t>   m_writeBytes;
+    std::atomic<uint64_t>   m_syncNum;
 };
\ No newline at end of file
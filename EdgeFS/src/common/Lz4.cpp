@@ -0,0 +1,221 @@
+#include "Lz4.h"
+#include <string.h>
+
+namespace
+{
+    const uint32_t kMinMatch = 4;
+    const uint32_t kHashLog = 12;
+    // 块的最后5个字节必须是字面量，最后一个匹配必须在结尾12个字节之前开始
+    const uint32_t kLastLiterals = 5;
+    const uint32_t kMFLimit = 12;
+    const uint32_t kMaxOffset = 65535;
+    // 连续没有匹配时逐渐增大步长，不可压缩的数据可以快速跳过
+    const uint32_t kSkipStrength = 6;
+
+    inline uint32_t read32(const uint8_t* p)
+    {
+        uint32_t val;
+        memcpy(&val, p, sizeof(val));
+        return val;
+    }
+
+    inline uint32_t hash(uint32_t seq)
+    {
+        return (seq * 2654435761u) >> (32 - kHashLog);
+    }
+
+    // 写入长度的扩展字节
+    inline uint8_t* writeLength(uint8_t* out, uint32_t len)
+    {
+        while (len >= 255)
+        {
+            *out++ = 255;
+            len -= 255;
+        }
+        *out++ = (uint8_t)len;
+        return out;
+    }
+
+    inline bool readLength(const uint8_t*& in, const uint8_t* inEnd, uint32_t& len)
+    {
+        uint8_t b = 0;
+        do
+        {
+            if (in >= inEnd)
+            {
+                return false;
+            }
+            b = *in++;
+            len += b;
+        } while (255 == b);
+        return true;
+    }
+
+    // 输出一段字面量，isLast为false时后面跟随一个匹配
+    inline uint8_t* writeSequence(uint8_t* out, uint8_t* outEnd, const uint8_t* literal, uint32_t literalLen,
+        uint32_t offset, uint32_t matchLen, bool isLast)
+    {
+        // 最坏情况下需要的长度
+        uint64_t need = 1 + literalLen / 255 + 1 + literalLen + (isLast ? 0 : 2 + matchLen / 255 + 1);
+        if ((uint64_t)(outEnd - out) < need)
+        {
+            return NULL;
+        }
+
+        uint8_t* token = out++;
+        if (literalLen >= 15)
+        {
+            *token = 15 << 4;
+            out = writeLength(out, literalLen - 15);
+        }
+        else
+        {
+            *token = (uint8_t)(literalLen << 4);
+        }
+        memcpy(out, literal, literalLen);
+        out += literalLen;
+
+        if (isLast)
+        {
+            return out;
+        }
+
+        *out++ = (uint8_t)(offset & 0xff);
+        *out++ = (uint8_t)(offset >> 8);
+        uint32_t ml = matchLen - kMinMatch;
+        if (ml >= 15)
+        {
+            *token |= 15;
+            out = writeLength(out, ml - 15);
+        }
+        else
+        {
+            *token |= (uint8_t)ml;
+        }
+        return out;
+    }
+}
+
+uint32_t Lz4::compress(const char* src, uint32_t srcLen, char* dst, uint32_t dstCap)
+{
+    const uint8_t* in = (const uint8_t*)src;
+    uint8_t* out = (uint8_t*)dst;
+    uint8_t* outEnd = out + dstCap;
+    uint32_t anchor = 0;
+
+    if (srcLen > kMFLimit)
+    {
+        uint32_t table[1 << kHashLog];
+        memset(table, 0, sizeof(table));
+
+        uint32_t matchLimit = srcLen - kLastLiterals;
+        uint32_t posLimit = srcLen - kMFLimit;
+        uint32_t pos = 0;
+        uint32_t missNum = 0;
+        while (pos < posLimit)
+        {
+            uint32_t seq = read32(in + pos);
+            uint32_t h = hash(seq);
+            uint32_t ref = table[h];
+            table[h] = pos;
+
+            if (ref >= pos || pos - ref > kMaxOffset || read32(in + ref) != seq)
+            {
+                pos += 1 + (missNum++ >> kSkipStrength);
+                continue;
+            }
+
+            uint32_t matchLen = kMinMatch;
+            while (pos + matchLen < matchLimit && in[ref + matchLen] == in[pos + matchLen])
+            {
+                matchLen++;
+            }
+
+            out = writeSequence(out, outEnd, in + anchor, pos - anchor, pos - ref, matchLen, false);
+            if (NULL == out)
+            {
+                return 0;
+            }
+            pos += matchLen;
+            anchor = pos;
+            missNum = 0;
+        }
+    }
+
+    out = writeSequence(out, outEnd, in + anchor, srcLen - anchor, 0, 0, true);
+    if (NULL == out)
+    {
+        return 0;
+    }
+    return (uint32_t)(out - (uint8_t*)dst);
+}
+
+bool Lz4::decompress(const char* src, uint32_t srcLen, char* dst, uint32_t dstLen)
+{
+    const uint8_t* in = (const uint8_t*)src;
+    const uint8_t* inEnd = in + srcLen;
+    uint8_t* out = (uint8_t*)dst;
+    uint8_t* outEnd = out + dstLen;
+
+    while (in < inEnd)
+    {
+        uint32_t token = *in++;
+
+        uint32_t literalLen = token >> 4;
+        if (15 == literalLen && !readLength(in, inEnd, literalLen))
+        {
+            return false;
+        }
+        if (literalLen > (uint64_t)(inEnd - in) || literalLen > (uint64_t)(outEnd - out))
+        {
+            return false;
+        }
+        memcpy(out, in, literalLen);
+        out += literalLen;
+        in += literalLen;
+
+        // 最后一段只有字面量
+        if (in == inEnd)
+        {
+            break;
+        }
+
+        if (inEnd - in < 2)
+        {
+            return false;
+        }
+        uint32_t offset = in[0] | ((uint32_t)in[1] << 8);
+        in += 2;
+        if (0 == offset || offset > (uint64_t)(out - (uint8_t*)dst))
+        {
+            return false;
+        }
+
+        uint32_t matchLen = token & 15;
+        if (15 == matchLen && !readLength(in, inEnd, matchLen))
+        {
+            return false;
+        }
+        matchLen += kMinMatch;
+        if (matchLen > (uint64_t)(outEnd - out))
+        {
+            return false;
+        }
+
+        // 匹配可能和输出重叠，重叠时只能逐字节复制
+        const uint8_t* match = out - offset;
+        if (offset >= matchLen)
+        {
+            memcpy(out, match, matchLen);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < matchLen; i++)
+            {
+                out[i] = match[i];
+            }
+        }
+        out += matchLen;
+    }
+    return out == outEnd;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+
+// LZ4 block格式的压缩和解压，不依赖外部库
+// 压缩使用单个hash表的贪心匹配，速度优先；解压对输入做完整的越界检查
+class Lz4
+{
+public:
+    // @return : 压缩后的长度，dstCap放不下时返回0
+    static uint32_t compress(const char* src, uint32_t srcLen, char* dst, uint32_t dstCap);
+
+    // 解压后的长度必须正好是dstLen
+    static bool decompress(const char* src, uint32_t srcLen, char* dst, uint32_t dstLen);
+};
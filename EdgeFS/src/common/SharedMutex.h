@@ -0,0 +1,52 @@
+#pragma once
+
+#include <pthread.h>
+#include "noncopyable.h"
+
+// C++11没有std::shared_mutex，用pthread读写锁实现相同的接口，独占时可以配合std::lock_guard使用
+// 有写入在等待时新的读取也等待，持续的读取不会让写入一直拿不到锁，同一个线程不能重复加读锁
+class SharedMutex : noncopyable
+{
+public:
+    SharedMutex()
+    {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        pthread_rwlock_init(&m_lock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    }
+
+    ~SharedMutex()
+    {
+        pthread_rwlock_destroy(&m_lock);
+    }
+
+public:
+    void lock()             { pthread_rwlock_wrlock(&m_lock); }
+    void unlock()           { pthread_rwlock_unlock(&m_lock); }
+    void lock_shared()      { pthread_rwlock_rdlock(&m_lock); }
+    void unlock_shared()    { pthread_rwlock_unlock(&m_lock); }
+
+private:
+    pthread_rwlock_t    m_lock;
+};
+
+// 同std::lock_guard，构造时加读锁，析构时释放
+class SharedLockGuard : noncopyable
+{
+public:
+    explicit SharedLockGuard(SharedMutex& mutex)
+    : m_mutex(mutex)
+    {
+        m_mutex.lock_shared();
+    }
+
+    ~SharedLockGuard()
+    {
+        m_mutex.unlock_shared();
+    }
+
+private:
+    SharedMutex&    m_mutex;
+};
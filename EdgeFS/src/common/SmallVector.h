@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+前N个元素存放在对象内部的数组中，超出后才申请堆内存
+只用于可以直接memcpy的简单类型，用于读写路径上避免每次调用的内存申请
+*/
+template<typename T, uint32_t N>
+class SmallVector
+{
+public:
+    SmallVector()
+    : m_pData(m_inlineData)
+    , m_size(0)
+    , m_capacity(N)
+    {}
+
+    ~SmallVector()
+    {
+        if (m_pData != m_inlineData)
+        {
+            free(m_pData);
+        }
+    }
+
+    SmallVector(const SmallVector&) = delete;
+    void operator = (const SmallVector&) = delete;
+
+public:
+    void push_back(const T& val)
+    {
+        if (m_size == m_capacity)
+        {
+            grow();
+        }
+        m_pData[m_size++] = val;
+    }
+
+    void clear()
+    {
+        m_size = 0;
+    }
+
+    uint32_t size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return 0 == m_size;
+    }
+
+    T& operator [] (uint32_t idx)
+    {
+        return m_pData[idx];
+    }
+
+    const T& operator [] (uint32_t idx) const
+    {
+        return m_pData[idx];
+    }
+
+    T* begin()              { return m_pData; }
+    T* end()                { return m_pData + m_size; }
+    const T* begin() const  { return m_pData; }
+    const T* end() const    { return m_pData + m_size; }
+
+private:
+    void grow()
+    {
+        uint32_t capacity = m_capacity * 2;
+        T* pData = (T*)malloc(sizeof(T) * capacity);
+        if (NULL == pData)
+        {
+            // release版本关闭了异常，与new失败的行为保持一致
+            abort();
+        }
+        memcpy(pData, m_pData, sizeof(T) * m_size);
+        if (m_pData != m_inlineData)
+        {
+            free(m_pData);
+        }
+        m_pData = pData;
+        m_capacity = capacity;
+    }
+
+private:
+    T*          m_pData;
+    uint32_t    m_size;
+    uint32_t    m_capacity;
+    T           m_inlineData[N];
+};
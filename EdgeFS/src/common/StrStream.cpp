@@ -1,7 +1,7 @@
 #include "StrStream.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include "BufferPool.h"
 
 namespace apd_vp2p
 {
@@ -14,7 +14,7 @@ StrStream::StrStream()
     , m_size(0)
     , m_maxSize(kMaxLogSize)
 {
-    m_data = (char*) BufferPool::allocBuff(m_maxSize);
+    m_data = (char*)malloc(m_maxSize);
     if (m_data)
     {
         m_data[0] = 0;
@@ -26,7 +26,7 @@ StrStream::StrStream(uint32_t maxSize)
     , m_size(0)
     , m_maxSize(maxSize)
 {
-    m_data = (char*)BufferPool::allocBuff(m_maxSize);
+    m_data = (char*)malloc(m_maxSize);
     if (m_data)
     {
         m_data[0] = 0;
@@ -35,7 +35,7 @@ StrStream::StrStream(uint32_t maxSize)
 
 StrStream::~StrStream()
 {
-    BufferPool::freeBuff(m_data);
+    free(m_data);
 }
 
 StrStream& StrStream::operator << (uint8_t val)
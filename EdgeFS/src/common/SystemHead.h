@@ -8,11 +8,15 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <errno.h>
+#include <assert.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <limits.h>
 
 // C++ head file
 #include <thread>
@@ -27,3 +31,4 @@
 #include <condition_variable>
 #include <functional>
 #include <random>
+#include <algorithm>
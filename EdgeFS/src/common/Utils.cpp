@@ -1 +1,35 @@
 #include "./Utils.h"
+
+namespace
+{
+    struct Crc32Table
+    {
+        uint32_t    m_table[256];
+
+        Crc32Table()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t val = i;
+                for (uint32_t j = 0; j < 8; j++)
+                {
+                    val = (val & 1) ? (0xEDB88320u ^ (val >> 1)) : (val >> 1);
+                }
+                m_table[i] = val;
+            }
+        }
+    };
+
+    const Crc32Table kCrc32Table;
+}
+
+uint32_t Utils::crc32(const void* buff, uint64_t len, uint32_t crc)
+{
+    const uint8_t* p = (const uint8_t*)buff;
+    crc = ~crc;
+    for (uint64_t i = 0; i < len; i++)
+    {
+        crc = kCrc32Table.m_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -16,4 +16,7 @@ public:
             val = max;
         }
     }
+
+    // 标准的crc32(多项式0xEDB88320)，crc为之前数据的结果，可以分段计算
+    static uint32_t crc32(const void* buff, uint64_t len, uint32_t crc = 0);
 };
\ No newline at end of file
@@ -1,13 +1,16 @@
-#pragma once
-
-class FileOper;
-
-#include "SystemHead.h"
-#include "macro.h"
-#include "Sha1Helper.h"
-#include "Utils.h"
-#include "noncopyable.h"
-
-#include "logger.h"
-#include "AsyncLogging.h"
+#pragma once
+
+class FileOper;
+
+#include "SystemHead.h"
+#include "macro.h"
+#include "Sha1Helper.h"
+#include "Utils.h"
+#include "noncopyable.h"
+#include "SharedMutex.h"
+#include "SmallVector.h"
+#include "Lz4.h"
+
+#include "logger.h"
+#include "AsyncLogging.h"
 #include "FileOper.h"
\ No newline at end of file
@@ -1,31 +1,77 @@
-#pragma once
-#include "./common.h"
-
-enum LogLevel
-{
-    LogLevel_DEBUG,
-    LogLevel_INFO,
-    LogLevel_NOTICE,    // 用户时间的通知
-    LogLevel_WARN,
-    LogLevel_ERROR,
-    LogLevel_FATAL,     // 致命告警，出现则应该立即停止运行
-    LogLevel_NONE,      // 不输出日志
-};
-
-void mediaLog(LogLevel level, const char* level_str, const char* file, const char* format, ...) __attribute__((format(printf,4,5)));
-
-#if 1
-#define logger(level, level_str, format, args...) \
-        do { mediaLog(level, level_str, __FILE__, "-%s:%d] " format, __FUNCTION__, __LINE__, ##args); } while(0)
-#else
-#define logger(level, level_str, format, args...)   \
-        do { mediaLog(level, "%s " format, level_str, ##args); } while(0)
-#endif
-
-#define  ldebug(format, args...)        logger(LogLevel_DEBUG,  "D", format, ##args)
-#define  linfo(format, args...)         logger(LogLevel_INFO,   "I", format, ##args)
-#define  lnotice(format, args...)       logger(LogLevel_NOTICE, "N", format, ##args)
-#define  lwarn(format, args...)         logger(LogLevel_WARN,   "W", format, ##args)
-#define  lerror(format, args...)        logger(LogLevel_ERROR,  "E", format, ##args)
-#define  lfatal(format, args...)        logger(LogLevel_FATAL,  "F", format, ##args)
-
+#pragma once
+#include "./common.h"
+
+enum LogLevel
+{
+    LogLevel_DEBUG,
+    LogLevel_INFO,
+    LogLevel_NOTICE,    // 用户时间的通知
+    LogLevel_WARN,
+    LogLevel_ERROR,
+    LogLevel_FATAL,     // 致命告警，出现则应该立即停止运行
+    LogLevel_NONE,      // 不输出日志
+};
+
+// 编译期的最低日志级别，取LogLevel的值，低于它的调用点不生成代码，参数也不会求值
+// 例如 -DEDGEFS_LOG_MIN_LEVEL=1 去掉所有ldebug
+#ifndef EDGEFS_LOG_MIN_LEVEL
+#define EDGEFS_LOG_MIN_LEVEL 0
+#endif
+
+void mediaLog(LogLevel level, const char* level_str, const char* file, const char* format, ...) __attribute__((format(printf,4,5)));
+
+// 只用于编译期检查格式和参数，不会被调用
+inline void mediaLogCheck(const char*, ...) __attribute__((format(printf,1,2)));
+inline void mediaLogCheck(const char*, ...) {}
+
+// 日志调用点，每处调用一个静态变量，二进制日志只记录它的编号和参数
+typedef struct LogSite_
+{
+    LogLevel                m_level;
+    const char*             m_levelStr;
+    const char*             m_file;
+    const char*             m_function;
+    uint32_t                m_line;
+    const char*             m_format;   // 以"-%s:%d] "开头，对应函数名和行号
+    std::atomic<uint32_t>   m_id;       // 第一次输出时分配，0表示还没有分配
+    std::atomic<uint64_t>   m_tatNs;    // 限速用，下一条日志理论上的到达时间
+    std::atomic<uint64_t>   m_suppressNum;  // 限速丢弃后还没有报告的条数
+
+    constexpr LogSite_(LogLevel level, const char* levelStr, const char* file, const char* function, uint32_t line,
+        const char* format)
+    : m_level(level)
+    , m_levelStr(levelStr)
+    , m_file(file)
+    , m_function(function)
+    , m_line(line)
+    , m_format(format)
+    , m_id(0)
+    , m_tatNs(0)
+    , m_suppressNum(0)
+    {}
+} LogSite;
+
+// 先判断级别和限速，输出时才对参数求值，例如被过滤的ldebug("%s", info.print().c_str())不会构造字符串
+#if 1
+#define logger(level, level_str, format, args...) \
+        do { \
+            if (false) { mediaLogCheck("-%s:%d] " format, __FUNCTION__, __LINE__, ##args); } \
+            if ((int)level >= EDGEFS_LOG_MIN_LEVEL && mediaLogIsOn(level)) { \
+                static LogSite s_logSite(level, level_str, __FILE__, __FUNCTION__, __LINE__, "-%s:%d] " format); \
+                if (mediaLogAcquire(&s_logSite)) { \
+                    mediaLogSite(&s_logSite, ##args); \
+                } \
+            } \
+        } while(0)
+#else
+#define logger(level, level_str, format, args...)   \
+        do { mediaLog(level, "%s " format, level_str, ##args); } while(0)
+#endif
+
+#define  ldebug(format, args...)        logger(LogLevel_DEBUG,  "D", format, ##args)
+#define  linfo(format, args...)         logger(LogLevel_INFO,   "I", format, ##args)
+#define  lnotice(format, args...)       logger(LogLevel_NOTICE, "N", format, ##args)
+#define  lwarn(format, args...)         logger(LogLevel_WARN,   "W", format, ##args)
+#define  lerror(format, args...)        logger(LogLevel_ERROR,  "E", format, ##args)
+#define  lfatal(format, args...)        logger(LogLevel_FATAL,  "F", format, ##args)
+